@@ -7,6 +7,7 @@
 #include "elasticMsg.h"
 #include "r2dnMsg.h"
 #include "path.h"
+#include "smfTimingWheel.h"  // used for UpstreamHistory aging
 #include <list>
 #include <sstream>
 #include <vector>
@@ -329,7 +330,8 @@ class MulticastFIB
         // (The IPv4 UMP header extension is used to apply a sequence number
         //  by "upstream" relays to support link quality measurement by
         //  "downstream" relays/nodes.
-        class UpstreamHistory : public ProtoTree::Item
+        // (Smf::Interface schedules its upstream histories in a timing wheel for aging)
+        class UpstreamHistory : public ProtoTree::Item, public SmfTimingWheel::Item
         {
             public:
                 UpstreamHistory(const ProtoAddress& addr);
@@ -2,6 +2,8 @@
 #define _SMF
 #include "protoDefs.h"
 #include "smfHash.h"
+#include "smfHashMulti.h"
+#include "smfPktInfo.h"
 #include "smfDpd.h"
 #include "smfQueue.h"    // for optional per-flow interface queues
 #include "protoTimer.h"
@@ -91,6 +93,50 @@ class Smf
             idpd_enable = state ? true : idpd_enable;
         }
         
+        // Sets the duplicate packet detection mechanism (SmfDpd::TABLE,
+        // SmfDpd::HASH_TABLE, or SmfDpd::FILTER) used for new interfaces
+        // ("window" overrides this)
+        void SetDpdType(SmfDpd::Type dpdType)
+            {dpd_type = dpdType;}
+        SmfDpd::Type GetDpdType() const
+            {return dpd_type;}
+        // Sets the detector parameters (filter memory budget, window size
+        // bounds, etc) used for new interfaces
+        void SetDpdParams(const SmfDpd::Params& params)
+        {
+            dpd_params = params;
+            dpd_params.shared_store = &shared_dpd;
+            dpd_params.flow_budget = &flow_budget;
+            dpd_params.state_file = state_file.IsOpen() ? &state_file : NULL;
+        }
+        const SmfDpd::Params& GetDpdParams() const
+            {return dpd_params;}
+        // Initializes the node-wide store used by SmfDpd::SHARED interfaces
+        // (if not already initialized or if "capacity" is non-zero)
+        bool InitSharedDpd(unsigned int capacity = 0);
+        const SmfDpdHashTable& GetSharedDpd() const
+            {return shared_dpd;}
+        // Sets the node-wide limit on DPD (table and window), sequence, and
+        // hash history flows (least-recently-updated flows are evicted)
+        void SetFlowBudget(unsigned int flowMax)
+            {flow_budget.SetFlowMax(flowMax, current_update_time);}
+        const SmfFlowBudget& GetFlowBudget() const
+            {return flow_budget;}
+        // Keeps window DPD and resequencing flow state in a memory-mapped
+        // "path" file that is adopted upon restart if it is no older than
+        // "staleMax" seconds (see smfState.h)
+        bool OpenStateFile(const char*  path,
+                           unsigned int staleMax = SmfStateFile::STALE_MAX_DEFAULT,
+                           unsigned int capacity = SmfStateFile::CAPACITY_DEFAULT);
+        void CloseStateFile();
+        const SmfStateFile& GetStateFile() const
+            {return state_file;}
+        // Duration of the last (and longest) periodic flow state prune (usec)
+        unsigned int GetPruneTime() const
+            {return prune_usec_last;}
+        unsigned int GetPruneTimeMax() const
+            {return prune_usec_max;}
+        
 #ifdef ELASTIC_MCAST
         void SetUnreliableTOS(UINT8 tos)
             {unreliable_tos = tos;}
@@ -156,7 +202,11 @@ class Smf
                 Interface(unsigned int ifIndex, const char *ifName);
                 ~Interface();
                 
-                bool Init(bool useWindow);// = false);  // (TBD) add parameters for DPD window, etc
+                bool Init(SmfDpd::Type dpdType, const SmfDpd::Params& dpdParams);
+                // Replaces the interface's duplicate packet detector (any DPD state is discarded)
+                bool SetDpdType(SmfDpd::Type dpdType, const SmfDpd::Params& dpdParams);
+                SmfDpd::Type GetDpdType() const
+                    {return ((NULL != dup_detector) ? dup_detector->GetType() : SmfDpd::TABLE);}
                 void Destroy();
                 
                 unsigned int GetIndex() const
@@ -185,14 +235,13 @@ class Smf
                 const ProtoAddress& GetIpAddress() const
                     {return ip_addr;}
                         
-                bool IsDuplicatePkt(unsigned int   currentTime,
-                                    const char*    flowId,
-                                    unsigned int   flowIdSize,   // in bits
-                                    const char*    pktId,
-                                    unsigned int   pktIdSize)    // in bits 
+                bool IsDuplicatePkt(unsigned int      currentTime,
+                                    const SmfFlowKey& flowKey,
+                                    const char*       pktId,
+                                    unsigned int      pktIdSize)    // in bits 
                 {
                     ASSERT(NULL != dup_detector);
-                    return (dup_detector->IsDuplicate(currentTime, flowId, flowIdSize, pktId, pktIdSize));   
+                    return (dup_detector->IsDuplicate(currentTime, flowKey, pktId, pktIdSize));   
                 } 
                 
                 void PruneDuplicateDetector(unsigned int currentTime, unsigned int ageMax)
@@ -203,6 +252,21 @@ class Smf
                 
                 unsigned int GetFlowCount() const
                     {return ((NULL != dup_detector) ? dup_detector->GetFlowCount() : 0);}
+                unsigned int GetFlowCacheHitCount() const
+                    {return ((NULL != dup_detector) ? dup_detector->GetFlowCacheHitCount() : 0);}
+                unsigned int GetFlowCacheMissCount() const
+                    {return ((NULL != dup_detector) ? dup_detector->GetFlowCacheMissCount() : 0);}
+                unsigned int GetFlowEvictionCount() const
+                    {return ((NULL != dup_detector) ? dup_detector->GetFlowEvictionCount() : 0);}
+                // Probabilistic DPD filter statistics (NULL unless SmfDpd::FILTER is used)
+                const SmfDpdFilter* GetDpdFilter() const
+                    {return ((SmfDpd::FILTER == GetDpdType()) ? static_cast<const SmfDpdFilter*>(dup_detector) : NULL);}
+                // Window DPD statistics (NULL unless SmfDpd::WINDOW is used)
+                const SmfDpdWindow* GetDpdWindow() const
+                    {return ((SmfDpd::WINDOW == GetDpdType()) ? static_cast<const SmfDpdWindow*>(dup_detector) : NULL);}
+                // Attaches window DPD state to the "stateFile" (NULL to detach) and
+                // adopts any of its pending records for this interface
+                unsigned int SetStateFile(SmfStateFile* stateFile, unsigned int currentTime);
                 
                 void IncrementUnicastGroupCount()
                     {unicast_group_count++;}
@@ -313,15 +377,17 @@ class Smf
 #ifdef ELASTIC_MCAST                        
                 MulticastFIB::UpstreamHistory* FindUpstreamHistory(const ProtoAddress& upstreamAddr)
                     {return upstream_history_table.FindUpstreamHistory(upstreamAddr);}
-                void AddUpstreamHistory(MulticastFIB::UpstreamHistory& upstreamHistory)
-                    {upstream_history_table.Insert(upstreamHistory);}
+                void AddUpstreamHistory(MulticastFIB::UpstreamHistory& upstreamHistory, unsigned int currentTime);
                 void RemoveUpstreamHistory(MulticastFIB::UpstreamHistory& upstreamHistory)
-                    {upstream_history_table.Remove(upstreamHistory);}
+                {
+                    upstream_history_wheel.Cancel(upstreamHistory);
+                    upstream_history_table.Remove(upstreamHistory);
+                }
                 UINT16 GetLocalAdvId() const
                     {return local_adv_id;}
                 UINT16 IncrementLocalAdvId()
                     {return local_adv_id++;}
-                void PruneUpstreamHistory(unsigned int currentTick);
+                void PruneUpstreamHistory(unsigned int currentTick, unsigned int currentTime);
                 void SetRepairWindow(double sec)
                     {repair_window = sec;}
                 double GetRepairWindow() const
@@ -465,6 +531,7 @@ class Smf
                 SmfQueue                              pkt_queue;           // interface output queue
 #ifdef ELASTIC_MCAST                
                 MulticastFIB::UpstreamHistoryTable    upstream_history_table;
+                SmfTimingWheel                        upstream_history_wheel;  // upstream histories by next age check
                 double                                repair_window;      // in secs (max retransmit packet age)
                 UINT16                                local_adv_id;
                 bool                                  elastic_mcast;
@@ -665,10 +732,49 @@ class Smf
         // Return value indicates how many outbound (dst) ifaces to forward over
         // Notes:
         // 1) This decrements the ttl/hopLimit of the "ipPkt"
-        // 2)
+        // 2) The optional "pktInfo" is the packet's descriptor (see smfPktInfo.h)
+        //    if the caller has already parsed it
         int ProcessPacket(ProtoPktIP& ipPkt, const ProtoAddress& srcMac, const ProtoAddress& dstMac, 
                           Interface& srcIface, unsigned int dstIfArray[], unsigned int dstIfArraySize, 
-                          ProtoPktETH& ethPkt, bool outbound = false, bool* recvDup = NULL);
+                          ProtoPktETH& ethPkt, bool outbound = false, bool* recvDup = NULL,
+                          const SmfPktInfo* pktInfo = NULL)
+        {
+            return ProcessPacketVRF(ipPkt, srcMac, dstMac, srcIface, dstIfArray, dstIfArraySize, ethPkt, 
+                                    outbound, recvDup, vrf_list.GetVRFbyIfaceIndex(srcIface.GetIndex()),
+                                    pktInfo);
+        }
+        
+        // An entry for ProcessPacketBatch().  The caller sets up the packet,
+        // address and "dst_if_array" members (and optionally "pkt_info") and the
+        // "dst_count" (the ProcessPacket() return value) and "recv_dup" results
+        // are filled in.
+        class BatchPacket
+        {
+            public:
+                BatchPacket()
+                 : dst_if_array(NULL), dst_if_array_size(0), dst_count(0), recv_dup(false) {}
+                
+                ProtoPktIP      ip_pkt;
+                ProtoPktETH     eth_pkt;
+                ProtoAddress    prev_hop_addr;
+                ProtoAddress    dst_mac_addr;
+                SmfPktInfo      pkt_info;
+                unsigned int*   dst_if_array;
+                unsigned int    dst_if_array_size;
+                int             dst_count;
+                bool            recv_dup;
+        };  // end class Smf::BatchPacket
+        
+        // Processes a batch of packets received on the same "srcIface".  The
+        // per-interface lookups (e.g., the source VRF) are done once for the batch
+        // and upcoming packet headers are prefetched as each packet is processed.
+        // When the hash algorithm supports it, the H-DPD hash values are computed
+        // SmfHashMulti::LANES packets at a time (see smfHashMulti.h), skipping the
+        // packets that ProcessPacketVRF() discards (or doesn't hash) beforehand.
+        // Return value is the number of batch packets to forward (dst_count > 0)
+        enum {BATCH_PREFETCH = 4};  // how many packets ahead to prefetch
+        unsigned int ProcessPacketBatch(BatchPacket* batch[], unsigned int count, 
+                                        Interface& srcIface, bool outbound = false);
 		unsigned int GetInterfaceList(Interface& srcIface, unsigned int dstIfArray[], int dstIfArrayLength);
         void SetRelayEnabled(bool state);
         bool GetRelayEnabled() const
@@ -756,6 +862,7 @@ class Smf
         
         static const unsigned int DEFAULT_AGE_MAX; // (in seconds)
         static const unsigned int PRUNE_INTERVAL;  // (in seconds)
+        static const unsigned int SHARED_DPD_CAPACITY_DEFAULT;  // (in packet ids)
         
 
         
@@ -818,6 +925,13 @@ class Smf
 #endif // ELASTIC_MCAST
         
     private:
+        int ProcessPacketVRF(ProtoPktIP& ipPkt, const ProtoAddress& srcMac, const ProtoAddress& dstMac, 
+                             Interface& srcIface, unsigned int dstIfArray[], unsigned int dstIfArraySize, 
+                             ProtoPktETH& ethPkt, bool outbound, bool* recvDup, SmfVRF* vrf,
+                             const SmfPktInfo* pktInfo = NULL);
+        // Used by ProcessPacketBatch() to hash only the packets ProcessPacketVRF() would hash
+        bool IsBatchHashPacket(ProtoPktIP& ipPkt, const Interface& srcIface, bool outbound) const;
+        
         // These are used to mark the IPSec "type" for DPD
         static const char AH;
         static const char ESP;
@@ -833,9 +947,16 @@ class Smf
         ProtoTimerMgr&      timer_mgr;
         
         SmfHash*            hash_algorithm;
+        SmfHashMulti*       hash_multi;     // batch hashing for hash_algorithm (if supported)
         bool                ihash_only;
         bool                idpd_enable;
         bool                use_window;
+        SmfDpd::Type        dpd_type;
+        SmfDpd::Params      dpd_params;
+        SmfDpdHashTable     shared_dpd;     // node-wide store for SmfDpd::SHARED
+        SmfFlowBudget       flow_budget;    // node-wide flow state limit
+        SmfStateFile        state_file;     // warm restart flow state
+        bool                state_pending;  // adopted records not yet released
         
         SmfCacheTable           cache_table;  // used for optional reliable forwarding
         SmfIndexedPacket::Pool  indexed_pkt_pool;
@@ -863,6 +984,8 @@ class Smf
         ProtoTimer          prune_timer;     // to timeout stale flows
         unsigned int        update_age_max;  // max staleness allowed for flows
         unsigned int        current_update_time;
+        unsigned int        prune_usec_last; // prune timeout handling (i.e. forwarding stall) duration
+        unsigned int        prune_usec_max;
 #ifdef ELASTIC_MCAST
         UINT8               unreliable_tos;
 #endif // ELASTIC_MCAST
@@ -36,7 +36,11 @@
 
 #include "protoTree.h"
 #include "protoAddress.h"
-#include "protoBitmask.h"
+#include "smfWindowMask.h"
+#include "smfSlab.h"
+#include "smfTimingWheel.h"
+#include "smfState.h"
+#include "smfFlowKey.h"
 
 
 // Both the "window" (sequence) and "table" lookup approaches to DPD use
@@ -53,8 +57,18 @@ class SmfFlow : public ProtoTree::Item
     public:
         virtual ~SmfFlow();
 
-        const char* GetKey() const {return flow_id;}
-        unsigned int GetKeysize() const {return flow_id_size;}
+        const char* GetKey() const {return flow_key.GetBuffer();}
+        unsigned int GetKeysize() const {return flow_key.GetSize();}
+        UINT32 GetHash() const {return flow_key.GetHash();}
+        const SmfFlowKey& GetFlowKey() const {return flow_key;}
+
+        // Flow update time (used for aging/pruning and budget eviction)
+        void SetUpdateTime(unsigned int currentTime)
+            {update_time = currentTime;}
+        unsigned int GetUpdateTime() const
+            {return update_time;}
+        unsigned int GetAge(unsigned int currentTime) const
+            {return (currentTime - update_time);}
 
         virtual void Destroy();
         class Iterator;
@@ -69,8 +83,8 @@ class SmfFlow : public ProtoTree::Item
 
                 void Append(SmfFlow& flow);
 
-                SmfFlow* Find(const char* flowId, unsigned int flowIdBits) const
-                    {return static_cast<SmfFlow*>(flow_tree.Find(flowId, flowIdBits));}
+                // Checks the flow cache before the flow_tree
+                SmfFlow* Find(const SmfFlowKey& flowKey) const;
 
                 void MoveToTail(SmfFlow& flow)
                 {
@@ -80,6 +94,7 @@ class SmfFlow : public ProtoTree::Item
 
                 void Remove(SmfFlow& flow)
                 {
+                    Uncache(flow);
                     RemoveFromList(flow);
                     flow_tree.Remove(flow);
                     count--;
@@ -88,6 +103,12 @@ class SmfFlow : public ProtoTree::Item
                 unsigned int GetCount() const
                     {return count;}
 
+                // Flow cache statistics
+                unsigned int GetCacheHitCount() const
+                    {return cache_hits;}
+                unsigned int GetCacheMissCount() const
+                    {return cache_misses;}
+
                 SmfFlow* GetHead() const
                     {return head;}
 
@@ -97,10 +118,26 @@ class SmfFlow : public ProtoTree::Item
                 void AppendToList(SmfFlow& flow);
                 void RemoveFromList(SmfFlow& flow);
 
-                unsigned int count;
-                ProtoTree    flow_tree;
-                SmfFlow*     head;  // stalest flow at head of linked list
-                SmfFlow*     tail;  // freshest flow at tail of linked list
+                // The flow cache is a small 2-way set associative cache (indexed by
+                // flow id hash) in front of the flow_tree so lookups for the most
+                // active flows avoid a bitwise Patricia tree descent.
+                enum {CACHE_SETS = 64};
+                struct CacheEntry
+                {
+                    UINT32      hash;
+                    SmfFlow*    flow;   // NULL if unused
+                };
+                void Cache(SmfFlow& flow) const;
+                void Uncache(SmfFlow& flow);
+                void ClearCache();
+
+                unsigned int         count;
+                ProtoTree            flow_tree;
+                SmfFlow*             head;  // stalest flow at head of linked list
+                SmfFlow*             tail;  // freshest flow at tail of linked list
+                mutable CacheEntry   flow_cache[CACHE_SETS][2];  // (most recently used way first)
+                mutable unsigned int cache_hits;
+                mutable unsigned int cache_misses;
         };  // end class SmfFlow::List
 
 
@@ -130,8 +167,7 @@ class SmfFlow : public ProtoTree::Item
     protected:
         SmfFlow();
 
-        bool Init(const char*         flowId,
-                  unsigned int        flowIdSize); // in bits
+        bool Init(const SmfFlowKey& flowKey);
 
         // List linking (used for aging/pruning entries)
         void Append(SmfFlow* nextFlow)
@@ -141,23 +177,123 @@ class SmfFlow : public ProtoTree::Item
         SmfFlow* GetPrev() {return prev;}
         SmfFlow* GetNext() {return next;}
 
-        char*               flow_id;
-        unsigned int        flow_id_size;
+        SmfFlowKey          flow_key;
+        unsigned int        update_time;
         SmfFlow*            prev;
         SmfFlow*            next;
 
 };  // end class SmfFlow
 
+// The SmfFlowBudget class bounds the total number of flows (node-wide) kept
+// by the flow state "members" (SmfDpdTable, SmfDpdWindow, and SmfSequenceMgr
+// instances) that join it.  When a member adds a flow that puts the total
+// over budget, the least-recently-updated flow among all members is evicted.
+// Notes:
+// 1) Each member's flow list is kept in update order, so only the list heads
+//    are compared.  Flow update times have the (coarse) granularity of the
+//    "currentTime" the members are given, so ties are broken arbitrarily.
+// 2) A zero "flowMax" (the default) means no limit.
+
+class SmfFlowBudget
+{
+    public:
+        SmfFlowBudget();
+        ~SmfFlowBudget();
+
+        class Member
+        {
+            friend class SmfFlowBudget;
+            public:
+                virtual ~Member();
+
+                // Joins the given budget (or leaves the current one if NULL)
+                void SetFlowBudget(SmfFlowBudget* budget);
+                SmfFlowBudget* GetFlowBudget() const
+                    {return flow_budget;}
+                // Flows evicted from this member
+                unsigned int GetEvictionCount() const
+                    {return eviction_count;}
+
+            protected:
+                Member(const SmfFlow::List& flowList);
+
+                // Members call this after appending "newFlow" (which is not evicted)
+                void EnforceFlowBudget(unsigned int currentTime, const SmfFlow& newFlow)
+                {
+                    if (NULL != flow_budget)
+                        flow_budget->Enforce(currentTime, &newFlow);
+                }
+
+                // Removes and deletes the given flow (i.e., the member's stalest flow)
+                virtual void EvictFlow(SmfFlow& flow) = 0;
+
+            private:
+                const SmfFlow::List&    budget_flow_list;
+                SmfFlowBudget*          flow_budget;
+                unsigned int            eviction_count;
+                Member*                 budget_prev;
+                Member*                 budget_next;
+
+        };  // end class SmfFlowBudget::Member
+
+        // Sets the flow limit (zero is unlimited), evicting flows as needed
+        void SetFlowMax(unsigned int flowMax, unsigned int currentTime);
+        unsigned int GetFlowMax() const
+            {return flow_max;}
+
+        // Total flows kept by all members
+        unsigned int GetFlowCount() const;
+        unsigned int GetEvictionCount() const
+            {return eviction_count;}
+
+        // Evicts the least-recently-updated flows until within budget
+        void Enforce(unsigned int currentTime, const SmfFlow* newFlow = NULL);
+
+    private:
+        void Add(Member& member);
+        void Remove(Member& member);
+
+        unsigned int    flow_max;
+        unsigned int    eviction_count;
+        Member*         member_head;
+
+};  // end class SmfFlowBudget
+
+class SmfDpdHashTable;
+
 class SmfDpd
 {
     public:
         virtual ~SmfDpd();
 
+        // Duplicate packet detection mechanisms (see classes below)
+        enum Type
+        {
+            TABLE,      // SmfDpdTable
+            WINDOW,     // SmfDpdWindow
+            HASH_TABLE, // SmfDpdHashTable
+            FILTER,     // SmfDpdFilter
+            SHARED      // SmfDpdShared
+        };
+        virtual Type GetType() const = 0;
+
+        // Detector parameters (see the Init() methods of the classes below)
+        struct Params
+        {
+            Params();
+            unsigned int    filter_memory;      // SmfDpdFilter memory budget (bytes)
+            double          filter_fp_rate;     // SmfDpdFilter target false positive rate
+            UINT32          window_size_min;    // SmfDpdWindow adaptive size bounds (packets)
+            UINT32          window_size_max;
+            SmfDpdHashTable* shared_store;      // node-wide store for SmfDpdShared
+            SmfFlowBudget*  flow_budget;        // node-wide flow budget for SmfDpdTable/SmfDpdWindow
+            SmfStateFile*   state_file;         // warm restart state for SmfDpdWindow
+        };
+
         virtual void Destroy() = 0;
 
         virtual bool IsDuplicate(unsigned int   currentTime,
-                                 const char*    flowId,
-                                 unsigned int   flowIdSize,   // in bits
+                                 const SmfFlowKey& flowKey,
                                  const char*    pktId,
                                  unsigned int   pktIdSize) = 0;     // in bits
 
@@ -165,6 +301,15 @@ class SmfDpd
 
         virtual unsigned int GetFlowCount() const = 0;
 
+        // Flow lookup cache statistics (zero if not applicable)
+        virtual unsigned int GetFlowCacheHitCount() const
+            {return 0;}
+        virtual unsigned int GetFlowCacheMissCount() const
+            {return 0;}
+        // Flows evicted to meet the node-wide SmfFlowBudget (zero if not applicable)
+        virtual unsigned int GetFlowEvictionCount() const
+            {return 0;}
+
     protected:
         SmfDpd();
 
@@ -175,7 +320,7 @@ class SmfDpd
 ///////////////////////////////////////////////////////////////////
 // Table (lookup) based duplicate packet detection classes
 
-class SmfDpdTable : public SmfDpd
+class SmfDpdTable : public SmfDpd, public SmfFlowBudget::Member
 {
     public:
         SmfDpdTable(unsigned int pktSizeMax);
@@ -184,11 +329,13 @@ class SmfDpdTable : public SmfDpd
         enum {MAX_ID_BITS = (3*128)};
         enum {MAX_ID_BYTES = (MAX_ID_BITS/8)};
 
+        Type GetType() const
+            {return TABLE;}
+
         void Destroy();
 
         bool IsDuplicate(unsigned int   currentTime,
-                         const char*    flowId,
-                         unsigned int   flowIdSize,   // in bits
+                         const SmfFlowKey& flowKey,
                          const char*    pktId,
                          unsigned int   pktIdSize);   // in bits
 
@@ -196,6 +343,12 @@ class SmfDpdTable : public SmfDpd
 
         unsigned int GetFlowCount() const
             {return (flow_list.GetCount());}
+        unsigned int GetFlowCacheHitCount() const
+            {return flow_list.GetCacheHitCount();}
+        unsigned int GetFlowCacheMissCount() const
+            {return flow_list.GetCacheMissCount();}
+        unsigned int GetFlowEvictionCount() const
+            {return GetEvictionCount();}
 
         // We keep packet id entries on a per-flow basis
         class PacketIdEntry;
@@ -222,6 +375,8 @@ class SmfDpdTable : public SmfDpd
 
                 bool IsEmpty() const
                     {return (NULL == head);}
+                unsigned int GetOldestArrivalTime() const
+                    {return ((NULL != head) ? head->arrival_time : 0);}
 
             private:
                 ProtoTree       id_tree;
@@ -239,6 +394,11 @@ class SmfDpdTable : public SmfDpd
                 PacketIdEntry();
                 ~PacketIdEntry();
 
+                static void* operator new(size_t size) noexcept
+                    {return slab.Get(size);}
+                static void operator delete(void* ptr)
+                    {slab.Put(ptr);}
+
                 unsigned int GetAge(unsigned int currentTime) const
                     {return (currentTime - arrival_time);}
 
@@ -261,20 +421,32 @@ class SmfDpdTable : public SmfDpd
                     {return next;}
 
             private:
-                UINT8*          pkt_id;
+                // Packet ids up to PKT_ID_INLINE-1 bytes (e.g. an MD5 hash) are kept inline
+                enum {PKT_ID_INLINE = 17};
+
+                UINT8*          pkt_id;     // (length, id) in "pkt_id_buf" or heap
                 unsigned int    arrival_time;
                 PacketIdEntry*  next;
+                UINT8           pkt_id_buf[PKT_ID_INLINE];
+
+                static SmfSlab  slab;
         };  // end class SmfDpdTable::PacketIdEntry
 
 
-        class Flow : public SmfFlow
+        // Flows are scheduled in the "aging_wheel" by the arrival time of their
+        // oldest packet id, so Prune() only visits flows with stale entries
+        class Flow : public SmfFlow, public SmfTimingWheel::Item
         {
             public:
                 Flow(unsigned int pktCountMax);
                 ~Flow();
 
-                bool Init(const char*   flowId,
-                          unsigned int  flowIdSize); // in bits
+                static void* operator new(size_t size) noexcept
+                    {return slab.Get(size);}
+                static void operator delete(void* ptr)
+                    {slab.Put(ptr);}
+
+                bool Init(const SmfFlowKey& flowKey);
 
                 void Prune(unsigned int             currentTime,
                            unsigned int             ageMax,
@@ -294,45 +466,71 @@ class SmfDpdTable : public SmfDpd
 
                 bool IsEmpty() const
                     {return pkt_id_table.IsEmpty();}
+                unsigned int GetOldestArrivalTime() const
+                    {return pkt_id_table.GetOldestArrivalTime();}
 
             private:
                 PacketIdTable   pkt_id_table;
                 unsigned int    pkt_count_max;  // zero means unlimited
 
+                static SmfSlab  slab;
+
         };  // end class SmfDpdTable::Flow
 
+    protected:
+        void EvictFlow(SmfFlow& flow);
+
     private:
         void Reset();
 
         SmfFlow::List           flow_list;
+        SmfTimingWheel          aging_wheel;
 
         unsigned int            pkt_count_max;  // per-flow table size limit (zero is unlimited)
 
         ProtoTree::ItemPool*    entry_pools[MAX_ID_BYTES+1];
 
-    // (TBD) add some Pools for our different entry types
-
 };  // end class SmfDpdTable
 
 
 ///////////////////////////////////////////////////////////////////
 // Window (sequence) based duplicate packet detection classes
 
-class SmfDpdWindow : public SmfDpd
+// Notes:
+// 1) When Init() is given a "windowSizeMin" less than its "windowSizeMax",
+//    each flow's window is sized adaptively between those bounds.  A flow
+//    window grows (preserving its history) when a packet arrives older than
+//    the window but within "windowSizeMax", and upon its first update after
+//    each advance of "currentTime" it is resized to cover twice the reordering
+//    depth observed since its last resize and 1/16 second of the flow's
+//    sequence number advance (shrinking by no more than half at a time).
+// 2) Window sizes are powers of 2 (bounded by half the sequence space).
+
+class SmfDpdWindow : public SmfDpd, public SmfFlowBudget::Member
 {
     public:
 		SmfDpdWindow ();
 		~SmfDpdWindow ();
 
-		bool Init(UINT32    windowSize,     // in packets
-                  UINT32    windowPastMax); // in packets
+        enum
+        {
+            SIZE_DEFAULT        = 1024,  // initial window size
+            SIZE_MIN_DEFAULT    = 64,
+            SIZE_MAX_DEFAULT    = 8192
+        };
+
+		bool Init(UINT32    windowSize,         // in packets
+                  UINT32    windowPastMax,      // in packets
+                  UINT32    windowSizeMin = 0,  // in packets (0 for fixed window size)
+                  UINT32    windowSizeMax = 0); // in packets
 
-        void Destroy()
-            {flow_list.Destroy();}
+        Type GetType() const
+            {return WINDOW;}
+
+        void Destroy();
 
 		bool IsDuplicate(unsigned int   currentTime,
-                         const char*    flowId,
-                         unsigned int   flowIdSize,   // in bits
+                         const SmfFlowKey& flowKey,
                          const char*    pktId,
                          unsigned int   pktIdSize);         // in bits
 
@@ -340,6 +538,25 @@ class SmfDpdWindow : public SmfDpd
 
         unsigned int GetFlowCount() const
             {return flow_list.GetCount();}
+        unsigned int GetFlowCacheHitCount() const
+            {return flow_list.GetCacheHitCount();}
+        unsigned int GetFlowCacheMissCount() const
+            {return flow_list.GetCacheMissCount();}
+        unsigned int GetFlowEvictionCount() const
+            {return GetEvictionCount();}
+
+        // Fills in "sizeCount[n]" with the number of flows whose window size is 2^n
+        // (for n < 32) and returns the total window bitmask memory (in bytes)
+        unsigned int GetWindowSizeCounts(unsigned int sizeCount[32]) const;
+
+        // Keeps flow state in the given "stateFile" (NULL to detach) with
+        // records tagged by "ifIndex".  Restore() adopts the file's pending
+        // records for "ifIndex" as flows and returns the number restored.
+        void SetStateFile(SmfStateFile* stateFile, UINT32 ifIndex);
+        unsigned int Restore(unsigned int currentTime);
+
+    protected:
+        void EvictFlow(SmfFlow& flow);
 
     private:
         class Flow : public SmfFlow
@@ -348,53 +565,323 @@ class SmfDpdWindow : public SmfDpd
                 Flow();
                 ~Flow();
 
-                bool Init(const char*         flowId,
-                          unsigned int        flowIdSize,     // in bits
+                static void* operator new(size_t size) noexcept
+                    {return slab.Get(size);}
+                static void operator delete(void* ptr)
+                    {slab.Put(ptr);}
+
+                bool Init(const SmfFlowKey&   flowKey,
                           UINT8               pktIdSize,      // in bits
                           UINT32              windowSize,     // in packets
-                          UINT32              windowPastMax); // in packets
+                          UINT32              windowPastMax,  // in packets
+                          UINT32              windowSizeMin,  // in packets
+                          UINT32              windowSizeMax); // in packets
 
                 void Destroy()
                 {
                     bitmask.Destroy();
                     SmfFlow::Destroy();
                 }
-                void SetUpdateTime(unsigned int currentTime)
-                    {update_time = currentTime;}
-
-                unsigned int GetAge(unsigned int currentTime) const
-                    {return (currentTime - update_time);}
+                void SetAdaptTime(unsigned int currentTime)
+                    {adapt_time = currentTime;}
 
                 bool IsDuplicate(UINT32 seqNum);
 
                 UINT32 GetRangeMask() const
                     {return bitmask.GetRangeMask();}
+                UINT32 GetWindowSize() const
+                    {return bitmask.GetSize();}
+
+                // Resizes the window per the observed reordering and sequence velocity
+                void Adapt(unsigned int currentTime);
+
+                // Restarts the window at "seq" with the window behind it marked
+                // as received (for flows restored from a state record)
+                void Restore(UINT32 seq);
+
+                void SetStateRecord(SmfStateFile::Record* record)
+                    {state_record = record;}
+                SmfStateFile::Record* GetStateRecord() const
+                    {return state_record;}
+                void SaveState()
+                {
+                    if (NULL != state_record)
+                    {
+                        bitmask.GetLastSet(state_record->value);
+                        state_record->window_size = bitmask.GetSize();
+                    }
+                }
 
             private:
-                ProtoSlidingMask bitmask;
+                bool Resize(UINT32 windowSize);
+
+                SmfWindowMask    bitmask;
                 UINT32           window_past_max;
-                unsigned int     update_time;
+                UINT32           size_min;
+                UINT32           size_max;
+                UINT32           reorder_depth;     // max "old" packet delta since last Adapt()
+                UINT32           seq_advance;       // sequence advance since last Adapt()
+                unsigned int     adapt_time;
+                SmfStateFile::Record* state_record;
+
+                static SmfSlab   slab;
 
         };  // end class SmfDpdWindow::Flow
 
+        void DeleteFlow(Flow* flow);
+
 
         SmfFlow::List   flow_list;
         UINT32          window_size;
 		UINT32          window_past_max;
+        UINT32          window_size_min;
+        UINT32          window_size_max;
+        SmfStateFile*   state_file;
+        UINT32          state_if_index;
 
 };  // end class SmfDpdWindow
 
+///////////////////////////////////////////////////////////////////
+// Fixed-capacity hash table duplicate packet detection class
+//
+// This is an alternative to SmfDpdTable that keeps the packet ids of all
+// flows inline in a single, preallocated entry array that is also used as a
+// circular "age ring" (entries are added in arrival order, so the oldest
+// entry is always at the ring tail).  A compact open-addressing (linear
+// probing) index of { hash, entry } slots is used for lookup, so a lookup
+// typically touches a single cache line of the index plus the matching
+// entry.  There is no allocation once initialized and the oldest entry
+// is evicted in O(1) time when the table is full.
+//
+// Notes:
+// 1) The capacity bounds the total number of packet ids held for all flows
+//    (instead of per flow as with SmfDpdTable).
+// 2) Per-flow state is limited to a reference count (by flow id hash) so
+//    GetFlowCount() can be reported.
+// 3) Each entry also has a 64-bit "member" mask so one table can be shared
+//    by up to 64 interfaces (see SmfDpdShared below).  A packet id is then a
+//    duplicate for a given member only if that member has already seen it.
+
+class SmfDpdHashTable : public SmfDpd
+{
+    public:
+        SmfDpdHashTable();
+        ~SmfDpdHashTable();
+
+        enum {CAPACITY_DEFAULT = 8192};
+        enum {MAX_FLOW_ID_BYTES = SmfFlowKey::KEY_BYTES_MAX};
+        enum {MAX_PKT_ID_BYTES = SmfDpdTable::MAX_ID_BYTES};
+
+        bool Init(unsigned int capacity = CAPACITY_DEFAULT); // in packet ids (rounded up to power of 2)
+
+        Type GetType() const
+            {return HASH_TABLE;}
+
+        void Destroy();
+
+        bool IsDuplicate(unsigned int   currentTime,
+                         const SmfFlowKey& flowKey,
+                         const char*    pktId,
+                         unsigned int   pktIdSize)    // in bits
+            {return IsDuplicate(currentTime, flowKey, pktId, pktIdSize, 0x01);}
+
+        // Checks (and marks) the packet id for the given "memberBit" only
+        bool IsDuplicate(unsigned int   currentTime,
+                         const SmfFlowKey& flowKey,
+                         const char*    pktId,
+                         unsigned int   pktIdSize,    // in bits
+                         UINT64         memberBit);
+
+        void Prune(unsigned int currentTime, unsigned int ageMax);
+
+        unsigned int GetFlowCount() const
+            {return flow_count;}
+        unsigned int GetEntryCount() const
+            {return entry_count;}
+        unsigned int GetCapacity() const
+            {return capacity;}
+
+        // Member index allocation for shared use (returns -1 if all 64 in use)
+        int AllocMember();
+        void ReleaseMember(int memberIndex);  // (clears the member's marks)
+        unsigned int GetMemberCount() const;
+
+    private:
+        // Index slot (a zero "value" marks an empty slot)
+        struct Slot
+        {
+            UINT32  tag;    // key hash
+            UINT32  value;  // entry index + 1 (or flow reference count)
+        };
+
+        struct Entry
+        {
+            UINT64  member_mask;    // members that have seen this packet id
+            UINT32  flow_hash;
+            UINT32  slot;           // index slot referencing this entry
+            unsigned int arrival_time;
+            UINT16  flow_id_size;   // in bits
+            UINT16  pkt_id_size;    // in bits
+            char    key[MAX_FLOW_ID_BYTES + MAX_PKT_ID_BYTES];  // flowId followed by pktId
+        };
+
+        UINT32 FindFlowSlot(UINT32 flowHash) const;
+        void RemoveSlot(Slot* table, UINT32 index, bool isEntryTable);
+        void EvictOldest();
+
+        unsigned int    capacity;       // entry_array size (power of 2)
+        UINT32          slot_mask;      // index tables are 2*capacity (load factor <= 0.5)
+        Slot*           entry_index;
+        Slot*           flow_index;
+        Entry*          entry_array;    // circular age ring
+        unsigned int    entry_head;     // next free entry (oldest is at entry_head - entry_count)
+        unsigned int    entry_count;
+        unsigned int    flow_count;
+        UINT64          member_alloc;   // allocated member indices
+
+};  // end class SmfDpdHashTable
+
+///////////////////////////////////////////////////////////////////
+// Shared (node-wide) duplicate packet detection class
+//
+// This is a per-interface "view" of a single SmfDpdHashTable store that
+// is shared by all interfaces using it.  Each view is allocated a member
+// index of the store so a packet seen on several interfaces is kept as a
+// single entry (with a member bit per interface) while the per-interface
+// duplicate semantics are preserved.  The store is pruned once by its
+// owner (Smf) and so Prune() does nothing here.  Note an entry's age is
+// from its first arrival on any member interface.
+
+class SmfDpdShared : public SmfDpd
+{
+    public:
+        SmfDpdShared(SmfDpdHashTable& theStore);
+        ~SmfDpdShared();
+
+        bool Init();  // allocates our member index
+
+        Type GetType() const
+            {return SHARED;}
+
+        void Destroy();
+
+        bool IsDuplicate(unsigned int   currentTime,
+                         const SmfFlowKey& flowKey,
+                         const char*    pktId,
+                         unsigned int   pktIdSize)    // in bits
+        {
+            return store.IsDuplicate(currentTime, flowKey, pktId, pktIdSize,
+                                     ((UINT64)1) << member_index);
+        }
+
+        void Prune(unsigned int currentTime, unsigned int ageMax) {}
+
+        unsigned int GetFlowCount() const
+            {return store.GetFlowCount();}
+
+        const SmfDpdHashTable& GetStore() const
+            {return store;}
+
+    private:
+        SmfDpdHashTable&    store;
+        int                 member_index;
+
+};  // end class SmfDpdShared
+
+///////////////////////////////////////////////////////////////////
+// Probabilistic (cuckoo filter) duplicate packet detection class
+//
+// This keeps only a short fingerprint of each <flowId:pktId> key in a
+// fixed-size cuckoo filter (4-slot buckets, partial-key cuckoo hashing) so
+// memory use is bounded by a configured budget regardless of the number of
+// flows.  The filter is time-partitioned into GENERATIONS equal sub-filters.
+// New keys are inserted into the "current" generation while lookups check
+// all of them, and the oldest generation is cleared and made current when
+// the current one has aged past "ageMax" (see Prune()) or is full.  So keys
+// are remembered for at least "ageMax" unless the packet rate exceeds what
+// the memory budget can hold for that long.
+//
+// Notes:
+// 1) The fingerprint size is chosen from the target false-positive (i.e.,
+//    false duplicate drop) rate, and the bucket count is then the largest
+//    power of 2 that fits the memory budget.
+// 2) No per-flow state is kept, so GetFlowCount() is always zero.
+
+class SmfDpdFilter : public SmfDpd
+{
+    public:
+        SmfDpdFilter();
+        ~SmfDpdFilter();
+
+        enum {MEMORY_DEFAULT = (1 << 20)};  // 1 MB
+        static const double FP_RATE_DEFAULT;
+
+        bool Init(unsigned int memoryBytes = MEMORY_DEFAULT,
+                  double       fpRate = FP_RATE_DEFAULT);
+
+        Type GetType() const
+            {return FILTER;}
+
+        void Destroy();
+
+        bool IsDuplicate(unsigned int   currentTime,
+                         const SmfFlowKey& flowKey,
+                         const char*    pktId,
+                         unsigned int   pktIdSize);   // in bits
+
+        void Prune(unsigned int currentTime, unsigned int ageMax);
+
+        unsigned int GetFlowCount() const
+            {return 0;}
+
+        // Filter statistics
+        unsigned int GetMemorySize() const
+            {return (GENERATIONS * BUCKET_SIZE * (bucket_mask + 1) * sizeof(UINT32));}
+        unsigned int GetFingerprintBits() const
+            {return fp_bits;}
+        double GetOccupancy() const;            // fraction of all slots in use
+        double GetFalsePositiveRate() const;    // estimated for current occupancy
+
+    private:
+        enum
+        {
+            GENERATIONS = 2,
+            BUCKET_SIZE = 4,    // fingerprint slots per bucket
+            KICK_MAX    = 500   // cuckoo displacements before generation is "full"
+        };
+
+        struct Generation
+        {
+            UINT32*         slot;           // a zero fingerprint marks an empty slot
+            unsigned int    count;
+            unsigned int    start_time;
+        };
+
+        UINT32 GetAltIndex(UINT32 index, UINT32 fp) const
+            {return ((index ^ (fp * 0x5bd1e995)) & bucket_mask);}
+        bool Contains(const Generation& gen, UINT32 index, UINT32 fp) const;
+        bool Insert(Generation& gen, UINT32& index, UINT32& fp);
+        void Rotate(unsigned int currentTime);
+
+        Generation      gen_array[GENERATIONS];
+        unsigned int    gen_current;
+        UINT32          bucket_mask;    // per generation (bucket count is power of 2)
+        unsigned int    fp_bits;
+        UINT32          fp_mask;
+        UINT32          kick_seed;      // for random victim selection
+
+};  // end class SmfDpdFilter
+
 /////////////////////////////////////////////////////////////////////////
 // This class keeps per-flow (dst[:src] addr) sequence number
 // state and is used for SMF source host resequencing purposes
-class SmfSequenceMgr
+class SmfSequenceMgr : public SmfFlowBudget::Member
 {
     public:
         SmfSequenceMgr();
         ~SmfSequenceMgr();
         bool Init(UINT8 numSeqBits);
-        void Destroy()
-            {flow_list.Destroy();}
+        void Destroy();
 
         UINT32 IncrementSequence(unsigned int        updateTime,
                                  const ProtoAddress* dstAddr,
@@ -405,6 +892,17 @@ class SmfSequenceMgr
 
         void Prune(unsigned int currentTime, unsigned int ageMax);
 
+        unsigned int GetFlowCount() const
+            {return flow_list.GetCount();}
+
+        // Keeps flow sequence state in the given "stateFile" (NULL to detach)
+        // as records of the given "stateType".  Restore() adopts the file's
+        // pending records as flows and returns the number restored.
+        void SetStateFile(SmfStateFile* stateFile, SmfStateFile::RecordType stateType);
+        unsigned int Restore(unsigned int currentTime);
+
+    protected:
+        void EvictFlow(SmfFlow& flow);
 
     private:
         class Flow : public SmfFlow
@@ -413,31 +911,45 @@ class SmfSequenceMgr
                 Flow();
                 ~Flow();
 
-                bool Init(const char* flowId, unsigned int flowIdSize)
-                    {return SmfFlow::Init(flowId, flowIdSize);}
+                static void* operator new(size_t size) noexcept
+                    {return slab.Get(size);}
+                static void operator delete(void* ptr)
+                    {slab.Put(ptr);}
+
+                bool Init(const SmfFlowKey& flowKey)
+                    {return SmfFlow::Init(flowKey);}
 
                 void SetSequence(UINT32 value)
                     {sequence = value;}
                 UINT32 GetSequence() const
                     {return sequence;}
                 UINT32 IncrementSequence(UINT32 seqMask)
-                    {return (sequence++ & seqMask);}
-
-                void SetUpdateTime(unsigned int currentTime)
-                    {update_time = currentTime;}
+                {
+                    UINT32 seq = sequence++;
+                    if (NULL != state_record) state_record->value = sequence;
+                    return (seq & seqMask);
+                }
 
-                unsigned int GetAge(unsigned int currentTime) const
-                    {return (currentTime - update_time);}
+                void SetStateRecord(SmfStateFile::Record* record)
+                    {state_record = record;}
+                SmfStateFile::Record* GetStateRecord() const
+                    {return state_record;}
 
             private:
-                UINT32          sequence;
-                unsigned int    update_time;
+                UINT32                  sequence;
+                SmfStateFile::Record*   state_record;
+
+                static SmfSlab  slab;
 
         };  // end class SmfSequenceMgr::Flow
 
-        UINT32              seq_mask;
-        UINT32              seq_global;
-        SmfFlow::List       flow_list;
+        void DeleteFlow(Flow* flow);
+
+        UINT32                      seq_mask;
+        UINT32                      seq_global;
+        SmfFlow::List               flow_list;
+        SmfStateFile*               state_file;
+        SmfStateFile::RecordType    state_type;
 
 };  // end class SmfSequenceMgr
 
@@ -0,0 +1,126 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_FLOW_KEY
+#define _SMF_FLOW_KEY
+
+#include "protoDefs.h"
+#include "protoAddress.h"
+#include <string.h>  // for memcpy()
+
+// The SmfFlowKey class is a fixed-width flow identifier (e.g., the DPD
+// <taggerId:srcAddr:dstAddr> "flowId" or a queue's <dst:src:proto:class>
+// key) with its hash value precomputed when the key is finalized.  The key
+// bytes are kept in 64-bit aligned words that are zero-padded past the key
+// length, so keys are compared a word at a time (after comparing the hash
+// values) and a key built once per packet can be used for all the flow
+// lookups (e.g., the DPD table of each interface) without rehashing.
+//
+// Usage:  SetKey() from a buffer, or Clear() then Append() the key fields
+//         then Finalize(), or fill in AccessBuffer() in place then SetSize().
+//
+// Notes:
+// 1) The key bytes are the same as the byte-string "flowId" formerly used
+//    (so ProtoTree lookups and saved state records are unchanged).
+// 2) Keys are limited to KEY_BYTES_MAX bytes (the IPv6 "flowId" worst case).
+
+class SmfFlowKey
+{
+    public:
+        enum {KEY_BYTES_MAX = 48};  // (3*128 bits)
+
+        SmfFlowKey()
+         : key_size(0), key_hash(0) {memset(key_word, 0, sizeof(key_word));}
+        SmfFlowKey(const char* key, unsigned int keySize)  // keySize in bits
+         : key_size(0), key_hash(0) {SetKey(key, keySize);}
+
+        bool SetKey(const char* key, unsigned int keySize)  // keySize in bits
+        {
+            unsigned int keyBytes = (keySize + 7) >> 3;
+            if (keyBytes > KEY_BYTES_MAX) return false;
+            memcpy(key_word, key, keyBytes);
+            return SetSize(keySize);
+        }
+
+        void Clear()
+            {key_size = 0;}
+        bool Append(const char* data, unsigned int numBytes)
+        {
+            unsigned int keyBytes = key_size >> 3;
+            if ((keyBytes + numBytes) > KEY_BYTES_MAX) return false;
+            memcpy(((char*)key_word) + keyBytes, data, numBytes);
+            key_size += (numBytes << 3);
+            return true;
+        }
+        bool AppendAddress(const ProtoAddress& addr)
+            {return Append(addr.GetRawHostAddress(), addr.GetLength());}
+        bool AppendByte(UINT8 value)
+            {return Append((const char*)&value, 1);}
+        void Finalize()
+            {SetSize(key_size);}
+
+        // For in-place construction (up to KEY_BYTES_MAX bytes)
+        char* AccessBuffer()
+            {return ((char*)key_word);}
+        // Sets the key size (zero-padding the key) and computes its hash
+        bool SetSize(unsigned int keySize);  // keySize in bits
+
+        const char* GetBuffer() const
+            {return ((const char*)key_word);}
+        unsigned int GetSize() const  // in bits
+            {return key_size;}
+        unsigned int GetLength() const  // in bytes
+            {return ((key_size + 7) >> 3);}
+        UINT32 GetHash() const
+            {return key_hash;}
+
+        bool IsEqual(const SmfFlowKey& key) const
+        {
+            if ((key_hash != key.key_hash) || (key_size != key.key_size)) return false;
+            unsigned int wordCount = (key_size + 63) >> 6;
+            for (unsigned int i = 0; i < wordCount; i++)
+                if (key_word[i] != key.key_word[i]) return false;
+            return true;
+        }
+        bool operator==(const SmfFlowKey& key) const
+            {return IsEqual(key);}
+
+        // Fast (non-cryptographic) hash used for flow lookups, etc
+        static UINT32 ComputeHash(const char* buffer, unsigned int length, UINT32 seed);
+
+    private:
+        enum {WORD_COUNT = KEY_BYTES_MAX / 8};
+
+        UINT64          key_word[WORD_COUNT];
+        unsigned int    key_size;   // in bits
+        UINT32          key_hash;
+
+};  // end class SmfFlowKey
+
+#endif // _SMF_FLOW_KEY
@@ -12,6 +12,9 @@ class SmfHash
             MD5,        // MD5 hash of packet
             CRC32,      // CRC-32 checksum
             SHA1,       // SHA-1 hash
+            CRC32C,     // CRC-32C (Castagnoli) checksum
+            XXH3,       // XXH3 64-bit hash
+            SIPHASH,    // SipHash-2-4 keyed hash
             INVALID
         };
            
@@ -53,6 +56,13 @@ class SmfHash
 
 
 
+// The CRC classes use a CRC "engine" selected at start-up per the CPU
+// features available.  The portable engine uses "slice-by-16" lookup
+// tables (16 bytes per iteration).  On x86 CPUs, the CRC-32 engine uses
+// PCLMULQDQ carry-less multiply folding and the CRC-32C engine uses the
+// SSE4.2 "crc32" instruction.  All engines for a given polynomial produce
+// identical results (i.e., the same as the original byte-at-a-time CRC-32).
+
 class SmfHashCRC32 : public SmfHash
 {
     public: 
@@ -68,17 +78,61 @@ class SmfHashCRC32 : public SmfHash
         
         void Init()
             {checksum = CRC32_XINIT;}
-        void Update(const char* buffer, unsigned int buflen);
+        void Update(const char* buffer, unsigned int buflen)
+            {checksum = update_func(checksum, (const unsigned char*)buffer, buflen);}
         void Finalize()
             {checksum ^= CRC32_XOROT;}
         
+        // Name of the engine in use (for debugging and benchmarks)
+        static const char* GetEngineName()
+            {return engine_name;}
+        
+        typedef UINT32 (*UpdateFunc)(UINT32 crc, const unsigned char* buffer, unsigned int buflen);
+        
     private:
+        static UpdateFunc SelectEngine();
+        
         static const UINT32 CRC32_XINIT;
         static const UINT32 CRC32_XOROT;
         static const UINT32 CRC32_TABLE[256];
         
+        static const char*  engine_name;
+        static UpdateFunc   update_func;
+        
         UINT32  checksum;
 };  // end class SmfHashCRC32
 
+class SmfHashCRC32C : public SmfHash
+{
+    public: 
+        SmfHashCRC32C();
+        ~SmfHashCRC32C();
+        
+        Type GetType() const 
+            {return CRC32C;}
+        unsigned int GetLength() const
+            {return 4;}
+        const char* GetValue() const
+            {return ((const char*)&checksum);}
+        
+        void Init()
+            {checksum = 0xFFFFFFFF;}
+        void Update(const char* buffer, unsigned int buflen)
+            {checksum = update_func(checksum, (const unsigned char*)buffer, buflen);}
+        void Finalize()
+            {checksum ^= 0xFFFFFFFF;}
+        
+        static const char* GetEngineName()
+            {return engine_name;}
+        
+    private:
+        static SmfHashCRC32::UpdateFunc SelectEngine();
+        
+        static const char*                  engine_name;
+        static SmfHashCRC32::UpdateFunc     update_func;
+        
+        UINT32  checksum;
+};  // end class SmfHashCRC32C
+
 
 #endif // _SMF_HASH
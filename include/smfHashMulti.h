@@ -0,0 +1,111 @@
+#ifndef _SMF_HASH_MULTI
+#define _SMF_HASH_MULTI
+
+#include "smfHashMD5.h"
+
+// "Multi-buffer" H-DPD hashing for packet batches (see Smf::ProcessPacketBatch()).
+// A hash like MD5 is a serial chain of dependent operations per message, so
+// a single packet hash leaves most of a modern CPU idle.  Instead, up to LANES
+// packets are hashed at once, each packet in its own 32-bit SIMD lane, giving
+// the same (wire-compatible) hash values several times faster.  The engine
+// used is selected at start-up per the CPU features available (AVX2 on x86,
+// else the compiler's generic vector code, else one packet at a time).
+//
+// Usage:  Init(), then ComputeHashIPv4/IPv6() for each packet (in lane order),
+//         then Compute(), then GetValue(lane) for each packet's hash value.
+//         The packet buffers must not be modified until Compute() is done.
+//
+// Currently MD5 (the interoperable H-DPD default) is the only algorithm
+// supported (the CRC engines are already faster than a batch could help)
+
+class SmfHashMulti
+{
+    public:
+        SmfHashMulti();
+        ~SmfHashMulti();
+
+        enum {LANES = 8};
+
+        static bool IsSupported(SmfHash::Type hashType)
+            {return (SmfHash::MD5 == hashType);}
+
+        SmfHash::Type GetType() const
+            {return SmfHash::MD5;}
+        unsigned int GetLength() const
+            {return 16;}
+
+        void Init()
+            {lane_count = 0;}
+        unsigned int GetCount() const
+            {return lane_count;}
+
+        // These add a packet (or buffer) as the next lane (returns false if all lanes in use)
+        bool ComputeHashIPv4(ProtoPktIPv4& ipv4Pkt);
+        bool ComputeHashIPv6(ProtoPktIPv6& ipv6Pkt);
+        bool ComputeHash(const char* buffer, unsigned int buflen);
+
+        // Hashes all the lanes added since Init()
+        void Compute();
+
+        const char* GetValue(unsigned int lane) const
+            {return lane_list[lane].GetValue();}
+
+        // Name of the engine in use (for debugging and benchmarks)
+        static const char* GetEngineName()
+            {return engine_name;}
+
+        // Lanes are SmfHash instances whose Init()/Update() calls just record
+        // the packet segments to hash (so the SmfHash::ComputeHashIPv4/IPv6()
+        // parsing is reused as is).  A lane with more segments than it can
+        // record (lots of IPv6 options) is hashed on its own with SmfHashMD5.
+        class Lane : public SmfHash
+        {
+            public:
+                Lane();
+                ~Lane();
+
+                Type GetType() const
+                    {return MD5;}
+                unsigned int GetLength() const
+                    {return 16;}
+                const char* GetValue() const
+                    {return ((const char*)digest);}
+
+                void Init();
+                void Update(const char* buffer, unsigned int buflen);
+                void Finalize() {}
+
+            private:
+                friend class SmfHashMulti;
+                enum {SEGMENT_MAX = 16};
+
+                // Fills in this lane's next 64-byte (padded) message block
+                void LoadBlock(UINT32* words, unsigned int blockIndex);
+
+                const char*     seg_ptr[SEGMENT_MAX];
+                unsigned int    seg_len[SEGMENT_MAX];
+                unsigned int    seg_count;
+                unsigned int    seg_index;      // LoadBlock() position
+                unsigned int    seg_offset;
+                bool            pad_set;        // "1" pad bit has been loaded
+                UINT32          msg_len;
+                unsigned int    block_count;    // padded message blocks
+                bool            overflow;       // (hashed by "md5" instead)
+                SmfHashMD5      md5;
+                UINT8           digest[16];
+        };  // end class SmfHashMulti::Lane
+
+        typedef void (*TransformFunc)(UINT32 state[4][LANES], const UINT32 words[16][LANES], const UINT32 mask[LANES]);
+
+    private:
+        static TransformFunc SelectEngine();
+
+        static const char*      engine_name;
+        static TransformFunc    transform_func;
+
+        Lane            lane_list[LANES];
+        unsigned int    lane_count;
+
+};  // end class SmfHashMulti
+
+#endif // _SMF_HASH_MULTI
@@ -0,0 +1,50 @@
+#ifndef _SMF_HASH_SIPHASH
+#define _SMF_HASH_SIPHASH
+ 
+#include "smfHash.h"
+
+// SipHash-2-4 keyed hash (64-bit value).  When all nodes of an SMF domain
+// are configured with the same (secret) key, it is impractical for an
+// outsider to craft packets with colliding H-DPD hash values (i.e., to
+// have legitimate packets discarded as duplicates).  The key is shared by
+// all instances and applies to hashes started (via Init()) after it is set.
+
+class SmfHashSipHash : public SmfHash
+{
+    public:
+        SmfHashSipHash();
+        ~SmfHashSipHash();
+        
+        enum {KEY_SIZE = 16};
+        
+        // Sets the key used for subsequent hashes (all zero by default)
+        static void SetKey(const char key[KEY_SIZE]);
+        
+        void Init();
+        void Update(const char* buffer, unsigned int buflen);
+        void Finalize();
+        
+        Type GetType() const
+            {return SIPHASH;}
+
+        unsigned int GetLength() const
+            {return 8;}        
+        
+        const char* GetValue() const
+            {return ((const char*)digest);} 
+            
+    private:
+        void Compress(UINT64 m);
+        
+        UINT64          v0, v1, v2, v3;
+        UINT8           tail[8];
+        unsigned int    tail_len;
+        UINT64          total_len;
+        UINT8           digest[8];
+        
+        static UINT64   key0;
+        static UINT64   key1;
+               
+};  // end class SmfHashSipHash
+
+#endif // _SMF_HASH_SIPHASH
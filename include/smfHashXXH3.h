@@ -0,0 +1,51 @@
+#ifndef _SMF_HASH_XXH3
+#define _SMF_HASH_XXH3
+
+#include "smfHash.h"
+
+// XXH3 (64-bit, seed 0, default secret) non-cryptographic hash.  This is
+// much faster than MD5 or SHA1 for H-DPD and the value is identical to
+// that of the reference XXH3_64bits() (in its big-endian "canonical" form)
+// so all nodes agree regardless of host byte order.  Input is streamed
+// through a small internal buffer so it works with multiple Update()
+// calls (as done by SmfHash::ComputeHashIPv4/IPv6()).
+
+class SmfHashXXH3 : public SmfHash
+{
+    public:
+        SmfHashXXH3();
+        ~SmfHashXXH3();
+        
+        void Init();
+        void Update(const char* buffer, unsigned int buflen);
+        void Finalize();
+        
+        Type GetType() const
+            {return XXH3;}
+
+        unsigned int GetLength() const
+            {return 8;}        
+        
+        const char* GetValue() const
+            {return ((const char*)digest);} 
+            
+    private:
+        enum
+        {
+            STRIPE_LEN      = 64,
+            BUFFER_SIZE     = 256,                  // (4 stripes)
+            STRIPES_PER_BLOCK = (192 - 64) / 8      // per default secret size
+        };
+        
+        void ConsumeStripes(const UINT8* input, unsigned int numStripes);
+        
+        UINT64          acc[8];
+        UINT8           buffer[BUFFER_SIZE];
+        unsigned int    buffer_len;
+        unsigned int    stripe_count;       // stripes in current block so far
+        UINT64          total_len;
+        UINT8           digest[8];
+               
+};  // end class SmfHashXXH3
+
+#endif // _SMF_HASH_XXH3
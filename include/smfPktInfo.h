@@ -0,0 +1,43 @@
+#ifndef _SMF_PKT_INFO
+#define _SMF_PKT_INFO
+
+#include "protoPktIP.h"
+#include "protoAddress.h"
+
+// An SmfPktInfo is a compact descriptor of an inbound IP packet's header
+// fields (raw addresses, protocol and traffic class).  It is filled once by
+// InitFromPacket() when a frame is captured (see SmfApp::PrepareInboundFrame())
+// and then used by the later forwarding stages (unicast and priority checks,
+// traffic class lookup) instead of re-parsing the packet or building
+// ProtoAddress instances for these checks.  Note the descriptor must be
+// re-initialized if the packet is reframed (e.g., IPIP decapsulation).
+
+class SmfPktInfo
+{
+    public:
+        SmfPktInfo();
+
+        void Clear();
+        // Returns "false" (and descriptor invalid) if not a valid IPv4/IPv6 packet
+        bool InitFromPacket(ProtoPktIP& ipPkt);
+        bool IsValid() const
+            {return (0 != version);}
+
+        unsigned int GetAddrLength() const
+            {return ((4 == version) ? 4 : 16);}
+        void GetSrcAddr(ProtoAddress& addr) const;
+        void GetDstAddr(ProtoAddress& addr) const;
+        // (These match the ProtoAddress methods of the same names)
+        bool DstIsMulticast() const;
+        bool DstIsUnicast() const;
+
+        UINT8           version;            // 4 or 6 (0 when invalid)
+        UINT8           protocol;           // IPv4 protocol or IPv6 (first) next header
+        UINT8           traffic_class;      // IPv4 TOS or IPv6 traffic class
+        UINT8           src_addr[16];       // (first 4 bytes for IPv4)
+        UINT8           dst_addr[16];
+        const char*     hash_value;         // precomputed H-DPD hash (see Smf::ProcessPacketBatch())
+
+};  // end class SmfPktInfo
+
+#endif // _SMF_PKT_INFO
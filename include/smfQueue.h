@@ -5,36 +5,129 @@
 #include <protoAddress.h>
 #include <protoPktIP.h>
 #include <protoTime.h>
+#include <string.h>  // for memcpy()
+#include "smfFlowKey.h"
 
 // Per-flow packet queuing classes
 
+// Reference-counted packet buffer.  A single received frame can be referenced by
+// multiple SmfPackets (e.g., the queues of different destination interfaces) so
+// that it is copied only once.  Writes via SmfPacketTemplate::AccessBuffer() are
+// "copy-on-write" so a packet with a shared buffer gets its own copy first.
+// Released buffers are kept in a free list for reuse.
+// (Note these are _not_ thread-safe)
+class SmfPacketBuffer
+{
+    public:
+        enum {BUFFER_SIZE = 2048 + sizeof(UINT32)};
+        
+        // Gets buffer from free list or allocates new (reference count is 1)
+        static SmfPacketBuffer* Create();
+        
+        void Retain()
+            {ref_count++;}
+        void Release();  // returns to free list upon last reference
+        
+        bool IsShared() const
+            {return (ref_count > 1);}
+        unsigned int GetRefCount() const
+            {return ref_count;}
+        
+        UINT32* AccessBuffer()
+            {return pkt_buffer;}
+        const UINT32* GetBuffer() const
+            {return pkt_buffer;}
+        
+        static unsigned int GetFreeCount() 
+            {return free_count;}
+        static void EmptyFreeList();  
+    
+    private:
+        SmfPacketBuffer() : ref_count(1), next(NULL) {}
+        ~SmfPacketBuffer() {}
+        
+        // We make the buffer an extra few bytes so we can align
+        // ProtoPktETH and ProtoPktIP into the same buffer here as needed
+        UINT32              pkt_buffer[BUFFER_SIZE/sizeof(UINT32)];
+        unsigned int        ref_count;
+        SmfPacketBuffer*    next;  // for free list
+        
+        static SmfPacketBuffer* free_list;
+        static unsigned int     free_count;
+};  // end class SmfPacketBuffer
+
 template <class ITEM_TYPE>
 class SmfPacketTemplate : public ITEM_TYPE
 {
     public:
         enum {PKT_SIZE_MAX = 2048};
     
-        SmfPacketTemplate() : pkt_length(0) {}
-        ~SmfPacketTemplate() {}
+        SmfPacketTemplate() : pkt_buf(NULL), pkt_length(0) {}
+        ~SmfPacketTemplate() 
+            {if (NULL != pkt_buf) pkt_buf->Release();}
         
-        UINT32* AccessBuffer()
-            {return pkt_buffer;}
+        // Returns a writable buffer, copying the content first if the 
+        // buffer is shared with other packets (NULL if allocation fails)
+        UINT32* AccessBuffer();
+        // Returns a writable buffer for new content (i.e., no copy needed)
+        UINT32* PrepareBuffer();
         void SetLength(unsigned int length)
             {pkt_length = length;}
         
         const UINT32* GetBuffer() const
-            {return pkt_buffer;}
+            {return ((NULL != pkt_buf) ? pkt_buf->GetBuffer() : NULL);}
         unsigned int GetLength() const
             {return pkt_length;}
+        
+        // Makes this packet reference the given "pktBuf" content instead of copying it
+        void ShareBuffer(SmfPacketBuffer& pktBuf, unsigned int length)
+        {
+            pktBuf.Retain();
+            if (NULL != pkt_buf) pkt_buf->Release();
+            pkt_buf = &pktBuf;
+            pkt_length = length;
+        }
+        SmfPacketBuffer* GetPacketBuffer() const
+            {return pkt_buf;}
+        bool IsShared() const
+            {return ((NULL != pkt_buf) && pkt_buf->IsShared());}
     
     private:
-        // We make the packet an extra few bytes so we can align
-        // ProtoPktETH and ProtoPktIP into the same buffer here as needed
-        UINT32       pkt_buffer[PKT_SIZE_MAX/sizeof(UINT32) + 1];
-        unsigned int pkt_length;
+        SmfPacketBuffer*    pkt_buf;
+        unsigned int        pkt_length;
        
 };  // end class SmfPacketTemplate
 
+template <class ITEM_TYPE>
+UINT32* SmfPacketTemplate<ITEM_TYPE>::AccessBuffer()
+{
+    if ((NULL != pkt_buf) && pkt_buf->IsShared())
+    {
+        // Copy-on-write (the extra word covers any alignment offset used)
+        SmfPacketBuffer* pktBuf = SmfPacketBuffer::Create();
+        if (NULL == pktBuf) return NULL;
+        unsigned int copyLen = pkt_length + sizeof(UINT32);
+        if (copyLen > SmfPacketBuffer::BUFFER_SIZE) copyLen = SmfPacketBuffer::BUFFER_SIZE;
+        memcpy(pktBuf->AccessBuffer(), pkt_buf->GetBuffer(), copyLen);
+        pkt_buf->Release();
+        pkt_buf = pktBuf;
+    }
+    return PrepareBuffer();
+}  // end SmfPacketTemplate::AccessBuffer()
+
+template <class ITEM_TYPE>
+UINT32* SmfPacketTemplate<ITEM_TYPE>::PrepareBuffer()
+{
+    if ((NULL != pkt_buf) && pkt_buf->IsShared())
+    {
+        pkt_buf->Release();
+        pkt_buf = NULL;
+    }
+    if ((NULL == pkt_buf) && (NULL == (pkt_buf = SmfPacketBuffer::Create())))
+        return NULL;
+    return pkt_buf->AccessBuffer();
+}  // end SmfPacketTemplate::PrepareBuffer()
+
 class SmfQueueBase : public ProtoTree::Item
 {
     public:
@@ -68,19 +161,18 @@ class SmfQueueBase : public ProtoTree::Item
         bool IsFull() const
             {return ((queue_limit > 0) ? (queue_length >= (unsigned int)queue_limit) : false);}
         
-        static unsigned int BuildKey(char* keyBuffer,  // must be sized at least 2*16 + 2 (IPv6 addr worst case)
-                                     const ProtoAddress&  src, 
-                                     const ProtoAddress&  dst,
-                                     ProtoPktIP::Protocol proto,
-                                     UINT8                trafficClass);
+        static void BuildKey(SmfFlowKey&          flowKey,
+                             const ProtoAddress&  src, 
+                             const ProtoAddress&  dst,
+                             ProtoPktIP::Protocol proto,
+                             UINT8                trafficClass);
     protected:
         const char* GetKey() const
-            {return flow_id;}
+            {return flow_key.GetBuffer();}
         unsigned int GetKeysize() const
-            {return flow_id_size;}
+            {return flow_key.GetSize();}
         
-        char                  flow_id[2*16 + 2];  // sized for IPv6 (worst case)
-        unsigned int          flow_id_size;
+        SmfFlowKey            flow_key;
         int                   queue_limit;        // -1 is no limit (default), 0 is no queuing
         unsigned int          queue_length;       // in bytes? 
         
@@ -101,9 +193,9 @@ class SmfQueueTableTemplate : public ProtoTreeTemplate<QUEUE_TYPE>
                               ProtoPktIP::Protocol proto = ProtoPktIP::RESERVED,
                               UINT8                trafficClass = 255) const
         {
-            char key[2*16 + 2];
-            unsigned int keysize = SmfQueueBase::BuildKey(key, src, dst, proto, trafficClass);
-            return ProtoTreeTemplate<QUEUE_TYPE>::Find(key, keysize);
+            SmfFlowKey key;
+            SmfQueueBase::BuildKey(key, src, dst, proto, trafficClass);
+            return ProtoTreeTemplate<QUEUE_TYPE>::Find(key.GetBuffer(), key.GetSize());
         }
         
         void RemoveQueue(QUEUE_TYPE& queue)
@@ -118,6 +210,7 @@ class SmfPacket : public SmfPacketTemplate<ProtoList::Item>
         {
             public:
                 // This gets packet from pool or allocates one as needed
+                // (with a writable, unshared buffer ready for new content)
                 // TBD - add a pool depth limit ???
                 SmfPacket* GetPacket();
         };
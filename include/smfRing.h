@@ -0,0 +1,111 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _SMF_RING
+#define _SMF_RING
+
+#include "protoChannel.h"
+#include "protoDefs.h"
+
+// The SmfRing class provides a receive-only, memory-mapped packet capture
+// channel using the Linux PACKET_MMAP TPACKET_V3 block ring.  The kernel
+// fills whole blocks of frames and "retires" a block when it is full or
+// when the block timeout expires.  Input notification fires when a retired
+// block is available and the frames can then be walked in place without
+// a per-frame system call.  Blocks are returned to the kernel as they are
+// consumed.
+//
+// Notes:
+// 1) This is a receive-only mechanism.  The associated ProtoCap is still
+//    used for transmission (and for putting the interface into promiscuous
+//    mode) by nrlsmf.
+// 2) On non-Linux systems, Open() will fail and nrlsmf will fall back to
+//    ProtoCap::Recv() for input.
+
+class SmfRing : public ProtoChannel
+{
+    public:
+        SmfRing();
+        ~SmfRing();
+
+        enum
+        {
+            BLOCK_SIZE_DEFAULT      = (1 << 18),  // 256 kB blocks
+            BLOCK_COUNT_DEFAULT     = 64,         // 16 MB ring total
+            BLOCK_TIMEOUT_DEFAULT   = 1           // block retire timeout (msec)
+        };
+
+        bool Open(unsigned int ifIndex,
+                  unsigned int blockSize = BLOCK_SIZE_DEFAULT,
+                  unsigned int blockCount = BLOCK_COUNT_DEFAULT,
+                  unsigned int blockTimeout = BLOCK_TIMEOUT_DEFAULT);
+        void Close();
+
+        unsigned int GetInterfaceIndex() const
+            {return if_index;}
+
+        // Attaches a drop-all socket filter to the given (AF_PACKET) socket
+        // descriptor and discards any frames already queued to it.  This is
+        // used for a ProtoCap socket whose input has moved to the ring (or to
+        // an io_uring socket) so the kernel doesn't keep cloning frames to it.
+        // DetachDropFilter() removes the filter again.
+        static bool AttachDropFilter(int descriptor);
+        static bool DetachDropFilter(int descriptor);
+
+        // Gets the next inbound frame from the ring, if any.  The returned
+        // "frame" pointer references ring memory and is valid only until the
+        // next call to GetNextFrame() (or Close()).  Returns "false" when no
+        // more frames are available (i.e., all retired blocks consumed).
+        // Outbound (locally sent) frames are skipped.
+        bool GetNextFrame(const char*& frame, unsigned int& frameLength);
+
+        // Ring statistics
+        unsigned int GetFrameCount() const
+            {return frame_count;}
+        unsigned int GetBlockCount() const
+            {return block_total;}
+        unsigned int GetDropCount();  // kernel-reported drops since last call
+
+    private:
+        void ReleaseBlock();
+
+        unsigned int    if_index;
+        char*           ring_buffer;    // mmap'd ring
+        size_t          ring_size;
+        unsigned int    block_size;
+        unsigned int    block_count;
+        unsigned int    block_index;    // current block being walked
+        char*           block_ptr;      // current (user-owned) block, if any
+        unsigned int    block_frames;   // frames remaining in current block
+        const char*     frame_ptr;      // next frame header in current block
+        unsigned int    frame_count;    // total frames received
+        unsigned int    block_total;    // total blocks consumed
+
+};  // end class SmfRing
+
+#endif // _SMF_RING
@@ -0,0 +1,115 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_SHARD
+#define _SMF_SHARD
+
+#include "protoDefs.h"
+
+// The SmfShard class supports running nrlsmf as a set of "flow-sharded"
+// forwarding processes (see the nrlsmf "shards" command).  Each shard is a
+// complete nrlsmf instance with its own Smf DPD, resequencing and multicast
+// FIB state, so no locking is needed in the forwarding path.  The kernel
+// steers each frame to exactly one shard using a classic BPF socket filter
+// attached to each shard's packet capture socket(s).  The filter hashes the
+// IP source and destination addresses (the same fields that make up the DPD
+// "flowId") so all copies of a packet, received on any interface, are seen
+// by the same shard and duplicate detection still works.
+//
+// Notes:
+// 1) Shards are separate processes rather than threads because Smf packet
+//    processing (and its timers, controllers, etc) shares a great deal of
+//    state with the ProtoDispatcher thread.
+// 2) Non-IP frames (ARP, VLAN-tagged, etc) are handled by shard 0 only.
+//    The filter uses the frame's protocol and network header offset as
+//    determined by the kernel, so it works for both Ethernet and GRE (no
+//    link header) capture sockets.
+// 3) This is only supported on Linux.  Elsewhere, Start() with a count
+//    greater than one fails.
+// 4) Each shard publishes its per-interface forwarding counters to a shared
+//    memory area (see PublishCounters()) so the primary can report node-wide
+//    totals for the "stats" and "jsonStats" queries.
+
+class SmfShard
+{
+    public:
+        SmfShard();
+        ~SmfShard();
+
+        enum {SHARD_COUNT_MAX = 64};
+        enum {IFACE_COUNT_MAX = 64};  // per-shard counter slots
+
+        // Per-interface forwarding counters (see Smf::Interface) of one shard
+        class Counters
+        {
+            public:
+                unsigned int    if_index;   // (zero for an unused slot)
+                unsigned int    flows;
+                unsigned int    recv;
+                unsigned int    mrcv;
+                unsigned int    sent;
+                unsigned int    retr;
+                unsigned int    fwd;
+                unsigned int    dups;
+                unsigned int    asym;
+        };
+
+        // Forks "shardCount - 1" additional shard processes.  Upon return,
+        // GetIndex() is the shard index of the calling process (zero for the
+        // original, "primary" process).
+        bool Start(unsigned int shardCount);
+        // Terminates and reaps the other shard processes (primary only)
+        void Stop();
+
+        bool IsActive() const
+            {return (shard_count > 1);}
+        bool IsPrimary() const
+            {return (0 == shard_index);}
+        unsigned int GetCount() const
+            {return shard_count;}
+        unsigned int GetIndex() const
+            {return shard_index;}
+
+        // Attaches the shard socket filter to the given (AF_PACKET) socket
+        // descriptor so only frames of this shard's flows are received
+        bool AttachFilter(int descriptor) const;
+
+        // Sets this shard's published counters to the "count" slots given
+        void PublishCounters(const Counters* counters, unsigned int count);
+        // Adds the counters other shards published for "ifIndex" to "totals"
+        void AddShardCounters(unsigned int ifIndex, Counters& totals) const;
+
+    private:
+        unsigned int    shard_count;
+        unsigned int    shard_index;
+        int             shard_pid[SHARD_COUNT_MAX];  // child process ids (primary only)
+        Counters*       shard_counters;              // shared SHARD_COUNT_MAX*IFACE_COUNT_MAX slots
+};  // end class SmfShard
+
+#endif // _SMF_SHARD
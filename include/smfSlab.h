@@ -0,0 +1,121 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_SLAB
+#define _SMF_SLAB
+
+#include "protoDefs.h"
+#include <stddef.h>  // for size_t
+
+// The SmfSlab class is a simple fixed-size object allocator used for the
+// nrlsmf flow state objects (DPD and sequence manager flows and packet id
+// entries) that are otherwise created and deleted at a high rate as short-
+// lived flows come and go.  Objects are carved from large, aligned "slabs"
+// and recycled through a free list, so allocation and release are O(1)
+// with no heap calls once the slabs are in place.  Classes use an SmfSlab
+// via class-specific operator new/delete, so the usual "new" and "delete"
+// expressions (and NULL checks) remain unchanged.
+//
+// Notes:
+// 1) Slab memory is only returned to the system by Destroy() when no objects
+//    are in use (i.e., normally at process exit).
+// 2) Each SmfSlab registers itself by name in a process-wide list so its
+//    preallocation and statistics can be managed by name (see Find()).
+// 3) This is not thread-safe.  The flow state objects are only created
+//    and deleted by the nrlsmf main thread.
+
+class SmfSlab
+{
+    public:
+        enum
+        {
+            CACHE_LINE  = 64,
+            SLAB_SIZE   = 16384  // nominal bytes per slab
+        };
+
+        // The "objectSize" is rounded up to a multiple of "alignment" (a power of 2)
+        SmfSlab(const char* name, size_t objectSize, size_t alignment = CACHE_LINE);
+        ~SmfSlab();
+
+        // Returns NULL if allocation fails (or "size" exceeds the object size)
+        void* Get(size_t size);
+        void Put(void* ptr);
+
+        // Grows the slab capacity to at least "count" objects
+        bool Preallocate(unsigned int count);
+
+        void Destroy();
+
+        const char* GetName() const
+            {return slab_name;}
+        size_t GetObjectSize() const
+            {return object_size;}
+        unsigned int GetSlabCount() const
+            {return slab_count;}
+        unsigned int GetObjectCount() const  // total capacity
+            {return (slab_count * slab_objects);}
+        unsigned int GetUseCount() const
+            {return use_count;}
+        unsigned int GetUsePeak() const
+            {return use_peak;}
+        unsigned int GetFailureCount() const
+            {return fail_count;}
+
+        // Process-wide slab list
+        static SmfSlab* Find(const char* name);
+        static SmfSlab* GetFirst()
+            {return slab_head;}
+        SmfSlab* GetNext() const
+            {return next;}
+
+    private:
+        bool Grow();
+
+        struct FreeItem
+        {
+            FreeItem*   next;
+        };
+
+        const char*     slab_name;
+        size_t          object_size;
+        size_t          alignment;
+        unsigned int    slab_objects;   // objects per slab
+        char*           slab_list;      // raw slab allocations (linked via their first word)
+        unsigned int    slab_count;
+        FreeItem*       free_list;
+        unsigned int    use_count;
+        unsigned int    use_peak;
+        unsigned int    fail_count;
+        SmfSlab*        next;
+
+        static SmfSlab* slab_head;
+
+};  // end class SmfSlab
+
+#endif // _SMF_SLAB
@@ -0,0 +1,142 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_SPSC_RING
+#define _SMF_SPSC_RING
+
+#include <atomic>
+#include <stddef.h>  // for NULL
+
+// The SmfSpscRing template is a bounded, lock-free, single-producer /
+// single-consumer ring of items (e.g. SmfPacket pointers).  One thread may
+// Push() while another thread concurrently Pop()s without any locking.  The
+// ring size is rounded up to a power of two.
+//
+// Notes:
+// 1) Init() and Destroy() must not be called while the ring is in use.
+// 2) The drop count and high water mark are maintained by the producer.
+//    GetCount() is only approximate when called during concurrent use.
+
+template <class ITEM_TYPE>
+class SmfSpscRing
+{
+    public:
+        SmfSpscRing()
+         : ring_buffer(NULL), ring_mask(0), push_index(0), pop_index(0),
+           drop_count(0), high_water(0) {}
+        ~SmfSpscRing()
+            {Destroy();}
+
+        bool Init(unsigned int ringSize)
+        {
+            Destroy();
+            unsigned int size = 2;
+            while (size < ringSize) size <<= 1;
+            if (NULL == (ring_buffer = new ITEM_TYPE[size]))
+                return false;
+            ring_mask = size - 1;
+            push_index.store(0);
+            pop_index.store(0);
+            drop_count = high_water = 0;
+            return true;
+        }
+        void Destroy()
+        {
+            if (NULL != ring_buffer)
+            {
+                delete[] ring_buffer;
+                ring_buffer = NULL;
+            }
+            ring_mask = 0;
+        }
+        bool IsReady() const
+            {return (NULL != ring_buffer);}
+        unsigned int GetSize() const
+            {return (NULL != ring_buffer) ? (ring_mask + 1) : 0;}
+
+        // Producer side:  "true" if a Push() would fail
+        bool IsFull() const
+        {
+            return ((push_index.load(std::memory_order_relaxed) -
+                     pop_index.load(std::memory_order_acquire)) > ring_mask);
+        }
+
+        // Producer side:  returns "false" (and counts a drop) if the ring is full
+        bool Push(const ITEM_TYPE& item)
+        {
+            unsigned int index = push_index.load(std::memory_order_relaxed);
+            unsigned int count = index - pop_index.load(std::memory_order_acquire);
+            if (count > ring_mask)
+            {
+                drop_count++;
+                return false;
+            }
+            ring_buffer[index & ring_mask] = item;
+            push_index.store(index + 1, std::memory_order_release);
+            if (++count > high_water) high_water = count;
+            return true;
+        }
+
+        // Consumer side:  returns "false" if the ring is empty
+        bool Pop(ITEM_TYPE& item)
+        {
+            unsigned int index = pop_index.load(std::memory_order_relaxed);
+            if (index == push_index.load(std::memory_order_acquire))
+                return false;
+            item = ring_buffer[index & ring_mask];
+            pop_index.store(index + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool IsEmpty() const
+            {return (pop_index.load(std::memory_order_acquire) == push_index.load(std::memory_order_acquire));}
+        unsigned int GetCount() const
+            {return (push_index.load(std::memory_order_acquire) - pop_index.load(std::memory_order_acquire));}
+
+        unsigned int GetDropCount() const
+            {return drop_count;}
+        unsigned int GetHighWater() const
+            {return high_water;}
+
+    private:
+        enum {CACHE_LINE_SIZE = 64};
+
+        ITEM_TYPE*                  ring_buffer;
+        unsigned int                ring_mask;
+        // (the producer and consumer indices are kept on separate cache lines)
+        char                        pad1[CACHE_LINE_SIZE];
+        std::atomic<unsigned int>   push_index;
+        char                        pad2[CACHE_LINE_SIZE];
+        std::atomic<unsigned int>   pop_index;
+        char                        pad3[CACHE_LINE_SIZE];
+        unsigned int                drop_count;
+        unsigned int                high_water;
+};  // end class SmfSpscRing
+
+#endif // _SMF_SPSC_RING
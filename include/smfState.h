@@ -0,0 +1,144 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_STATE
+#define _SMF_STATE
+
+#include "protoDefs.h"
+
+// The SmfStateFile class keeps nrlsmf resequencing (SmfSequenceMgr) and
+// window DPD (SmfDpdWindow) flow state in a memory-mapped file so that it
+// can be adopted when nrlsmf is restarted.  This avoids the burst of
+// re-forwarded duplicates (and resequenced packet id collisions) that
+// otherwise follows a restart with empty state.
+//
+// The file is a fixed-size header followed by an array of fixed-size
+// records, one per flow.  Records are allocated as flows are created,
+// updated in place as their sequence numbers advance (a single store per
+// packet), and freed when the flows are pruned.  The header "write_time"
+// is refreshed periodically, so the file contents are at most that stale
+// after a crash.
+//
+// Notes:
+// 1) The layout is native byte order (the file is not meant to be moved
+//    between hosts) and is versioned.  A file with a different version,
+//    record size or capacity, or one older than the given "staleMax", is
+//    discarded (reinitialized) by Open().
+// 2) Records found by Open() are marked "pending" until claimed by Claim()
+//    (i.e., adopted by a restored flow).  ReleasePending() frees those
+//    that were not adopted.
+// 3) Close() leaves the records in place (for the next start) and any
+//    later Release() calls are ignored.
+
+class SmfStateFile
+{
+    public:
+        SmfStateFile();
+        ~SmfStateFile();
+
+        enum
+        {
+            VERSION             = 1,
+            CAPACITY_DEFAULT    = 16384,    // records (1 MB file)
+            STALE_MAX_DEFAULT   = 30,       // seconds
+            FLOW_ID_MAX         = 48        // bytes
+        };
+
+        enum RecordType
+        {
+            FREE        = 0,
+            SEQ_IPV4    = 1,    // ip4_seq_mgr flow
+            SEQ_IPV6    = 2,    // ip6_seq_mgr flow
+            WINDOW      = 3     // SmfDpdWindow flow
+        };
+
+        struct Record
+        {
+            UINT8   type;           // RecordType (plus PENDING flag)
+            UINT8   pkt_id_size;    // in bits (WINDOW)
+            UINT16  flow_id_size;   // in bits
+            UINT32  if_index;       // interface index (WINDOW)
+            UINT32  window_size;    // in packets (WINDOW)
+            UINT32  value;          // next sequence (SEQ_IPV4/SEQ_IPV6) or newest sequence (WINDOW)
+            char    flow_id[FLOW_ID_MAX];
+        };  // (64 bytes)
+
+        // Returns false on error.  If a usable (fresh) state file is found,
+        // its records are kept for adoption and "adopted" is set true.
+        bool Open(const char*   path,
+                  unsigned int  staleMax = STALE_MAX_DEFAULT,
+                  unsigned int  capacity = CAPACITY_DEFAULT,
+                  bool*         adopted = NULL);
+        void Close();
+        bool IsOpen() const
+            {return (NULL != record_array);}
+
+        // Returns NULL if the file is not open or is full
+        Record* Allocate(RecordType type, const char* flowId, unsigned int flowIdSize);  // flowIdSize in bits
+        void Release(Record* record);
+
+        // Finds the next pending record of the given type (starting after "prev")
+        Record* GetNextPending(RecordType type, Record* prev = NULL) const;
+        void Claim(Record& record)
+            {record.type &= ~PENDING;}
+        void ReleasePending();
+
+        // Refreshes the header write time (wall clock seconds)
+        void SetWriteTime(UINT32 wallTime);
+
+        unsigned int GetCapacity() const
+            {return capacity;}
+        unsigned int GetRecordCount() const
+            {return (capacity - free_count);}
+
+    private:
+        enum {PENDING = 0x80};
+
+        struct Header
+        {
+            char    magic[4];       // "SMFS"
+            UINT16  version;
+            UINT16  record_size;
+            UINT32  capacity;
+            UINT32  write_time;     // wall clock seconds
+            char    reserved[48];
+        };  // (64 bytes)
+
+        int             file_descriptor;
+        void*           map_base;
+        size_t          map_size;
+        Header*         header;
+        Record*         record_array;
+        unsigned int    capacity;
+        UINT32*         free_stack;     // free record indices
+        unsigned int    free_count;
+
+};  // end class SmfStateFile
+
+#endif // _SMF_STATE
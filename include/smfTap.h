@@ -0,0 +1,118 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_TAP
+#define _SMF_TAP
+
+#include "protoVif.h"
+#include "protoDefs.h"
+
+// The SmfTap class is a Linux multi-queue (IFF_MULTI_QUEUE) tap "vif" for the
+// nrlsmf "device".  It has one tap file descriptor per queue so that locally
+// originated traffic is not funneled through a single kernel tx queue (and
+// its lock) when several CPUs are sourcing traffic through the device.  The
+// kernel distributes the flows it sends across the queues, and frames we
+// write up to the kernel are dispatched to a queue by a hash of their IP
+// addresses.  The kernel tun flow steering then sends the return traffic for
+// a flow out the same queue.
+//
+// Notes:
+// 1) The queue descriptors are registered with an epoll instance that serves
+//    as this channel's descriptor, so the usual ProtoVif input notification
+//    covers all of the queues.  Read() services the ready queues round-robin.
+// 2) With the "vnetHdr" option, the tap uses IFF_VNET_HDR and enables the
+//    checksum and TSO (and USO where supported) offloads so the kernel hands
+//    us GSO super-frames with one read().  Read() returns them as a series of
+//    MTU-sized segments (with IP length/ID, TCP sequence, and checksums fixed
+//    up) so each segment gets its own SMF DPD identifier upstream.  Partial
+//    checksums of non-GSO frames are also completed by Read().
+// 3) On non-Linux systems, Open() fails (use ProtoVif::Create() instead).
+
+class SmfTap : public ProtoVif
+{
+    public:
+        SmfTap(unsigned int queueCount, bool vnetHdr = false);
+        ~SmfTap();
+
+        enum
+        {
+            QUEUE_COUNT_MAX = 64,
+            SUPER_FRAME_MAX = 65536 + 256   // GSO super-frame buffer size
+        };
+
+        bool Open(const char* vifName, const ProtoAddress& ipAddr, unsigned int maskLen);
+        void Close();
+        bool SetHardwareAddress(const ProtoAddress& ethAddr);
+        bool SetARP(bool status);
+        bool Write(const char* buffer, unsigned int numBytes);
+        bool Read(char* buffer, unsigned int& numBytes);
+
+        unsigned int GetQueueCount() const
+            {return queue_count;}
+        bool GetVnetHdr() const
+            {return vnet_hdr;}
+        
+        // Offload statistics
+        unsigned int GetSuperFrameCount() const
+            {return super_count;}
+        unsigned int GetSegmentCount() const
+            {return segment_count;}
+
+        // Picks the queue for the given Ethernet frame from a hash of its IP
+        // src/dst addresses (non-IP frames use queue 0)
+        static unsigned int GetFlowQueue(const char* frame, unsigned int frameLength, unsigned int queueCount);
+
+    private:
+        bool InitSegmentation(UINT8 gsoType, UINT16 gsoSize, unsigned int frameLength);
+        bool GetNextSegment(char* buffer, unsigned int& numBytes);
+        static UINT32 ChecksumAdd(UINT32 sum, const UINT8* data, unsigned int length);
+        static UINT16 ChecksumFold(UINT32 sum);
+        
+        unsigned int    queue_count;
+        int             queue_fd[QUEUE_COUNT_MAX];
+        unsigned int    read_index;     // next queue for Read() to check
+        bool            vnet_hdr;
+        // GSO super-frame segmentation state
+        char*           gso_buffer;
+        unsigned int    gso_length;     // super-frame length (0 when none pending)
+        unsigned int    gso_offset;     // offset of next segment payload
+        unsigned int    gso_index;      // next segment number
+        UINT16          gso_size;       // segment payload size
+        UINT8           gso_proto;      // TCP or UDP
+        bool            gso_ipv4;
+        unsigned int    gso_l4_offset;  // transport header offset
+        unsigned int    gso_hdr_len;    // Ethernet + IP + transport header length
+        UINT16          gso_ip_id;      // IPv4 ID of first segment
+        UINT32          gso_seq;        // TCP sequence of first segment
+        unsigned int    super_count;
+        unsigned int    segment_count;
+
+};  // end class SmfTap
+
+#endif // _SMF_TAP
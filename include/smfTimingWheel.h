@@ -0,0 +1,111 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_TIMING_WHEEL
+#define _SMF_TIMING_WHEEL
+
+#include "protoDefs.h"
+
+// The SmfTimingWheel class is a two-level hierarchical timing wheel used
+// for incremental aging of nrlsmf flow state.  Items (e.g., flows) are
+// scheduled by an integer "expire time" (in the same units as the nrlsmf
+// "currentTime", i.e. seconds) and Advance() returns the items that have
+// expired.  Scheduling, cancelling and expiring an item are O(1), so aging
+// work is proportional to the number of expired items rather than the
+// total number of items.
+//
+// Notes:
+// 1) Level 0 has one slot per time unit for the next SLOTS units and level 1
+//    has one slot per SLOTS units for the next SLOTS*SLOTS units.  Items
+//    further out are kept in the last level 1 slot and rescheduled when it
+//    is reached.
+// 2) Items scheduled for a time that has already passed expire upon the next
+//    Advance().
+
+class SmfTimingWheel
+{
+    public:
+        SmfTimingWheel();
+        ~SmfTimingWheel();
+
+        class Item
+        {
+            friend class SmfTimingWheel;
+            public:
+                Item();
+                ~Item();
+
+                bool IsScheduled() const
+                    {return (NULL != wheel_slot);}
+                unsigned int GetExpireTime() const
+                    {return expire_time;}
+
+                // Used to walk the list of items returned by Advance()
+                Item* GetNextExpired() const
+                    {return wheel_next;}
+
+            private:
+                unsigned int    expire_time;
+                Item**          wheel_slot;     // slot list head (NULL if not scheduled)
+                Item*           wheel_prev;
+                Item*           wheel_next;
+        };  // end class SmfTimingWheel::Item
+
+        // (Re)schedules the "item" to expire at "expireTime"
+        void Schedule(Item& item, unsigned int expireTime);
+        void Cancel(Item& item);
+
+        // Advances the wheel time to "currentTime" and returns the list of
+        // items with expire times at or before "currentTime" (no longer
+        // scheduled and linked via Item::GetNextExpired())
+        Item* Advance(unsigned int currentTime);
+
+        unsigned int GetCurrentTime() const
+            {return wheel_time;}
+        unsigned int GetCount() const
+            {return item_count;}
+
+    private:
+        enum
+        {
+            SLOT_BITS   = 6,
+            SLOTS       = (1 << SLOT_BITS),
+            SLOT_MASK   = (SLOTS - 1)
+        };
+
+        void Insert(Item& item);
+        static void Link(Item*& slotHead, Item& item);
+
+        Item*           slot_array[2][SLOTS];
+        unsigned int    wheel_time;
+        unsigned int    item_count;
+
+};  // end class SmfTimingWheel
+
+#endif // _SMF_TIMING_WHEEL
@@ -0,0 +1,109 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_TX_BATCH
+#define _SMF_TX_BATCH
+
+#include "protoDefs.h"
+
+// The SmfTxBatch class stages outbound Ethernet frames for an interface so
+// that they can be transmitted with a single system call (Linux sendmmsg())
+// instead of one ProtoCap::Forward() call per frame.  nrlsmf stages frames
+// as they are forwarded and flushes the batch when it is full, at the end of
+// each packet input handling cycle, or upon the batch latency timeout.
+//
+// Notes:
+// 1) Frames are copied into the batch buffer since the forwarding code
+//    reuses (and may modify) its frame buffer for each destination.
+// 2) Flush() uses the given (bound, non-blocking) packet socket descriptor,
+//    i.e. the ProtoCap descriptor on Linux.  On other systems Init() fails
+//    and nrlsmf sends frames individually as usual.
+
+class SmfTxBatch
+{
+    public:
+        SmfTxBatch();
+        ~SmfTxBatch();
+
+        enum {BATCH_SIZE_MAX = 256};
+
+        bool Init(unsigned int batchSize, unsigned int frameSizeMax);
+        void Destroy();
+        bool IsEnabled() const
+            {return (NULL != frame_buffer);}
+
+        unsigned int GetBatchSize() const
+            {return batch_size;}
+        bool IsEmpty() const
+            {return (send_index == frame_count);}
+        bool IsFull() const
+            {return (frame_count == batch_size);}
+
+        // Copies the frame into the batch, setting its source MAC address
+        // to "srcMac" (if non-NULL).  Returns "false" if batch is full.
+        bool Stage(const char* frame, unsigned int frameLength, const char* srcMac);
+
+        // Sends the staged frames via the socket "fd".  Returns "false" if
+        // the socket blocked (EAGAIN) with frames still pending, in which case
+        // the caller should wait for output readiness and call Flush() again.
+        // (Frames that fail with other errors are dropped and counted)
+        bool Flush(int fd);
+
+        // Staged frames not yet sent (e.g., to requeue them before a re-Init())
+        unsigned int GetPendingCount() const
+            {return (frame_count - send_index);}
+        const char* GetPendingFrame(unsigned int index, unsigned int& frameLength) const
+        {
+            frameLength = frame_length[send_index + index];
+            return (frame_buffer + ((send_index + index) * frame_size));
+        }
+
+        // Statistics
+        unsigned int GetSendCount() const
+            {return send_count;}
+        unsigned int GetFlushCount() const
+            {return flush_count;}
+        unsigned int GetErrorCount() const
+            {return error_count;}
+
+    private:
+        unsigned int    batch_size;
+        unsigned int    frame_size;      // max frame size (per buffer slot)
+        char*           frame_buffer;    // batch_size slots of frame_size bytes
+        unsigned int*   frame_length;
+        unsigned int    frame_count;     // number of staged frames (including sent ones)
+        unsigned int    send_index;      // index of first unsent staged frame
+        void*           msg_vector;      // "struct mmsghdr" array (Linux)
+        void*           iov_vector;      // "struct iovec" array
+        unsigned int    send_count;
+        unsigned int    flush_count;
+        unsigned int    error_count;
+};  // end class SmfTxBatch
+
+#endif // _SMF_TX_BATCH
@@ -0,0 +1,153 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_URING
+#define _SMF_URING
+
+#include "protoChannel.h"
+#include "protoDefs.h"
+
+// The SmfUring class provides a completion-based (Linux io_uring) receive
+// option for nrlsmf interfaces.  A single ring is shared by all interfaces
+// using it.  Each interface gets its own AF_PACKET socket with a "multishot"
+// receive request armed on the ring, so the kernel keeps posting a completion
+// per received frame without the request being resubmitted.  Frames are
+// received directly into a pool of kernel "provided buffers" and the ring's
+// eventfd is the ProtoChannel descriptor, so one dispatcher wakeup drains the
+// completions for all interfaces.
+//
+// Notes:
+// 1) This uses the raw io_uring system calls (no liburing dependency) and
+//    requires Linux 6.0 or later for multishot receive with a provided
+//    buffer ring.  Otherwise Open() fails and nrlsmf falls back to
+//    ProtoCap::Recv() for input.
+// 2) This is a receive-only mechanism.  The associated ProtoCap is still used
+//    for transmission (and for putting the interface into promiscuous mode).
+// 3) Received frames are handled in place within their buffer, so the buffer
+//    headroom is sized to match the SmfApp "alignedBuffer" layout (i.e. 256
+//    words for "smfPkt" message header use plus 2-byte alignment pad).
+
+class SmfUring : public ProtoChannel
+{
+    public:
+        SmfUring();
+        ~SmfUring();
+
+        enum
+        {
+            FRAME_SIZE          = 8192,
+            FRAME_HEADROOM      = (256*4 + 2),
+            FRAME_TAILROOM      = 256,
+            FRAME_COUNT_DEFAULT = 2048,     // 16 MB buffer pool (power of 2)
+            RING_SIZE_DEFAULT   = 256,      // submission queue entries
+            SOCKET_MAX          = 64        // max interfaces per ring
+        };
+
+        bool Open(unsigned int frameCount = FRAME_COUNT_DEFAULT,
+                  unsigned int ringSize = RING_SIZE_DEFAULT);
+        void Close();
+
+        // Opens an AF_PACKET socket bound to the given interface and arms its
+        // multishot receive.  Returns the socket's slot index (or -1 on error).
+        // Outbound (locally sent) frames are ignored.
+        int AddSocket(unsigned int ifIndex, const void* userData);
+        void RemoveSocket(int slot);
+        // (Frames received for a socket that is not enabled are discarded)
+        void EnableSocket(int slot, bool enable);
+        bool SocketIsEnabled(int slot) const
+            {return ((GetSocketHandle(slot) >= 0) && socket_table[slot].enabled);}
+        int GetSocketHandle(int slot) const
+            {return ((slot >= 0) && (slot < SOCKET_MAX)) ? socket_table[slot].fd : -1;}
+
+        // Clears the eventfd notification.  Call this before draining completions
+        // with GetNextFrame() so any completions posted meanwhile will re-notify.
+        void BeginReceive();
+        // Gets the next received frame (and its socket's "userData").  The frame
+        // is handled in place and the caller must call ReleaseFrame() when done
+        // with it.  Returns "false" when no more completions are available.
+        bool GetNextFrame(char*& frame, unsigned int& frameLength, const void*& userData);
+        void ReleaseFrame(char* frame);
+        // Returns consumed buffers to the kernel and re-arms any receive
+        // requests that terminated (e.g., if the buffer pool ran dry)
+        void EndReceive();
+
+        // Statistics
+        unsigned int GetRecvCount() const
+            {return recv_count;}
+        unsigned int GetRearmCount() const
+            {return rearm_count;}
+
+    private:
+        bool Arm(int slot);
+        bool Cancel(int slot);
+        struct io_uring_sqe* GetSqe();
+        bool Submit(bool getEvents = false);
+
+        struct Socket
+        {
+            int             fd;
+            const void*     user_data;
+            bool            enabled;
+            bool            armed;      // multishot receive is active
+            bool            closing;    // waiting for final completion
+        };
+
+        int                 ring_fd;
+        char*               sq_ring;
+        size_t              sq_ring_size;
+        char*               cq_ring;
+        size_t              cq_ring_size;
+        struct io_uring_sqe* sqe_array;
+        size_t              sqe_array_size;
+        unsigned int*       sq_head;
+        unsigned int*       sq_tail;
+        unsigned int*       sq_flags;
+        unsigned int        sq_mask;
+        unsigned int        sq_entries;
+        unsigned int*       sq_index_array;
+        unsigned int        sq_local_tail;  // includes prepared entries not yet submitted
+        unsigned int*       cq_head;
+        unsigned int*       cq_tail;
+        unsigned int        cq_mask;
+        struct io_uring_cqe* cqe_array;
+        unsigned int        cq_local_head;
+
+        char*               buffer_area;
+        size_t              buffer_size;
+        unsigned int        frame_count;
+        struct io_uring_buf* buf_ring;     // provided buffer ring (same count as frames)
+        size_t              buf_ring_size;
+        UINT16              buf_tail;
+
+        Socket              socket_table[SOCKET_MAX];
+        unsigned int        recv_count;
+        unsigned int        rearm_count;
+};  // end class SmfUring
+
+#endif // _SMF_URING
@@ -0,0 +1,108 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#ifndef _SMF_WINDOW_MASK
+#define _SMF_WINDOW_MASK
+
+#include "protoDefs.h"
+
+// The SmfWindowMask class is a fixed-size ring bitmap specialized for
+// sequence number duplicate detection windows.  The bit for sequence number
+// "seq" is always at ring position (seq & (size - 1)), so sliding the window
+// forward only needs to clear the bits passed over, which is done a 64-bit
+// word at a time (with AVX2 stores for long runs when built with -mavx2).
+// The window "delta" of a sequence number relative to the newest one set is
+// computed with a sign-extending shift instead of range comparisons.
+//
+// Notes:
+// 1) The size is a power of 2 (at least 64 bits) and must not exceed half
+//    of the sequence number space.
+// 2) This replaces ProtoSlidingMask for SmfDpdWindow flows.  See the
+//    "dpdBench" program (src/common/dpdBench.cpp) for a comparison.
+
+class SmfWindowMask
+{
+    public:
+        SmfWindowMask();
+        ~SmfWindowMask();
+
+        bool Init(UINT32 numBits,       // rounded up to a power of 2
+                  UINT8  seqNumSize);   // in bits (8 to 32)
+        void Destroy();
+
+        // Changes the window size, keeping the most recent history
+        bool Resize(UINT32 numBits);
+
+        UINT32 GetSize() const
+            {return num_bits;}
+        UINT32 GetRangeMask() const
+            {return range_mask;}
+        bool IsSet() const
+            {return is_set;}
+        bool GetLastSet(UINT32& seq) const
+        {
+            seq = last_set;
+            return is_set;
+        }
+
+        // Returns the signed distance of "seq" from the newest sequence set
+        // (i.e. positive for newer sequence numbers)
+        INT32 GetDelta(UINT32 seq) const
+            {return (((INT32)((seq - last_set) << delta_shift)) >> delta_shift);}
+
+        bool Test(UINT32 seq) const
+        {
+            UINT32 pos = seq & (num_bits - 1);
+            return (0 != (bits[pos >> 6] & ((UINT64)1 << (pos & 63))));
+        }
+        // Sets an older "seq" that is within the window
+        void Set(UINT32 seq)
+        {
+            UINT32 pos = seq & (num_bits - 1);
+            bits[pos >> 6] |= ((UINT64)1 << (pos & 63));
+        }
+        // Slides the window forward to make "seq" (delta > 0) the newest set
+        void Advance(UINT32 seq, UINT32 delta);
+        // Makes "seq" the only sequence set
+        void Reset(UINT32 seq);
+        void Clear();
+
+    private:
+        void ClearRange(UINT32 pos, UINT32 count);
+
+        UINT64*     bits;
+        UINT32      num_bits;
+        UINT32      range_mask;
+        unsigned int delta_shift;   // 32 - seqNumSize
+        UINT32      last_set;
+        bool        is_set;
+
+};  // end class SmfWindowMask
+
+#endif // _SMF_WINDOW_MASK
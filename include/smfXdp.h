@@ -0,0 +1,174 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _SMF_XDP
+#define _SMF_XDP
+
+#include "protoChannel.h"
+#include "protoDefs.h"
+
+#ifdef HAVE_XDP
+#include <xdp/xsk.h>  // from libxdp
+#endif // HAVE_XDP
+
+// These classes provide an AF_XDP packet I/O option for nrlsmf interfaces
+// (in addition to ProtoCap and ProtoDetour).  A single SmfXdpUmem packet
+// buffer area is shared by all of the SmfXdpSocket instances (one per
+// interface) so that a frame received on one interface can be transmitted
+// on another by passing its UMEM descriptor without copying it.
+//
+// Notes:
+// 1) This requires building with -DHAVE_XDP and linking libxdp/libbpf (see
+//    Makefile.common "XDP" option).  Otherwise SmfXdpSocket::Open() fails.
+// 2) The socket is bound to a single device queue (queue 0 by default), so
+//    multi-queue NICs should be configured accordingly (e.g., "ethtool -L
+//    <iface> combined 1").  Frames arriving on other queues still reach
+//    the interface's ProtoCap.  This works with veth pairs, using the
+//    kernel XDP_COPY mode where driver zero-copy is not supported.
+// 3) Received frames are handled in place within their UMEM frame, so the
+//    UMEM frame headroom is sized to match the SmfApp "alignedBuffer" layout
+//    (i.e. 256 words for "smfPkt" message header use plus 2-byte alignment pad).
+
+class SmfXdpUmem
+{
+    public:
+        SmfXdpUmem();
+        ~SmfXdpUmem();
+
+        enum
+        {
+            FRAME_SIZE          = 4096,
+            FRAME_HEADROOM      = (256*4 + 2),
+            FRAME_COUNT_DEFAULT = 16384,     // 64 MB UMEM area
+            RING_SIZE           = 1024       // per-socket fill/comp/rx/tx ring size
+        };
+
+        bool Open(unsigned int frameCount = FRAME_COUNT_DEFAULT);
+        void Close();
+        bool IsOpen() const
+            {return (NULL != umem_area);}
+
+        // UMEM frame allocation.  Each frame has a reference count that is
+        // held by the kernel (fill/tx rings) or nrlsmf (rx handling) and the
+        // frame is returned to the free list when it drops to zero.
+        bool AllocFrame(UINT64& addr);
+        // (Note "addr" may be anywhere within the given frame)
+        void RetainFrame(UINT64 addr)
+            {ref_count[addr / FRAME_SIZE]++;}
+        void ReleaseFrame(UINT64 addr);
+        unsigned int GetRefCount(UINT64 addr) const
+            {return ref_count[addr / FRAME_SIZE];}
+        unsigned int GetFreeCount() const
+            {return free_count;}
+
+        bool Contains(const char* ptr) const
+            {return ((ptr >= umem_area) && (ptr < (umem_area + umem_size)));}
+        UINT64 GetAddress(const char* ptr) const
+            {return (UINT64)(ptr - umem_area);}
+        char* GetPointer(UINT64 addr) const
+            {return (umem_area + addr);}
+
+#ifdef HAVE_XDP
+        struct xsk_umem* GetHandle() const
+            {return umem_handle;}
+#endif // HAVE_XDP
+
+    private:
+        char*               umem_area;
+        size_t              umem_size;
+        unsigned int        frame_count;
+        UINT64*             free_stack;
+        unsigned int        free_count;
+        UINT16*             ref_count;
+#ifdef HAVE_XDP
+        struct xsk_umem*    umem_handle;
+        struct xsk_ring_prod umem_fill;   // initial rings (adopted by first socket)
+        struct xsk_ring_cons umem_comp;
+#endif // HAVE_XDP
+};  // end class SmfXdpUmem
+
+class SmfXdpSocket : public ProtoChannel
+{
+    public:
+        SmfXdpSocket(SmfXdpUmem& theUmem);
+        ~SmfXdpSocket();
+
+        bool Open(const char* ifaceName, unsigned int queueId = 0, bool zeroCopy = false);
+        void Close();
+
+        SmfXdpUmem& GetUmem() const
+            {return umem;}
+
+        // Gets the next received frame.  The frame is handled in place and
+        // the caller must call ReleaseFrame() when done with it.  Returns
+        // "false" when no more frames are available.
+        bool GetNextFrame(char*& frame, unsigned int& frameLength);
+        void ReleaseFrame(char* frame)
+            {umem.ReleaseFrame(umem.GetAddress(frame));}
+        // Completes received frame handling (returns rx ring slots, refills fill ring)
+        void EndReceive();
+
+        // Sends the frame, setting its source MAC address to "srcMac".  If "handoff"
+        // is true and the "frame" is a received frame in our shared UMEM that
+        // is not otherwise in use, it is transmitted by descriptor with no copy
+        // (and the caller must not modify the frame afterwards).  Otherwise it
+        // is copied into a free UMEM frame.  Returns "false" with "frameLength"
+        // unchanged if the tx ring is full (i.e., blocked) and "false" with a
+        // zero "frameLength" upon error.
+        bool Send(char* frame, unsigned int& frameLength, const char* srcMac, bool handoff = false);
+
+        // Statistics
+        unsigned int GetRecvCount() const
+            {return recv_count;}
+        unsigned int GetSendCount() const
+            {return send_count;}
+        unsigned int GetZeroCopyCount() const
+            {return zcopy_count;}
+
+    private:
+        void Reclaim();     // process completion ring
+        void Refill();      // refill the fill ring with free UMEM frames
+        void Kick();        // wake up kernel tx processing if needed
+
+        SmfXdpUmem&             umem;
+        unsigned int            rx_index;     // next rx descriptor to handle
+        unsigned int            rx_count;     // rx descriptors peeked but not yet handled
+        unsigned int            rx_peeked;    // rx descriptors to release in EndReceive()
+        unsigned int            recv_count;
+        unsigned int            send_count;
+        unsigned int            zcopy_count;
+#ifdef HAVE_XDP
+        struct xsk_socket*      xsk;
+        struct xsk_ring_cons    rx_ring;
+        struct xsk_ring_prod    tx_ring;
+        struct xsk_ring_prod    fill_ring;
+        struct xsk_ring_cons    comp_ring;
+#endif // HAVE_XDP
+};  // end class SmfXdpSocket
+
+#endif // _SMF_XDP
@@ -17,12 +17,27 @@ LOCAL_SRC_FILES := \
 	../../../src/common/nrlsmf.cpp \
 	../../../src/common/smf.cpp \
 	../../../src/common/smfDpd.cpp \
+	../../../src/common/smfFlowKey.cpp \
 	../../../src/common/smfHash.cpp \
 	../../../src/common/smfHashMD5.cpp \
 	../../../src/common/smfHashSHA1.cpp \
+	../../../src/common/smfHashXXH3.cpp \
+	../../../src/common/smfHashSipHash.cpp \
+	../../../src/common/smfHashMulti.cpp \
+	../../../src/common/smfPktInfo.cpp \
 	../../../src/common/smfQueue.cpp \
 	../../../src/common/smfConfig.cpp \
 	../../../src/common/smfVrf.cpp \
+	../../../src/common/smfRing.cpp \
+	../../../src/common/smfXdp.cpp \
+	../../../src/common/smfTxBatch.cpp \
+	../../../src/common/smfShard.cpp \
+	../../../src/common/smfTap.cpp \
+	../../../src/common/smfUring.cpp \
+	../../../src/common/smfWindowMask.cpp \
+	../../../src/common/smfSlab.cpp \
+	../../../src/common/smfTimingWheel.cpp \
+	../../../src/common/smfState.cpp \
 	../../../protolib/src/linux/linuxCap.cpp \
 	../../../protolib/src/common/protoVif.cpp \
 	../../../protolib/src/unix/unixVif.cpp
@@ -0,0 +1,520 @@
+// This "dpdBench" program is a microbenchmark comparing the SmfWindowMask
+// ring bitmap used for window-based duplicate packet detection (I-DPD)
+// with the ProtoSlidingMask based implementation it replaced.  Both run
+// the same window update logic over a few synthetic sequence number
+// patterns and the resulting duplicate counts are cross-checked.
+//
+// It then cross-checks the other nrlsmf DPD and flow aging classes against
+// a reference:
+//   - SmfDpdHashTable, SmfDpdShared and SmfDpdFilter against SmfDpdTable
+//     (one per interface) over a synthetic multi-flow packet id stream,
+//   - SmfTimingWheel against a brute force scan of item expire times, and
+//   - SmfStateFile records adopted upon reopening against the records
+//     that were written.
+//
+// Usage: dpdBench [<windowSize> [<packetCount>]]
+
+#include "smfWindowMask.h"
+#include "smfDpd.h"
+#include "smfTimingWheel.h"
+#include "smfState.h"
+
+#include <protoBitmask.h>
+#include <protoDebug.h>
+#include <protoDefs.h>
+#include <protoTime.h>
+
+#include <stdio.h>   // for printf()
+#include <stdlib.h>  // for rand(), srand(), atoi()
+#include <string.h>  // for memset(), memcpy()
+#include <unistd.h>  // for getpid(), unlink()
+
+// Window update as formerly done by SmfDpdWindow::Flow::IsDuplicate()
+static bool SlidingMaskIsDuplicate(ProtoSlidingMask& bitmask, UINT32 seq)
+{
+    UINT32 lastSet;
+    if (!bitmask.GetLastSet(lastSet))
+    {
+        bitmask.Set(seq);
+        return false;
+    }
+    INT32 rangeSign = (INT32)bitmask.GetRangeSign();
+    INT32 rangeMask = (INT32)bitmask.GetRangeMask();
+    INT32 delta = seq - lastSet;
+    delta = ((0 == (delta & rangeSign)) ?
+                    (delta & rangeMask) :
+                    (((delta != rangeSign) || (seq < lastSet)) ?
+                        (delta | ~rangeMask) : delta));
+    if (delta > 0)
+    {
+        INT32 bitmaskSize = bitmask.GetSize();
+        if (delta < bitmaskSize)
+        {
+            UINT32 index = (lastSet - bitmaskSize + 1) & rangeMask;
+            bitmask.UnsetBits(index, delta);
+        }
+        else
+        {
+            bitmask.Clear();
+        }
+        bitmask.Set(seq);
+        return false;
+    }
+    else if (delta < 0)
+    {
+        delta = -delta;
+        if (delta < (INT32)bitmask.GetSize())
+        {
+            if (bitmask.Test(seq)) return true;
+            bitmask.Set(seq);
+            return false;
+        }
+        bitmask.Clear();
+        bitmask.Set(seq);
+        return false;
+    }
+    return true;
+}  // end SlidingMaskIsDuplicate()
+
+// Window update as done by SmfDpdWindow::Flow::IsDuplicate() (fixed size)
+static bool WindowMaskIsDuplicate(SmfWindowMask& bitmask, UINT32 seq)
+{
+    if (!bitmask.IsSet())
+    {
+        bitmask.Reset(seq);
+        return false;
+    }
+    INT32 delta = bitmask.GetDelta(seq);
+    if (delta > 0)
+    {
+        bitmask.Advance(seq, delta);
+        return false;
+    }
+    else if (delta < 0)
+    {
+        if ((UINT32)(-delta) < bitmask.GetSize())
+        {
+            if (bitmask.Test(seq)) return true;
+            bitmask.Set(seq);
+            return false;
+        }
+        bitmask.Reset(seq);
+        return false;
+    }
+    return true;
+}  // end WindowMaskIsDuplicate()
+
+// Synthetic multi-flow packet id stream for the DPD cross-checks: packets
+// of CHECK_FLOWS flows at CHECK_RATE packets per second, with 1 in 4 being
+// a repeat of one of the last CHECK_DEPTH packet ids of its flow (so well
+// within CHECK_AGE_MAX), arriving on one of "ifaceCount" interfaces
+enum
+{
+    CHECK_FLOWS     = 64,
+    CHECK_DEPTH     = 64,
+    CHECK_RATE      = 1000,     // packets per second
+    CHECK_AGE_MAX   = 10,       // seconds
+    CHECK_PKTS      = 200000
+};
+
+class CheckStream
+{
+    public:
+        CheckStream(unsigned int ifaceCount)
+         : iface_count(ifaceCount), pkt_index(0)
+        {
+            memset(flow_seq, 0, sizeof(flow_seq));
+            srand(1);
+        }
+
+        // Sets the next packet's time, interface, flowKey and (16-bit) pktId
+        void Next(unsigned int& currentTime, unsigned int& ifaceIndex, SmfFlowKey& flowKey, char* pktId)
+        {
+            currentTime = pkt_index++ / CHECK_RATE;
+            ifaceIndex = rand() % iface_count;
+            unsigned int flow = rand() % CHECK_FLOWS;
+            UINT16 seq;
+            if ((flow_seq[flow] > CHECK_DEPTH) && (0 == (rand() % 4)))
+                seq = flow_seq[flow] - (rand() % CHECK_DEPTH);
+            else
+                seq = ++flow_seq[flow];
+            // flowId is a <srcAddr:dstAddr> pair
+            char flowId[8] = {10, 0, 0, (char)flow, (char)239, 0, 0, 1};
+            flowKey.SetKey(flowId, 64);
+            pktId[0] = (char)(seq >> 8);
+            pktId[1] = (char)(seq & 0xff);
+        }
+
+    private:
+        unsigned int    iface_count;
+        unsigned int    pkt_index;
+        UINT16          flow_seq[CHECK_FLOWS];
+};  // end class CheckStream
+
+// Runs the check stream through "dpd" and a reference SmfDpdTable for each
+// interface.  When "exact", every result must match.  Otherwise (i.e., for
+// the probabilistic SmfDpdFilter), no duplicate may be missed and false
+// positives are bounded by "fpRate".  "store" is pruned instead of "dpd"
+// when given (i.e., for SmfDpdShared).
+static bool CheckDpd(const char*        name,
+                     SmfDpd**           dpd,
+                     unsigned int       ifaceCount,
+                     bool               exact,
+                     double             fpRate = 0.0,
+                     SmfDpdHashTable*   store = NULL)
+{
+    SmfDpdTable* ref[2];
+    for (unsigned int i = 0; i < ifaceCount; i++)
+        ref[i] = new SmfDpdTable(65536);
+    CheckStream stream(ifaceCount);
+    unsigned int dupCount = 0;
+    unsigned int mismatchCount = 0;
+    unsigned int missCount = 0;
+    unsigned int falseCount = 0;
+    unsigned int pruneTime = 0;
+    for (unsigned int i = 0; i < CHECK_PKTS; i++)
+    {
+        unsigned int currentTime, ifaceIndex;
+        SmfFlowKey flowKey;
+        char pktId[2];
+        stream.Next(currentTime, ifaceIndex, flowKey, pktId);
+        if (currentTime != pruneTime)
+        {
+            pruneTime = currentTime;
+            for (unsigned int j = 0; j < ifaceCount; j++)
+            {
+                ref[j]->Prune(currentTime, CHECK_AGE_MAX);
+                if (NULL == store) dpd[j]->Prune(currentTime, CHECK_AGE_MAX);
+            }
+            if (NULL != store) store->Prune(currentTime, CHECK_AGE_MAX);
+        }
+        bool refDup = ref[ifaceIndex]->IsDuplicate(currentTime, flowKey, pktId, 16);
+        bool dup = dpd[ifaceIndex]->IsDuplicate(currentTime, flowKey, pktId, 16);
+        if (refDup) dupCount++;
+        if (refDup != dup)
+        {
+            if (0 == mismatchCount++)
+                fprintf(stderr, "dpdBench: %s first mismatch at packet %u (table:%d %s:%d)\n",
+                        name, i, refDup, name, dup);
+            if (refDup)
+                missCount++;
+            else
+                falseCount++;
+        }
+    }
+    for (unsigned int i = 0; i < ifaceCount; i++)
+        delete ref[i];
+    bool result;
+    if (exact)
+    {
+        result = (0 == mismatchCount);
+        printf("%-16s %s (%u dups, %u mismatches)\n", name, result ? "ok" : "FAILED", dupCount, mismatchCount);
+    }
+    else
+    {
+        unsigned int falseMax = 1 + (unsigned int)(fpRate * (double)(CHECK_PKTS - dupCount));
+        result = (0 == missCount) && (falseCount <= falseMax);
+        printf("%-16s %s (%u dups, %u missed, %u false (max %u))\n", name, result ? "ok" : "FAILED",
+               dupCount, missCount, falseCount, falseMax);
+    }
+    return result;
+}  // end CheckDpd()
+
+class CheckItem : public SmfTimingWheel::Item
+{
+    public:
+        CheckItem() : scheduled(false), expire_at(0), expired(false) {}
+
+        bool            scheduled;      // reference state
+        unsigned int    expire_at;
+        bool            expired;        // returned by the last Advance()
+};  // end class CheckItem
+
+// Randomly schedules, reschedules and cancels items (including past due ones
+// and ones beyond the wheel's level 1 range) while advancing a time unit at a
+// time, and checks each Advance() returns exactly the items due
+static bool CheckTimingWheel()
+{
+    const unsigned int ITEM_COUNT = 4096;
+    const unsigned int TIME_MAX = 20000;
+    CheckItem* item = new CheckItem[ITEM_COUNT];
+    SmfTimingWheel wheel;
+    srand(1);
+    unsigned int expireCount = 0;
+    unsigned int mismatchCount = 0;
+    for (unsigned int t = 1; (t <= TIME_MAX) && (0 == mismatchCount); t++)
+    {
+        for (unsigned int k = 0; k < 8; k++)
+        {
+            CheckItem& next = item[rand() % ITEM_COUNT];
+            switch (rand() % 8)
+            {
+                case 0:
+                    wheel.Cancel(next);
+                    next.scheduled = false;
+                    break;
+                case 1:  // past due
+                    next.expire_at = t - (rand() % 4) - 1;
+                    wheel.Schedule(next, next.expire_at);
+                    next.scheduled = true;
+                    break;
+                case 2:  // beyond level 1
+                    next.expire_at = t + 4096 + (rand() % 8192);
+                    wheel.Schedule(next, next.expire_at);
+                    next.scheduled = true;
+                    break;
+                default:
+                    next.expire_at = t + (rand() % 4096);
+                    wheel.Schedule(next, next.expire_at);
+                    next.scheduled = true;
+                    break;
+            }
+        }
+        for (SmfTimingWheel::Item* x = wheel.Advance(t); NULL != x; x = x->GetNextExpired())
+            static_cast<CheckItem*>(x)->expired = true;
+        unsigned int scheduledCount = 0;
+        for (unsigned int i = 0; i < ITEM_COUNT; i++)
+        {
+            CheckItem& next = item[i];
+            bool due = next.scheduled && ((int)(t - next.expire_at) >= 0);
+            if ((due != next.expired) || (next.IsScheduled() != (next.scheduled && !due)))
+            {
+                if (0 == mismatchCount++)
+                    fprintf(stderr, "dpdBench: timing wheel mismatch at time %u item %u (expire:%u due:%d expired:%d)\n",
+                            t, i, next.expire_at, due, next.expired);
+            }
+            if (due)
+            {
+                expireCount++;
+                next.scheduled = false;
+            }
+            next.expired = false;
+            if (next.scheduled) scheduledCount++;
+        }
+        if (scheduledCount != wheel.GetCount())
+        {
+            if (0 == mismatchCount++)
+                fprintf(stderr, "dpdBench: timing wheel count mismatch at time %u (%u vs %u)\n",
+                        t, wheel.GetCount(), scheduledCount);
+        }
+    }
+    for (unsigned int i = 0; i < ITEM_COUNT; i++)
+        wheel.Cancel(item[i]);
+    delete[] item;
+    bool result = (0 == mismatchCount);
+    printf("%-16s %s (%u expired)\n", "SmfTimingWheel", result ? "ok" : "FAILED", expireCount);
+    return result;
+}  // end CheckTimingWheel()
+
+// Writes records of each type to a state file (releasing some and filling it),
+// reopens it and checks exactly the remaining records are adopted intact.  Then
+// checks a file with a different capacity is not adopted.
+static bool CheckStateFile()
+{
+    const unsigned int CAPACITY = 1024;
+    char path[64];
+    snprintf(path, 64, "/tmp/dpdBench.%d.state", (int)getpid());
+    unlink(path);
+    SmfStateFile stateFile;
+    bool adopted;
+    if (!stateFile.Open(path, SmfStateFile::STALE_MAX_DEFAULT, CAPACITY, &adopted) || adopted)
+    {
+        fprintf(stderr, "dpdBench: state file open error\n");
+        unlink(path);
+        return false;
+    }
+    // Each flow's flowId is its index, with its type and value derived from it
+    SmfStateFile::Record* record[CAPACITY];
+    bool live[CAPACITY];
+    srand(1);
+    unsigned int errorCount = 0;
+    for (unsigned int i = 0; i < CAPACITY; i++)
+    {
+        UINT32 flowId[2] = {i, ~i};
+        SmfStateFile::RecordType type = (SmfStateFile::RecordType)(SmfStateFile::SEQ_IPV4 + (i % 3));
+        if (NULL == (record[i] = stateFile.Allocate(type, (const char*)flowId, 64)))
+        {
+            errorCount++;
+            live[i] = false;
+            continue;
+        }
+        record[i]->value = i * 7;
+        record[i]->if_index = i % 5;
+        live[i] = true;
+    }
+    if (NULL != stateFile.Allocate(SmfStateFile::WINDOW, "full", 32))
+        errorCount++;  // should be full
+    unsigned int liveCount = CAPACITY;
+    for (unsigned int i = 0; i < CAPACITY; i++)
+    {
+        if (live[i] && (0 == (rand() % 3)))
+        {
+            stateFile.Release(record[i]);
+            live[i] = false;
+            liveCount--;
+        }
+    }
+    stateFile.Close();
+    if (!stateFile.Open(path, SmfStateFile::STALE_MAX_DEFAULT, CAPACITY, &adopted) || !adopted)
+    {
+        fprintf(stderr, "dpdBench: state file reopen error\n");
+        unlink(path);
+        return false;
+    }
+    unsigned int adoptCount = 0;
+    for (unsigned int t = SmfStateFile::SEQ_IPV4; t <= SmfStateFile::WINDOW; t++)
+    {
+        SmfStateFile::RecordType type = (SmfStateFile::RecordType)t;
+        SmfStateFile::Record* next = NULL;
+        while (NULL != (next = stateFile.GetNextPending(type, next)))
+        {
+            UINT32 flowId[2];
+            memcpy(flowId, next->flow_id, 8);
+            unsigned int i = flowId[0];
+            if ((64 != next->flow_id_size) || (i >= CAPACITY) || (flowId[1] != ~i) || !live[i] ||
+                (type != (SmfStateFile::RecordType)(SmfStateFile::SEQ_IPV4 + (i % 3))) ||
+                (next->value != (i * 7)) || (next->if_index != (i % 5)))
+            {
+                if (0 == errorCount++)
+                    fprintf(stderr, "dpdBench: state file adopted unexpected record (flow %u)\n", i);
+            }
+            live[i] = false;  // (so a record adopted twice is caught)
+            stateFile.Claim(*next);
+            adoptCount++;
+        }
+    }
+    stateFile.ReleasePending();
+    if ((adoptCount != liveCount) || (stateFile.GetRecordCount() != liveCount)) errorCount++;
+    stateFile.Close();
+    if (!stateFile.Open(path, SmfStateFile::STALE_MAX_DEFAULT, CAPACITY / 2, &adopted) || adopted ||
+        (0 != stateFile.GetRecordCount()))
+        errorCount++;
+    stateFile.Close();
+    unlink(path);
+    bool result = (0 == errorCount);
+    printf("%-16s %s (%u of %u records adopted)\n", "SmfStateFile", result ? "ok" : "FAILED", adoptCount, liveCount);
+    return result;
+}  // end CheckStateFile()
+
+static double GetElapsed(const struct timeval& startTime, const struct timeval& stopTime)
+{
+    return ((double)(stopTime.tv_sec - startTime.tv_sec) +
+            1.0e-06 * ((double)stopTime.tv_usec - (double)startTime.tv_usec));
+}  // end GetElapsed()
+
+int main(int argc, char* argv[])
+{
+    unsigned int windowSize = (argc > 1) ? atoi(argv[1]) : 1024;
+    unsigned int pktCount = (argc > 2) ? atoi(argv[2]) : 10000000;
+    if ((windowSize < 64) || (windowSize > 0x8000) || (0 != (windowSize & (windowSize - 1))) || (0 == pktCount))
+    {
+        fprintf(stderr, "Usage: dpdBench [<windowSize> [<packetCount>]]  (windowSize is a power of 2, 64 to 32768)\n");
+        return -1;
+    }
+    // Synthetic 16-bit sequence number patterns
+    const char* patternName[] = {"in-order", "bursty", "reordered", "duplicated"};
+    const unsigned int PATTERN_COUNT = sizeof(patternName) / sizeof(const char*);
+    UINT16* seqList = new UINT16[pktCount];
+    if (NULL == seqList)
+    {
+        fprintf(stderr, "dpdBench: new seqList error: %s\n", GetErrorString());
+        return -1;
+    }
+    printf("dpdBench: window size %u, %u packets per pattern\n", windowSize, pktCount);
+    printf("%-12s %14s %14s %8s\n", "pattern", "sliding nsec", "ring nsec", "speedup");
+    int result = 0;
+    for (unsigned int p = 0; p < PATTERN_COUNT; p++)
+    {
+        srand(1);
+        UINT16 seq = 0;
+        for (unsigned int i = 0; i < pktCount; i++)
+        {
+            switch (p)
+            {
+                case 0:  // in-order
+                    seq++;
+                    break;
+                case 1:  // bursty (loss bursts of up to 3/4 window)
+                    seq += (0 == (rand() % 16)) ? (1 + (rand() % (3 * windowSize / 4))) : 1;
+                    break;
+                case 2:  // reordered (multipath, up to 1/2 window late)
+                    seq++;
+                    break;
+                default:  // duplicated (1 in 4 packets repeated from within the window)
+                    seq++;
+                    break;
+            }
+            seqList[i] = seq;
+            if ((2 == p) && (i > windowSize) && (0 == (rand() % 8)))
+            {
+                unsigned int j = i - (rand() % (windowSize / 2));
+                UINT16 tmp = seqList[i];
+                seqList[i] = seqList[j];
+                seqList[j] = tmp;
+            }
+            else if ((3 == p) && (i > windowSize) && (0 == (rand() % 4)))
+            {
+                seqList[i] = seqList[i - 1 - (rand() % (windowSize / 2))];
+            }
+        }
+        ProtoSlidingMask slidingMask;
+        SmfWindowMask windowMask;
+        if (!slidingMask.Init(windowSize, 0xffff) || !windowMask.Init(windowSize, 16))
+        {
+            fprintf(stderr, "dpdBench: bitmask init error\n");
+            result = -1;
+            break;
+        }
+        struct timeval startTime, stopTime;
+        unsigned int slidingDups = 0;
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < pktCount; i++)
+            if (SlidingMaskIsDuplicate(slidingMask, seqList[i])) slidingDups++;
+        ProtoSystemTime(stopTime);
+        double slidingTime = GetElapsed(startTime, stopTime);
+        unsigned int windowDups = 0;
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < pktCount; i++)
+            if (WindowMaskIsDuplicate(windowMask, seqList[i])) windowDups++;
+        ProtoSystemTime(stopTime);
+        double windowTime = GetElapsed(startTime, stopTime);
+        printf("%-12s %14.2f %14.2f %7.2fx\n", patternName[p],
+               1.0e+09 * slidingTime / (double)pktCount,
+               1.0e+09 * windowTime / (double)pktCount,
+               (windowTime > 0.0) ? (slidingTime / windowTime) : 0.0);
+        if (slidingDups != windowDups)
+        {
+            fprintf(stderr, "dpdBench: %s duplicate count mismatch (sliding:%u ring:%u)\n",
+                    patternName[p], slidingDups, windowDups);
+            result = -1;
+        }
+    }
+    delete[] seqList;
+
+    printf("\ndpdBench: cross-checks (%u packets, %u flows)\n", (unsigned int)CHECK_PKTS, (unsigned int)CHECK_FLOWS);
+    SmfDpdHashTable hashTable;
+    SmfDpdFilter filter;
+    SmfDpdHashTable store;
+    if (!hashTable.Init(32768) || !filter.Init() || !store.Init(32768))
+    {
+        fprintf(stderr, "dpdBench: DPD init error\n");
+        return -1;
+    }
+    SmfDpd* dpd[2] = {&hashTable, NULL};
+    if (!CheckDpd("SmfDpdHashTable", dpd, 1, true)) result = -1;
+    dpd[0] = &filter;
+    if (!CheckDpd("SmfDpdFilter", dpd, 1, false, SmfDpdFilter::FP_RATE_DEFAULT)) result = -1;
+    SmfDpdShared shared0(store);
+    SmfDpdShared shared1(store);
+    if (!shared0.Init() || !shared1.Init())
+    {
+        fprintf(stderr, "dpdBench: SmfDpdShared init error\n");
+        return -1;
+    }
+    dpd[0] = &shared0;
+    dpd[1] = &shared1;
+    if (!CheckDpd("SmfDpdShared", dpd, 2, true, 0.0, &store)) result = -1;
+    if (!CheckTimingWheel()) result = -1;
+    if (!CheckStateFile()) result = -1;
+    return result;
+}  // end main()
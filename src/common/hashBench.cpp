@@ -0,0 +1,126 @@
+// This "hashBench" program is a microbenchmark comparing the throughput of
+// the SmfHash algorithms available for H-DPD ("hash" and "ihash" commands)
+// across a range of payload sizes.  Each algorithm hashes the same random
+// payloads and the time per hash and throughput are reported.  The "MD5x8"
+// rows are the SmfHashMulti multi-buffer MD5 used for batched H-DPD.
+//
+// Usage: hashBench [<hashCount> [<payloadSize> ...]]
+
+#include "smfHash.h"
+#include "smfHashMD5.h"
+#include "smfHashSHA1.h"
+#include "smfHashXXH3.h"
+#include "smfHashSipHash.h"
+#include "smfHashMulti.h"
+
+#include <protoDebug.h>
+#include <protoDefs.h>
+#include <protoTime.h>
+
+#include <stdio.h>   // for printf()
+#include <stdlib.h>  // for rand(), atoi()
+
+static double GetElapsed(const struct timeval& startTime, const struct timeval& stopTime)
+{
+    return ((double)(stopTime.tv_sec - startTime.tv_sec) +
+            1.0e-06 * ((double)stopTime.tv_usec - (double)startTime.tv_usec));
+}  // end GetElapsed()
+
+int main(int argc, char* argv[])
+{
+    unsigned int hashCount = (argc > 1) ? atoi(argv[1]) : 1000000;
+    const unsigned int SIZE_DEFAULT[] = {64, 256, 512, 1400, 8192};
+    const unsigned int PAYLOAD_MAX = 65535;
+    unsigned int sizeCount = (argc > 2) ? (argc - 2) : (sizeof(SIZE_DEFAULT) / sizeof(unsigned int));
+    unsigned int* sizeList = new unsigned int[sizeCount];
+    char* payload = new char[PAYLOAD_MAX];
+    if ((NULL == sizeList) || (NULL == payload))
+    {
+        fprintf(stderr, "hashBench: new buffer error: %s\n", GetErrorString());
+        return -1;
+    }
+    for (unsigned int i = 0; i < sizeCount; i++)
+    {
+        sizeList[i] = (argc > 2) ? atoi(argv[i + 2]) : SIZE_DEFAULT[i];
+        if ((0 == hashCount) || (0 == sizeList[i]) || (sizeList[i] > PAYLOAD_MAX))
+        {
+            fprintf(stderr, "Usage: hashBench [<hashCount> [<payloadSize> ...]]  (payloadSize is 1 to 65535 bytes)\n");
+            delete[] sizeList;
+            delete[] payload;
+            return -1;
+        }
+    }
+    srand(1);
+    for (unsigned int i = 0; i < PAYLOAD_MAX; i++)
+        payload[i] = (char)rand();
+
+    SmfHash* hashList[] =
+    {
+        new SmfHashMD5,
+        new SmfHashSHA1,
+        new SmfHashCRC32,
+        new SmfHashCRC32C,
+        new SmfHashXXH3,
+        new SmfHashSipHash,
+        NULL
+    };
+    printf("hashBench: %u hashes per payload size (CRC32 engine:%s CRC32C engine:%s MD5x%d engine:%s)\n",
+           hashCount, SmfHashCRC32::GetEngineName(), SmfHashCRC32C::GetEngineName(),
+           SmfHashMulti::LANES, SmfHashMulti::GetEngineName());
+    printf("%-8s %8s %12s %12s\n", "hash", "bytes", "nsec/hash", "MB/sec");
+    for (SmfHash** hashPtr = hashList; NULL != *hashPtr; hashPtr++)
+    {
+        SmfHash* hash = *hashPtr;
+        for (unsigned int s = 0; s < sizeCount; s++)
+        {
+            unsigned int size = sizeList[s];
+            unsigned int check = 0;  // so the work is not optimized away
+            struct timeval startTime, stopTime;
+            ProtoSystemTime(startTime);
+            for (unsigned int i = 0; i < hashCount; i++)
+            {
+                // (varying offset so each hash is of a different payload)
+                unsigned int offset = i & 0xff;
+                if ((offset + size) > PAYLOAD_MAX) offset = 0;
+                hash->Compute(payload + offset, size);
+                check += (UINT8)hash->GetValue()[0];
+            }
+            ProtoSystemTime(stopTime);
+            double elapsed = GetElapsed(startTime, stopTime);
+            printf("%-8s %8u %12.2f %12.1f\n", SmfHash::GetName(hash->GetType()), size,
+                   1.0e+09 * elapsed / (double)hashCount,
+                   (elapsed > 0.0) ? ((double)size * (double)hashCount / elapsed / 1.0e+06) : 0.0);
+            if (0 == check) PLOG(PL_DEBUG, "hashBench: zero check sum\n");
+        }
+        delete hash;
+    }
+    SmfHashMulti multi;
+    for (unsigned int s = 0; s < sizeCount; s++)
+    {
+        unsigned int size = sizeList[s];
+        unsigned int check = 0;
+        struct timeval startTime, stopTime;
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < hashCount; i += SmfHashMulti::LANES)
+        {
+            multi.Init();
+            for (unsigned int j = i; (j < hashCount) && (j < (i + SmfHashMulti::LANES)); j++)
+            {
+                unsigned int offset = j & 0xff;
+                if ((offset + size) > PAYLOAD_MAX) offset = 0;
+                multi.ComputeHash(payload + offset, size);
+            }
+            multi.Compute();
+            check += (UINT8)multi.GetValue(0)[0];
+        }
+        ProtoSystemTime(stopTime);
+        double elapsed = GetElapsed(startTime, stopTime);
+        printf("MD5x%-4d %8u %12.2f %12.1f\n", SmfHashMulti::LANES, size,
+               1.0e+09 * elapsed / (double)hashCount,
+               (elapsed > 0.0) ? ((double)size * (double)hashCount / elapsed / 1.0e+06) : 0.0);
+        if (0 == check) PLOG(PL_DEBUG, "hashBench: zero check sum\n");
+    }
+    delete[] sizeList;
+    delete[] payload;
+    return 0;
+}  // end main()
@@ -3,8 +3,16 @@
 
 #include "smf.h"
 #include "smfHash.h"
+#include "smfHashSipHash.h"
 #include "smfConfig.h"
 #include "smfDupTree.h"
+#include "smfRing.h"
+#include "smfXdp.h"
+#include "smfUring.h"
+#include "smfTxBatch.h"
+#include "smfShard.h"
+#include "smfTap.h"
+#include "smfSpscRing.h"
 
 // maximum allowed packet size including MAC, IP, etc. headers
 #define FRAME_SIZE_MAX 4096
@@ -55,6 +63,13 @@
 #include <unistd.h>
 #include <sstream>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#ifdef UNIX
+#include <poll.h>
+#endif // UNIX
 #include <tuple>
 
 #define FRR_PID_FILE_PATH "/var/run/frr/nrlsmf.pid"
@@ -149,11 +164,14 @@ class SmfApp : public ProtoApp
         void RemoveMatchers(const char* groupName);
     
         unsigned int OpenDevice(const char* vifName, const char* ifaceName, const char* addrList, 
-                                bool shadow = false, bool blockIGMP = false);
-        Smf::Interface* AddDevice(const char* vifName, const char* ifaceName, bool stealAddrs);
-        Smf::Interface* CreateDevice(const char* vifName);
+                                bool shadow = false, bool blockIGMP = false, 
+                                unsigned int vifQueues = 1, bool vifOffload = false);
+        Smf::Interface* AddDevice(const char* vifName, const char* ifaceName, bool stealAddrs, 
+                                  unsigned int vifQueues = 1, bool vifOffload = false);
+        Smf::Interface* CreateDevice(const char* vifName, unsigned int vifQueues = 1, bool vifOffload = false);
         unsigned int AddCidElement(const char* deviceName, const char* ifaceName, int flags, unsigned int vifIndex);
         bool RemoveCidElement(const char* deviceName, const char* ifaceName);
+        static int GetCidFlags(const char* ifaceStatus);
         bool TransferAddresses(unsigned int vifIndex, unsigned int ifaceIndex);
         bool AssignAddresses(const char* ifaceName, unsigned int ifaceIndex, const char* addrList);
         
@@ -170,14 +188,51 @@ class SmfApp : public ProtoApp
         void OnPktOutput(ProtoChannel&              theChannel,
 	                     ProtoChannel::Notification notifyType);
 
+        void OnRingCapture(ProtoChannel&              theChannel,
+	                       ProtoChannel::Notification notifyType);
+
+        void OnXdpInput(ProtoChannel&              theChannel,
+	                    ProtoChannel::Notification notifyType);
+
+        void OnUringInput(ProtoChannel&              theChannel,
+	                      ProtoChannel::Notification notifyType);
+
         bool HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, ProtoCap& srcCap);
+        
+        // Inbound frames are handled in batches (up to INBOUND_BATCH_MAX per capture
+        // notification) so the Smf::ProcessPacketBatch() can be used.  Each batch
+        // entry has its own "alignedBuffer" (see OnPktCapture() buffer notes).
+        enum {INBOUND_BATCH_MAX = 32};
+        class InboundFrame : public Smf::BatchPacket
+        {
+            public:
+                InboundFrame();
+                
+                UINT32*         aligned_buffer;
+                UINT16*         eth_buffer;
+                unsigned int    num_bytes;
+                bool            is_ip;
+                bool            is_unicast;
+                bool            is_control;  // IGMP or elastic multicast control packet
+                bool            result;
+                unsigned int    dst_if_indices[IF_COUNT_MAX];
+        };  // end class SmfApp::InboundFrame
+        
+        // These are the HandleInboundPacket() phases before and after Smf packet processing
+        bool PrepareInboundFrame(InboundFrame& frame, ProtoCap& srcCap);
+        bool CompleteInboundFrame(InboundFrame& frame, ProtoCap& srcCap);
+        void HandleInboundBatch(unsigned int count, ProtoCap& srcCap);
 
         void HandleIGMP(ProtoPktIGMP igmpMsg, Smf::Interface& iface, bool inbound);
 
         static bool IsPriorityFrame(UINT32* frameBuffer, unsigned int frameLength);
+        static bool IsPriorityProtocol(ProtoPktIP::Protocol protocol);
 
-        bool ForwardFrame(unsigned int dstCount, unsigned int* dstIfIndices, char* frameBuffer, unsigned int frameLength);
-        bool SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int frameLength);
+        // The optional "pktInfo" is the forwarded packet's descriptor (saves re-parsing the frame)
+        bool ForwardFrame(unsigned int dstCount, unsigned int* dstIfIndices, char* frameBuffer, unsigned int frameLength,
+                          const SmfPktInfo* pktInfo = NULL);
+        bool SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int frameLength, bool handoff = false,
+                       const SmfPktInfo* pktInfo = NULL);
         bool ForwardFrameToTap(unsigned int srcIfIndex, unsigned int dstCount, unsigned int* dstIfIndices, char* frameBuffer, unsigned int frameLength);
 
         void OnControlMsg(ProtoSocket&       thePipe,
@@ -195,8 +250,11 @@ class SmfApp : public ProtoApp
             public:
                 enum Flag
                 {
-                    CID_RX = 0x01,
-                    CID_TX = 0x02
+                    CID_RX   = 0x01,
+                    CID_TX   = 0x02,
+                    CID_RING = 0x04,  // use TPACKET_V3 mmap ring (SmfRing) for rx instead of ProtoCap::Recv()
+                    CID_XDP  = 0x08,  // use AF_XDP socket (SmfXdpSocket) for rx and tx
+                    CID_URING = 0x10  // use io_uring multishot receive (SmfUring) for rx instead of ProtoCap::Recv()
                 };
                 CidElement(ProtoCap& protoCap, int flags = CID_TX | CID_RX);
                 ~CidElement();
@@ -204,6 +262,33 @@ class SmfApp : public ProtoApp
                 ProtoCap& GetProtoCap()
                     {return proto_cap;}
                     
+                // Optional mmap ring used for input in place of the ProtoCap
+                void SetProtoRing(SmfRing* protoRing)
+                    {proto_ring = protoRing;}
+                SmfRing* GetProtoRing() const
+                    {return proto_ring;}
+                    
+                // Optional AF_XDP socket used for input (along with the ProtoCap) and output
+                void SetXdpSocket(SmfXdpSocket* xdpSocket)
+                    {xdp_socket = xdpSocket;}
+                SmfXdpSocket* GetXdpSocket() const
+                    {return xdp_socket;}
+                    
+                // Optional io_uring socket slot used for input in place of the ProtoCap
+                void SetUringSlot(SmfUring* theUring, int slot)
+                {
+                    uring = theUring;
+                    uring_slot = slot;
+                }
+                SmfUring* GetUring() const
+                    {return uring;}
+                int GetUringSlot() const
+                    {return uring_slot;}
+                    
+                // Optional transmit batch used for ProtoCap output (see InterfaceMechanism::SetTxBatch())
+                SmfTxBatch& GetTxBatch()
+                    {return tx_batch;}
+                    
                 unsigned int GetInterfaceIndex() const
                     {return proto_cap.GetInterfaceIndex();}
                 
@@ -221,11 +306,20 @@ class SmfApp : public ProtoApp
 
             private:
                 ProtoCap&               proto_cap;
+                SmfRing*                proto_ring;
+                SmfXdpSocket*           xdp_socket;
+                SmfUring*               uring;
+                int                     uring_slot;
+                SmfTxBatch              tx_batch;
                 int                     cid_flags;
         };  // end class SmfApp::CidElement
 
         class CidElementList : public ProtoListTemplate<CidElement> {};
 
+        bool SetRingCapture(CidElement& elem, bool enable);
+        bool SetXdpMode(CidElement& elem, bool enable);
+        bool SetUringCapture(CidElement& elem, bool enable);
+
         // This class contains pointers to classes that provide
         // any I/O (input/output) mechanism for an nrlsmf interface
         class InterfaceMechanism : public Smf::Interface::Extension
@@ -264,6 +358,7 @@ class SmfApp : public ProtoApp
                 void RemoveCidElement(unsigned int capIndex);
                 
                 CidElement* GetPrincipalElement() {return cid_list.GetHead();}
+                CidElement* GetCidElement(unsigned int capIndex);
                 
 #ifdef _PROTO_DETOUR
                 void SetProtoDetour(ProtoDetour* protoDetour)
@@ -273,7 +368,9 @@ class SmfApp : public ProtoApp
 #endif // _PROTO_DETOUR
 
                 enum TxStatus {TX_OK, TX_BLOCK,TX_ERROR};
-                TxStatus SendFrame(char* frame, unsigned int frameLen);
+                // If "handoff" is true, the caller is done with the "frame" buffer so it may be
+                // transmitted in place (i.e., by AF_XDP descriptor) instead of being copied
+                TxStatus SendFrame(char* frame, unsigned int frameLen, bool handoff = false);
 
 
                 void ResetTxIterator() {tx_iterator.Reset();}
@@ -294,8 +391,52 @@ class SmfApp : public ProtoApp
                 
                 bool OnTxTimeout(ProtoTimer& theTimer);
                 unsigned int GetSendErrorCount() const {return serr_count;}
+                
+                // Transmit batching stages frames for the ProtoCap cid elements and sends
+                // them "batchSize" at a time with one system call (a "batchSize" of 0 or 1
+                // disables batching).  Batching is not used for GRE or AF_XDP elements or
+                // while a tx rate limit is imposed.
+                bool SetTxBatch(unsigned int batchSize);
+                unsigned int GetTxBatchSize() const
+                    {return tx_batch_size;}
+                bool TxBatchPending() const
+                    {return tx_batch_pending;}
+                // Sends any staged frames.  Returns "false" if blocked (output notification is started)
+                bool FlushTxBatch();
+
+                // The transmit pipeline hands frames to a per-interface tx thread through
+                // a lock-free ring so a blocked or rate-limited interface doesn't hold up
+                // input handling.  While it runs, the tx thread owns transmission via the
+                // (principal) cid element, including tx batching and rate limit pacing.
+                // This is only for single-element interfaces without a vif or AF_XDP socket.
+                bool StartTxPipeline(unsigned int ringSize);
+                void StopTxPipeline();
+                bool TxPipelineActive() const
+                    {return tx_pipe_active;}
+                // Hands packet to the tx thread (returns "false" if the ring is full or
+                // queued packets are still waiting for it)
+                bool EnqueueTxPipeline(SmfPacket& pkt);
+                // Moves packets queued (while the ring was full) to the tx ring as room
+                // allows.  Returns "true" if the interface queue has been emptied.
+                bool ServiceTxPipeline();
+                unsigned int GetTxPipelineSize() const
+                    {return tx_pipe_ring.GetSize();}
+                unsigned int GetTxPipelineCount() const
+                    {return tx_pipe_ring.GetCount();}
+                unsigned int GetTxPipelineDropCount() const
+                    {return tx_pipe_drops;}
+                void IncrementTxPipelineDropCount()
+                    {tx_pipe_drops++;}
+                unsigned int GetTxPipelineErrorCount() const
+                    {return tx_pipe_errors.load(std::memory_order_relaxed);}
 
             private:
+                bool SendElementFrame(CidElement& elem, char* frame, unsigned int& numBytes, bool handoff);
+                bool StageElementFrame(CidElement& elem, char* frame, unsigned int& numBytes, const char* srcMac);
+                void TxPipelineRun();      // tx thread main loop
+                void TxPipelineWait(int fd);
+                void ReclaimTxPipeline();  // returns sent packets to the pool
+
                 Smf::Interface&             smf_iface;
                 SmfPacket::Pool&            pkt_pool;
                 ProtoVif*                   proto_vif;
@@ -314,6 +455,20 @@ class SmfApp : public ProtoApp
                 double                      tx_rate_limit;  // in _bytes_ per second (-1.0 means no limit)
                 ProtoTimer                  tx_timer;
                 unsigned int                serr_count;
+                unsigned int                tx_batch_size;     // 0 means no tx batching
+                bool                        tx_batch_pending;  // true when frames may be staged
+                // Transmit pipeline state (see StartTxPipeline())
+                SmfSpscRing<SmfPacket*>     tx_pipe_ring;      // packets to tx thread
+                SmfSpscRing<SmfPacket*>     tx_pipe_done;      // sent packets back from tx thread
+                std::thread                 tx_pipe_thread;
+                bool                        tx_pipe_active;
+                std::atomic<bool>           tx_pipe_stop;
+                std::atomic<bool>           tx_pipe_waiting;   // tx thread is idle
+                std::mutex                  tx_pipe_mutex;
+                std::condition_variable     tx_pipe_cond;
+                std::atomic<unsigned int>   tx_pipe_errors;
+                unsigned int                tx_pipe_drops;     // neither handed to tx thread nor queued
+                SmfPacket*                  tx_pipe_held;      // unsent packet held by tx thread upon stop
 
         };  // end class SmfApp::InterfaceMechanism
 
@@ -321,6 +476,11 @@ class SmfApp : public ProtoApp
         // (the normal default is -1.0 which means unlimited rate)
         void SetTxRateLimit(double bytesPerSecond)
             {default_tx_rate_limit = bytesPerSecond;}
+        
+        // Sends any frames staged by interface tx batching (called at the end of each 
+        // input handling cycle and upon tx_batch_timer timeout)
+        void FlushTxBatches();
+        bool OnTxBatchTimeout(ProtoTimer& theTimer);
 
         class InterfaceMatcher : public ProtoSortedTree::Item
         {
@@ -371,6 +531,9 @@ class SmfApp : public ProtoApp
         class InterfaceMatcherList : public ProtoSortedTreeTemplate<InterfaceMatcher> {};
 
         SmfPacket* GetPacket(); // from pool or allocate new
+        // Gets packet (from pool) with the given frame content.  During ForwardFrame() the
+        // destinations that enqueue the frame share a single (reference-counted) copy of it.
+        SmfPacket* GetFramePacket(const char* frameBuffer, unsigned int frameLength);
 
         // Member variables
         Smf                     smf;            // General-purpose "SMF" class
@@ -381,8 +544,23 @@ class SmfApp : public ProtoApp
         bool                    resequence;
         int                     ttl_set;
         double                  default_tx_rate_limit;   // default tx_rate_limit (bytes / second) for new interfaces
+        unsigned int            default_tx_batch;        // default tx_batch_size for new interfaces
+        unsigned int            default_tx_pipeline;     // default tx pipeline ring size for new interfaces (0 = off)
+        bool                    tx_batch_pending;        // true when some interface may have staged tx frames
+        ProtoTimer              tx_batch_timer;          // bounds tx batch latency
         int                     smf_queue_limit; // default queue limit, if non-zero, using Smf::Interface queues
         SmfPacket::Pool         pkt_pool;
+        const char*             share_frame;     // frame buffer being forwarded to multiple destinations, if any
+        SmfPacketBuffer*        share_buffer;    // queued copy of "share_frame" content
+        SmfXdpUmem              xdp_umem;        // AF_XDP packet buffer area shared by all SmfXdpSockets
+        SmfUring                uring;           // io_uring receive ring shared by all CID_URING elements
+        SmfShard                flow_shards;     // flow-sharded forwarding processes, if any
+        ProtoTimer              shard_stats_timer;  // publishes counters of non-primary flow shards
+        bool OnShardStatsTimeout(ProtoTimer& theTimer);
+        // Gets the interface's forwarding counters, summed across flow shards
+        void GetInterfaceCounters(Smf::Interface& iface, SmfShard::Counters& counters);
+        InboundFrame            inbound_batch[INBOUND_BATCH_MAX];
+        UINT32*                 inbound_batch_buffer;  // (INBOUND_BATCH_MAX aligned buffers)
         ProtoRouteTable         route_table;     // to support routing supplicant encapsulation
 
 #ifdef _PROTO_DETOUR
@@ -432,6 +610,8 @@ class SmfApp : public ProtoApp
         ProtoPipe                   control_pipe;   // pipe _from_ controller to me
         char                        control_pipe_name[128];
         ProtoPipe                   server_pipe;    // pipe _to_ controller (e.g., nrlolsr)
+        ProtoPipe                   shard_pipe;     // pipe _to_ other flow shards (primary only)
+        void ForwardToShards(const char* msg, unsigned int msgLen);
 
         ProtoPipe                   tap_pipe;
         bool                        tap_active;
@@ -451,7 +631,9 @@ SmfApp::InterfaceMechanism::InterfaceMechanism(Smf::Interface& iface, SmfPacket:
 #ifdef _PROTO_DETOUR
    proto_detour(NULL),
 #endif // _PROTO_DETOUR
-   tx_rate_limit(-1.0), serr_count(0)
+   tx_rate_limit(-1.0), serr_count(0), tx_batch_size(0), tx_batch_pending(false),
+   tx_pipe_active(false), tx_pipe_stop(false), tx_pipe_waiting(false), tx_pipe_errors(0),
+   tx_pipe_drops(0), tx_pipe_held(NULL)
 {
     tx_timer.SetRepeat(-1);
 }
@@ -478,6 +660,7 @@ void SmfApp::InterfaceMechanism::CloseDevice()
 
 void SmfApp::InterfaceMechanism::Close()
 {
+    StopTxPipeline();
     CloseDevice();
     
 #ifdef _PROTO_DETOUR
@@ -494,6 +677,16 @@ void SmfApp::InterfaceMechanism::Close()
 // if return value is true, the application should activate tx_timer
 bool SmfApp::InterfaceMechanism::SetTxRateLimit(double bytesPerSecond)
 {
+    if (tx_pipe_active)
+    {
+        // The tx thread paces itself, so just restart it with the new rate
+        unsigned int ringSize = tx_pipe_ring.GetSize();
+        StopTxPipeline();
+        tx_rate_limit = bytesPerSecond;
+        if (!StartTxPipeline(ringSize))
+            PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::SetTxRateLimit() error: unable to restart tx pipeline\n");
+        return false;
+    }
     if (0.0 == tx_rate_limit)
     {
         ASSERT(!tx_timer.IsActive());
@@ -580,6 +773,8 @@ bool SmfApp::InterfaceMechanism::AddCidElement(ProtoCap& protoCap, int flags)
         PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::AddCidElement() new CidElement error: %s\n", GetErrorString());
         return false;
     }
+    if ((tx_batch_size > 1) && !elem->GetTxBatch().Init(tx_batch_size, FRAME_SIZE_MAX))
+        PLOG(PL_WARN, "SmfApp::InterfaceMechanism::AddCidElement() warning: unable to enable tx batching\n");
     cid_list.Append(*elem);
     cid_list_length += 1;
     return true;
@@ -601,14 +796,34 @@ void SmfApp::InterfaceMechanism::RemoveCidElement(unsigned int capIndex)
     PLOG(PL_WARN, "SmfApp::InterfaceMechanism::RemoveCidElement() warning: invalid interface index %u for this InterfaceMechanism!\n", capIndex);
 }  // end SmfApp::InterfaceMechanism::RemoveCidElement()
 
+SmfApp::CidElement* SmfApp::InterfaceMechanism::GetCidElement(unsigned int capIndex)
+{
+    CidElementList::Iterator ciderator(cid_list);
+    CidElement* elem;
+    while (NULL != (elem = ciderator.GetNextItem()))
+    {
+        if (capIndex == elem->GetInterfaceIndex())
+            return elem;
+    }
+    return NULL;
+}  // end SmfApp::InterfaceMechanism::GetCidElement()
+
 void SmfApp::InterfaceMechanism::StartInputNotification()
 {
     CidElement* elem;
     CidElementList::Iterator ciderator(cid_list);
     while (NULL != (elem = ciderator.GetNextItem()))
     {
-        if (elem->FlagIsSet(CidElement::CID_RX))
+        if (!elem->FlagIsSet(CidElement::CID_RX)) continue;
+        if (NULL != elem->GetProtoRing())
+            elem->GetProtoRing()->StartInputNotification();  // ring replaces ProtoCap::Recv() for input
+        else if (NULL != elem->GetUring())
+            elem->GetUring()->EnableSocket(elem->GetUringSlot(), true);  // (the shared SmfUring input is always active)
+        else
             elem->GetProtoCap().StartInputNotification();  // (TBD) error check?
+        // Frames not redirected to the AF_XDP socket (if any) still reach the ProtoCap
+        if (NULL != elem->GetXdpSocket())
+            elem->GetXdpSocket()->StartInputNotification();
     }
 }  // end SmfApp::InterfaceMechanism::StartInputNotification()
 
@@ -640,7 +855,123 @@ SmfApp::CidElement* SmfApp::InterfaceMechanism::GetNextTxElement(bool autoReset)
     return elem;
 }  // end  SmfApp::InterfaceMechanism::GetNetTxElement()
 
-SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char* frame, unsigned int frameLength)
+bool SmfApp::InterfaceMechanism::SetTxBatch(unsigned int batchSize)
+{
+    if (batchSize > SmfTxBatch::BATCH_SIZE_MAX)
+    {
+        PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::SetTxBatch() error: batch size exceeds maximum %d\n", SmfTxBatch::BATCH_SIZE_MAX);
+        return false;
+    }
+    if (batchSize < 2) batchSize = 0;
+    if (batchSize == tx_batch_size) return true;
+    // (the tx pipeline thread, if any, uses the tx batch so it is restarted)
+    unsigned int pipeSize = tx_pipe_active ? tx_pipe_ring.GetSize() : 0;
+    StopTxPipeline();
+    FlushTxBatch();
+    bool result = true;
+    CidElementList::Iterator ciderator(cid_list);
+    CidElement* elem;
+    while (NULL != (elem = ciderator.GetNextItem()))
+    {
+        // Frames still blocked in the batch go back to the interface queue (if
+        // queuing) so they aren't lost by the re-Init() below
+        SmfTxBatch& batch = elem->GetTxBatch();
+        unsigned int dropCount = 0;
+        for (unsigned int i = 0; i < batch.GetPendingCount(); i++)
+        {
+            unsigned int frameLength;
+            const char* frame = batch.GetPendingFrame(i, frameLength);
+            if (!smf_iface.IsQueuing() || !smf_iface.EnqueueFrame(frame, frameLength, &pkt_pool))
+                dropCount++;
+        }
+        if (0 != dropCount)
+            PLOG(PL_WARN, "SmfApp::InterfaceMechanism::SetTxBatch() warning: dropped %u blocked tx batch frames\n", dropCount);
+        if (0 == batchSize)
+            batch.Destroy();
+        else if (!batch.Init(batchSize, FRAME_SIZE_MAX))
+            result = false;
+    }
+    tx_batch_size = batchSize;
+    tx_batch_pending = false;
+    if ((0 != pipeSize) && !StartTxPipeline(pipeSize))
+    {
+        PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::SetTxBatch() error: unable to restart tx pipeline\n");
+        result = false;
+    }
+    return result;
+}  // end SmfApp::InterfaceMechanism::SetTxBatch()
+
+bool SmfApp::InterfaceMechanism::FlushTxBatch()
+{
+    if (!tx_batch_pending) return true;
+    bool blocked = false;
+    CidElementList::Iterator ciderator(cid_list);
+    CidElement* elem;
+    while (NULL != (elem = ciderator.GetNextItem()))
+    {
+        SmfTxBatch& batch = elem->GetTxBatch();
+        if (batch.IsEmpty()) continue;
+        ProtoCap& cap = elem->GetProtoCap();
+        if (!batch.Flush(cap.GetHandle()))
+        {
+            // Resume upon ProtoCap output readiness (see SmfApp::OnPktCapture())
+            cap.StartOutputNotification();
+            output_notification = true;
+            blocked = true;
+        }
+    }
+    tx_batch_pending = blocked;
+    return !blocked;
+}  // end SmfApp::InterfaceMechanism::FlushTxBatch()
+
+// Stages frame in the cid element's tx batch, flushing the batch when it is full
+bool SmfApp::InterfaceMechanism::StageElementFrame(CidElement& elem, char* frame, unsigned int& numBytes, const char* srcMac)
+{
+    SmfTxBatch& batch = elem.GetTxBatch();
+    int fd = elem.GetProtoCap().GetHandle();
+    // If the batch is still full from a blocked flush, we're blocked
+    // (note "numBytes" is left unchanged to indicate blocking)
+    if (batch.IsFull() && !batch.Flush(fd)) return false;
+    batch.Stage(frame, numBytes, srcMac);
+    tx_batch_pending = true;
+    if (batch.IsFull()) batch.Flush(fd);  // (if this blocks, it's detected on next send or flush)
+    return true;
+}  // end SmfApp::InterfaceMechanism::StageElementFrame()
+
+// Sends frame via a single cid element using its AF_XDP socket, tx batch or ProtoCap as appropriate
+bool SmfApp::InterfaceMechanism::SendElementFrame(CidElement& elem, char* frame, unsigned int& numBytes, bool handoff)
+{
+    ProtoCap& cap = elem.GetProtoCap();
+    if (ProtoNet::IFACE_GRE == cap.GetInterfaceType())
+    {
+        // Just send the IP payload portion
+        numBytes -= 14;
+        return cap.Send(frame + 14, numBytes);
+    }
+    SmfXdpSocket* xsk = elem.GetXdpSocket();
+    if ((NULL != proto_vif) && !is_shadowing)
+    {
+        // Send frame using vif MAC addr as source address for frame
+        if (NULL != xsk)
+            return xsk->Send(frame, numBytes, proto_vif->GetHardwareAddress().GetRawHostAddress(), handoff);
+        else if (elem.GetTxBatch().IsEnabled() && (tx_rate_limit < 0.0))
+            return StageElementFrame(elem, frame, numBytes, proto_vif->GetHardwareAddress().GetRawHostAddress());
+        else
+            return cap.ForwardFrom(frame, numBytes, proto_vif->GetHardwareAddress());
+    }
+    else
+    {
+        // Forward using the "cap" MAC addr as the source addr
+        if (NULL != xsk)
+            return xsk->Send(frame, numBytes, cap.GetInterfaceAddr().GetRawHostAddress(), handoff);
+        else if (elem.GetTxBatch().IsEnabled() && (tx_rate_limit < 0.0))
+            return StageElementFrame(elem, frame, numBytes, cap.GetInterfaceAddr().GetRawHostAddress());
+        else
+            return cap.Forward(frame, numBytes);
+    }
+}  // end SmfApp::InterfaceMechanism::SendElementFrame()
+
+SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char* frame, unsigned int frameLength, bool handoff)
 {
     bool success = false;
     unsigned int numBytes = frameLength;
@@ -653,21 +984,9 @@ SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char*
             success = false;
             numBytes = 0;  // will end up setting TX_BLOCK for this interface until a CID_TX element is available
         }
-        else if (ProtoNet::IFACE_GRE == elem->GetProtoCap().GetInterfaceType())
-        {
-            // Just send the IP payload portion
-            numBytes -= 14;
-            success = elem->GetProtoCap().Send(frame + 14, numBytes);
-        }
-        else if ((NULL != proto_vif) && !is_shadowing)
-        {
-            // Send frame using vif MAC addr as source address for frame
-            success = elem->GetProtoCap().ForwardFrom(frame, numBytes, proto_vif->GetHardwareAddress());
-        }
         else
         {
-            // Forward using the "cap" MAC addr as the source addr
-            success = elem->GetProtoCap().Forward(frame, numBytes);
+            success = SendElementFrame(*elem, frame, numBytes, handoff);
         }
     }
     else
@@ -679,28 +998,17 @@ SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char*
         if (cid_mirror)
         {
             // Mirror frame to all tx-enable sub-elements
+            // (only the last element may be handed the frame buffer itself)
             ResetTxIterator();
             CidElement* elem = GetNextTxElement(false);
             while (NULL != elem)
             {
+                CidElement* nextElem = GetNextTxElement(false);
                 numBytes = frameLength;
-                bool mirrorSuccess;
-                if (ProtoNet::IFACE_GRE == elem->GetProtoCap().GetInterfaceType())
-                {
-                    numBytes -= 14;
-                    mirrorSuccess = elem->GetProtoCap().Send(frame + 14, numBytes);
-                }
-                else if (is_shadowing)
-                {
-                    mirrorSuccess = elem->GetProtoCap().Forward(frame, numBytes);
-                }
-                else
-                {
-                    mirrorSuccess = elem->GetProtoCap().ForwardFrom(frame, numBytes, proto_vif->GetHardwareAddress());
-                }
+                bool mirrorSuccess = SendElementFrame(*elem, frame, numBytes, handoff && (NULL == nextElem));
                 if (0 == numBytes) mirrorSuccess = false;
                 success |= mirrorSuccess;  // 'success' will be true if _any_ interface works
-                elem = GetNextTxElement(false);
+                elem = nextElem;
             }
         }
         else
@@ -718,19 +1026,7 @@ SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char*
             while (true)
             {
                 numBytes = frameLength;
-                if (ProtoNet::IFACE_GRE == elem->GetProtoCap().GetInterfaceType())
-                {
-                    numBytes -= 14;
-                    success = elem->GetProtoCap().Send(frame + 14, numBytes);
-                }
-                else if (is_shadowing)
-                {
-                    success = elem->GetProtoCap().Forward(frame, numBytes);
-                }
-                else
-                {
-                    success = elem->GetProtoCap().ForwardFrom(frame, numBytes, proto_vif->GetHardwareAddress());
-                }
+                success = SendElementFrame(*elem, frame, numBytes, handoff);
                 if (0 == numBytes) success = false;
                 if (success) break;
                 elem = GetNextTxElement(true);
@@ -759,7 +1055,10 @@ SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char*
             // is added as CID_TX or changed to CID_TX status
             if (elem->FlagIsSet(CidElement::CID_TX))
             {
-                elem->GetProtoCap().StartOutputNotification();
+                if (NULL != elem->GetXdpSocket())
+                    elem->GetXdpSocket()->StartOutputNotification();
+                else
+                    elem->GetProtoCap().StartOutputNotification();
                 output_notification = true;
             }
         }
@@ -771,8 +1070,234 @@ SmfApp::InterfaceMechanism::TxStatus SmfApp::InterfaceMechanism::SendFrame(char*
     }
 }  // end  SmfApp::InterfaceMechanism::SendFrame()
 
+bool SmfApp::InterfaceMechanism::StartTxPipeline(unsigned int ringSize)
+{
+    StopTxPipeline();
+    if (0 == ringSize) return true;  // pipeline disabled
+    CidElement* elem = cid_list.GetHead();
+    if ((NULL != proto_vif) || (1 != cid_list_length) || (NULL == elem) || (NULL != elem->GetXdpSocket()))
+    {
+        PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::StartTxPipeline() error: tx pipeline requires single element, non-vif, non-AF_XDP interface\n");
+        return false;
+    }
+    if (!tx_pipe_ring.Init(ringSize) || !tx_pipe_done.Init(2*ringSize))
+    {
+        PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::StartTxPipeline() error: unable to allocate rings: %s\n", GetErrorString());
+        tx_pipe_ring.Destroy();
+        tx_pipe_done.Destroy();
+        return false;
+    }
+    // The tx thread takes over any pending transmission
+    FlushTxBatch();  // (any frames still staged are sent by the tx thread)
+    if (output_notification)
+    {
+        elem->GetProtoCap().StopOutputNotification();
+        output_notification = false;
+    }
+    // Queued packets that don't fit the ring stay queued for ServiceTxPipeline()
+    // (an active tx_timer keeps servicing them, see OnTxTimeout())
+    if (ServiceTxPipeline())
+    {
+        if (tx_timer.IsActive()) tx_timer.Deactivate();
+    }
+    else
+    {
+        tx_timer.SetInterval(1.0e-03);
+    }
+    tx_pipe_stop.store(false);
+    tx_pipe_waiting.store(false);
+    try
+    {
+        tx_pipe_thread = std::thread(&InterfaceMechanism::TxPipelineRun, this);
+    }
+    catch (const std::system_error& error)
+    {
+        PLOG(PL_ERROR, "SmfApp::InterfaceMechanism::StartTxPipeline() error: unable to start tx thread: %s\n", error.what());
+        SmfPacket* pkt;
+        while (tx_pipe_ring.Pop(pkt)) pkt_pool.Put(*pkt);
+        tx_pipe_ring.Destroy();
+        tx_pipe_done.Destroy();
+        return false;
+    }
+    tx_pipe_active = true;
+    return true;
+}  // end SmfApp::InterfaceMechanism::StartTxPipeline()
+
+void SmfApp::InterfaceMechanism::StopTxPipeline()
+{
+    if (!tx_pipe_active) return;
+    tx_pipe_stop.store(true);
+    {
+        std::lock_guard<std::mutex> lock(tx_pipe_mutex);
+        tx_pipe_cond.notify_one();
+    }
+    tx_pipe_thread.join();
+    tx_pipe_active = false;
+    ReclaimTxPipeline();
+    // Unsent packets go back to the interface queue (if queuing) so they
+    // aren't lost when the pipeline is restarted, otherwise they're dropped
+    SmfPacket* pkt = tx_pipe_held;
+    tx_pipe_held = NULL;
+    if ((NULL != pkt) || tx_pipe_ring.Pop(pkt))
+    {
+        do
+        {
+            if (!smf_iface.IsQueuing() ||
+                !smf_iface.EnqueuePacket(*pkt, IsPriorityFrame((UINT32*)pkt->GetBuffer(), pkt->GetLength()), &pkt_pool))
+            {
+                pkt_pool.Put(*pkt);
+            }
+        } while (tx_pipe_ring.Pop(pkt));
+    }
+    tx_pipe_ring.Destroy();
+    tx_pipe_done.Destroy();
+}  // end SmfApp::InterfaceMechanism::StopTxPipeline()
+
+bool SmfApp::InterfaceMechanism::EnqueueTxPipeline(SmfPacket& pkt)
+{
+    // (packets queued earlier go first)
+    if (!ServiceTxPipeline() || tx_pipe_ring.IsFull()) return false;
+    SmfPacket* pktPtr = &pkt;
+    tx_pipe_ring.Push(pktPtr);
+    // Wake up the tx thread if it's idle (see TxPipelineRun())
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tx_pipe_waiting.load())
+    {
+        std::lock_guard<std::mutex> lock(tx_pipe_mutex);
+        tx_pipe_cond.notify_one();
+    }
+    return true;
+}  // end SmfApp::InterfaceMechanism::EnqueueTxPipeline()
+
+bool SmfApp::InterfaceMechanism::ServiceTxPipeline()
+{
+    ReclaimTxPipeline();
+    bool pushed = false;
+    SmfPacket* pkt;
+    while (NULL != (pkt = smf_iface.PeekNextPacket()))
+    {
+        if (tx_pipe_ring.IsFull()) break;
+        pkt->AccessBuffer();  // (makes sure a shared buffer is copied since tx thread sets the src MAC addr in place)
+        tx_pipe_ring.Push(pkt);
+        smf_iface.DequeuePacket();
+        pushed = true;
+    }
+    if (pushed)
+    {
+        // Wake up the tx thread if it's idle (see TxPipelineRun())
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (tx_pipe_waiting.load())
+        {
+            std::lock_guard<std::mutex> lock(tx_pipe_mutex);
+            tx_pipe_cond.notify_one();
+        }
+    }
+    return (NULL == pkt);
+}  // end SmfApp::InterfaceMechanism::ServiceTxPipeline()
+
+void SmfApp::InterfaceMechanism::ReclaimTxPipeline()
+{
+    SmfPacket* pkt;
+    while (tx_pipe_done.Pop(pkt)) pkt_pool.Put(*pkt);
+}  // end SmfApp::InterfaceMechanism::ReclaimTxPipeline()
+
+// Waits (up to 1 msec) for the tx thread's blocked socket to be ready for output
+void SmfApp::InterfaceMechanism::TxPipelineWait(int fd)
+{
+#ifdef UNIX
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    poll(&pfd, 1, 1);
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif // if/else UNIX
+}  // end SmfApp::InterfaceMechanism::TxPipelineWait()
+
+// Note this runs in the interface's tx thread, so it must only use the tx ring
+// and the principal cid element (the rest is owned by the dispatcher thread)
+void SmfApp::InterfaceMechanism::TxPipelineRun()
+{
+    CidElement& elem = *cid_list.GetHead();
+    int fd = elem.GetProtoCap().GetHandle();
+    SmfTxBatch& batch = elem.GetTxBatch();
+    double txRateLimit = tx_rate_limit;  // (fixed while we run, see SetTxRateLimit())
+    std::chrono::steady_clock::time_point nextTime = std::chrono::steady_clock::now();
+    SmfPacket* pkt = NULL;
+    while (!tx_pipe_stop.load())
+    {
+        if ((NULL == pkt) && !tx_pipe_ring.Pop(pkt))
+        {
+            // Idle, so send any staged frames and wait for more
+            pkt = NULL;
+            if (!batch.IsEmpty() && !batch.Flush(fd))
+            {
+                TxPipelineWait(fd);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(tx_pipe_mutex);
+            tx_pipe_waiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (tx_pipe_ring.IsEmpty() && !tx_pipe_stop.load())
+                tx_pipe_cond.wait_for(lock, std::chrono::milliseconds(100));
+            tx_pipe_waiting.store(false);
+            continue;
+        }
+        if (txRateLimit >= 0.0)
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if ((0.0 == txRateLimit) || (now < nextTime))
+            {
+                // Pace our transmissions (a zero rate suspends them until changed)
+                std::unique_lock<std::mutex> lock(tx_pipe_mutex);
+                if (tx_pipe_stop.load()) break;
+                if (0.0 == txRateLimit)
+                    tx_pipe_cond.wait_for(lock, std::chrono::milliseconds(100));
+                else
+                    tx_pipe_cond.wait_until(lock, nextTime);
+                continue;
+            }
+            nextTime = now;  // (no credit for idle time)
+        }
+        unsigned int numBytes = pkt->GetLength();
+        if (SendElementFrame(elem, (char*)pkt->GetBuffer(), numBytes, false))
+        {
+            if (txRateLimit > 0.0)
+                nextTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>
+                                (std::chrono::duration<double>((double)pkt->GetLength() / txRateLimit));
+        }
+        else if (0 != numBytes)
+        {
+            // Blocked, so wait for output readiness and try again
+            TxPipelineWait(fd);
+            continue;
+        }
+        else
+        {
+            tx_pipe_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        while (!tx_pipe_done.Push(pkt))
+            std::this_thread::yield();  // (not expected as "tx_pipe_done" is twice the "tx_pipe_ring" size)
+        pkt = NULL;
+    }
+    if (!batch.IsEmpty()) batch.Flush(fd);  // (best effort)
+    tx_pipe_held = pkt;
+}  // end SmfApp::InterfaceMechanism::TxPipelineRun()
+
 bool SmfApp::InterfaceMechanism::OnTxTimeout(ProtoTimer& theTimer)
 {
+    if (tx_pipe_active)
+    {
+        // The tx thread has taken over, but we move any packets queued
+        // while its ring was full over as the ring drains
+        if (ServiceTxPipeline())
+        {
+            theTimer.Deactivate();
+            return false;
+        }
+        return true;
+    }
     // TBD - we may want to have a strategy here that pulls a packet from the "vif" if there are
     // no priority packets in our queue to give potential priority packets a better chance
     if (GetTxRateLimit() < 0.0)
@@ -793,7 +1318,7 @@ bool SmfApp::InterfaceMechanism::OnTxTimeout(ProtoTimer& theTimer)
     if (NULL != frame)
     {
         // if so, send and resched timeout
-        InterfaceMechanism::TxStatus txStatus = SendFrame((char*)frame->AccessBuffer(), frame->GetLength());
+        InterfaceMechanism::TxStatus txStatus = SendFrame((char*)frame->GetBuffer(), frame->GetLength());
         if (InterfaceMechanism::TX_OK == txStatus)
         {
             frame = smf_iface.DequeuePacket();
@@ -803,7 +1328,8 @@ bool SmfApp::InterfaceMechanism::OnTxTimeout(ProtoTimer& theTimer)
             {
                 // Try to pull a frame from vif to replace the one we just sent
                 unsigned int numBytes = SmfPacket::PKT_SIZE_MAX;
-                if (proto_vif->Read((char*)frame->AccessBuffer(), numBytes))
+                char* readBuffer = (char*)frame->PrepareBuffer();  // (frame buffer may have been shared)
+                if ((NULL != readBuffer) && proto_vif->Read(readBuffer, numBytes))
                 {
                     if (0 != numBytes)
                     {
@@ -939,12 +1465,30 @@ bool SmfApp::InterfaceMechanism::OnTxTimeout(ProtoTimer& theTimer)
 
 
 SmfApp::CidElement::CidElement(ProtoCap& protoCap, int flags)
-  : proto_cap(protoCap), cid_flags(flags)
+  : proto_cap(protoCap), proto_ring(NULL), xdp_socket(NULL), uring(NULL), uring_slot(-1), cid_flags(flags)
 {
 }
 
 SmfApp::CidElement::~CidElement()
 {
+    if (NULL != proto_ring)
+    {
+        proto_ring->Close();
+        delete proto_ring;
+        proto_ring = NULL;
+    }
+    if (NULL != xdp_socket)
+    {
+        xdp_socket->Close();
+        delete xdp_socket;
+        xdp_socket = NULL;
+    }
+    if (NULL != uring)
+    {
+        uring->RemoveSocket(uring_slot);
+        uring = NULL;
+        uring_slot = -1;
+    }
     proto_cap.Close();
     delete &proto_cap;
 }
@@ -970,7 +1514,8 @@ const char* SmfApp::DEFAULT_SMF_SERVER = "nrlolsr";
 SmfApp::SmfApp()
  : smf(GetTimerMgr()), need_help(false), priority_boost(true), ipv6_enabled(false),
    resequence(false), ttl_set(-1),
-   default_tx_rate_limit(-1.0), smf_queue_limit(0),
+   default_tx_rate_limit(-1.0), default_tx_batch(0), default_tx_pipeline(0), tx_batch_pending(false), smf_queue_limit(0),
+   share_frame(NULL), share_buffer(NULL), inbound_batch_buffer(NULL),
 #ifdef _PROTO_DETOUR
    firewall_capture(false), firewall_forward(false),
    detour_ipv4(NULL), detour_ipv4_flags(0),
@@ -995,10 +1540,17 @@ SmfApp::SmfApp()
    iface_monitor(NULL),
    control_pipe(ProtoPipe::MESSAGE),
    server_pipe(ProtoPipe::MESSAGE),
+   shard_pipe(ProtoPipe::MESSAGE),
    tap_pipe(ProtoPipe::MESSAGE), tap_active(false)
 {
     control_pipe.SetNotifier(&GetSocketNotifier());
     control_pipe.SetListener(this, &SmfApp::OnControlMsg);
+    tx_batch_timer.SetListener(this, &SmfApp::OnTxBatchTimeout);
+    tx_batch_timer.SetInterval(1.0e-03);  // default 1 msec tx batch latency bound
+    tx_batch_timer.SetRepeat(0);
+    shard_stats_timer.SetListener(this, &SmfApp::OnShardStatsTimeout);
+    shard_stats_timer.SetInterval(1.0);
+    shard_stats_timer.SetRepeat(-1);
 #ifdef WIN32
 	if_friendly_name[0] = '\0';
 #endif //WINew
@@ -1068,14 +1620,17 @@ const char* const SmfApp::CMD_LIST[] =
     "+add",             "<group>,{cf|smpr|ecds},<ifaceList> : add interface(s) to flooding group with relay algorithm type given",
     "-advertise",       "Sets elastic multicast operation to advertise flows instead of token-bucket limited forwarding",
     "+allow",           "{<vrfLeakSpec> | <filterSpec> | all} : set VRF route leak policy or filter for flows that nrlsmf elastic mcast is allowed to forward.",
+    "+batch",           "[<iface>,]<count>[/<msec>] : batch up to <count> frames per transmit system call (default = 0 (off), 1 msec latency bound)",
     "+boost",           "{on | off}  : boost process priority (default = on)",
+    "+budget",          "<flowMax>   : limit node-wide DPD, sequence, and hash history flow state, evicting least-recently-updated flows (default = 0 (unlimited))",
     "+cf",              "<ifaceList>  : CF relay among all iface's listed",
-    "+cid",             "<vifName>,<iface1>[/{t|r|d}][,<iface2>[/{t|r|d}][,<iface3>[/{t|r|d}],...]] to add/delete elements to composite interface device",
+    "+cid",             "<vifName>,<iface1>[/{t|r|d}[m|x|u]][,<iface2>[/{t|r|d}[m|x|u]][,<iface3>[/{t|r|d}[m|x|u]],...]] to add/delete elements to composite interface device ('m' = mmap ring capture, 'x' = AF_XDP, 'u' = io_uring capture)",
     "+debug",           "<debugLevel>   : set debug level [0..6]",
     //"+defaultForward",  "{on | off}  : same as \"relay\" (for backwards compatibility)",
     "+delayoff",        "<double>    : number of microseconds delay before executing a relay off command (default = 0)",
     "+deny",            "{<vrfLeakSpec> | <filterSpec> | all} : set VRF route leak policy or filter for flows that nrlsmf elastic mcast should ignore",
-    "+device",          "<vifName>,<ifaceName>[/{t|r|d}][,<addr1>[,addr2, ...]] to create virtual interface 'device' associated with one or more physical interfaces",
+    "+device",          "<vifName>,<ifaceName>[/{t|r}[m|x|u]][,queues=<count>][,offload][,<addr1>[,addr2, ...]] to create virtual interface 'device' associated with one or more physical interfaces ('m' = mmap ring capture, 'x' = AF_XDP, 'u' = io_uring capture, 'queues' > 1 = multi-queue tap, 'offload' = GSO/checksum offload vif)",
+    "+dpd",             "[<iface>,]{table | hash | filter[/<kbytes>[/<fpRate>]] | shared[/<capacity>]} : set I-DPD/H-DPD packet id table type (default = table, 'hash' = fixed-size open-addressing hash table, 'filter' = fixed-memory cuckoo filter, default 1024 kB, 1.0e-06, 'shared' = node-wide hash table, default 32768 packet ids)",
     "+dscpCapture",     "<dscpValue>,<dscpValueList> : set the DSCP values(s) for unicast capture.",
     "+dscpRelease",     "<dscpValue>,<dscpValueList> : unset DSCP values(s) for unicast capture.",
     "+ecds",            "<ifaceList>  : E_CDS relay among all iface's listed",
@@ -1089,6 +1644,7 @@ const char* const SmfApp::CMD_LIST[] =
     "+flow",            "[<srcAddr>->]<dstAddr>[,<protocol>[,<class>]]] (Note <srcAddr> can optionally be an interface name)",
     "+forward",         "{on | off}  : forwarding enable/disable (default = on)",
     "+hash",            "<algorithm> : to set H-DPD hash algorithm",
+    "+hashkey",         "<32 hex digits> : sets the 128-bit key for the keyed SIPHASH algorithm",
     "-help",            "print help info an exit",
     "+idpd",            "{on | off}  : to do I-DPD when possible",
     "+igmpProxy",       "<ifaceList>  : mark interface(s) to send igmp joins for the groups we are interested to receive",
@@ -1102,6 +1658,8 @@ const char* const SmfApp::CMD_LIST[] =
     "+log",             "<logFile>      : debug log file",
     "+merge",           "<ifaceList>  : forward _among_ all iface's listed",
     "+push",            "<srcIface,dstIfaceList> : forward packets from srcIFace to all dstIface's listed",
+    "+pipeline",        "[<iface>,]<ringSize> : transmit via per-interface thread fed by <ringSize> frame ring, queuing (see \"queue\") when full (default = 0 (off))",
+    "+prealloc",        "<slab>/<count>[,<slab>/<count>...] : preallocate flow state objects, where <slab> is 'flow' (DPD table flows), 'window' (DPD window flows), 'seq' (sequence flows), or 'pktid' (DPD table packet ids)",
     "+queue",           "[<iface>,]<limit> : perform SMF packet queuing",
     "+rate",            "[<iface>,]<bitsPerSecond> : impose forwarding/transmit rate limit",
     "+relay",           "{on | off}  : act as relay node (default = on)",
@@ -1112,8 +1670,10 @@ const char* const SmfApp::CMD_LIST[] =
     "+route",           "<dstAddr>,<nextHopAddr> : used for debugging encapsulation only",
     "+rpush",           "<srcIface,dstIfaceList> : reseq/forward packets from srcIFace to all dstIface's listed",
     "+save",            "<configFile>   : save JSON configurstion file upon exit",
+    "+shards",          "<count>     : run <count> flow-sharded forwarding processes (must precede \"instance\" and interface commands, not with igmpProxy)",
     "+smfServer",       "<serverName>   : instructs smf to \"register\" itself to the given server (pipe only)\"+smfTap\"",
     "+smpr",            "<ifaceList>  : S_MPR relay among all iface's listed",
+    "+state",           "{<path>[,<staleSec>[,<capacity>]] | off} : keep window DPD and resequencing flow state in <path> for adoption upon restart (default 30 sec, 16384 flows)",
     "-stats",           "Returns interface information for all groups",
     "+tap",             "<tapName>      : instructs smf to divert forwarded packets to process ProtoPipe named <tapName>",
     "+ttl",             "<value>     : set TTL of outbound packets",
@@ -1122,7 +1682,7 @@ const char* const SmfApp::CMD_LIST[] =
     "+utos",            "<trafficClass> : set IP traffic class to be ignored by reliable forwarding",
     "-version",         "show version and exit",
     "+vrf",             "<vrf-name>,[<vrf-id>,]<ifaceList> : list of interfaces belonging to a vrf",
-    "+window",          "{on | off}  : do window-based I-DPD of sequenced packets",
+    "+window",          "{on | off}[,<sizeMin>,<sizeMax>]  : do window-based I-DPD of sequenced packets (adaptive per-flow window size bounds, default 64,8192)",
     "-with-frr",        "run along frr and pull configuration where appropriate, such as vrf info",
     NULL
 };
@@ -1167,6 +1727,16 @@ bool SmfApp::OnStartup(int argc, const char*const* argv)
         PLOG(PL_FATAL, "SmfApp::OnStartup() error: smf core initialization failed\n");
         return false;
     }
+    
+    // Allocate and assign the inbound batch frame buffers
+    const unsigned int BATCH_BUFFER_WORDS = (BUFFER_MAX + sizeof(UINT32) - 1) / sizeof(UINT32);
+    if (NULL == (inbound_batch_buffer = new UINT32[INBOUND_BATCH_MAX * BATCH_BUFFER_WORDS]))
+    {
+        PLOG(PL_FATAL, "SmfApp::OnStartup() new inbound_batch_buffer error: %s\n", GetErrorString());
+        return false;
+    }
+    for (unsigned int i = 0; i < INBOUND_BATCH_MAX; i++)
+        inbound_batch[i].aligned_buffer = inbound_batch_buffer + (i * BATCH_BUFFER_WORDS);
 
     unsigned int ifIndexArray[IF_COUNT_MAX];
     unsigned int ifCount = ProtoNet::GetInterfaceIndices(ifIndexArray, IF_COUNT_MAX);
@@ -1360,6 +1930,9 @@ void SmfApp::OnShutdown()
     if ('\0' != config_path[0])
         SaveConfig(config_path);
 
+    // Close the state file before interfaces (and their flows) are removed
+    smf.CloseStateFile();
+
     if (NULL != iface_monitor)
     {
         if (iface_monitor->IsOpen()) iface_monitor->Close();
@@ -1369,6 +1942,8 @@ void SmfApp::OnShutdown()
     iface_matcher_list.Destroy();
     if (control_pipe.IsOpen()) control_pipe.Close();
     if (server_pipe.IsOpen()) server_pipe.Close();
+    if (tx_batch_timer.IsActive()) tx_batch_timer.Deactivate();
+    if (shard_stats_timer.IsActive()) shard_stats_timer.Deactivate();
 
     Smf::InterfaceList::Iterator iterator(smf.AccessInterfaceList());
     Smf::Interface* iface;
@@ -1492,6 +2067,16 @@ void SmfApp::OnShutdown()
             delete mech;
         }
     }
+    xdp_umem.Close();  // (after all AF_XDP sockets are closed)
+    uring.Close();     // (after all cid elements have removed their sockets)
+    flow_shards.Stop();  // (primary terminates any other flow shards)
+    if (NULL != inbound_batch_buffer)
+    {
+        for (unsigned int i = 0; i < INBOUND_BATCH_MAX; i++)
+            inbound_batch[i].aligned_buffer = NULL;
+        delete[] inbound_batch_buffer;
+        inbound_batch_buffer = NULL;
+    }
 #ifdef _PROTO_DETOUR
     if (NULL != detour_ipv4)
     {
@@ -2527,6 +3112,28 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
             return false;
         }
     }
+    else if (!strncmp("hashkey", cmd, len))
+    {
+        // syntax: "hashkey <32 hex digits>"
+        char key[SmfHashSipHash::KEY_SIZE];
+        bool valid = (2*SmfHashSipHash::KEY_SIZE == strlen(val));
+        for (unsigned int i = 0; valid && (i < SmfHashSipHash::KEY_SIZE); i++)
+        {
+            unsigned int byte;
+            if (!isxdigit(val[2*i]) || !isxdigit(val[2*i+1]) ||
+                (1 != sscanf(val + 2*i, "%2x", &byte)))
+                valid = false;
+            else
+                key[i] = (char)byte;
+        }
+        if (!valid)
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(hashkey) invalid argument: expected %u hex digits\n",
+                 2*SmfHashSipHash::KEY_SIZE);
+            return false;
+        }
+        SmfHashSipHash::SetKey(key);
+    }
     else if (!strncmp("ihash", cmd, len))
     {
         SmfHash::Type hashType = SmfHash::GetTypeByName(val);
@@ -2557,73 +3164,213 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
             return false;
         }
     }
-    else if (!strncmp("window", cmd, len))
+    else if (!strncmp("dpd", cmd, len))
     {
-        if (!strcmp("on", val))
-        {
-            smf.SetUseWindow(true);
-        }
-        else if (!strcmp("off", val))
+        // [<iface>,]{table | hash}
+        Smf::Interface* iface = NULL;
+        const char* typePtr = strchr(val, ',');
+        if (NULL != typePtr)
         {
-            smf.SetUseWindow(false);
+            size_t namelen = typePtr - val;
+            if (namelen > Smf::IF_NAME_MAX)
+                namelen = Smf::IF_NAME_MAX;
+            char ifaceName[Smf::IF_NAME_MAX+1];
+            strncpy(ifaceName, val, namelen);
+            ifaceName[namelen] = '\0';
+            unsigned int ifaceIndex = ProtoNet::GetInterfaceIndex(ifaceName);
+            iface = smf.GetInterface(ifaceIndex);
+            if (NULL == iface)
+            {
+                PLOG(PL_ERROR, "OnCommand(dpd) error: invalid interface \"%s\"\n", ifaceName);
+                return false;
+            }
+            typePtr++;
         }
         else
         {
-            PLOG(PL_ERROR, "SmfApp::OnCommand(window) invalid argument: %s\n", val);
-            return false;
+            typePtr = val;
         }
-    }
-
-    else if (!strncmp("device", cmd, len))
-    {
-        // value is in form <vifName>,<ifaceName>[,shadow][,blockIGMP],[,addr1/maskLen,addr2[/maskLen],...
-        // copy it so we can parse it
-        ProtoTokenator tk(val, ',');
-        const char* vifName = tk.GetNextItem(true); // _detaches_ tokenized 'vifName' so needs deletion later
-        if (NULL == vifName)
+        SmfDpd::Type dpdType;
+        SmfDpd::Params dpdParams = smf.GetDpdParams();
+        if (!strcmp("table", typePtr))
         {
-            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: no arguments provided!\n");
-            return false;
+            dpdType = SmfDpd::TABLE;
         }
-        const char* ifaceName = tk.GetNextItem(true); // _detaches_ tokenized 'ifaceName' so needs deletion later
-        if (NULL == ifaceName)
+        else if (!strcmp("hash", typePtr))
         {
-            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: mission <ifaceName> argument!\n");
-            delete[] vifName;
-            return false;
+            dpdType = SmfDpd::HASH_TABLE;
         }
-        bool shadow = false;
-        bool blockIGMP = false;
-        const char* addrList;
-        while (NULL != (addrList = tk.GetNextPtr()))
+        else if (!strncmp("filter", typePtr, 6) && (('\0' == typePtr[6]) || ('/' == typePtr[6])))
         {
-            if (0 == strncmp("shadow", addrList, 6))
+            dpdType = SmfDpd::FILTER;
+            if ('/' == typePtr[6])
             {
-                shadow = true;
-                tk.GetNextItem();  // consume 'shadow' key word
+                unsigned int kbytes;
+                double fpRate;
+                int result = sscanf(typePtr + 7, "%u/%lf", &kbytes, &fpRate);
+                if ((result < 1) || (0 == kbytes) || (kbytes > (0xffffffff >> 10)) ||
+                    ((result > 1) && ((fpRate <= 0.0) || (fpRate >= 1.0))))
+                {
+                    PLOG(PL_ERROR, "SmfApp::OnCommand(dpd) invalid filter parameters: %s\n", typePtr);
+                    return false;
+                }
+                dpdParams.filter_memory = kbytes << 10;
+                if (result > 1) dpdParams.filter_fp_rate = fpRate;
             }
-            else if (0 == strncmp("block", addrList, 5))
+        }
+        else if (!strncmp("shared", typePtr, 6) && (('\0' == typePtr[6]) || ('/' == typePtr[6])))
+        {
+            dpdType = SmfDpd::SHARED;
+            unsigned int capacity = 0;
+            if (('/' == typePtr[6]) && ((1 != sscanf(typePtr + 7, "%u", &capacity)) || (0 == capacity)))
             {
-                blockIGMP = true;
-                tk.GetNextItem();  // consume 'blockIGMP' key word
+                PLOG(PL_ERROR, "SmfApp::OnCommand(dpd) invalid shared capacity: %s\n", typePtr);
+                return false;
             }
-            else
+            if (!smf.InitSharedDpd(capacity))
             {
-                break;
+                PLOG(PL_ERROR, "SmfApp::OnCommand(dpd) error: unable to initialize shared DPD store\n");
+                return false;
             }
         }
-        unsigned int vifIndex = OpenDevice(vifName, ifaceName, addrList, shadow, blockIGMP);
-        delete[] vifName;
-        delete[] ifaceName;
-        if (0 == vifIndex)
+        else
         {
-            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: unable to add device \"%s\"!\n", val);
+            PLOG(PL_ERROR, "SmfApp::OnCommand(dpd) invalid argument: %s\n", typePtr);
             return false;
         }
-    }
-    else if (!strncmp("cid", cmd, len))
-    {
-        // cid <vifName>,<iface1,iface2, ...>
+        if (NULL != iface)
+        {
+            if (SmfDpd::WINDOW == iface->GetDpdType())
+            {
+                PLOG(PL_ERROR, "OnCommand(dpd) error: interface \"%s\" uses window DPD\n", iface->GetNameStr());
+                return false;
+            }
+            if (!iface->SetDpdType(dpdType, dpdParams))
+            {
+                PLOG(PL_ERROR, "OnCommand(dpd) error: unable to set DPD type for interface \"%s\"\n", iface->GetNameStr());
+                return false;
+            }
+        }
+        else
+        {
+            // Default setting for all new interfaces
+            smf.SetDpdType(dpdType);
+            smf.SetDpdParams(dpdParams);
+        }
+    }
+    else if (!strncmp("window", cmd, len))
+    {
+        // value is in form {on | off}[,<sizeMin>,<sizeMax>]
+        const char* boundsPtr = strchr(val, ',');
+        size_t statelen = (NULL != boundsPtr) ? (size_t)(boundsPtr - val) : strlen(val);
+        if (NULL != boundsPtr)
+        {
+            unsigned int sizeMin, sizeMax;
+            if ((2 != sscanf(boundsPtr + 1, "%u,%u", &sizeMin, &sizeMax)) ||
+                (0 == sizeMin) || (sizeMax < sizeMin) || (sizeMax > 0x8000))
+            {
+                PLOG(PL_ERROR, "SmfApp::OnCommand(window) invalid window size bounds: %s\n", boundsPtr + 1);
+                return false;
+            }
+            SmfDpd::Params dpdParams = smf.GetDpdParams();
+            dpdParams.window_size_min = sizeMin;
+            dpdParams.window_size_max = sizeMax;
+            smf.SetDpdParams(dpdParams);
+        }
+        if ((2 == statelen) && !strncmp("on", val, 2))
+        {
+            smf.SetUseWindow(true);
+        }
+        else if ((3 == statelen) && !strncmp("off", val, 3))
+        {
+            smf.SetUseWindow(false);
+        }
+        else
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(window) invalid argument: %s\n", val);
+            return false;
+        }
+    }
+
+    else if (!strncmp("device", cmd, len))
+    {
+        if (flow_shards.IsActive())
+        {
+            // (TBD) support devices with flow shards (vif output needs to be shared)
+            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: not supported with flow shards\n");
+            return false;
+        }
+        // value is in form <vifName>,<ifaceName>[,shadow][,blockIGMP][,queues=<count>][,offload][,addr1/maskLen,addr2[/maskLen],...
+        // copy it so we can parse it
+        ProtoTokenator tk(val, ',');
+        const char* vifName = tk.GetNextItem(true); // _detaches_ tokenized 'vifName' so needs deletion later
+        if (NULL == vifName)
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: no arguments provided!\n");
+            return false;
+        }
+        const char* ifaceName = tk.GetNextItem(true); // _detaches_ tokenized 'ifaceName' so needs deletion later
+        if (NULL == ifaceName)
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: mission <ifaceName> argument!\n");
+            delete[] vifName;
+            return false;
+        }
+        bool shadow = false;
+        bool blockIGMP = false;
+        unsigned int vifQueues = 1;
+        bool vifOffload = false;
+        const char* addrList;
+        while (NULL != (addrList = tk.GetNextPtr()))
+        {
+            if (0 == strncmp("shadow", addrList, 6))
+            {
+                shadow = true;
+                tk.GetNextItem();  // consume 'shadow' key word
+            }
+            else if (0 == strncmp("block", addrList, 5))
+            {
+                blockIGMP = true;
+                tk.GetNextItem();  // consume 'blockIGMP' key word
+            }
+            else if (0 == strncmp("queues=", addrList, 7))
+            {
+                if ((1 != sscanf(addrList + 7, "%u", &vifQueues)) || (0 == vifQueues) || (vifQueues > SmfTap::QUEUE_COUNT_MAX))
+                {
+                    PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: invalid vif queue count (maximum %u)\n", SmfTap::QUEUE_COUNT_MAX);
+                    delete[] vifName;
+                    delete[] ifaceName;
+                    return false;
+                }
+                tk.GetNextItem();  // consume 'queues=<count>' key word
+            }
+            else if (0 == strncmp("offload", addrList, 7))
+            {
+                vifOffload = true;
+                tk.GetNextItem();  // consume 'offload' key word
+            }
+            else
+            {
+                break;
+            }
+        }
+        unsigned int vifIndex = OpenDevice(vifName, ifaceName, addrList, shadow, blockIGMP, vifQueues, vifOffload);
+        delete[] vifName;
+        delete[] ifaceName;
+        if (0 == vifIndex)
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(device) error: unable to add device \"%s\"!\n", val);
+            return false;
+        }
+    }
+    else if (!strncmp("cid", cmd, len))
+    {
+        if (flow_shards.IsActive())
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(cid) error: not supported with flow shards\n");
+            return false;
+        }
+        // cid <vifName>,<iface1,iface2, ...>
         ProtoTokenator tk(val, ',');
         const char* vifName = tk.GetNextItem(true); // _detaches_ tokenized 'vifName', so we MUST delete it later
         if (NULL == vifName)
@@ -2640,39 +3387,26 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
             ProtoTokenator tk2(next, '/');
             const char* ifaceName = tk2.GetNextItem(true);  // _detaches_ tokenized 'ifaceName', so we MUST delete it later
             const char* ifaceStatus = tk2.GetNextItem();
-            int cidFlags;
-            if (NULL == ifaceStatus)
+            if ((NULL != ifaceStatus) && ('d' == ifaceStatus[0]))
             {
-                cidFlags = CidElement::CID_TX | CidElement::CID_RX;
-            }
-            else 
-            {
-                switch(ifaceStatus[0])
+                // remove this interface from the Composite Interface Device (CID)
+                if (!RemoveCidElement(vifName, ifaceName))
                 {
-                    case 't':
-                        cidFlags = CidElement::CID_TX;
-                        break;
-                    case 'r':
-                        cidFlags = CidElement::CID_RX;
-                        break;
-                    case 'd':
-                    {
-                        // remove this interface from the Composite Interface Device (CID)
-                        if (!RemoveCidElement(vifName, ifaceName))
-                        {
-                            PLOG(PL_ERROR, "SmfApp::OnCommand(cid) error: invalid interface status: %s\n", next);
-                            delete[] ifaceName;
-                            delete[] vifName;
-                            return false;
-                        }
-                        continue;
-                    }
-                    default:
-                        PLOG(PL_ERROR, "SmfApp::OnCommand(cid) error: invalid interface deletion: %s\n", next);
-                        delete[] ifaceName;
-                        delete[] vifName;
-                        return false;
+                    PLOG(PL_ERROR, "SmfApp::OnCommand(cid) error: invalid interface deletion: %s\n", next);
+                    delete[] ifaceName;
+                    delete[] vifName;
+                    return false;
                 }
+                delete[] ifaceName;
+                continue;
+            }
+            int cidFlags = GetCidFlags(ifaceStatus);
+            if (0 == cidFlags)
+            {
+                PLOG(PL_ERROR, "SmfApp::OnCommand(cid) error: invalid interface status: %s\n", next);
+                delete[] ifaceName;
+                delete[] vifName;
+                return false;
             }
             if (!AddCidElement(vifName, ifaceName, cidFlags, 0))
             {
@@ -2778,6 +3512,112 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
             smf_queue_limit = qlimit;
         }
     }
+    else if (!strncmp("batch", cmd, len))
+    {
+        // [<iface>,]<count>[/<msec>] zero (or one) count means no tx batching
+        Smf::Interface* iface = NULL;
+        const char* countPtr = strchr(val, ',');
+        if (NULL != countPtr)
+        {
+            size_t namelen = countPtr - val;
+            if (namelen > Smf::IF_NAME_MAX)
+                namelen = Smf::IF_NAME_MAX;
+            char ifaceName[Smf::IF_NAME_MAX+1];
+            strncpy(ifaceName, val, namelen);
+            ifaceName[namelen] = '\0';
+            unsigned int ifaceIndex = ProtoNet::GetInterfaceIndex(ifaceName);
+            iface = smf.GetInterface(ifaceIndex);
+            if (NULL == iface)
+            {
+                PLOG(PL_ERROR, "OnCommand(batch) error: invalid interface \"%s\"\n", ifaceName);
+                return false;
+            }
+            countPtr++;
+        }
+        else
+        {
+            countPtr = val;
+        }
+        unsigned int count;
+        if ((1 != sscanf(countPtr, "%u", &count)) || (count > SmfTxBatch::BATCH_SIZE_MAX))
+        {
+            PLOG(PL_ERROR, "OnCommand(batch) error: invalid batch count \"%s\"\n", countPtr);
+            return false;
+        }
+        const char* latencyPtr = strchr(countPtr, '/');
+        if (NULL != latencyPtr)
+        {
+            double latency;
+            if ((1 != sscanf(latencyPtr + 1, "%lf", &latency)) || (latency <= 0.0))
+            {
+                PLOG(PL_ERROR, "OnCommand(batch) error: invalid batch latency \"%s\"\n", latencyPtr + 1);
+                return false;
+            }
+            // (the latency bound applies to all interfaces)
+            tx_batch_timer.SetInterval(latency * 1.0e-03);
+        }
+        if (NULL != iface)
+        {
+            InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+            if ((NULL == mech) || !mech->SetTxBatch(count))
+            {
+                PLOG(PL_ERROR, "OnCommand(batch) error: unable to set tx batching for interface \"%s\"\n", iface->GetNameStr());
+                return false;
+            }
+        }
+        else
+        {
+            // Default setting for all new interfaces
+            default_tx_batch = count;
+        }
+    }
+    else if (!strncmp("pipeline", cmd, len))
+    {
+        // [<iface>,]<ringSize> zero ring size means no tx pipeline thread
+        Smf::Interface* iface = NULL;
+        const char* sizePtr = strchr(val, ',');
+        if (NULL != sizePtr)
+        {
+            size_t namelen = sizePtr - val;
+            if (namelen > Smf::IF_NAME_MAX)
+                namelen = Smf::IF_NAME_MAX;
+            char ifaceName[Smf::IF_NAME_MAX+1];
+            strncpy(ifaceName, val, namelen);
+            ifaceName[namelen] = '\0';
+            unsigned int ifaceIndex = ProtoNet::GetInterfaceIndex(ifaceName);
+            iface = smf.GetInterface(ifaceIndex);
+            if (NULL == iface)
+            {
+                PLOG(PL_ERROR, "OnCommand(pipeline) error: invalid interface \"%s\"\n", ifaceName);
+                return false;
+            }
+            sizePtr++;
+        }
+        else
+        {
+            sizePtr = val;
+        }
+        unsigned int ringSize;
+        if ((1 != sscanf(sizePtr, "%u", &ringSize)) || (ringSize > 65536))
+        {
+            PLOG(PL_ERROR, "OnCommand(pipeline) error: invalid ring size \"%s\"\n", sizePtr);
+            return false;
+        }
+        if (NULL != iface)
+        {
+            InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+            if ((NULL == mech) || !mech->StartTxPipeline(ringSize))
+            {
+                PLOG(PL_ERROR, "OnCommand(pipeline) error: unable to set tx pipeline for interface \"%s\"\n", iface->GetNameStr());
+                return false;
+            }
+        }
+        else
+        {
+            // Default setting for all new interfaces
+            default_tx_pipeline = ringSize;
+        }
+    }
     else if (!strncmp("layered", cmd, len))
     {
         ProtoTokenator tk(val, ',');
@@ -2796,6 +3636,12 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
     }
     else if (!strncmp("igmpProxy", cmd, len))
     {
+        if (flow_shards.IsActive())
+        {
+            // (IGMP membership reports would reach only the shard their addresses hash to)
+            PLOG(PL_ERROR, "SmfApp::OnCommand(igmpProxy) error: not supported with flow shards\n");
+            return false;
+        }
         ProtoTokenator tk(val, ',');
         const char* ifaceName;
         while (NULL != (ifaceName = tk.GetNextItem()))
@@ -2873,6 +3719,12 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
         // (TBD) "remap cap" when this is toggled (need to make sure input notify is done)
         if (!strcmp("on", val))
         {
+            if (flow_shards.IsActive())
+            {
+                // (the firewall queue can't be split among flow shards)
+                PLOG(PL_ERROR, "SmfApp::OnCommand(firewallCapture) error: not supported with flow shards\n");
+                return false;
+            }
             // Setup ProtoDetour to intercept INBOUND packets
             int hookFlags = detour_ipv4_flags | ProtoDetour::INPUT; // intercept inbound packets
             if (!SetupIPv4Detour(hookFlags))
@@ -2964,16 +3816,22 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
 #endif // _PROTO_DETOUR
     else if (!strncmp("instance", cmd, len))
     {
+        // Non-primary flow shards listen on "<instanceName>_<shardIndex>"
+        char instanceName[128];
+        if (flow_shards.IsPrimary())
+            strncpy(instanceName, val, 127);
+        else
+            snprintf(instanceName, 127, "%s_%u", val, flow_shards.GetIndex());
+        instanceName[127] = '\0';
         if (control_pipe.IsOpen()) control_pipe.Close();
-        if (!control_pipe.Listen(val))
+        if (!control_pipe.Listen(instanceName))
         {
             PLOG(PL_ERROR, "SmfApp::OnCommand(instance) error opening control pipe\n");
             if ('\0' != control_pipe_name[0])
                 control_pipe.Listen(control_pipe_name);
             return false;
         }
-        strncpy(control_pipe_name, val, 127);
-        control_pipe_name[127] = '\0';
+        strncpy(control_pipe_name, instanceName, 128);
         // Following returns json formatted response, if that is not desired, comment the lines below and uncomment next section
         if (!ServerSend("smfClientStart", "control_pipe_name"))
         {
@@ -3005,8 +3863,130 @@ bool SmfApp::OnCommand(const char* cmd, const char* val)
             return false;
         }
     }
+    else if (!strncmp("budget", cmd, len))
+    {
+        // budget <flowMax> (may be changed at run time to shrink or grow the budget)
+        unsigned int flowMax;
+        if (1 != sscanf(val, "%u", &flowMax))
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(budget) error: invalid argument: %s\n", val);
+            return false;
+        }
+        smf.SetFlowBudget(flowMax);
+    }
+    else if (!strncmp("prealloc", cmd, len))
+    {
+        // prealloc <slab>/<count>[,<slab>/<count>...]
+        const char* ptr = val;
+        while (NULL != ptr)
+        {
+            const char* countPtr = strchr(ptr, '/');
+            const char* nextPtr = strchr(ptr, ',');
+            size_t namelen = (NULL != countPtr) ? (size_t)(countPtr - ptr) : 0;
+            char slabName[16];
+            unsigned int count;
+            if ((0 == namelen) || (namelen >= sizeof(slabName)) ||
+                ((NULL != nextPtr) && (nextPtr < countPtr)) ||
+                (1 != sscanf(countPtr + 1, "%u", &count)))
+            {
+                PLOG(PL_ERROR, "SmfApp::OnCommand(prealloc) error: invalid argument: %s\n", ptr);
+                return false;
+            }
+            strncpy(slabName, ptr, namelen);
+            slabName[namelen] = '\0';
+            SmfSlab* slab = SmfSlab::Find(slabName);
+            if (NULL == slab)
+            {
+                PLOG(PL_ERROR, "SmfApp::OnCommand(prealloc) error: unknown slab \"%s\"\n", slabName);
+                return false;
+            }
+            if (!slab->Preallocate(count))
+            {
+                PLOG(PL_ERROR, "SmfApp::OnCommand(prealloc) error: unable to preallocate %u \"%s\" objects\n", count, slabName);
+                return false;
+            }
+            ptr = (NULL != nextPtr) ? (nextPtr + 1) : NULL;
+        }
+    }
+    else if (!strncmp("state", cmd, len))
+    {
+        // state {<path>[,<staleSec>[,<capacity>]] | off}
+        if (!strcmp("off", val))
+        {
+            smf.CloseStateFile();
+            return true;
+        }
+        char path[PATH_MAX + 1];
+        const char* ptr = strchr(val, ',');
+        size_t pathLen = (NULL != ptr) ? (size_t)(ptr - val) : strlen(val);
+        unsigned int staleMax = SmfStateFile::STALE_MAX_DEFAULT;
+        unsigned int capacity = SmfStateFile::CAPACITY_DEFAULT;
+        if ((0 == pathLen) || (pathLen > PATH_MAX) ||
+            ((NULL != ptr) && (sscanf(ptr + 1, "%u,%u", &staleMax, &capacity) < 1)))
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(state) error: invalid argument: %s\n", val);
+            return false;
+        }
+        strncpy(path, val, pathLen);
+        path[pathLen] = '\0';
+        // Non-primary flow shards keep their own state in "<path>_<shardIndex>"
+        if (!flow_shards.IsPrimary())
+        {
+            size_t len = strlen(path);
+            snprintf(path + len, PATH_MAX + 1 - len, "_%u", flow_shards.GetIndex());
+        }
+        if (!smf.OpenStateFile(path, staleMax, capacity))
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(state) error: unable to open state file %s\n", path);
+            return false;
+        }
+    }
+    else if (!strncmp("shards", cmd, len))
+    {
+        // shards <count> : fork additional nrlsmf processes that each handle a
+        // (kernel-filtered) share of the flows with their own DPD state.  Since the
+        // child processes inherit our state, this must come before any control pipe
+        // or interfaces are opened.
+#if defined(ELASTIC_MCAST) || defined(ADAPTIVE_ROUTING)
+        // (TBD) The IGMP and multicast controller state (and their timers) would be
+        // per shard while the shard filter hashes control messages like any other flow,
+        // so a group's data could land on a shard that never sees its membership
+        PLOG(PL_ERROR, "SmfApp::OnCommand(shards) error: not supported with elastic multicast\n");
+        return false;
+#endif // ELASTIC_MCAST || ADAPTIVE_ROUTING
+        if (flow_shards.IsActive())
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(shards) error: flow shards already started\n");
+            return false;
+        }
+        if (control_pipe.IsOpen() || !smf.AccessInterfaceList().IsEmpty())
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(shards) error: must precede \"instance\" and interface commands\n");
+            return false;
+        }
+        unsigned int count;
+        if ((1 != sscanf(val, "%u", &count)) || (count < 1) || (count > SmfShard::SHARD_COUNT_MAX))
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(shards) error: invalid shard count \"%s\"\n", val);
+            return false;
+        }
+        if (!flow_shards.Start(count))
+        {
+            PLOG(PL_ERROR, "SmfApp::OnCommand(shards) error: unable to start flow shards\n");
+            return false;
+        }
+        if (flow_shards.IsActive())
+        {
+            PLOG(PL_INFO, "SmfApp::OnCommand(shards) started flow shard %u of %u (pid %d)\n",
+                          flow_shards.GetIndex(), count, (int)getpid());
+            // The other shards publish their counters for the primary's "stats" replies
+            if (!flow_shards.IsPrimary()) ActivateTimer(shard_stats_timer);
+        }
+    }
     else if (!strncmp("smfServer", cmd, len))
     {
+        // (only the primary flow shard talks to the server and passes its commands along)
+        if (!flow_shards.IsPrimary()) return true;
         if (server_pipe.IsOpen()) server_pipe.Close();
         if (!control_pipe.IsOpen())
         {
@@ -3848,8 +4828,7 @@ bool SmfApp::ParseInterfaceList(const char*         groupName,
         if (glen > Smf::IF_GROUP_NAME_MAX) glen = Smf::IF_GROUP_NAME_MAX;
         strncpy(pushGroupName, groupName, glen);
         pushGroupName[glen++]= ':';
-        const char* ptr = strchr(ifaceList, ',');
-        size_t ilen = (NULL != ptr) ? ptr - ifaceList : strlen(ifaceList);
+        size_t ilen = strcspn(ifaceList, ",/");  // (excludes any "/m", "/x" or "/u" interface flags)
         if (ilen > Smf::IF_NAME_MAX) ilen = Smf::IF_NAME_MAX;
         strncpy(pushGroupName + glen, ifaceList, ilen);
         pushGroupName[glen+ilen] = '\0';
@@ -3959,12 +4938,71 @@ bool SmfApp::ParseInterfaceName(Smf::InterfaceGroup& ifaceGroup, const char* ifa
     }
     else
     {
+        // An "ifaceName/m" suffix selects TPACKET_V3 mmap ring capture for input,
+        // "ifaceName/x" selects AF_XDP packet I/O and "ifaceName/u" selects io_uring input
+        // (TBD - support this for wildcard interface matchers, too)
+        char ifName[Smf::IF_NAME_MAX+1];
+        bool ringCapture = false;
+        bool xdpMode = false;
+        bool uringCapture = false;
+        const char* slashPtr = strchr(ifaceName, '/');
+        if (NULL != slashPtr)
+        {
+            if (0 == strcmp(slashPtr, "/m"))
+            {
+                ringCapture = true;
+            }
+            else if (0 == strcmp(slashPtr, "/x"))
+            {
+                xdpMode = true;
+            }
+            else if (0 == strcmp(slashPtr, "/u"))
+            {
+                uringCapture = true;
+            }
+            else
+            {
+                PLOG(PL_ERROR, "SmfApp::ParseInterfaceName() error: invalid interface flags \"%s\"\n", ifaceName);
+                return false;
+            }
+            size_t nameLen = slashPtr - ifaceName;
+            if (nameLen > Smf::IF_NAME_MAX) nameLen = Smf::IF_NAME_MAX;
+            strncpy(ifName, ifaceName, nameLen);
+            ifName[nameLen] = '\0';
+            ifaceName = ifName;
+        }
         Smf::Interface* iface = GetInterface(ifaceName);
         if (NULL == iface)
         {
             PLOG(PL_ERROR, "SmfApp::ParseInterfaceName() error: unable to add new Smf::Interface\n");
             // return false;
         }
+        else if (ringCapture)
+        {
+            InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+            CidElement* elem = (NULL != mech) ? mech->GetPrincipalElement() : NULL;
+            if ((NULL == elem) || !SetRingCapture(*elem, true))
+                PLOG(PL_WARN, "SmfApp::ParseInterfaceName() warning: unable to enable ring capture for \"%s\" (using ProtoCap::Recv())\n", ifaceName);
+        }
+        else if (xdpMode)
+        {
+            InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+            CidElement* elem = (NULL != mech) ? mech->GetPrincipalElement() : NULL;
+            if ((NULL != mech) && mech->TxPipelineActive())
+            {
+                PLOG(PL_WARN, "SmfApp::ParseInterfaceName() warning: tx pipeline not used with AF_XDP for \"%s\"\n", ifaceName);
+                mech->StopTxPipeline();
+            }
+            if ((NULL == elem) || !SetXdpMode(*elem, true))
+                PLOG(PL_WARN, "SmfApp::ParseInterfaceName() warning: unable to enable AF_XDP for \"%s\" (using ProtoCap)\n", ifaceName);
+        }
+        else if (uringCapture)
+        {
+            InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+            CidElement* elem = (NULL != mech) ? mech->GetPrincipalElement() : NULL;
+            if ((NULL == elem) || !SetUringCapture(*elem, true))
+                PLOG(PL_WARN, "SmfApp::ParseInterfaceName() warning: unable to enable io_uring capture for \"%s\" (using ProtoCap::Recv())\n", ifaceName);
+        }
         if (!AddInterfaceToGroup(ifaceGroup, *iface, isSourceIface))
         {
             PLOG(PL_ERROR, "SmfApp::ParseInterfaceName() error: unable to add interface \"%s\" to group \"%s\"\n",
@@ -4057,6 +5095,7 @@ Smf::Interface* SmfApp::GetInterface(const char* ifName, unsigned int ifIndex)
         iface->SetExtension(*mech);
         mech->GetTxTimer().SetListener(mech, &SmfApp::InterfaceMechanism::OnTxTimeout);
         if (mech->SetTxRateLimit(default_tx_rate_limit)) ActivateTimer(mech->GetTxTimer());  // inherit SmfApp default tx_rate_limit
+        mech->SetTxBatch(default_tx_batch);  // inherit SmfApp default tx_batch_size
     }
     // We always open a ProtoCap for each interface to ensure that it is in
     // promiscuous mode to get packets.  Later, we enable ProtoCap input
@@ -4080,10 +5119,20 @@ Smf::Interface* SmfApp::GetInterface(const char* ifName, unsigned int ifIndex)
             smf.RemoveInterface(ifIndex);
             return NULL;
         }
+        if (!flow_shards.AttachFilter(cap->GetHandle()))
+        {
+            PLOG(PL_ERROR, "SmfApp::GetInterface(): unable to attach flow shard filter for iface %s\n", ifName);
+            cap->Close();
+            delete cap;
+            smf.RemoveInterface(ifIndex);
+            return NULL;
+        }
         cap->StopInputNotification();  // will be re-enabled in UpdateGroupAssociations() as needed
         cap->SetUserData(iface);
         unsigned int flags = CidElement::CID_TX | CidElement::CID_RX;
         mech->AddCidElement(*cap, flags);
+        if (!mech->StartTxPipeline(default_tx_pipeline))  // inherit SmfApp default tx pipeline
+            PLOG(PL_WARN, "SmfApp::GetInterface() warning: unable to start tx pipeline for iface %s\n", ifName);
     }  // end if (mech->GetElementList().IsEmpty())
     
     // if the ProtoVif "device" is associated with a GRE ProtoCap, record its tunnel local addr for SMF operations
@@ -4842,10 +5891,11 @@ void SmfApp::RemoveMatchers(const char* groupName)
 // channels. This is mainly to support experimentation but have other use cases.
 
 // A nrlsmf "device" is a virtual interface (ProtoVif "vif") bound to one or more pcap instances (ProtoCap "cap")
-unsigned int SmfApp::OpenDevice(const char* vifName, const char* ifaceNameAndFlags, const char* addrList, bool shadow, bool blockIGMP)
+unsigned int SmfApp::OpenDevice(const char* vifName, const char* ifaceNameAndFlags, const char* addrList, bool shadow, bool blockIGMP, 
+                                unsigned int vifQueues, bool vifOffload)
 {
     // Add ProtoVif "device", stealing ifaceName addresses if NULL addrString
-    Smf::Interface* iface = AddDevice(vifName, ifaceNameAndFlags, (NULL == addrList));
+    Smf::Interface* iface = AddDevice(vifName, ifaceNameAndFlags, (NULL == addrList), vifQueues, vifOffload);
     if (NULL == iface)
     {
         PLOG(PL_ERROR, "SmfApp::OpenDevice() error: unable to add device '%s'\n", vifName);
@@ -4891,10 +5941,11 @@ unsigned int SmfApp::OpenDevice(const char* vifName, const char* ifaceNameAndFla
     return vifIndex;
 }  // end SmfApp::OpenDevice()
 
-Smf::Interface* SmfApp::AddDevice(const char* vifName, const char* ifaceNameAndFlags, bool stealAddrs)
+Smf::Interface* SmfApp::AddDevice(const char* vifName, const char* ifaceNameAndFlags, bool stealAddrs, 
+                                  unsigned int vifQueues, bool vifOffload)
 {
     // 1) Create the ProtoVif device
-    Smf::Interface* iface = CreateDevice(vifName);
+    Smf::Interface* iface = CreateDevice(vifName, vifQueues, vifOffload);
     if (NULL == iface)
     {
         PLOG(PL_ERROR, "SmfApp::AddDevice() error: unable to create ProtoVif device: \"%s\"\n", vifName);
@@ -4906,32 +5957,20 @@ Smf::Interface* SmfApp::AddDevice(const char* vifName, const char* ifaceNameAndF
     //    This will be the underlying interface tethered to the vif although
     //     multiple CidElements can be tethered to a vif device
     
-    // Note "ifaceName" here can have syntax "ifaceName[/{t|r|d}]" to specify tx-only (t) or rx-only (r) operation for the given iface
+    // Note "ifaceName" here can have syntax "ifaceName[/{t|r}][m|x|u]" to specify tx-only (t) or rx-only (r) operation for the given iface
     // (This is with respect to composite interface device (cid) capaability. - the default is tx and rx operation)
+    // The 'm' flag selects TPACKET_V3 mmap ring capture for input on the iface, 'x' selects AF_XDP packet I/O
+    // and 'u' selects io_uring multishot receive for input
     
     ProtoTokenator tk(ifaceNameAndFlags, '/');
     const char* ifaceName = tk.GetNextItem(true); // detaches tokenized string item, so we MUST delete it later
     const char* ifaceStatus = tk.GetNextItem();
-    int cidFlags;
-    if (NULL == ifaceStatus)
+    int cidFlags = GetCidFlags(ifaceStatus);
+    if (0 == cidFlags)
     {
-        cidFlags = CidElement::CID_TX | CidElement::CID_RX;
-    }
-    else 
-    {
-        switch(ifaceStatus[0])
-        {
-            case 't':
-                cidFlags = CidElement::CID_TX;
-                break;
-            case 'r':
-                cidFlags = CidElement::CID_RX;
-                break;
-            default:
-                PLOG(PL_ERROR, "SmfApp::OpenDevice(%s) error: invalid interface status: %s\n", ifaceNameAndFlags);
-                delete[] ifaceName;
-                return NULL;
-        }
+        PLOG(PL_ERROR, "SmfApp::OpenDevice(%s) error: invalid interface status: %s\n", ifaceNameAndFlags, ifaceStatus);
+        delete[] ifaceName;
+        return NULL;
     }
     unsigned int ifaceIndex = AddCidElement(vifName, ifaceName, cidFlags, vifIndex);
     if (0 == ifaceIndex)
@@ -4956,7 +5995,7 @@ Smf::Interface* SmfApp::AddDevice(const char* vifName, const char* ifaceNameAndF
     return iface;
 }  // end SmfApp::AddDevice()
 
-Smf::Interface* SmfApp::CreateDevice(const char* vifName)
+Smf::Interface* SmfApp::CreateDevice(const char* vifName, unsigned int vifQueues, bool vifOffload)
 {
     // Create ProtoVif device for use as an Smf::Interface
     // 1) Make sure the device doesn't already exist and create it and associate InterfaceMechanism
@@ -4965,7 +6004,9 @@ Smf::Interface* SmfApp::CreateDevice(const char* vifName)
         PLOG(PL_ERROR, "SmfApp::CreateDevice() error: interface/device \"%s\" already exists!\n", vifName);
         return NULL;
     }
-    ProtoVif* vif = ProtoVif::Create();
+    // (An SmfTap is used for a multi-queue and/or offload (IFF_VNET_HDR) vif)
+    ProtoVif* vif = ((vifQueues > 1) || vifOffload) ? 
+                        static_cast<ProtoVif*>(new SmfTap(vifQueues, vifOffload)) : ProtoVif::Create();
     if (NULL == vif)
     {
         PLOG(PL_ERROR, "SmfApp::CreateDevice() new ProtoVif error: %s\n", GetErrorString());
@@ -4998,96 +6039,372 @@ Smf::Interface* SmfApp::CreateDevice(const char* vifName)
         delete vif;
         return NULL;
     }
-    // Verify that this is _not_ an already existing "smf" interface
-    Smf::Interface* iface = smf.GetInterface(vifIndex);
-    if (NULL != iface)
+    // Verify that this is _not_ an already existing "smf" interface
+    Smf::Interface* iface = smf.GetInterface(vifIndex);
+    if (NULL != iface)
+    {
+        PLOG(PL_ERROR, "SmfApp::CreateDevice() error: interface \"%s\" (index:%d) already in use!\n", vifName, vifIndex);
+        delete vif;
+        return NULL;
+    }
+    // 3) Now directly add the device  as an Smf::Interface
+    iface = smf.AddInterface(vifIndex, vifName);
+    if (NULL == iface)
+    {
+        PLOG(PL_ERROR, "SmfApp::CreateDevice() error: unable to add SMF interface\n");
+        delete vif;
+        return NULL;
+    }
+    
+    // Create InterfaceMechanism to associate vif device
+    InterfaceMechanism* mech = new InterfaceMechanism(*iface, pkt_pool);
+    if (NULL == mech)
+    {
+        PLOG(PL_ERROR, "SmfApp::CreateDevice() new InterfaceMechanism error: %s\n", GetErrorString());
+        delete vif;
+        smf.RemoveInterface(iface);
+        return NULL;
+    }
+    vif->SetBlocking(false);
+    mech->SetProtoVif(vif);
+    mech->GetTxTimer().SetListener(mech, &SmfApp::InterfaceMechanism::OnTxTimeout);
+    if (mech->SetTxRateLimit(default_tx_rate_limit)) ActivateTimer(mech->GetTxTimer());  // inherit SmfApp default tx_rate_limit
+    mech->SetTxBatch(default_tx_batch);  // inherit SmfApp default tx_batch_size
+    iface->SetInterfaceAddress(vif->GetHardwareAddress());
+    smf.AddOwnAddress(vif->GetHardwareAddress(), vifIndex);
+    iface->SetQueueLimit(smf_queue_limit);  // init to default
+    iface->SetExtension(*mech);
+    vif->SetUserData(iface);
+    return iface;
+}  // end SmfApp::CreateDevice()
+
+
+unsigned int SmfApp::AddCidElement(const char* deviceName, const char* ifaceName, int flags, unsigned int vifIndex)
+{
+    // Add a CID_RX pcap device to an existing nrlsmf virtual interface "device"
+     // First make sure nrlsmf isn't already using this "ifaceName" for something
+    unsigned int capIndex = ProtoNet::GetInterfaceIndex(ifaceName);
+    if (NULL != smf.GetInterface(capIndex))
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: interface \"%s\" (index:%d) already in use!\n", ifaceName, capIndex);
+        return 0;
+    }
+    // If not provided, lookup  the vif interface index to retrieve the corresponding Smf::Interface
+    if (0 == vifIndex)
+        vifIndex = ProtoNet::GetInterfaceIndex(deviceName);
+    if (0 == capIndex)
+    {
+        PLOG(PL_ERROR, "SmfApp::GetCidElementList() error: unable to get interface index for interface \"%s\"\n", ifaceName);
+        return 0;
+    }
+    // Verify that this "deviceName" is an existing nrlsmf interface
+    Smf::Interface* iface = smf.GetInterface(vifIndex);
+    if (NULL == iface)
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: invalid nrlsmf interface \"%s\"\n", deviceName);
+        return 0;
+    }
+    // Get its interface mechanism
+    InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+    if ((NULL == mech) || (NULL == mech->GetProtoVif()))
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: invalid nrlsmf device \"%s\"\n", deviceName);
+        return 0;
+    }
+    ProtoCap* cap = ProtoCap::Create();
+    if (NULL == cap)
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement(): ProtoCap::Create() error: %s\n", GetErrorString());
+        return 0;
+    }
+    cap->SetListener(this, &SmfApp::OnPktCapture);
+    cap->SetNotifier(static_cast<ProtoChannel::Notifier*>(&dispatcher));
+    if (!cap->Open(ifaceName))
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement(): ProtoCap::Open(%s) error: %s\n", ifaceName, GetErrorString());
+        delete cap;
+        return 0;
+    }
+    if (!flow_shards.AttachFilter(cap->GetHandle()))
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement(): unable to attach flow shard filter for iface %s\n", ifaceName);
+        cap->Close();
+        delete cap;
+        return 0;
+    }
+    cap->StopInputNotification();  // will be re-enabled in UpdateGroupAssociations() as needed
+    cap->SetUserData(iface);
+    if (!mech->AddCidElement(*cap, flags))
+    {
+        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: unable to add cid element \"%s\"\n", ifaceName);
+        delete cap;
+        return 0;
+    }
+    if (0 != (flags & CidElement::CID_RING))
+    {
+        CidElement* elem = mech->GetCidElement(capIndex);
+        if ((NULL == elem) || !SetRingCapture(*elem, true))
+            PLOG(PL_WARN, "SmfApp::AddCidElement() warning: unable to enable ring capture for \"%s\" (using ProtoCap::Recv())\n", ifaceName);
+    }
+    else if (0 != (flags & CidElement::CID_XDP))
+    {
+        CidElement* elem = mech->GetCidElement(capIndex);
+        if ((NULL == elem) || !SetXdpMode(*elem, true))
+            PLOG(PL_WARN, "SmfApp::AddCidElement() warning: unable to enable AF_XDP for \"%s\" (using ProtoCap)\n", ifaceName);
+    }
+    else if (0 != (flags & CidElement::CID_URING))
+    {
+        CidElement* elem = mech->GetCidElement(capIndex);
+        if ((NULL == elem) || !SetUringCapture(*elem, true))
+            PLOG(PL_WARN, "SmfApp::AddCidElement() warning: unable to enable io_uring capture for \"%s\" (using ProtoCap::Recv())\n", ifaceName);
+    }
+    return capIndex;
+}  // end SmfApp::AddCidElement()
+
+// Parses cid element status "{t|r}[m|x|u]" (or NULL for default tx and rx operation) into CidElement flags
+// (returns zero if the status is invalid)
+int SmfApp::GetCidFlags(const char* ifaceStatus)
+{
+    int cidFlags = CidElement::CID_TX | CidElement::CID_RX;
+    if (NULL == ifaceStatus) return cidFlags;
+    const char* ptr = ifaceStatus;
+    switch (*ptr)
+    {
+        case 't':
+            cidFlags = CidElement::CID_TX;
+            ptr++;
+            break;
+        case 'r':
+            cidFlags = CidElement::CID_RX;
+            ptr++;
+            break;
+        default:
+            break;
+    }
+    if ('m' == *ptr)
+    {
+        cidFlags |= CidElement::CID_RING;
+        ptr++;
+    }
+    else if ('x' == *ptr)
+    {
+        cidFlags |= CidElement::CID_XDP;
+        ptr++;
+    }
+    else if ('u' == *ptr)
+    {
+        cidFlags |= CidElement::CID_URING;
+        ptr++;
+    }
+    if ('\0' != *ptr) return 0;  // invalid status
+    return cidFlags;
+}  // end SmfApp::GetCidFlags()
+
+// Opens (or closes) a TPACKET_V3 mmap ring for input on the given cid element.  When
+// enabled, the ring replaces ProtoCap::Recv() for input while the ProtoCap is
+// still used for output (and keeps the interface in promiscuous mode).
+bool SmfApp::SetRingCapture(CidElement& elem, bool enable)
+{
+    ProtoCap& cap = elem.GetProtoCap();
+    SmfRing* ring = elem.GetProtoRing();
+    if (!enable)
+    {
+        elem.ClearFlag(CidElement::CID_RING);
+        if (NULL != ring)
+        {
+            bool inputActive = ring->InputNotification();
+            elem.SetProtoRing(NULL);
+            ring->Close();
+            delete ring;
+            // (the flow shard filter, if any, replaces the drop filter)
+            bool restored = flow_shards.IsActive() ? flow_shards.AttachFilter(cap.GetHandle()) :
+                                                     SmfRing::DetachDropFilter(cap.GetHandle());
+            if (!restored)
+                PLOG(PL_WARN, "SmfApp::SetRingCapture() warning: unable to restore ProtoCap socket filter\n");
+            if (inputActive) cap.StartInputNotification();
+        }
+        return true;
+    }
+    if (NULL != ring) return true;  // already enabled
+    if (NULL == (ring = new SmfRing()))
+    {
+        PLOG(PL_ERROR, "SmfApp::SetRingCapture() new SmfRing error: %s\n", GetErrorString());
+        return false;
+    }
+    ring->SetListener(this, &SmfApp::OnRingCapture);
+    ring->SetNotifier(static_cast<ProtoChannel::Notifier*>(&dispatcher));
+    if (!ring->Open(cap.GetInterfaceIndex()))
+    {
+        PLOG(PL_ERROR, "SmfApp::SetRingCapture() error: unable to open ring for ifIndex %u\n", cap.GetInterfaceIndex());
+        delete ring;
+        return false;
+    }
+    if (!flow_shards.AttachFilter(ring->GetHandle()))
+    {
+        PLOG(PL_ERROR, "SmfApp::SetRingCapture() error: unable to attach flow shard filter\n");
+        ring->Close();
+        delete ring;
+        return false;
+    }
+    ring->SetUserData(&cap);
+    // The ProtoCap socket (still used for output) drops all input so the kernel
+    // doesn't also clone every frame to it while the ring is used
+    if (!SmfRing::AttachDropFilter(cap.GetHandle()))
+        PLOG(PL_WARN, "SmfApp::SetRingCapture() warning: unable to attach ProtoCap drop filter\n");
+    // Swap input notification over from the ProtoCap to the ring, if active
+    if (cap.InputNotification())
+    {
+        cap.StopInputNotification();
+        ring->StartInputNotification();
+    }
+    else
+    {
+        ring->StopInputNotification();  // will be enabled in UpdateGroupAssociations() as needed
+    }
+    elem.SetProtoRing(ring);
+    elem.SetFlag(CidElement::CID_RING);
+    return true;
+}  // end SmfApp::SetRingCapture()
+
+// Opens (or closes) an AF_XDP socket for the given cid element.  When enabled, the socket
+// is used for input along with the ProtoCap (which gets any frames not redirected to the
+// socket) and replaces the ProtoCap for output.
+bool SmfApp::SetXdpMode(CidElement& elem, bool enable)
+{
+    ProtoCap& cap = elem.GetProtoCap();
+    SmfXdpSocket* xsk = elem.GetXdpSocket();
+    if (!enable)
+    {
+        elem.ClearFlag(CidElement::CID_XDP);
+        if (NULL != xsk)
+        {
+            elem.SetXdpSocket(NULL);
+            xsk->Close();
+            delete xsk;
+        }
+        return true;
+    }
+    if (NULL != xsk) return true;  // already enabled
+    if (flow_shards.IsActive())
+    {
+        // (the AF_XDP socket's device queue can't be shared among flow shards)
+        PLOG(PL_ERROR, "SmfApp::SetXdpMode() error: AF_XDP not supported with flow shards\n");
+        return false;
+    }
+    if (ProtoNet::IFACE_GRE == cap.GetInterfaceType())
+    {
+        PLOG(PL_ERROR, "SmfApp::SetXdpMode() error: AF_XDP not supported for GRE interfaces\n");
+        return false;
+    }
+    if ((NULL != elem.GetProtoRing()) || (NULL != elem.GetUring()))
+    {
+        PLOG(PL_ERROR, "SmfApp::SetXdpMode() error: AF_XDP and ring or io_uring capture are mutually exclusive\n");
+        return false;
+    }
+    char ifName[Smf::IF_NAME_MAX + 1];
+    ifName[Smf::IF_NAME_MAX] = '\0';
+    if (!ProtoNet::GetInterfaceName(cap.GetInterfaceIndex(), ifName, Smf::IF_NAME_MAX))
     {
-        PLOG(PL_ERROR, "SmfApp::CreateDevice() error: interface \"%s\" (index:%d) already in use!\n", vifName, vifIndex);
-        delete vif;
-        return NULL;
+        PLOG(PL_ERROR, "SmfApp::SetXdpMode() error: unable to get name for ifIndex %u\n", cap.GetInterfaceIndex());
+        return false;
     }
-    // 3) Now directly add the device  as an Smf::Interface
-    iface = smf.AddInterface(vifIndex, vifName);
-    if (NULL == iface)
+    if (NULL == (xsk = new SmfXdpSocket(xdp_umem)))
     {
-        PLOG(PL_ERROR, "SmfApp::CreateDevice() error: unable to add SMF interface\n");
-        delete vif;
-        return NULL;
+        PLOG(PL_ERROR, "SmfApp::SetXdpMode() new SmfXdpSocket error: %s\n", GetErrorString());
+        return false;
     }
-    
-    // Create InterfaceMechanism to associate vif device
-    InterfaceMechanism* mech = new InterfaceMechanism(*iface, pkt_pool);
-    if (NULL == mech)
+    xsk->SetListener(this, &SmfApp::OnXdpInput);
+    xsk->SetNotifier(static_cast<ProtoChannel::Notifier*>(&dispatcher));
+    if (!xsk->Open(ifName))
     {
-        PLOG(PL_ERROR, "SmfApp::CreateDevice() new InterfaceMechanism error: %s\n", GetErrorString());
-        delete vif;
-        smf.RemoveInterface(iface);
-        return NULL;
+        PLOG(PL_ERROR, "SmfApp::SetXdpMode() error: unable to open AF_XDP socket for \"%s\"\n", ifName);
+        delete xsk;
+        return false;
     }
-    vif->SetBlocking(false);
-    mech->SetProtoVif(vif);
-    mech->GetTxTimer().SetListener(mech, &SmfApp::InterfaceMechanism::OnTxTimeout);
-    if (mech->SetTxRateLimit(default_tx_rate_limit)) ActivateTimer(mech->GetTxTimer());  // inherit SmfApp default tx_rate_limit
-    iface->SetInterfaceAddress(vif->GetHardwareAddress());
-    smf.AddOwnAddress(vif->GetHardwareAddress(), vifIndex);
-    iface->SetQueueLimit(smf_queue_limit);  // init to default
-    iface->SetExtension(*mech);
-    vif->SetUserData(iface);
-    return iface;
-}  // end SmfApp::CreateDevice()
-
+    xsk->SetUserData(&cap);
+    if (cap.InputNotification())
+        xsk->StartInputNotification();
+    else
+        xsk->StopInputNotification();  // will be enabled in UpdateGroupAssociations() as needed
+    elem.SetXdpSocket(xsk);
+    elem.SetFlag(CidElement::CID_XDP);
+    PLOG(PL_INFO, "SmfApp::SetXdpMode() AF_XDP packet I/O enabled for \"%s\"\n", ifName);
+    return true;
+}  // end SmfApp::SetXdpMode()
 
-unsigned int SmfApp::AddCidElement(const char* deviceName, const char* ifaceName, int flags, unsigned int vifIndex)
+// Adds (or removes) an io_uring multishot receive socket for the given cid element.  When
+// enabled, the shared SmfUring replaces ProtoCap::Recv() for input while the ProtoCap is
+// still used for output (and keeps the interface in promiscuous mode).
+bool SmfApp::SetUringCapture(CidElement& elem, bool enable)
 {
-    // Add a CID_RX pcap device to an existing nrlsmf virtual interface "device"
-     // First make sure nrlsmf isn't already using this "ifaceName" for something
-    unsigned int capIndex = ProtoNet::GetInterfaceIndex(ifaceName);
-    if (NULL != smf.GetInterface(capIndex))
+    ProtoCap& cap = elem.GetProtoCap();
+    if (!enable)
+    {
+        elem.ClearFlag(CidElement::CID_URING);
+        if (NULL != elem.GetUring())
+        {
+            bool inputActive = uring.SocketIsEnabled(elem.GetUringSlot());
+            uring.RemoveSocket(elem.GetUringSlot());
+            elem.SetUringSlot(NULL, -1);
+            // (the flow shard filter, if any, replaces the drop filter)
+            bool restored = flow_shards.IsActive() ? flow_shards.AttachFilter(cap.GetHandle()) :
+                                                     SmfRing::DetachDropFilter(cap.GetHandle());
+            if (!restored)
+                PLOG(PL_WARN, "SmfApp::SetUringCapture() warning: unable to restore ProtoCap socket filter\n");
+            if (inputActive) cap.StartInputNotification();
+        }
+        return true;
+    }
+    if (NULL != elem.GetUring()) return true;  // already enabled
+    if (ProtoNet::IFACE_GRE == cap.GetInterfaceType())
     {
-        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: interface \"%s\" (index:%d) already in use!\n", ifaceName, capIndex);
-        return 0;
+        // (frames are handled in place, so there's no room to prepend a placeholder Ethernet header)
+        PLOG(PL_ERROR, "SmfApp::SetUringCapture() error: io_uring capture not supported for GRE interfaces\n");
+        return false;
     }
-    // If not provided, lookup  the vif interface index to retrieve the corresponding Smf::Interface
-    if (0 == vifIndex)
-        vifIndex = ProtoNet::GetInterfaceIndex(deviceName);
-    if (0 == capIndex)
+    if ((NULL != elem.GetProtoRing()) || (NULL != elem.GetXdpSocket()))
     {
-        PLOG(PL_ERROR, "SmfApp::GetCidElementList() error: unable to get interface index for interface \"%s\"\n", ifaceName);
-        return 0;
+        PLOG(PL_ERROR, "SmfApp::SetUringCapture() error: io_uring capture and ring capture or AF_XDP are mutually exclusive\n");
+        return false;
     }
-    // Verify that this "deviceName" is an existing nrlsmf interface
-    Smf::Interface* iface = smf.GetInterface(vifIndex);
-    if (NULL == iface)
+    if (!uring.IsOpen())
     {
-        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: invalid nrlsmf interface \"%s\"\n", deviceName);
-        return 0;
+        uring.SetListener(this, &SmfApp::OnUringInput);
+        uring.SetNotifier(static_cast<ProtoChannel::Notifier*>(&dispatcher));
+        if (!uring.Open())
+        {
+            PLOG(PL_ERROR, "SmfApp::SetUringCapture() error: unable to open io_uring\n");
+            return false;
+        }
+        uring.StartInputNotification();
     }
-    // Get its interface mechanism
-    InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
-    if ((NULL == mech) || (NULL == mech->GetProtoVif()))
+    int slot = uring.AddSocket(cap.GetInterfaceIndex(), &cap);
+    if (slot < 0)
     {
-        PLOG(PL_ERROR, "SmfApp::AddCidElement() error: invalid nrlsmf device \"%s\"\n", deviceName);
-        return 0;
+        PLOG(PL_ERROR, "SmfApp::SetUringCapture() error: unable to add socket for ifIndex %u\n", cap.GetInterfaceIndex());
+        return false;
     }
-    ProtoCap* cap = ProtoCap::Create();
-    if (NULL == cap)
+    if (!flow_shards.AttachFilter(uring.GetSocketHandle(slot)))
     {
-        PLOG(PL_ERROR, "SmfApp::AddCidElement(): ProtoCap::Create() error: %s\n", GetErrorString());
-        return 0;
+        PLOG(PL_ERROR, "SmfApp::SetUringCapture() error: unable to attach flow shard filter\n");
+        uring.RemoveSocket(slot);
+        return false;
     }
-    cap->SetListener(this, &SmfApp::OnPktCapture);
-    cap->SetNotifier(static_cast<ProtoChannel::Notifier*>(&dispatcher));
-    if (!cap->Open(ifaceName))
+    // The ProtoCap socket (still used for output) drops all input so the kernel
+    // doesn't also clone every frame to it while the io_uring socket is used
+    if (!SmfRing::AttachDropFilter(cap.GetHandle()))
+        PLOG(PL_WARN, "SmfApp::SetUringCapture() warning: unable to attach ProtoCap drop filter\n");
+    // Swap input over from the ProtoCap to the io_uring socket, if active
+    if (cap.InputNotification())
     {
-        PLOG(PL_ERROR, "SmfApp::AddCidElement(): ProtoCap::Open(%s) error: %s\n", ifaceName, GetErrorString());
-        delete cap;
-        return 0;
+        cap.StopInputNotification();
+        uring.EnableSocket(slot, true);
     }
-    cap->StopInputNotification();  // will be re-enabled in UpdateGroupAssociations() as needed
-    cap->SetUserData(iface);
-    mech->AddCidElement(*cap, flags);
-    return capIndex;
-}  // end SmfApp::AddCidElement()
+    elem.SetUringSlot(&uring, slot);
+    elem.SetFlag(CidElement::CID_URING);
+    PLOG(PL_INFO, "SmfApp::SetUringCapture() io_uring capture enabled for ifIndex %u\n", cap.GetInterfaceIndex());
+    return true;
+}  // end SmfApp::SetUringCapture()
 
 bool SmfApp::RemoveCidElement(const char* deviceName, const char* ifaceName)
 {
@@ -5297,6 +6614,9 @@ void SmfApp::OnControlMsg(ProtoSocket& thePipe, ProtoSocket::Event theEvent)
         unsigned int len = 8191;
         if (thePipe.Recv(buffer, len))
         {
+            // The primary flow shard passes commands along to the others
+            if (flow_shards.IsActive() && flow_shards.IsPrimary())
+                ForwardToShards(buffer, len);
             // trim trailing white space if present
             char *end = buffer + len - 1;
             while(end > buffer && isspace((unsigned char)*end)) end--;
@@ -5513,15 +6833,18 @@ void SmfApp::OnControlMsg(ProtoSocket& thePipe, ProtoSocket::Event theEvent)
                     ss << "---------------- ---------- ---------- ---------- ---------- ---------- ---------- ---------- ---------- ----------\n";
                     while (NULL != (nextIface = iterator.GetNextItem()))
                     {
+                        // (counters are summed across any flow shards)
+                        SmfShard::Counters counters;
+                        GetInterfaceCounters(*nextIface, counters);
                         ss << std::left << std::setw(16) <<  nextIface->GetNameStr() << " ";
-                        ss << std::right << std::setw(10) << nextIface->GetFlowCount() << " ";
-                        ss << std::setw(10) << nextIface->GetRecvCount() << " ";
-                        ss << std::setw(10) << nextIface->GetMcastCount() << " ";
-                        ss << std::setw(10) << nextIface->GetSentCount() << " ";
-                        ss << std::setw(10) << nextIface->GetRetransmissionCount() << " ";
-                        ss << std::setw(10) << nextIface->GetForwardCount() << " ";
-                        ss << std::setw(10) << nextIface->GetDuplicateCount() << " ";
-                        ss << std::setw(10) << nextIface->GetAsymCount() << " ";
+                        ss << std::right << std::setw(10) << counters.flows << " ";
+                        ss << std::setw(10) << counters.recv << " ";
+                        ss << std::setw(10) << counters.mrcv << " ";
+                        ss << std::setw(10) << counters.sent << " ";
+                        ss << std::setw(10) << counters.retr << " ";
+                        ss << std::setw(10) << counters.fwd << " ";
+                        ss << std::setw(10) << counters.dups << " ";
+                        ss << std::setw(10) << counters.asym << " ";
                         ss << std::setw(10) << nextIface->GetQueueLength() << "\n";
                     }
                     unsigned int numBytes = ss.str().size();
@@ -5687,17 +7010,61 @@ void SmfApp::OnControlMsg(ProtoSocket& thePipe, ProtoSocket::Event theEvent)
                     bool comma = false;
                     while (NULL != (nextIface = iterator.GetNextItem()))
                     {
+                        // (the flows and recv thru asym counters are summed across any flow
+                        //  shards while the others are those of the primary shard)
+                        SmfShard::Counters counters;
+                        GetInterfaceCounters(*nextIface, counters);
                         ss << (comma ? "," : "") << "{";
                         ss <<  "\"interface\":\"" << nextIface->GetNameStr() << "\",";
-                        ss <<  "\"flows\":\"" << nextIface->GetFlowCount() <<  "\",";
-                        ss <<  "\"recv\":\"" << nextIface->GetRecvCount() <<  "\",";
-                        ss <<  "\"mrcv\":\"" << nextIface->GetMcastCount() << "\",";
-                        ss <<  "\"sent\":\"" << nextIface->GetSentCount() << "\",";
-                        ss <<  "\"retr\":\"" << nextIface->GetRetransmissionCount() << "\",";
-                        ss <<  "\"fwd\":\"" << nextIface->GetForwardCount() <<  "\",";
-                        ss <<  "\"dups\":\"" << nextIface->GetDuplicateCount() << "\",";
-                        ss <<  "\"asym\":\"" << nextIface->GetAsymCount() << "\",";
+                        if (flow_shards.IsActive())
+                            ss <<  "\"shards\":\"" << flow_shards.GetCount() <<  "\",";
+                        ss <<  "\"flows\":\"" << counters.flows <<  "\",";
+                        ss <<  "\"fchits\":\"" << nextIface->GetFlowCacheHitCount() <<  "\",";
+                        ss <<  "\"fcmisses\":\"" << nextIface->GetFlowCacheMissCount() <<  "\",";
+                        ss <<  "\"fevicts\":\"" << nextIface->GetFlowEvictionCount() <<  "\",";
+                        const SmfDpdWindow* dpdWindow = nextIface->GetDpdWindow();
+                        if (NULL != dpdWindow)
+                        {
+                            // Per-flow window sizes (as "<size>":"<flowCount>" pairs)
+                            unsigned int sizeCount[32];
+                            ss <<  "\"wmem\":\"" << dpdWindow->GetWindowSizeCounts(sizeCount) <<  "\",";
+                            ss <<  "\"wsizes\":{";
+                            bool sizeComma = false;
+                            for (unsigned int n = 0; n < 32; n++)
+                            {
+                                if (0 == sizeCount[n]) continue;
+                                ss << (sizeComma ? "," : "") << "\"" << (1UL << n) << "\":\"" << sizeCount[n] << "\"";
+                                sizeComma = true;
+                            }
+                            ss << "},";
+                        }
+                        if (SmfDpd::SHARED == nextIface->GetDpdType())
+                        {
+                            const SmfDpdHashTable& store = smf.GetSharedDpd();
+                            ss <<  "\"dpdstore\":\"" << store.GetEntryCount() << "/" << store.GetCapacity() <<  "\",";
+                        }
+                        const SmfDpdFilter* dpdFilter = nextIface->GetDpdFilter();
+                        if (NULL != dpdFilter)
+                        {
+                            ss <<  "\"dpdmem\":\"" << dpdFilter->GetMemorySize() <<  "\",";
+                            ss <<  "\"dpdfill\":\"" << dpdFilter->GetOccupancy() <<  "\",";
+                            ss <<  "\"dpdfp\":\"" << dpdFilter->GetFalsePositiveRate() <<  "\",";
+                        }
+                        ss <<  "\"recv\":\"" << counters.recv <<  "\",";
+                        ss <<  "\"mrcv\":\"" << counters.mrcv << "\",";
+                        ss <<  "\"sent\":\"" << counters.sent << "\",";
+                        ss <<  "\"retr\":\"" << counters.retr << "\",";
+                        ss <<  "\"fwd\":\"" << counters.fwd <<  "\",";
+                        ss <<  "\"dups\":\"" << counters.dups << "\",";
+                        ss <<  "\"asym\":\"" << counters.asym << "\",";
                         ss <<  "\"queue\":\"" << nextIface->GetQueueLength() << "\"";
+                        InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(nextIface->GetExtension());
+                        if ((NULL != mech) && mech->TxPipelineActive())
+                        {
+                            ss << ",\"txring\":\"" << mech->GetTxPipelineCount() << "/" << mech->GetTxPipelineSize() << "\",";
+                            ss <<  "\"txdrops\":\"" << mech->GetTxPipelineDropCount() << "\",";
+                            ss <<  "\"txerrs\":\"" << mech->GetTxPipelineErrorCount() << "\"";
+                        }
                         ss << "}";
                         comma = true;
                     }
@@ -5866,6 +7233,40 @@ void SmfApp::OnControlMsg(ProtoSocket& thePipe, ProtoSocket::Event theEvent)
     }
 }  // end SmfApp::OnControlMsg()
 
+// Passes a control message along to the other flow shards' control pipes, except
+// for "smfPkt" messages and status queries that are handled by the primary only
+// (the "stats" and "jsonStats" counters include the other shards' published counters)
+void SmfApp::ForwardToShards(const char* msg, unsigned int msgLen)
+{
+    static const char* const PRIMARY_ONLY[] =
+    {
+        "smfPkt", "smfServerStart", "jsonVersion", "ping", "stats", "jsonInfo", "info",
+        "jsonStats", "interfaces", "interfacesj", "brfgroups", "brfgroupsj", "groups", "groupsj",
+        NULL
+    };
+    unsigned int cmdLen = 0;
+    while ((cmdLen < msgLen) && ('\0' != msg[cmdLen]) && !isspace((unsigned char)msg[cmdLen])) cmdLen++;
+    for (const char* const* cmd = PRIMARY_ONLY; NULL != *cmd; cmd++)
+    {
+        if ((strlen(*cmd) == cmdLen) && !strncmp(*cmd, msg, cmdLen))
+            return;
+    }
+    for (unsigned int i = 1; i < flow_shards.GetCount(); i++)
+    {
+        char pipeName[160];
+        snprintf(pipeName, 160, "%s_%u", control_pipe_name, i);
+        if (!shard_pipe.Connect(pipeName))
+        {
+            PLOG(PL_ERROR, "SmfApp::ForwardToShards() error: unable to connect to flow shard \"%s\"\n", pipeName);
+            continue;
+        }
+        unsigned int numBytes = msgLen;
+        if (!shard_pipe.Send(msg, numBytes))
+            PLOG(PL_ERROR, "SmfApp::ForwardToShards() error sending to flow shard \"%s\"\n", pipeName);
+        shard_pipe.Close();
+    }
+}  // end SmfApp::ForwardToShards()
+
 #ifdef MNE_SUPPORT
 bool SmfApp::MneIsBlocking(const char* macAddr) const
 {
@@ -6412,6 +7813,7 @@ void SmfApp::OnPktOutput(ProtoChannel&              theChannel,
         if (!vif.InputNotification()) break;
         numBytes = BUFFER_MAX - BUFFER_RESERVE;  // reset "numBytes" for next vif.Read() call
     }  // end while (vif.Read())
+    FlushTxBatches();
     //  (Also opportunity to do multicast mirror, etc)
 }  // end SmfApp::OnPktOutput()
 
@@ -6428,12 +7830,14 @@ void SmfApp::OnPktCapture(ProtoChannel&              theChannel,
         //       (i.e. not a multiple of 4 (sizeof(UINT32))
         //       This gives us a properly aligned buffer for 32-bit aligned IP packets
         //      (The 256*sizeof(UINT32) bytes are for potential "smfPkt" message header use)
-        UINT32  alignedBuffer[BUFFER_MAX/sizeof(UINT32)];
-        UINT16* ethBuffer = ((UINT16*)(alignedBuffer+256)) + 1; // offset by 2-bytes so IP content is 32-bit aligned
+        //       Packets are read into the "inbound_batch" frame buffers and handled a batch at a time.
         const unsigned int ETHER_BYTES_MAX = (BUFFER_MAX - 256*sizeof(UINT32) - 2);
+        unsigned int batchCount = 0;
         for (;;)
         {
             // Read in and handle all inbound captured packets
+            UINT32* alignedBuffer = inbound_batch[batchCount].aligned_buffer;
+            UINT16* ethBuffer = ((UINT16*)(alignedBuffer+256)) + 1; // offset by 2-bytes so IP content is 32-bit aligned
             unsigned int numBytes = ETHER_BYTES_MAX;
             char* recvBuffer = (char*)ethBuffer;
             if (ProtoNet::IFACE_GRE == cap.GetInterfaceType())
@@ -6460,16 +7864,23 @@ void SmfApp::OnPktCapture(ProtoChannel&              theChannel,
             {
                 // Create placeholder Ethernet header for packet received via GRE tunnel
                 // Note the src/dst MAC addresses will be null for now
-                // Note HandleInboundPacket() will populate Ethernet src/dst header fields later as needed
+                // Note PrepareInboundFrame() will populate Ethernet src/dst header fields later as needed
                 ProtoPktETH ethPkt;
                 ethPkt.InitIntoBuffer(ethBuffer, 14);
                 ethPkt.SetType(ProtoPktETH::IP);
                 ethPkt.SetPayloadLength(numBytes);
                 numBytes += 14;
             }
-            PLOG(PL_DETAIL, "SmfApp::OnPktCapture() calling HandleInboundPacket\n");
-            HandleInboundPacket(alignedBuffer, numBytes, cap);
+            inbound_batch[batchCount].num_bytes = numBytes;
+            if (++batchCount == INBOUND_BATCH_MAX)
+            {
+                PLOG(PL_DETAIL, "SmfApp::OnPktCapture() calling HandleInboundBatch\n");
+                HandleInboundBatch(batchCount, cap);
+                batchCount = 0;
+            }
         }  // end while(1)  (reading ProtoTap device loop)
+        if (0 != batchCount) HandleInboundBatch(batchCount, cap);
+        FlushTxBatches();
     }
     else if (ProtoChannel::NOTIFY_OUTPUT == notifyType)
     {
@@ -6479,10 +7890,13 @@ void SmfApp::OnPktCapture(ProtoChannel&              theChannel,
         ASSERT(NULL != iface);
         InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
         mech->SetOutputNotification(false);
+        if (mech->TxPipelineActive()) return;  // (tx thread handles output)
         ProtoVif* vif = mech->GetProtoVif();
         ProtoTimer& txTimer = mech->GetTxTimer();
         ASSERT(!txTimer.IsActive());
         if (0.0 == mech->GetTxRateLimit()) return;  // rate is zero, so don't send
+        // Any staged tx batch frames go first (FlushTxBatch() restarts output notification if still blocked)
+        if (!mech->FlushTxBatch()) return;
         // Send as many pending queued packets as we can ...
         // (Note SendFrame() polls "vif" (if applicable) for more
         while (!iface->QueueIsEmpty())
@@ -6492,8 +7906,10 @@ void SmfApp::OnPktCapture(ProtoChannel&              theChannel,
             // Note SendFrame() will re-enqueue frame and
             // restart output notification if blocked
             SendFrame(*iface, (char*)frame->GetBuffer(), frame->GetLength());
+            pkt_pool.Put(*frame);
             if (mech->OutputNotification() || txTimer.IsActive() || (0.0 == mech->GetTxRateLimit())) break;
         }
+        FlushTxBatches();
         if ((NULL != vif) && !vif->InputNotification())
         {
             if (iface->IsQueuing())
@@ -6511,10 +7927,136 @@ void SmfApp::OnPktCapture(ProtoChannel&              theChannel,
      }
 }  // end SmfApp::OnPktCapture()
 
+// Input notification for a TPACKET_V3 mmap ring (SmfRing) cid element.  All of the
+// frames in the ring's retired blocks are handled without a per-frame system call.
+// Each frame is still copied into an inbound batch buffer since HandleInboundBatch()
+// modifies frames in place and needs the headroom for possible encapsulation.
+void SmfApp::OnRingCapture(ProtoChannel&              theChannel,
+                           ProtoChannel::Notification notifyType)
+{
+    if (ProtoChannel::NOTIFY_INPUT != notifyType) return;
+    SmfRing& ring = static_cast<SmfRing&>(theChannel);
+    ProtoCap* cap = reinterpret_cast<ProtoCap*>((void*)ring.GetUserData());
+    ASSERT(NULL != cap);
+    bool isGRE = (ProtoNet::IFACE_GRE == cap->GetInterfaceType());
+    // (See the buffer alignment notes in OnPktCapture() above)
+    const unsigned int ETHER_BYTES_MAX = (BUFFER_MAX - 256*sizeof(UINT32) - 2);
+    const char* frame;
+    unsigned int frameLength;
+    unsigned int batchCount = 0;
+    while (ring.GetNextFrame(frame, frameLength))
+    {
+        UINT32* alignedBuffer = inbound_batch[batchCount].aligned_buffer;
+        UINT16* ethBuffer = ((UINT16*)(alignedBuffer+256)) + 1; // offset by 2-bytes so IP content is 32-bit aligned
+        char* recvBuffer = (char*)ethBuffer;
+        unsigned int numBytes = ETHER_BYTES_MAX;
+        if (isGRE)
+        {
+            recvBuffer += 14;
+            numBytes -= 14;
+        }
+        if (frameLength > numBytes)
+        {
+            PLOG(PL_WARN, "SmfApp::OnRingCapture() warning: oversized frame (%u bytes) ignored\n", frameLength);
+            continue;
+        }
+        memcpy(recvBuffer, frame, frameLength);
+        numBytes = frameLength;
+        if (isGRE)
+        {
+            // Create placeholder Ethernet header for packet received via GRE tunnel
+            // (PrepareInboundFrame() will populate Ethernet src/dst header fields later as needed)
+            ProtoPktETH ethPkt;
+            ethPkt.InitIntoBuffer(ethBuffer, 14);
+            ethPkt.SetType(ProtoPktETH::IP);
+            ethPkt.SetPayloadLength(numBytes);
+            numBytes += 14;
+        }
+        inbound_batch[batchCount].num_bytes = numBytes;
+        if (++batchCount == INBOUND_BATCH_MAX)
+        {
+            HandleInboundBatch(batchCount, *cap);
+            batchCount = 0;
+        }
+    }
+    if (0 != batchCount) HandleInboundBatch(batchCount, *cap);
+    FlushTxBatches();
+}  // end SmfApp::OnRingCapture()
+
+// Notifications for an AF_XDP (SmfXdpSocket) cid element.  Received frames are handled in
+// place within their UMEM frame (the UMEM frame headroom matches our "alignedBuffer" layout)
+// so they can be forwarded by descriptor to other AF_XDP interfaces without copying.
+void SmfApp::OnXdpInput(ProtoChannel&              theChannel,
+                        ProtoChannel::Notification notifyType)
+{
+    SmfXdpSocket& xsk = static_cast<SmfXdpSocket&>(theChannel);
+    ProtoCap* cap = reinterpret_cast<ProtoCap*>((void*)xsk.GetUserData());
+    ASSERT(NULL != cap);
+    if (ProtoChannel::NOTIFY_INPUT == notifyType)
+    {
+        UINT32  alignedBuffer[BUFFER_MAX/sizeof(UINT32)];  // used only if in place handling isn't possible
+        UINT16* ethBuffer = ((UINT16*)(alignedBuffer+256)) + 1;
+        const unsigned int ETHER_BYTES_MAX = (BUFFER_MAX - 256*sizeof(UINT32) - 2);
+        char* frame;
+        unsigned int frameLength;
+        while (xsk.GetNextFrame(frame, frameLength))
+        {
+            unsigned int offset = (unsigned int)(xsk.GetUmem().GetAddress(frame) % SmfXdpUmem::FRAME_SIZE);
+            if ((offset >= SmfXdpUmem::FRAME_HEADROOM) && (2 == (offset & 0x03)) &&
+                ((offset + frameLength + 256) <= SmfXdpUmem::FRAME_SIZE))
+            {
+                HandleInboundPacket((UINT32*)(frame - SmfXdpUmem::FRAME_HEADROOM), frameLength, *cap);
+            }
+            else if (frameLength <= ETHER_BYTES_MAX)
+            {
+                memcpy(ethBuffer, frame, frameLength);
+                HandleInboundPacket(alignedBuffer, frameLength, *cap);
+            }
+            xsk.ReleaseFrame(frame);
+        }
+        xsk.EndReceive();
+        FlushTxBatches();
+    }
+    else if (ProtoChannel::NOTIFY_OUTPUT == notifyType)
+    {
+        // Our tx ring has room again, so service the interface queue as for the ProtoCap
+        xsk.StopOutputNotification();
+        OnPktCapture(*cap, ProtoChannel::NOTIFY_OUTPUT);
+    }
+}  // end SmfApp::OnXdpInput()
+
+// Input notification for the shared io_uring (SmfUring) used by CID_URING elements.  One
+// notification drains the receive completions for all of those interfaces.  Received
+// frames are handled in place within their buffer (the buffer headroom matches our
+// "alignedBuffer" layout) and then returned to the kernel's provided buffer pool.
+void SmfApp::OnUringInput(ProtoChannel&              theChannel,
+                          ProtoChannel::Notification notifyType)
+{
+    if (ProtoChannel::NOTIFY_INPUT != notifyType) return;
+    SmfUring& theUring = static_cast<SmfUring&>(theChannel);
+    theUring.BeginReceive();
+    char* frame;
+    unsigned int frameLength;
+    const void* userData;
+    while (theUring.GetNextFrame(frame, frameLength, userData))
+    {
+        ProtoCap* cap = reinterpret_cast<ProtoCap*>((void*)userData);
+        ASSERT(NULL != cap);
+        HandleInboundPacket((UINT32*)(frame - SmfUring::FRAME_HEADROOM), frameLength, *cap);
+        theUring.ReleaseFrame(frame);
+    }
+    theUring.EndReceive();
+    FlushTxBatches();
+}  // end SmfApp::OnUringInput()
+
 // Forward IP packet encapsulated in ETH frame using "ProtoCap" (i.e. pcap or similar) device
-bool SmfApp::ForwardFrame(unsigned int dstCount, unsigned int* dstIfIndices, char* frameBuffer, unsigned int frameLength)
+bool SmfApp::ForwardFrame(unsigned int dstCount, unsigned int* dstIfIndices, char* frameBuffer, unsigned int frameLength,
+                          const SmfPktInfo* pktInfo)
 {
     bool result = false;
+    // The same frame content is sent to all destinations, so any interface queues
+    // can share a single copy of it (see GetFramePacket())
+    if (dstCount > 1) share_frame = frameBuffer;
     for (unsigned int i = 0; i < dstCount; i++)
     {
         // TBD - perhaps we should have a more efficient way to dereference the dstIface ???
@@ -6522,11 +8064,40 @@ bool SmfApp::ForwardFrame(unsigned int dstCount, unsigned int* dstIfIndices, cha
         int dstIfIndex = dstIfIndices[i];
         Smf::Interface* dstIface = smf.GetInterface(dstIfIndex);
         ASSERT(NULL != dstIface);
-        result |= SendFrame(*dstIface, frameBuffer, frameLength);
+        // The frame buffer can be handed off (e.g., AF_XDP zero-copy) for the last destination only
+        bool handoff = ((i + 1) == dstCount);
+        result |= SendFrame(*dstIface, frameBuffer, frameLength, handoff, pktInfo);
     }  // end for (...)
+    if (NULL != share_buffer)
+    {
+        share_buffer->Release();
+        share_buffer = NULL;
+    }
+    share_frame = NULL;
     return result;
 }  // end SmfApp::ForwardFrame()
 
+SmfPacket* SmfApp::GetFramePacket(const char* frameBuffer, unsigned int frameLength)
+{
+    SmfPacket* pkt = pkt_pool.GetPacket();
+    if (NULL == pkt) return NULL;
+    if ((frameBuffer == share_frame) && (NULL != share_buffer))
+    {
+        // Reference the copy already queued for another destination
+        // (Note the src MAC addr is set upon transmission for each interface)
+        pkt->ShareBuffer(*share_buffer, frameLength);
+        return pkt;
+    }
+    memcpy(pkt->AccessBuffer(), frameBuffer, frameLength);
+    pkt->SetLength(frameLength);
+    if (frameBuffer == share_frame)
+    {
+        share_buffer = pkt->GetPacketBuffer();
+        share_buffer->Retain();
+    }
+    return pkt;
+}  // end SmfApp::GetFramePacket()
+
 bool SmfApp::IsPriorityFrame(UINT32* frameBuffer, unsigned int frameLength)
 {
     ProtoPktETH ethPkt(frameBuffer, frameLength);
@@ -6571,6 +8142,11 @@ bool SmfApp::IsPriorityFrame(UINT32* frameBuffer, unsigned int frameLength)
         default:
             return false;
     }
+    return IsPriorityProtocol(protocol);
+}  // end SmfApp::IsPriorityFrame()
+
+bool SmfApp::IsPriorityProtocol(ProtoPktIP::Protocol protocol)
+{
     switch (protocol)
     {
         case ProtoPktIP::OSPF:
@@ -6579,7 +8155,7 @@ bool SmfApp::IsPriorityFrame(UINT32* frameBuffer, unsigned int frameLength)
             break;
     }
     return false;
-}  // end SmfApp::IsPriorityFrame()
+}  // end SmfApp::IsPriorityProtocol()
 
 // Send a single frame via a single interface (this method used for ElasticMulticast control plane messaging)
 bool SmfApp::SendFrame(unsigned int ifaceIndex, char* frameBuffer, unsigned int frameLength)
@@ -6590,9 +8166,46 @@ bool SmfApp::SendFrame(unsigned int ifaceIndex, char* frameBuffer, unsigned int
 }  // end SmfApp::SendFrame()
 
 // Forward IP packet encapsulated in ETH frame using "ProtoCap" (i.e. pcap or similar) device
-bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int frameLength)
+bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int frameLength, bool handoff,
+                       const SmfPktInfo* pktInfo)
 {
     InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface.GetExtension());
+    if (mech->TxPipelineActive())
+    {
+        // Hand a copy to the interface tx thread (that also handles any rate limit)
+        // Note the copy isn't shared with other destinations since the tx thread
+        // sets the source MAC address in place.
+        SmfPacket* pkt = pkt_pool.GetPacket();
+        if (NULL == pkt) return false;
+        memcpy(pkt->AccessBuffer(), frameBuffer, frameLength);
+        pkt->SetLength(frameLength);
+        if (mech->EnqueueTxPipeline(*pkt))
+        {
+            iface.IncrementSentCount();
+            return true;
+        }
+        // The tx ring is full (or packets are already waiting for it), so
+        // enqueue the packet, if queuing, for the tx timer to move it over
+        if (iface.IsQueuing())
+        {
+            bool priority = (NULL != pktInfo) ?
+                                IsPriorityProtocol((ProtoPktIP::Protocol)pktInfo->protocol) :
+                                IsPriorityFrame((UINT32*)pkt->GetBuffer(), pkt->GetLength());
+            if (iface.EnqueuePacket(*pkt, priority, &pkt_pool))
+            {
+                if (!mech->GetTxTimer().IsActive())
+                {
+                    mech->GetTxTimer().SetInterval(1.0e-03);
+                    ActivateTimer(mech->GetTxTimer());
+                }
+                return true;
+            }
+            PLOG(PL_WARN, "SmfApp::SendFrame() warning: interface queue is full\n");
+        }
+        mech->IncrementTxPipelineDropCount();
+        pkt_pool.Put(*pkt);
+        return false;
+    }
     // Iterate over tx-enabled CidElements
     ProtoVif* vif = mech->GetProtoVif();
     if (mech->OutputNotification() || mech->GetTxTimer().IsActive() || (0.0 == mech->GetTxRateLimit()))
@@ -6603,12 +8216,12 @@ bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int fr
         {
             // Enqueue packet for later service by pcap output notification or tx_timer
             // TBD - write received packets directly to an SmfPacket buffer to avoid copying done here
-            SmfPacket* pkt = pkt_pool.GetPacket();
+            SmfPacket* pkt = GetFramePacket(frameBuffer, frameLength);
             if (NULL != pkt)
             {
-                memcpy(pkt->AccessBuffer(), frameBuffer, frameLength);
-                pkt->SetLength(frameLength);
-                bool priority = IsPriorityFrame(pkt->AccessBuffer(), pkt->GetLength());
+                bool priority = (NULL != pktInfo) ?
+                                    IsPriorityProtocol((ProtoPktIP::Protocol)pktInfo->protocol) :
+                                    IsPriorityFrame((UINT32*)pkt->GetBuffer(), pkt->GetLength());
                 if (iface.EnqueuePacket(*pkt, priority, &pkt_pool))
                 {
                     if (iface.QueueIsFull() && (NULL != vif) && vif->InputNotification())
@@ -6625,7 +8238,7 @@ bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int fr
     }
     else
     {
-        InterfaceMechanism::TxStatus txStatus = mech->SendFrame(frameBuffer, frameLength);
+        InterfaceMechanism::TxStatus txStatus = mech->SendFrame(frameBuffer, frameLength, handoff);
         if (InterfaceMechanism::TX_OK == txStatus)     
         {
             double txRateLimit = mech->GetTxRateLimit();
@@ -6640,6 +8253,12 @@ bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int fr
                     vif->StopInputNotification();
                 }
             }
+            else if (mech->TxBatchPending())
+            {
+                // Frame was staged for batched transmission
+                tx_batch_pending = true;
+                if (!tx_batch_timer.IsActive()) ActivateTimer(tx_batch_timer);
+            }
             iface.IncrementSentCount();
             return true;
         }
@@ -6664,12 +8283,12 @@ bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int fr
             {
                 // Ennqueue (or re-enqueue) the packet for later service
                 // TBD - write received packets directly to an SmfPacket buffer to avoid copying done here
-                SmfPacket* pkt = pkt_pool.GetPacket();
+                SmfPacket* pkt = GetFramePacket(frameBuffer, frameLength);
                 if (NULL != pkt)
                 {
-                    memcpy(pkt->AccessBuffer(), frameBuffer, frameLength);
-                    pkt->SetLength(frameLength);
-                    bool priority = IsPriorityFrame(pkt->AccessBuffer(), pkt->GetLength());
+                    bool priority = (NULL != pktInfo) ?
+                                        IsPriorityProtocol((ProtoPktIP::Protocol)pktInfo->protocol) :
+                                        IsPriorityFrame((UINT32*)pkt->GetBuffer(), pkt->GetLength());
                     if (iface.EnqueuePacket(*pkt, priority, &pkt_pool))
                     {
                         if (iface.QueueIsFull() && (NULL != vif) && vif->InputNotification())
@@ -6694,6 +8313,58 @@ bool SmfApp::SendFrame(Smf::Interface& iface, char* frameBuffer, unsigned int fr
     return false;
 }  // end SmfApp::SendFrame()
 
+void SmfApp::FlushTxBatches()
+{
+    if (!tx_batch_pending) return;
+    tx_batch_pending = false;
+    Smf::InterfaceList::Iterator iterator(smf.AccessInterfaceList());
+    Smf::Interface* iface;
+    while (NULL != (iface = iterator.GetNextItem()))
+    {
+        InterfaceMechanism* mech = static_cast<InterfaceMechanism*>(iface->GetExtension());
+        // Note blocked batches are resumed via output notification (see OnPktCapture())
+        // and tx pipeline threads flush their own batches
+        if ((NULL != mech) && !mech->TxPipelineActive() && mech->TxBatchPending()) mech->FlushTxBatch();
+    }
+}  // end SmfApp::FlushTxBatches()
+
+void SmfApp::GetInterfaceCounters(Smf::Interface& iface, SmfShard::Counters& counters)
+{
+    counters.if_index = iface.GetIndex();
+    counters.flows = iface.GetFlowCount();
+    counters.recv = iface.GetRecvCount();
+    counters.mrcv = iface.GetMcastCount();
+    counters.sent = iface.GetSentCount();
+    counters.retr = iface.GetRetransmissionCount();
+    counters.fwd = iface.GetForwardCount();
+    counters.dups = iface.GetDuplicateCount();
+    counters.asym = iface.GetAsymCount();
+    if (flow_shards.IsPrimary())
+        flow_shards.AddShardCounters(iface.GetIndex(), counters);
+}  // end SmfApp::GetInterfaceCounters()
+
+// Non-primary flow shards periodically publish their interface counters
+// (so "stats" replies may lag the other shards' traffic by up to a second)
+bool SmfApp::OnShardStatsTimeout(ProtoTimer& /*theTimer*/)
+{
+    SmfShard::Counters counters[SmfShard::IFACE_COUNT_MAX];
+    unsigned int count = 0;
+    Smf::InterfaceList::Iterator iterator(smf.AccessInterfaceList());
+    Smf::Interface* iface;
+    while ((count < SmfShard::IFACE_COUNT_MAX) && (NULL != (iface = iterator.GetNextItem())))
+        GetInterfaceCounters(*iface, counters[count++]);
+    flow_shards.PublishCounters(counters, count);
+    return true;
+}  // end SmfApp::OnShardStatsTimeout()
+
+bool SmfApp::OnTxBatchTimeout(ProtoTimer& /*theTimer*/)
+{
+    // Note the tx_batch_timer is left to expire instead of being deactivated upon
+    // each FlushTxBatches() call, so it's usually a no-op by the time it fires
+    FlushTxBatches();
+    return true;
+}  // end SmfApp::OnTxBatchTimeout()
+
 // Divert IP packet encapsulated in ETH frame to external process using "ProtoPipe"
 bool SmfApp::ForwardFrameToTap(unsigned int srcIfIndex, unsigned int dstCount, unsigned int* dstIfIndices, char* frameBuffer, unsigned int frameLength)
 {
@@ -6755,40 +8426,116 @@ void SmfApp::HandleIGMP(ProtoPktIGMP igmpMsg, Smf::Interface& iface, bool inboun
     }
 }  // end SmfApp::HandleIGMP()
 
+SmfApp::InboundFrame::InboundFrame()
+ : aligned_buffer(NULL), eth_buffer(NULL), num_bytes(0), is_ip(false),
+   is_unicast(false), is_control(false), result(false)
+{
+    dst_if_array = dst_if_indices;
+    dst_if_array_size = IF_COUNT_MAX;
+}
+
 // returns "true" if packet is destined for local host.  This will be the case for multicast packets
 // and unicast packets destined for the local host.
 // TODO: Currently the unicast packets follow the former path through OnPktIntercept() and are NOT processed
 // through HandleInboundPacket()
 bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, ProtoCap& srcCap)
+{
+    InboundFrame frame;
+    frame.aligned_buffer = alignedBuffer;
+    frame.num_bytes = numBytes;
+    if (!PrepareInboundFrame(frame, srcCap)) return false;
+    if (frame.is_ip)
+    {
+        // Here is where the SMF forwarding process is done
+        Smf::Interface* srcIface = reinterpret_cast<Smf::Interface*>((void*)srcCap.GetUserData());
+        PLOG(PL_DETAIL, "SmfApp::HandleInboundPacket(): Calling Process Packet \n" );
+        frame.dst_count = smf.ProcessPacket(frame.ip_pkt, frame.prev_hop_addr, frame.dst_mac_addr, *srcIface,
+                                            frame.dst_if_indices, IF_COUNT_MAX, frame.eth_pkt, false, &frame.recv_dup,
+                                            &frame.pkt_info);
+        PLOG(PL_DETAIL, "SmfApp::HandleInboundPacket(): Called ProcessPacket, return value  = %d \n", frame.dst_count);
+    }
+    return CompleteInboundFrame(frame, srcCap);
+}  // end SmfApp::HandleInboundPacket()
+
+// Handles the first "count" frames of the "inbound_batch" received via "srcCap".  The IP
+// packets are processed together with Smf::ProcessPacketBatch() and then each frame is
+// completed (written to vif, forwarded, etc) in order.  A control (IGMP or elastic multicast)
+// frame ends the current batch segment and is handled on its own.
+void SmfApp::HandleInboundBatch(unsigned int count, ProtoCap& srcCap)
+{
+    Smf::Interface* srcIface = reinterpret_cast<Smf::Interface*>((void*)srcCap.GetUserData());
+    Smf::BatchPacket* ipBatch[INBOUND_BATCH_MAX];
+    bool ready[INBOUND_BATCH_MAX];
+    unsigned int ipCount = 0;
+    unsigned int start = 0;  // first frame of the current segment
+    for (unsigned int i = 0; i < count; i++)
+    {
+        InboundFrame& frame = inbound_batch[i];
+        ready[i] = PrepareInboundFrame(frame, srcCap);
+        if (!ready[i]) continue;
+        if (frame.is_control)
+        {
+            // A control frame may change state used for the frames after it (e.g., group
+            // membership) or refer to the frames before it (e.g., an EM_NACK for a frame
+            // cached upon completion), so the frames before it are completed first
+            if (0 != ipCount) smf.ProcessPacketBatch(ipBatch, ipCount, *srcIface);
+            for (; start < i; start++)
+            {
+                if (ready[start]) CompleteInboundFrame(inbound_batch[start], srcCap);
+            }
+            ipBatch[0] = &frame;
+            smf.ProcessPacketBatch(ipBatch, 1, *srcIface);
+            CompleteInboundFrame(frame, srcCap);
+            start = i + 1;
+            ipCount = 0;
+        }
+        else if (frame.is_ip)
+        {
+            ipBatch[ipCount++] = &frame;
+        }
+    }
+    if (0 != ipCount) smf.ProcessPacketBatch(ipBatch, ipCount, *srcIface);
+    for (; start < count; start++)
+    {
+        if (ready[start]) CompleteInboundFrame(inbound_batch[start], srcCap);
+    }
+}  // end SmfApp::HandleInboundBatch()
+
+// Maps the Ethernet frame (and IP packet, if applicable) of "frame.num_bytes" in the
+// "frame.aligned_buffer" and does the checks done prior to SMF forwarding.
+// Returns "false" if the frame is to be ignored.
+bool SmfApp::PrepareInboundFrame(InboundFrame& frame, ProtoCap& srcCap)
 {
     // NOTE:  The "alignedBuffer" has 256*4 + 2 bytes of extra space at head for an "smfPkt" header to be
     //        be prepended by "ForwardToTap()" if needed.  The "ethBuffer" is a UINT16 pointer offset
     //        by 2 from the "alignedBuffer" so the Ethernet IP packet payload is properly aligned
     //        (The pointers and max sizes here take all of this into account)
-    UINT16* ethBuffer = ((UINT16*)(alignedBuffer+256)) + 1; // offset by 2-bytes so IP content is 32-bit aligned
+    UINT32* alignedBuffer = frame.aligned_buffer;
+    frame.eth_buffer = ((UINT16*)(alignedBuffer+256)) + 1; // offset by 2-bytes so IP content is 32-bit aligned
+    frame.dst_count = 0;
+    frame.recv_dup = false;  // used to check for duplicate receptions for "device" interfaces
+    frame.is_ip = false;
+    frame.is_unicast = false;
+    frame.is_control = false;
+    frame.result = false;
+    frame.pkt_info.Clear();
+    frame.prev_hop_addr.Invalidate();
+    frame.dst_mac_addr.Invalidate();
 
     const unsigned int ETHER_BYTES_MAX = (BUFFER_MAX - 256*sizeof(UINT32) - 2);
     // Map ProtoPktETH instance into buffer and init for processing
-    ProtoPktETH ethPkt((UINT32*)ethBuffer, ETHER_BYTES_MAX);
+    ProtoPktETH& ethPkt = frame.eth_pkt;
     UINT32* ipBuffer = (alignedBuffer + 256) + 4; // offset by ETHER header size + 2 bytes
     const unsigned int IP_BYTES_MAX = (ETHER_BYTES_MAX - 14);
-    ProtoPktIP ipPkt(ipBuffer, IP_BYTES_MAX);
-    bool result = false;
-    
-    
-        // Here is where the SMF forwarding process is done
-    //unsigned int srcIfIndex = srcIface.GetIndex();
-    unsigned int dstIfIndices[IF_COUNT_MAX];
-    int dstCount = 0;
-    ProtoAddress prevHopAddr;
-    ProtoAddress dstMacAddr;
-    if (!ethPkt.InitFromBuffer(numBytes))
+    ProtoPktIP& ipPkt = frame.ip_pkt;
+    ProtoAddress& prevHopAddr = frame.prev_hop_addr;
+    ProtoAddress& dstMacAddr = frame.dst_mac_addr;
+    if (!ethPkt.InitFromBuffer(frame.num_bytes, (UINT32*)frame.eth_buffer, ETHER_BYTES_MAX))
     {
         PLOG(PL_ERROR, "SmfApp::HandleInboundPacket() error: bad Ether frame\n");
         return false;
     }
     Smf::Interface* srcIface = reinterpret_cast<Smf::Interface*>((void*)srcCap.GetUserData());
-    unsigned int srcIfIndex = srcIface->GetIndex();    
     bool srcCapIsGRE = (ProtoNet::IFACE_GRE == srcCap.GetInterfaceType());
     if (srcCapIsGRE)
     {
@@ -6808,67 +8555,85 @@ bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, P
         }
     }
     
-#ifdef ELASTIC_MCAST
-    UINT8 trafficClass = 0;
-#endif // ELASTIC_MCAST
-    bool isDuplicate = false; // used to check for duplicate receptions for "device" interfaces
-    bool isUnicast = false;
     ProtoPktIP::Protocol protocol = ProtoPktIP::RESERVED;  // will be set if IP packet
     ProtoPktETH::Type ethType = (ProtoPktETH::Type)ethPkt.GetType();
     if (ethType == ProtoPktETH::ARP)
     {
-        result = true;
+        frame.result = true;
     }
     else if ((ProtoPktETH::IP == ethType) || (ProtoPktETH::IPv6 == ethType))
     {
-        result = true;
+        frame.result = true;
          // Only process IP packets for forwarding
-        if (!ipPkt.InitFromBuffer(ethPkt.GetPayloadLength()))
+        if (!ipPkt.InitFromBuffer(ethPkt.GetPayloadLength(), ipBuffer, IP_BYTES_MAX))
         {
             PLOG(PL_ERROR, "SmfApp::HandleInboundPacket() error: bad IP packet?!\n");
             return false;
         }
-        unsigned char version = ipPkt.GetVersion();
-        ProtoAddress dstAddr;
-        if (4 == version)
-        {
-            ProtoPktIPv4 ip4Pkt(ipPkt);
-            ip4Pkt.GetDstAddr(dstAddr);
-            protocol = ip4Pkt.GetProtocol();
-#ifdef ELASTIC_MCAST
-            trafficClass = ip4Pkt.GetTOS();
-#endif // ELASTIC_MCAST
-        }
-        else if (6 == version)
-        {
-            ProtoPktIPv6 ip6Pkt(ipPkt);
-            ip6Pkt.GetDstAddr(dstAddr);
-            protocol = ip6Pkt.GetNextHeader();
-#ifdef ELASTIC_MCAST
-            trafficClass = ip6Pkt.GetTrafficClass();
-#endif // ELASTIC_MCAST
-        }
-        else
+        // Parse the IP header fields once for the later processing stages
+        SmfPktInfo& pktInfo = frame.pkt_info;
+        if (!pktInfo.InitFromPacket(ipPkt))
         {
             PLOG(PL_ERROR, "SmfApp::HandleInboundPacket() error: invalid IP version?!\n");
             return false;
         }
-        if (dstAddr.IsUnicast()) isUnicast = true;
+        protocol = (ProtoPktIP::Protocol)pktInfo.protocol;
+        if (pktInfo.DstIsUnicast()) frame.is_unicast = true;
         if (srcCapIsGRE)
         {
             // This packet came in from a GRE tunnel instead of Ethernet
             // so we can set the dst MAC addr if it's multicast
-            if (!isUnicast)
+            if (!frame.is_unicast)
             {
+                ProtoAddress dstAddr;
+                pktInfo.GetDstAddr(dstAddr);
                 dstMacAddr.GetEthernetMulticastAddress(dstAddr);
                 ethPkt.SetDstAddr(dstMacAddr);
             }
             // else dstMacAddr remains invalid for unicast packet received via GRE
         }
-        
+        // IGMP and elastic multicast control packets are handled in order
+        // with respect to the other frames of a batch (see HandleInboundBatch())
+        frame.is_control = (ProtoPktIP::IGMP == protocol);
+#ifdef ELASTIC_MCAST
+        if (!frame.is_control && (ProtoPktIP::UDP == protocol) && (4 == pktInfo.version))
+        {
+            ProtoAddress dstAddr;
+            pktInfo.GetDstAddr(dstAddr);
+            frame.is_control = dstAddr.HostIsEqual(ElasticMsg::ELASTIC_ADDR);
+        }
+#endif // ELASTIC_MCAST
+        frame.is_ip = true;
+    }  // end if/else ARP/IP
+    return true;
+}  // end SmfApp::PrepareInboundFrame()
+
+// Does the post SMF forwarding process handling (vif delivery, forwarding)
+// of a "frame" that was prepared and processed (if IP) as above
+bool SmfApp::CompleteInboundFrame(InboundFrame& frame, ProtoCap& srcCap)
+{
+    const unsigned int ETHER_BYTES_MAX = (BUFFER_MAX - 256*sizeof(UINT32) - 2);
+    UINT16* ethBuffer = frame.eth_buffer;
+    unsigned int numBytes = frame.num_bytes;
+    ProtoPktETH& ethPkt = frame.eth_pkt;
+    ProtoPktIP& ipPkt = frame.ip_pkt;
+    unsigned int* dstIfIndices = frame.dst_if_indices;
+    int dstCount = frame.dst_count;
+    bool isDuplicate = frame.recv_dup;
+    bool isUnicast = frame.is_unicast;
+#ifdef ELASTIC_MCAST
+    UINT8 trafficClass = frame.pkt_info.traffic_class;
+#endif // ELASTIC_MCAST
+    bool result = frame.result;
+    Smf::Interface* srcIface = reinterpret_cast<Smf::Interface*>((void*)srcCap.GetUserData());
+    unsigned int srcIfIndex = srcIface->GetIndex();    
+    bool srcCapIsGRE = (ProtoNet::IFACE_GRE == srcCap.GetInterfaceType());
+    if (frame.is_ip)
+    {
+        if (dstCount < 0) result = false;
         // Some IGMP snooping test code (TBD - handle IPv6 too)
         bool igmpSnoop = false;
-        if (igmpSnoop && (ProtoPktIP::IGMP == protocol))
+        if (igmpSnoop && (ProtoPktIP::IGMP == frame.pkt_info.protocol))
         {
             ProtoPktIPv4 ip4Pkt(ipPkt);
             ProtoPktIGMP igmpMsg(ip4Pkt.AccessPayload(), ip4Pkt.GetPayloadLength());
@@ -6877,11 +8642,6 @@ bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, P
             else
                 PLOG(PL_WARN, "SmfApp::HandleInboundPacket() warning: invalid IGMP message?!\n");
         }
-
-        PLOG(PL_DETAIL, "SmfApp::HandleInboundPacket(): Calling Process Packet \n" );
-        dstCount = smf.ProcessPacket(ipPkt, prevHopAddr, dstMacAddr, *srcIface, dstIfIndices, IF_COUNT_MAX, ethPkt, false, &isDuplicate);
-        PLOG(PL_DETAIL, "SmfApp::HandleInboundPacket(): Called ProcessPacket, return value  = %d \n", dstCount);
-        if (dstCount < 0) result = false;
         if (srcIface->IsEncapsulating() && (4 == ipPkt.GetVersion()))
         {
             // We need to check to see if we need to unpack the packet
@@ -6915,10 +8675,11 @@ bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, P
                         PLOG(PL_ERROR, "SmfApp::HandleInboundPacket() error: bad encapsulated IP packet\n");
                         return false;
                     }
+                    frame.pkt_info.InitFromPacket(ipPkt);
                 }
             }
         }  // end if (srcIFace.IsEncapsulating() ...
-    }  // end if/else ARP/IP
+    }  // end if (frame.is_ip)
    
      // Check if this is an "SMF Device" interface (i.e., coupled with a vif)
     // If this "srcIface" is part of an "SMF Device" (i.e., is a "vif"), we need to write a copy up to the
@@ -6995,7 +8756,7 @@ bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, P
             if (reliable)
                 smf.CachePacket(*dstIface, sequence, (char*)ethPkt.GetBuffer(), ethPkt.GetLength());
         }
-        if (!SendFrame(*dstIface, (char*)ethPkt.GetBuffer(), ethPkt.GetLength()))
+        if (!SendFrame(*dstIface, (char*)ethPkt.GetBuffer(), ethPkt.GetLength(), false, &frame.pkt_info))
         {
             char ifaceName[32], dstIfaceName[32];
             ifaceName[31] = dstIfaceName[31] = '\0';
@@ -7034,7 +8795,7 @@ bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, P
 #endif // _PROTO_DETOUR
         else
         {
-            if (!ForwardFrame(dstCount, dstIfIndices, (char*)ethPkt.GetBuffer(), ethPkt.GetLength()))
+            if (!ForwardFrame(dstCount, dstIfIndices, (char*)ethPkt.GetBuffer(), ethPkt.GetLength(), &frame.pkt_info))
             {
                 PLOG(PL_ERROR, "SmfApp::HandleInboundPacket() error: unable to forward packet via ProtoCap device\n");
             }
@@ -7042,7 +8803,7 @@ bool SmfApp::HandleInboundPacket(UINT32* alignedBuffer, unsigned int numBytes, P
     }  // end if (dstCount > 0)
 #endif  // if/else ELASTIC_MCAST
     return result;
-}  // end SmfApp::HandleInboundPacket()
+}  // end SmfApp::CompleteInboundFrame()
 
 void SmfApp::MonitorEventHandler(ProtoChannel&               theChannel,
                                  ProtoChannel::Notification  theNotification)
@@ -7566,6 +9327,7 @@ void SmfApp::OnPktIntercept(ProtoChannel&               theChannel,
 		        }
             }
         }
+        FlushTxBatches();
     }
 }  // end SmfApp::OnPktIntercept()
 
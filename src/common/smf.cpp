@@ -6,15 +6,19 @@
 #include "protoString.h"
 #include "smfHashMD5.h"
 #include "smfHashSHA1.h"
+#include "smfHashXXH3.h"
+#include "smfHashSipHash.h"
 
 #include "protoPktETH.h"
 #include "protoPktIP.h"
 #include "protoNet.h"
 #include <random>
+#include <time.h>  // for time()
 
 
 const unsigned int Smf::DEFAULT_AGE_MAX = 10;  // 10 seconds
 const unsigned int Smf::PRUNE_INTERVAL = 5;    // 5 seconds
+const unsigned int Smf::SHARED_DPD_CAPACITY_DEFAULT = 32768;  // packet ids
 
 #ifdef ELASTIC_MCAST
 const unsigned int REPAIR_AGE_MAX = 30*1000000;  // 30 seconds in microseconds
@@ -86,33 +90,117 @@ Smf::Interface::~Interface()
     Destroy();
 }
 
-bool Smf::Interface::Init(bool useWindow)
+bool Smf::Interface::Init(SmfDpd::Type dpdType, const SmfDpd::Params& dpdParams)
 {
     Destroy();
-    if (useWindow)
+    return SetDpdType(dpdType, dpdParams);
+}  // end Smf::Interface::Init()
+
+bool Smf::Interface::SetDpdType(SmfDpd::Type dpdType, const SmfDpd::Params& dpdParams)
+{
+    SmfDpd* dpd = NULL;
+    switch (dpdType)
     {
-        SmfDpdWindow* dpdWindow = new SmfDpdWindow;
-        if (NULL != dpdWindow)
+        case SmfDpd::WINDOW:
+        {
+            SmfDpdWindow* dpdWindow = new SmfDpdWindow;
+            if (NULL != dpdWindow)
+            {
+                if (!dpdWindow->Init(SmfDpdWindow::SIZE_DEFAULT, SmfDpdWindow::SIZE_DEFAULT,
+                                     dpdParams.window_size_min, dpdParams.window_size_max))
+                {
+                    PLOG(PL_ERROR, "Smf::Interface::SetDpdType() error: dpdWindow init failed: %s\n", GetErrorString());
+                    delete dpdWindow;
+                    return false;
+                }
+                dpdWindow->SetFlowBudget(dpdParams.flow_budget);
+                dpdWindow->SetStateFile(dpdParams.state_file, GetIndex());
+                dpd = static_cast<SmfDpd*>(dpdWindow);
+            }
+            break;
+        }
+        case SmfDpd::FILTER:
+        {
+            SmfDpdFilter* dpdFilter = new SmfDpdFilter;
+            if (NULL != dpdFilter)
+            {
+                if (!dpdFilter->Init(dpdParams.filter_memory, dpdParams.filter_fp_rate))
+                {
+                    PLOG(PL_ERROR, "Smf::Interface::SetDpdType() error: dpdFilter init failed\n");
+                    delete dpdFilter;
+                    return false;
+                }
+                dpd = static_cast<SmfDpd*>(dpdFilter);
+            }
+            break;
+        }
+        case SmfDpd::SHARED:
         {
-            if (!dpdWindow->Init(1024, 1024))
+            if (NULL == dpdParams.shared_store)
             {
-                PLOG(PL_ERROR, "Smf::Interface::Init() error: dpdWindow init failed: %s\n", GetErrorString());
+                PLOG(PL_ERROR, "Smf::Interface::SetDpdType() error: no shared DPD store\n");
                 return false;
             }
-            dup_detector = static_cast<SmfDpd*>(dpdWindow);
+            SmfDpdShared* dpdShared = new SmfDpdShared(*dpdParams.shared_store);
+            if (NULL != dpdShared)
+            {
+                if (!dpdShared->Init())
+                {
+                    PLOG(PL_ERROR, "Smf::Interface::SetDpdType() error: dpdShared init failed\n");
+                    delete dpdShared;
+                    return false;
+                }
+                dpd = static_cast<SmfDpd*>(dpdShared);
+            }
+            break;
+        }
+        case SmfDpd::HASH_TABLE:
+        {
+            SmfDpdHashTable* dpdHashTable = new SmfDpdHashTable;
+            if (NULL != dpdHashTable)
+            {
+                if (!dpdHashTable->Init())
+                {
+                    PLOG(PL_ERROR, "Smf::Interface::SetDpdType() error: dpdHashTable init failed: %s\n", GetErrorString());
+                    delete dpdHashTable;
+                    return false;
+                }
+                dpd = static_cast<SmfDpd*>(dpdHashTable);
+            }
+            break;
+        }
+        default:
+        {
+            SmfDpdTable* dpdTable = new SmfDpdTable(1024);
+            if (NULL != dpdTable)
+            {
+                dpdTable->SetFlowBudget(dpdParams.flow_budget);
+                dpd = static_cast<SmfDpd*>(dpdTable);
+            }
+            break;
         }
     }
-    else
+    if (NULL == dpd)
     {
-        dup_detector = static_cast<SmfDpd*>(new SmfDpdTable(1024));
+        PLOG(PL_ERROR, "Smf::Interface::SetDpdType() error: couldn't allocate dup_detector: %s\n", GetErrorString());
+        return false;
     }
-    if (NULL == dup_detector)
+    if (NULL != dup_detector)
     {
-        PLOG(PL_ERROR, "Smf::Interface::Init() error: couldn't allocate dup_detector: %s\n", GetErrorString());
-        return false;
+        dup_detector->Destroy();
+        delete dup_detector;
     }
+    dup_detector = dpd;
     return true;
-}  // end Smf::Interface::Init()
+}  // end Smf::Interface::SetDpdType()
+
+unsigned int Smf::Interface::SetStateFile(SmfStateFile* stateFile, unsigned int currentTime)
+{
+    if (SmfDpd::WINDOW != GetDpdType()) return 0;
+    SmfDpdWindow* dpdWindow = static_cast<SmfDpdWindow*>(dup_detector);
+    dpdWindow->SetStateFile(stateFile, GetIndex());
+    return dpdWindow->Restore(currentTime);
+}  // end Smf::Interface::SetStateFile()
 
 void Smf::Interface::Destroy()
 {
@@ -176,7 +264,16 @@ bool Smf::Interface::EnqueueFrame(const char* frameBuf, unsigned int frameLen, S
         return false;
     }
     // We offset by 2 bytes here so ProtoPktIP ends up with proper alignment
-    UINT32* alignedBuffer = smfPkt->AccessBuffer();
+    UINT32* alignedBuffer = smfPkt->PrepareBuffer();
+    if (NULL == alignedBuffer)
+    {
+        PLOG(PL_ERROR, "Smf::Interface::EnqueueFrame() error: unable to get packet buffer\n");
+        if (NULL != pktPool)
+            pktPool->Put(*smfPkt);
+        else
+            delete smfPkt;
+        return false;
+    }
     UINT16* ethBuffer = ((UINT16*)alignedBuffer) + 1;
 
     // Copy the frame to SmfPacket buffer (TBD - refactor nrlsmf code to avoid copy)
@@ -281,20 +378,35 @@ bool Smf::Interface::SetUMPOption(ProtoPktIPv4& ipPkt, bool increment)
 
 
 #ifdef ELASTIC_MCAST
-void Smf::Interface::PruneUpstreamHistory(unsigned int currentTick)
+void Smf::Interface::AddUpstreamHistory(MulticastFIB::UpstreamHistory& upstreamHistory, unsigned int currentTime)
 {
-    MulticastFIB::UpstreamHistoryTable::Iterator tablerator(upstream_history_table);
-    MulticastFIB::UpstreamHistory* upstreamHistory;
-    while (NULL != (upstreamHistory = tablerator.GetNextItem()))
+    upstream_history_table.Insert(upstreamHistory);
+    // (its age is first checked once it could have reached REPAIR_AGE_MAX)
+    upstream_history_wheel.Schedule(upstreamHistory, currentTime + (REPAIR_AGE_MAX / 1000000));
+}  // end Smf::Interface::AddUpstreamHistory()
+
+void Smf::Interface::PruneUpstreamHistory(unsigned int currentTick, unsigned int currentTime)
+{
+    // Only the upstream histories whose age check has come due are visited.  Ones
+    // refreshed since they were scheduled are rescheduled for when they could next
+    // reach REPAIR_AGE_MAX (so packet reception never touches the wheel)
+    SmfTimingWheel::Item* nextItem = upstream_history_wheel.Advance(currentTime);
+    while (NULL != nextItem)
     {
+        MulticastFIB::UpstreamHistory* upstreamHistory = static_cast<MulticastFIB::UpstreamHistory*>(nextItem);
+        nextItem = nextItem->GetNextExpired();
         unsigned int idleCount = upstreamHistory->GetIdleCount();
         unsigned int age = upstreamHistory->Age(currentTick);
         if ((age >= REPAIR_AGE_MAX) || (idleCount >= REPAIR_IDLE_MAX))
         {
-            // TBD - leave this for the PruneUpstreamHistory() to do???
             RemoveUpstreamHistory(*upstreamHistory);
             delete upstreamHistory;
         }
+        else
+        {
+            unsigned int delay = (REPAIR_AGE_MAX - age + 999999) / 1000000;  // (rounded up to seconds)
+            upstream_history_wheel.Schedule(*upstreamHistory, currentTime + delay);
+        }
     }
 }  // end Smf::Interface::PruneUpstreamHistory()
 #endif // ELASTIC_MCAST
@@ -376,11 +488,12 @@ void Smf::InterfaceGroup::SetElasticUnicast(bool state)
 }  // end Smf::InterfaceGroup::SetElasticUnicast()
 
 Smf::Smf(ProtoTimerMgr& timerMgr)
- : timer_mgr(timerMgr), hash_algorithm(NULL), ihash_only(true),
-   idpd_enable(true), use_window(false),
+ : timer_mgr(timerMgr), hash_algorithm(NULL), hash_multi(NULL), ihash_only(true),
+   idpd_enable(true), use_window(false), dpd_type(SmfDpd::TABLE), state_pending(false),
    relay_enabled(false), relay_selected(false),
    delay_time(0), hash_stash(1024),
    update_age_max(DEFAULT_AGE_MAX), current_update_time(0),
+   prune_usec_last(0), prune_usec_max(0),
    selector_list_len(0), neighbor_list_len(0),
    recv_count(0), mrcv_count(0), dups_count(0), asym_count(0), fwd_count(0),
    vrf_list(timerMgr), vrf_policies(), with_FRR(false)
@@ -396,16 +509,88 @@ Smf::Smf(ProtoTimerMgr& timerMgr)
 #endif // ELASTIC_MCAST
 
     memset(dscp, 0, 256);
+    dpd_params.shared_store = &shared_dpd;
+    dpd_params.flow_budget = &flow_budget;
+    ip4_seq_mgr.SetFlowBudget(&flow_budget);
+    ip6_seq_mgr.SetFlowBudget(&flow_budget);
+    hash_stash.SetFlowBudget(&flow_budget);
 }
 
 Smf::~Smf()
 {
     if (prune_timer.IsActive())
         prune_timer.Deactivate();
+    CloseStateFile();  // (so flow state records are kept for restart)
+    if (NULL != hash_multi)
+    {
+        delete hash_multi;
+        hash_multi = NULL;
+    }
     iface_list.Destroy();
     iface_group_list.Destroy();
 }
 
+bool Smf::InitSharedDpd(unsigned int capacity)
+{
+    if ((0 != shared_dpd.GetCapacity()) && ((0 == capacity) || (capacity == shared_dpd.GetCapacity())))
+        return true;  // already initialized
+    if (0 != shared_dpd.GetMemberCount())
+    {
+        // (TBD) allow resizing the store while in use
+        PLOG(PL_ERROR, "Smf::InitSharedDpd() error: shared DPD store is in use\n");
+        return false;
+    }
+    if (0 == capacity) capacity = SHARED_DPD_CAPACITY_DEFAULT;
+    if (!shared_dpd.Init(capacity))
+    {
+        PLOG(PL_ERROR, "Smf::InitSharedDpd() error: shared DPD store init failure\n");
+        return false;
+    }
+    return true;
+}  // end Smf::InitSharedDpd()
+
+bool Smf::OpenStateFile(const char* path, unsigned int staleMax, unsigned int capacity)
+{
+    CloseStateFile();
+    bool adopted = false;
+    if (!state_file.Open(path, staleMax, capacity, &adopted))
+    {
+        PLOG(PL_ERROR, "Smf::OpenStateFile() error: unable to open state file %s\n", path);
+        return false;
+    }
+    dpd_params.state_file = &state_file;
+    ip4_seq_mgr.SetStateFile(&state_file, SmfStateFile::SEQ_IPV4);
+    ip6_seq_mgr.SetStateFile(&state_file, SmfStateFile::SEQ_IPV6);
+    unsigned int count = ip4_seq_mgr.Restore(current_update_time);
+    count += ip6_seq_mgr.Restore(current_update_time);
+    InterfaceList::Iterator iterator(iface_list);
+    Interface* nextIface;
+    while (NULL != (nextIface = iterator.GetNextItem()))
+        count += nextIface->SetStateFile(&state_file, current_update_time);
+    if (adopted)
+    {
+        PLOG(PL_INFO, "Smf::OpenStateFile() restored %u flows\n", count);
+        // Records for interfaces not yet added are kept until the next prune
+        state_pending = true;
+    }
+    return true;
+}  // end Smf::OpenStateFile()
+
+void Smf::CloseStateFile()
+{
+    if (!state_file.IsOpen()) return;
+    // Detach all flows first (the records are left in the file)
+    dpd_params.state_file = NULL;
+    ip4_seq_mgr.SetStateFile(NULL, SmfStateFile::SEQ_IPV4);
+    ip6_seq_mgr.SetStateFile(NULL, SmfStateFile::SEQ_IPV6);
+    InterfaceList::Iterator iterator(iface_list);
+    Interface* nextIface;
+    while (NULL != (nextIface = iterator.GetNextItem()))
+        nextIface->SetStateFile(NULL, current_update_time);
+    state_file.Close();
+    state_pending = false;
+}  // end Smf::CloseStateFile()
+
 bool Smf::Init()
 {
     if (!ip4_seq_mgr.Init(16))
@@ -441,6 +626,15 @@ bool Smf::SetHashAlgorithm(SmfHash::Type hashType, bool internalHashOnly)
         case SmfHash::SHA1:
             hashAlgorithm = new SmfHashSHA1;
             break;
+        case SmfHash::CRC32C:
+            hashAlgorithm = new SmfHashCRC32C;
+            break;
+        case SmfHash::XXH3:
+            hashAlgorithm = new SmfHashXXH3;
+            break;
+        case SmfHash::SIPHASH:
+            hashAlgorithm = new SmfHashSipHash;
+            break;
        default:
             PLOG(PL_ERROR, "Smf::SetHashAlgorithm() error: unsupported hash algorithm\n");
             return false;
@@ -450,8 +644,17 @@ bool Smf::SetHashAlgorithm(SmfHash::Type hashType, bool internalHashOnly)
         PLOG(PL_ERROR, "Smf::SetHashAlgorithm() error: unable to allocate SmfHash instance: %s\n", GetErrorString());
         return false;
     }
+    SmfHashMulti* hashMulti = NULL;
+    if (SmfHashMulti::IsSupported(hashType))
+    {
+        // (batch hashing is only an optimization, so go on without it if need be)
+        if (NULL == (hashMulti = new SmfHashMulti))
+            PLOG(PL_WARN, "Smf::SetHashAlgorithm() warning: unable to allocate SmfHashMulti instance: %s\n", GetErrorString());
+    }
     if (NULL != hash_algorithm) delete hash_algorithm;
     hash_algorithm = hashAlgorithm;
+    if (NULL != hash_multi) delete hash_multi;
+    hash_multi = hashMulti;
     use_window = (SmfHash::NONE != hashType) ?  false : use_window;
     ihash_only = internalHashOnly;
     return true;
@@ -501,12 +704,14 @@ Smf::Interface *Smf::AddInterface(unsigned int ifIndex, const char *ifName)
             PLOG(PL_ERROR, "Smf::AddInterface() new Smf::Interface error: %s\n", GetErrorString());
             return NULL;
         }
-        if (!iface->Init(use_window))
+        if (!iface->Init(use_window ? SmfDpd::WINDOW : dpd_type, dpd_params))
         {
             PLOG(PL_ERROR, "Smf::AddInterface() Smf::Interface initialization error: %s\n", GetErrorString());
             delete iface;
             return NULL;
         }
+        if (state_pending)
+            iface->SetStateFile(&state_file, current_update_time);
         iface_list.Insert(*iface);
         // TBD -Initialize interface parameters to defaults
     }
@@ -920,13 +1125,12 @@ bool Smf::ApplyHAV(ProtoPktIPv6& ipv6Pkt, char* hashResult, unsigned int* hashSi
     unsigned int hashBytes = hash_algorithm->GetLength();
     memcpy(hashResult, hash_algorithm->GetValue(), hashBytes);
     // b) check hash history
-    const char* flowId = (const char*)ipv6Pkt.GetSrcAddrPtr();
-    unsigned int flowIdSize = 128;
+    SmfFlowKey flowKey((const char*)ipv6Pkt.GetSrcAddrPtr(), 128);
     bool noHAV = true;
     UINT8 havValue = 0;  // (TBD) make HAV size parametric?
     unsigned int havOffset;
     // c) while (conflicting) add or incrementally change HAV ...
-    while (hash_stash.IsDuplicate(current_update_time, flowId, flowIdSize, hashResult, hashBytes << 3))
+    while (hash_stash.IsDuplicate(current_update_time, flowKey, hashResult, hashBytes << 3))
     {
         if (noHAV)
         {
@@ -1061,18 +1265,136 @@ Smf::DpdType Smf::ResequenceIPv6(ProtoPktIPv6&   ipv6Pkt,     // input/output
 }  // end Smf::ResequenceIPv6()
 
 
+// Prefetch hint used by ProcessPacketBatch()
+#ifdef __GNUC__
+#define SMF_PREFETCH(ptr) __builtin_prefetch((ptr))
+#else
+#define SMF_PREFETCH(ptr)
+#endif // if/else __GNUC__
+
+unsigned int Smf::ProcessPacketBatch(BatchPacket* batch[], unsigned int count, Interface& srcIface, bool outbound)
+{
+    // The srcIface VRF lookup (a list walk) is the same for all packets in the batch
+    SmfVRF* vrf = vrf_list.GetVRFbyIfaceIndex(srcIface.GetIndex());
+    for (unsigned int i = 0; (i < BATCH_PREFETCH) && (i < count); i++)
+        SMF_PREFETCH(batch[i]->ip_pkt.GetBuffer());
+    // The H-DPD hash values can be computed up front, a batch at a time, unless the
+    // packets may be modified (resequenced, etc) before ProcessPacketVRF() hashes them
+    bool hashBatch = (NULL != hash_multi) && (count > 1) && !srcIface.GetResequence() && !GetAdaptiveRouting();
+    unsigned int lanePkt[SmfHashMulti::LANES];  // batch index of each hashed packet
+    unsigned int laneCount = 0;                 // number of lanes hashed by last Compute()
+    unsigned int laneNext = 0;                  // next lane value to be used
+    unsigned int hashIndex = 0;                 // next batch index to consider for hashing
+    unsigned int fwdCount = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if ((i + BATCH_PREFETCH) < count)
+        {
+            // Warm up the header (addresses, ID, options) of a packet further along
+            const char* hdr = (const char*)batch[i + BATCH_PREFETCH]->ip_pkt.GetBuffer();
+            SMF_PREFETCH(hdr);
+            SMF_PREFETCH(hdr + 64);
+        }
+        if (hashBatch && (laneNext == laneCount) && (hashIndex <= i))
+        {
+            // Hash the next (up to) LANES packets that ProcessPacketVRF() would hash
+            hash_multi->Init();
+            laneCount = laneNext = 0;
+            for (; (hashIndex < count) && (laneCount < SmfHashMulti::LANES); hashIndex++)
+            {
+                ProtoPktIP& ipPkt = batch[hashIndex]->ip_pkt;
+                if (!IsBatchHashPacket(ipPkt, srcIface, outbound)) continue;
+                if (4 == ipPkt.GetVersion())
+                {
+                    ProtoPktIPv4 ipv4Pkt(ipPkt);
+                    hash_multi->ComputeHashIPv4(ipv4Pkt);
+                }
+                else
+                {
+                    ProtoPktIPv6 ipv6Pkt(ipPkt);
+                    hash_multi->ComputeHashIPv6(ipv6Pkt);
+                }
+                lanePkt[laneCount++] = hashIndex;
+            }
+            if (0 != laneCount) hash_multi->Compute();
+        }
+        BatchPacket& pkt = *batch[i];
+        if ((laneNext < laneCount) && (i == lanePkt[laneNext]))
+            pkt.pkt_info.hash_value = hash_multi->GetValue(laneNext++);
+        else
+            pkt.pkt_info.hash_value = NULL;
+        pkt.dst_count = ProcessPacketVRF(pkt.ip_pkt, pkt.prev_hop_addr, pkt.dst_mac_addr, srcIface,
+                                         pkt.dst_if_array, pkt.dst_if_array_size, pkt.eth_pkt,
+                                         outbound, &pkt.recv_dup, vrf, &pkt.pkt_info);
+        pkt.pkt_info.hash_value = NULL;  // (only valid until next Compute())
+        if (pkt.dst_count > 0) fwdCount++;
+    }
+    return fwdCount;
+}  // end Smf::ProcessPacketBatch()
+
+// Returns "true" if ProcessPacketVRF() would compute the H-DPD hash of "ipPkt" (i.e.,
+// it passes the forwarding checks made before hashing and has no SMF_DPD hash assist value)
+bool Smf::IsBatchHashPacket(ProtoPktIP& ipPkt, const Interface& srcIface, bool outbound) const
+{
+    bool isTunnel = srcIface.IsTunnel();
+    ProtoAddress srcIp, dstIp;
+    switch (ipPkt.GetVersion())
+    {
+        case 4:
+        {
+            ProtoPktIPv4 ipv4Pkt(ipPkt);
+            ipv4Pkt.GetDstAddr(dstIp);
+            if (!dstIp.IsMulticast() && !GetUnicastEnabled()) return false;
+            if (dstIp.IsLinkLocal() && !isTunnel) return false;
+            ipv4Pkt.GetSrcAddr(srcIp);
+            break;
+        }
+        case 6:
+        {
+            ProtoPktIPv6 ipv6Pkt(ipPkt);
+            ipv6Pkt.GetDstAddr(dstIp);
+            if (!dstIp.IsMulticast() && !GetUnicastEnabled() && !outbound) return false;
+            if (dstIp.IsLinkLocal() && !isTunnel && !outbound) return false;
+            ipv6Pkt.GetSrcAddr(srcIp);
+            break;
+        }
+        default:
+            return false;
+    }
+    if (!outbound && IsOwnAddress(srcIp)) return false;  // locally-generated
+    if (srcIp.IsLinkLocal() && !isTunnel && !outbound) return false;
+    if (6 == ipPkt.GetVersion())
+    {
+        // An SMF_DPD hash assist value is used as is, and I-DPD + hash mode
+        // doesn't process IPv6 packets without a DPD identifier
+        ProtoPktIPv6 ipv6Pkt(ipPkt);
+        char flowId[SmfFlowKey::KEY_BYTES_MAX];
+        unsigned int flowIdSize = SmfFlowKey::KEY_BYTES_MAX*8;
+        char pktId[32];
+        unsigned int pktIdSize = 32*8;
+        DpdType dpdType = GetIPv6PktID(ipv6Pkt, flowId, &flowIdSize, pktId, &pktIdSize);
+        if (DPD_SMF_H == dpdType) return false;
+        if (idpd_enable && ihash_only && (DPD_NONE == dpdType)) return false;
+    }
+    return true;
+}  // end Smf::IsBatchHashPacket()
+
 // Return value here is the number of interfaces to which the packet should be forwarded
 // (the "dstIfArray" is populated with the list of indices for those interfaces)
-int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the packet (may be modified)
-                       const ProtoAddress& prevHopAddr,    // input - previous hop MAC addr (or IP addr if from tunnel iface)
-                       const ProtoAddress& dstMac,         // input - destination MAC addr of packet (typically mcast)
-                       Interface&          srcIface,       // input - Smf::Interface on which packet arrived
-                       unsigned int        dstIfArray[],   // output - list of interface indices to which packet should be forwarded
-                       unsigned int        dstIfArraySize, // input - size of "dstIfArray[]" passed in
-                       ProtoPktETH&        ethPkt,         // input/output - the ethernet packet (need to make sure size is changed correctly
-                       bool                outbound,       // boolean that equals true if this packet is originating from this node
-                       bool*               recvDup)        // returned value set to "true" if this a duplicate reception
+int Smf::ProcessPacketVRF(ProtoPktIP&         ipPkt,          // input/output - the packet (may be modified)
+                          const ProtoAddress& prevHopAddr,    // input - previous hop MAC addr (or IP addr if from tunnel iface)
+                          const ProtoAddress& dstMac,         // input - destination MAC addr of packet (typically mcast)
+                          Interface&          srcIface,       // input - Smf::Interface on which packet arrived
+                          unsigned int        dstIfArray[],   // output - list of interface indices to which packet should be forwarded
+                          unsigned int        dstIfArraySize, // input - size of "dstIfArray[]" passed in
+                          ProtoPktETH&        ethPkt,         // input/output - the ethernet packet (need to make sure size is changed correctly
+                          bool                outbound,       // boolean that equals true if this packet is originating from this node
+                          bool*               recvDup,        // returned value set to "true" if this a duplicate reception
+                          SmfVRF*             vrf,            // input - VRF of "srcIface" (if any)
+                          const SmfPktInfo*   pktInfo)        // input - packet descriptor (if non-NULL, see smfPktInfo.h)
 {
+    // Any precomputed H-DPD hash value is carried by the packet descriptor
+    const char* hashValue = (NULL != pktInfo) ? pktInfo->hash_value : NULL;
     if (NULL != recvDup) *recvDup = false;  // will be checked and set later as appropriate
     if (!prevHopAddr.IsValid())
         PLOG(PL_WARN, "Smf::ProcessPacket() warning: invalid prevHopAddr from ifIndex: %d!\n", srcIface.GetIndex());
@@ -1089,10 +1411,11 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
     //    and ttl/hopLimit (and also decrement ttl/hopLimit for forwarding)
     ProtoAddress srcIp, dstIp;
 
-    SmfVRF * vrf = vrf_list.GetVRFbyIfaceIndex(srcIface.GetIndex());
-
-    char flowId[48];  // worst case is probably IPV6 <taggerID:srcAddr:dstAddr> w/ taggerID a IPv6 addr (3*128 bits)
-    unsigned int flowIdSize = (48*8);
+    // worst case flowId is probably IPV6 <taggerID:srcAddr:dstAddr> w/ taggerID a IPv6 addr (3*128 bits)
+    // (It's built in place in the "flowKey" buffer and then "flowKey" is finalized below)
+    SmfFlowKey flowKey;
+    char* flowId = flowKey.AccessBuffer();
+    unsigned int flowIdSize = (SmfFlowKey::KEY_BYTES_MAX*8);
     char pktId[32];  // worst case 32-bits of ID plus 160 bits of hash
     const unsigned int PKT_ID_SIZE_MAX = 32*8; // in bits
     unsigned int pktIdSize = PKT_ID_SIZE_MAX;
@@ -1576,9 +1899,13 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
                 // Put hash value after pktId (if applicable)
                 char* hashValuePtr = pktId + pktIdBytes;
 
-                hash_algorithm->ComputeHashIPv4(ipv4Pkt);
+                if (NULL == hashValue)
+                {
+                    hash_algorithm->ComputeHashIPv4(ipv4Pkt);
+                    hashValue = hash_algorithm->GetValue();
+                }
                 unsigned int hashBytes = hash_algorithm->GetLength();
-                memcpy(hashValuePtr, hash_algorithm->GetValue(), hashBytes);
+                memcpy(hashValuePtr, hashValue, hashBytes);
                 pktIdBytes += hashBytes;
                 pktIdSize = pktIdBytes << 3;  // convert to length in bits
             }  // end if (SmfHash::NONE != GetHashType())
@@ -1700,9 +2027,13 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
                     }
                     // Put hash value after pktId (if applicable)
                     char* hashValuePtr = pktId + pktIdBytes;
-                    hash_algorithm->ComputeHashIPv6(ipv6Pkt);
+                    if (NULL == hashValue)
+                    {
+                        hash_algorithm->ComputeHashIPv6(ipv6Pkt);
+                        hashValue = hash_algorithm->GetValue();
+                    }
                     unsigned int hashBytes = hash_algorithm->GetLength();
-                    memcpy(hashValuePtr, hash_algorithm->GetValue(), hashBytes);
+                    memcpy(hashValuePtr, hashValue, hashBytes);
                     pktIdBytes += hashBytes;
                     pktIdSize = pktIdBytes << 3;
                 }
@@ -1734,6 +2065,9 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
             return 0;
     }  // end switch (version)
 
+    // The flow key (and its hash) are computed once here for all the DPD lookups below
+    flowKey.SetSize(flowIdSize);
+
     mrcv_count++;  // increment multicast received count
     srcIface.IncrementMcastCount();
 
@@ -2196,7 +2530,7 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
         bool sameIface = (&dstIface == &srcIface);
         if (ifaceForward || elastic || adaptive || (updateDupTree && sameIface))
         {
-            if (dstIface.IsDuplicatePkt(current_update_time, flowId, flowIdSize, pktId, pktIdSize))
+            if (dstIface.IsDuplicatePkt(current_update_time, flowKey, pktId, pktIdSize))
             {
                 PLOG(PL_DETAIL, "Smf::ProcessPacket(): received duplicate IPv%d packet ...\n", version);
                 dups_count++;
@@ -2620,7 +2954,7 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
     {
         if (srcIface.GetResequence() || (!outbound && srcIface.IsLayered()))
         {
-            srcIface.IsDuplicatePkt(current_update_time, flowId, flowIdSize, pktId, pktIdSize);
+            srcIface.IsDuplicatePkt(current_update_time, flowKey, pktId, pktIdSize);
         }
     }
 
@@ -2632,7 +2966,7 @@ int Smf::ProcessPacket(ProtoPktIP&         ipPkt,          // input/output - the
 #endif // ADAPTIVE_ROUTING
     PLOG(PL_DETAIL, "Smf::ProcessPacket(): completed: forwarding on %d interfaces.\n", dstCount);
     return dstCount;
-}  // end Smf::ProcessPacket()
+}  // end Smf::ProcessPacketVRF()
 
 
 #ifdef ELASTIC_MCAST
@@ -2956,8 +3290,9 @@ void Smf::HandleAdv(unsigned int                    currentTick,
 
     // Update our MulticastFIB as if this were a packet received.
 
-    char flowId[34];  // worst case is  IPV6 <dpdType:proto:srcAddr:dstAddr> w/ taggerID a IPv6 addr (8 + 8 + 2*128 bits)
-    unsigned int flowIdSize = (34*8);
+    SmfFlowKey flowKey;  // worst case is  IPV6 <dpdType:proto:srcAddr:dstAddr> w/ taggerID a IPv6 addr (8 + 8 + 2*128 bits)
+    char* flowId = flowKey.AccessBuffer();
+    unsigned int flowIdSize = 0;
     char pktId[16+2];  // worst case is IPv6 advertiser and 16-bit ElasticAdv ID
     unsigned int pktIdSize = 18*8;  // in bits
 
@@ -2986,9 +3321,11 @@ void Smf::HandleAdv(unsigned int                    currentTick,
     memcpy(pktId + advIp.GetLength(), &advId, 2);
     pktIdSize = (advIp.GetLength() + 2) * 8;
     
+    flowKey.SetSize(flowIdSize);
+    
     const ProtoAddress& relayAddr = (NULL != upstreamHistory) ? upstreamHistory->GetAddress() : prevHopAddr;
     
-    if (srcIface.IsDuplicatePkt(current_update_time, flowId, flowIdSize, pktId, pktIdSize))
+    if (srcIface.IsDuplicatePkt(current_update_time, flowKey, pktId, pktIdSize))
     {
         PLOG(PL_DEBUG, "Smf::HandleAdv() duplicate EM_ADV\n");
         // Update the upstream relay metric and link quality even though this won't excite
@@ -3072,7 +3409,7 @@ MulticastFIB::UpstreamHistory* Smf::GetUpstreamHistory(Interface&    srcIface,
         {
             if (NULL != (upstreamHistory = new MulticastFIB::UpstreamHistory(upstreamAddr)))
             {
-                srcIface.AddUpstreamHistory(*upstreamHistory);
+                srcIface.AddUpstreamHistory(*upstreamHistory, current_update_time);
                 upstreamHistory->SetSequence(upstreamSeq);
 
             }
@@ -3350,7 +3687,14 @@ bool Smf::CachePacket(const Interface& iface, UINT16 sequence, char* frameBuffer
     {
         pkt = cache->DequeuePacket();
     }
-    memcpy(pkt->AccessBuffer(), frameBuffer, frameLength);
+    UINT32* pktBuffer = (NULL != pkt) ? pkt->PrepareBuffer() : NULL;
+    if (NULL == pktBuffer)
+    {
+        PLOG(PL_ERROR, "Smf::CachePacket() error: unable to get packet buffer\n");
+        if (NULL != pkt) indexed_pkt_pool.Put(*pkt);
+        return false;
+    }
+    memcpy(pktBuffer, frameBuffer, frameLength);
     pkt->SetLength(frameLength);
     pkt->SetIndex(sequence);
     ProtoTime currentTime;
@@ -3728,6 +4072,9 @@ bool Smf::OnDelayRelayOffTimeout(ProtoTimer& theTimer)
 
 bool Smf::OnPruneTimeout(ProtoTimer& /*theTimer*/)
 {
+    // The time spent here stalls packet forwarding, so we measure it
+    struct timeval startTime;
+    ProtoSystemTime(startTime);
 #ifdef ELASTIC_MCAST
     unsigned int currentTick = time_ticker.Update();  // ticker used for ElasticMulticast state maintenance
 #endif // ELASTIC_MCAST
@@ -3736,18 +4083,33 @@ bool Smf::OnPruneTimeout(ProtoTimer& /*theTimer*/)
     ip6_seq_mgr.Prune(current_update_time, update_age_max);
     hash_stash.Prune(current_update_time, update_age_max);
 
+    if (state_file.IsOpen())
+    {
+        // Restored state not adopted by now (e.g., for interfaces
+        // no longer in use) is discarded
+        if (state_pending)
+        {
+            state_file.ReleasePending();
+            state_pending = false;
+        }
+        state_file.SetWriteTime((UINT32)time(NULL));
+    }
+
     bool outputReport = (GetDebugLevel() >= PL_INFO);
 
     // The SmfDuplicateTree::Prune() method removes
     // entries which are stale for more than "update_age_max"
-    unsigned int flowCount = 0;
+    // (interfaces using the node-wide shared store are pruned here just once)
+    shared_dpd.Prune(current_update_time, update_age_max);
+    unsigned int flowCount = shared_dpd.GetFlowCount();
     InterfaceList::Iterator iterator(iface_list);
     Interface* nextIface;
     if (outputReport) PLOG(PL_ALWAYS, "nrlsmf report:\n");  // TBD - add date / timestamp
     while (NULL != (nextIface = iterator.GetNextItem()))
     {
         nextIface->PruneDuplicateDetector(current_update_time, update_age_max);
-        flowCount += nextIface->GetFlowCount();
+        if (SmfDpd::SHARED != nextIface->GetDpdType())
+            flowCount += nextIface->GetFlowCount();
         if (outputReport)
         {
             PLOG(PL_ALWAYS, "  iface:%s flows:%u recv:%u mrcv:%u sent:%u retr:%u fwd:%u dups:%u asym:%u queue:%u\n",
@@ -3758,7 +4120,7 @@ bool Smf::OnPruneTimeout(ProtoTimer& /*theTimer*/)
         }
 
 #ifdef ELASTIC_MCAST
-        nextIface->PruneUpstreamHistory(currentTick);
+        nextIface->PruneUpstreamHistory(currentTick, current_update_time);
 #endif // ELASTIC_MCAST
 
     }
@@ -3768,9 +4130,25 @@ bool Smf::OnPruneTimeout(ProtoTimer& /*theTimer*/)
         PLOG(PL_ALWAYS, "  summary> flows:%u recv:%u mrcv:%u dups:%u asym:%u fwd:%u\n",
                 flowCount, recv_count, mrcv_count,
                 dups_count, asym_count, fwd_count);
+        if (0 != flow_budget.GetFlowMax())
+        {
+            PLOG(PL_ALWAYS, "  budget> flows:%u/%u evictions:%u\n",
+                    flow_budget.GetFlowCount(), flow_budget.GetFlowMax(),
+                    flow_budget.GetEvictionCount());
+        }
+        PLOG(PL_ALWAYS, "  prune> last:%uus max:%uus\n", prune_usec_last, prune_usec_max);
+        for (const SmfSlab* slab = SmfSlab::GetFirst(); NULL != slab; slab = slab->GetNext())
+        {
+            PLOG(PL_ALWAYS, "  slab> %s use:%u/%u peak:%u slabs:%u size:%u fail:%u\n",
+                    slab->GetName(), slab->GetUseCount(), slab->GetObjectCount(),
+                    slab->GetUsePeak(), slab->GetSlabCount(),
+                    (unsigned int)slab->GetObjectSize(), slab->GetFailureCount());
+        }
     }
     current_update_time += (unsigned int)prune_timer.GetInterval();
 #ifdef ELASTIC_MCAST
+    // (the FIB's active and idle flow lists are in refresh order, so this
+    //  only visits the flows that have timed out)
     mcast_fib.PruneFlowList(currentTick, mcast_controller);
     if (outputReport)
     {
@@ -3845,6 +4223,11 @@ bool Smf::OnPruneTimeout(ProtoTimer& /*theTimer*/)
         }
     }
 #endif // ELASTIC_MCAST
+    struct timeval stopTime;
+    ProtoSystemTime(stopTime);
+    prune_usec_last = (unsigned int)((stopTime.tv_sec - startTime.tv_sec) * 1000000 +
+                                     (stopTime.tv_usec - startTime.tv_usec));
+    if (prune_usec_last > prune_usec_max) prune_usec_max = prune_usec_last;
     return true;
 }  // end Smf::OnPruneTimeout()
 
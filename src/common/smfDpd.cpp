@@ -35,7 +35,7 @@
 
 
 SmfFlow::SmfFlow()
-: flow_id(NULL), flow_id_size(0), prev(NULL), next(NULL)
+: update_time(0), prev(NULL), next(NULL)
 {
 }
 
@@ -44,39 +44,29 @@ SmfFlow::~SmfFlow()
     Destroy();
 }
 
-bool SmfFlow::Init(const char*         flowId,
-                   unsigned int        flowIdSize)
+bool SmfFlow::Init(const SmfFlowKey& flowKey)
 {
-    if (NULL != flow_id) delete[] flow_id;
-    unsigned int flowIdBytes = flowIdSize >> 3;
-    if (0 != (flowIdSize & 0x07)) flowIdBytes++;
-    flow_id = new char[flowIdBytes];
-    if (NULL == flow_id)
+    SmfFlow::Destroy();
+    if (0 == flowKey.GetSize())
     {
-        PLOG(PL_ERROR, "SmfFlow::Init() new flow_id error: %s\n", GetErrorString());
-        flow_id_size = 0;
+        PLOG(PL_ERROR, "SmfFlow::Init() error: invalid flow key\n");
         return false;
     }
-    memcpy(flow_id, flowId, flowIdBytes);
-    flow_id_size = flowIdSize;
+    flow_key = flowKey;
 	return true;
 }  // end SmfFlow::Init()
 
 void SmfFlow::Destroy()
 {
-    if (NULL != flow_id)
-    {
-        delete[] flow_id;
-        flow_id = NULL;
-        flow_id_size = 0;
-    }
+    flow_key.Clear();
 }  // end SmfFlow::Destroy()
 
 
 
 SmfFlow::List::List()
- : count(0), head(NULL), tail(NULL)
+ : count(0), head(NULL), tail(NULL), cache_hits(0), cache_misses(0)
 {
+    ClearCache();
 }
 
 SmfFlow::List::~List()
@@ -96,8 +86,67 @@ void SmfFlow::List::Destroy(ProtoTree::ItemPool* itemPool)
             delete nextFlow;
     }
     count = 0;
+    ClearCache();
 }  // end SmfFlow::List::Destroy()
 
+SmfFlow* SmfFlow::List::Find(const SmfFlowKey& flowKey) const
+{
+    UINT32 hash = flowKey.GetHash();
+    CacheEntry* set = flow_cache[hash & (CACHE_SETS - 1)];
+    for (int way = 0; way < 2; way++)
+    {
+        SmfFlow* flow = set[way].flow;
+        if ((NULL != flow) && (hash == set[way].hash) && flowKey.IsEqual(flow->flow_key))
+        {
+            if (0 != way)
+            {
+                // Make it the most recently used way
+                set[1] = set[0];
+                set[0].hash = hash;
+                set[0].flow = flow;
+            }
+            cache_hits++;
+            return flow;
+        }
+    }
+    cache_misses++;
+    SmfFlow* flow = static_cast<SmfFlow*>(flow_tree.Find(flowKey.GetBuffer(), flowKey.GetSize()));
+    if (NULL != flow) Cache(*flow);
+    return flow;
+}  // end SmfFlow::List::Find()
+
+void SmfFlow::List::Cache(SmfFlow& flow) const
+{
+    // The least recently used way is replaced
+    CacheEntry* set = flow_cache[flow.GetHash() & (CACHE_SETS - 1)];
+    set[1] = set[0];
+    set[0].hash = flow.GetHash();
+    set[0].flow = &flow;
+}  // end SmfFlow::List::Cache()
+
+void SmfFlow::List::Uncache(SmfFlow& flow)
+{
+    CacheEntry* set = flow_cache[flow.GetHash() & (CACHE_SETS - 1)];
+    if (&flow == set[0].flow)
+    {
+        set[0] = set[1];
+        set[1].flow = NULL;
+    }
+    else if (&flow == set[1].flow)
+    {
+        set[1].flow = NULL;
+    }
+}  // end SmfFlow::List::Uncache()
+
+void SmfFlow::List::ClearCache()
+{
+    for (int i = 0; i < CACHE_SETS; i++)
+    {
+        flow_cache[i][0].flow = NULL;
+        flow_cache[i][1].flow = NULL;
+    }
+}  // end SmfFlow::List::ClearCache()
+
 
 void SmfFlow::List::AppendToList(SmfFlow& flow)
 {
@@ -134,6 +183,7 @@ void SmfFlow::List::Append(SmfFlow& flow)
     AppendToList(flow);
     flow_tree.Insert(flow);
     count++;
+    Cache(flow);  // (new flows are usually looked up again right away)
 }  // end SmfFlow::List::Append()
 
 SmfFlow::Iterator::Iterator(const SmfFlow::List& theList)
@@ -145,6 +195,97 @@ SmfFlow::Iterator::~Iterator()
 {
 }
 
+SmfFlowBudget::SmfFlowBudget()
+ : flow_max(0), eviction_count(0), member_head(NULL)
+{
+}
+
+SmfFlowBudget::~SmfFlowBudget()
+{
+    while (NULL != member_head)
+        member_head->SetFlowBudget(NULL);
+}
+
+void SmfFlowBudget::Add(Member& member)
+{
+    member.budget_prev = NULL;
+    member.budget_next = member_head;
+    if (NULL != member_head) member_head->budget_prev = &member;
+    member_head = &member;
+}  // end SmfFlowBudget::Add()
+
+void SmfFlowBudget::Remove(Member& member)
+{
+    if (NULL != member.budget_prev)
+        member.budget_prev->budget_next = member.budget_next;
+    else
+        member_head = member.budget_next;
+    if (NULL != member.budget_next)
+        member.budget_next->budget_prev = member.budget_prev;
+    member.budget_prev = member.budget_next = NULL;
+}  // end SmfFlowBudget::Remove()
+
+unsigned int SmfFlowBudget::GetFlowCount() const
+{
+    unsigned int flowCount = 0;
+    for (const Member* member = member_head; NULL != member; member = member->budget_next)
+        flowCount += member->budget_flow_list.GetCount();
+    return flowCount;
+}  // end SmfFlowBudget::GetFlowCount()
+
+void SmfFlowBudget::SetFlowMax(unsigned int flowMax, unsigned int currentTime)
+{
+    flow_max = flowMax;
+    Enforce(currentTime);
+}  // end SmfFlowBudget::SetFlowMax()
+
+void SmfFlowBudget::Enforce(unsigned int currentTime, const SmfFlow* newFlow)
+{
+    if (0 == flow_max) return;  // unlimited
+    unsigned int flowCount = GetFlowCount();
+    while (flowCount > flow_max)
+    {
+        // Find the member whose stalest (head) flow is the oldest
+        Member* stalestMember = NULL;
+        unsigned int ageMax = 0;
+        for (Member* member = member_head; NULL != member; member = member->budget_next)
+        {
+            SmfFlow* flow = member->budget_flow_list.GetHead();
+            if ((NULL == flow) || (flow == newFlow)) continue;
+            unsigned int age = flow->GetAge(currentTime);
+            if ((NULL == stalestMember) || (age > ageMax))
+            {
+                stalestMember = member;
+                ageMax = age;
+            }
+        }
+        if (NULL == stalestMember) break;  // nothing left to evict
+        stalestMember->EvictFlow(*stalestMember->budget_flow_list.GetHead());
+        stalestMember->eviction_count++;
+        eviction_count++;
+        flowCount--;
+    }
+}  // end SmfFlowBudget::Enforce()
+
+SmfFlowBudget::Member::Member(const SmfFlow::List& flowList)
+ : budget_flow_list(flowList), flow_budget(NULL), eviction_count(0),
+   budget_prev(NULL), budget_next(NULL)
+{
+}
+
+SmfFlowBudget::Member::~Member()
+{
+    SetFlowBudget(NULL);
+}
+
+void SmfFlowBudget::Member::SetFlowBudget(SmfFlowBudget* budget)
+{
+    if (budget == flow_budget) return;
+    if (NULL != flow_budget) flow_budget->Remove(*this);
+    flow_budget = budget;
+    if (NULL != flow_budget) flow_budget->Add(*this);
+}  // end SmfFlowBudget::Member::SetFlowBudget()
+
 SmfDpd::SmfDpd()
 {
 }
@@ -153,9 +294,20 @@ SmfDpd::~SmfDpd()
 {
 }
 
+SmfDpd::Params::Params()
+ : filter_memory(SmfDpdFilter::MEMORY_DEFAULT), filter_fp_rate(SmfDpdFilter::FP_RATE_DEFAULT),
+   window_size_min(SmfDpdWindow::SIZE_MIN_DEFAULT), window_size_max(SmfDpdWindow::SIZE_MAX_DEFAULT),
+   shared_store(NULL), flow_budget(NULL), state_file(NULL)
+{
+}
+
+
+// Slab allocators for the table flows and packet id entries
+SmfSlab SmfDpdTable::Flow::slab("flow", sizeof(SmfDpdTable::Flow));
+SmfSlab SmfDpdTable::PacketIdEntry::slab("pktid", sizeof(SmfDpdTable::PacketIdEntry), 16);
 
 SmfDpdTable::SmfDpdTable(unsigned int pktCountMax)
-    : pkt_count_max(pktCountMax)
+    : SmfFlowBudget::Member(flow_list), pkt_count_max(pktCountMax)
 {
     memset(entry_pools, 0, (MAX_ID_BYTES+1)*sizeof(ProtoTree::ItemPool*));
 }
@@ -169,10 +321,11 @@ SmfDpdTable::~SmfDpdTable()
 void SmfDpdTable::Reset()
 {
     // iterate thru all flows, remove & pool any entries, delete flows
-    // (TBD) Do we want to pool flows, too?
+    // (flows are returned to the Flow slab when deleted)
     Flow* nextFlow;
     while (NULL != (nextFlow = static_cast<Flow*>(flow_list.GetHead())))
     {
+        aging_wheel.Cancel(*nextFlow);
         flow_list.Remove(*nextFlow);
         nextFlow->EmptyToPool(entry_pools);
         delete nextFlow;
@@ -199,24 +352,40 @@ void SmfDpdTable::Destroy()
 
 void SmfDpdTable::Prune(unsigned int currentTime, unsigned int ageMax)
 {
-    Flow* nextFlow;
-    SmfFlow::Iterator iterator(flow_list);
-    while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
+    // Entries are stale when their age exceeds "ageMax", so the flows with
+    // an oldest entry arrival time before "currentTime - ageMax" are expired
+    if (currentTime <= ageMax) return;
+    SmfTimingWheel::Item* nextItem = aging_wheel.Advance(currentTime - ageMax - 1);
+    while (NULL != nextItem)
     {
+        Flow* nextFlow = static_cast<Flow*>(nextItem);
+        nextItem = nextItem->GetNextExpired();
         nextFlow->Prune(currentTime, ageMax, entry_pools);
         if (nextFlow->IsEmpty())
         {
             flow_list.Remove(*nextFlow);
             delete nextFlow;
         }
+        else
+        {
+            aging_wheel.Schedule(*nextFlow, nextFlow->GetOldestArrivalTime());
+        }
     }
 }  // end SmfDpdTable::Prune()
 
-bool SmfDpdTable::IsDuplicate(unsigned int   currentTime,
-                              const char*    flowId,
-                              unsigned int   flowIdSize,   // in bits
-                              const char*    pktId,
-                              unsigned int   pktIdSize)    // in bits
+void SmfDpdTable::EvictFlow(SmfFlow& flow)
+{
+    Flow& theFlow = static_cast<Flow&>(flow);
+    aging_wheel.Cancel(theFlow);
+    flow_list.Remove(theFlow);
+    theFlow.EmptyToPool(entry_pools);
+    delete &theFlow;
+}  // end SmfDpdTable::EvictFlow()
+
+bool SmfDpdTable::IsDuplicate(unsigned int      currentTime,
+                              const SmfFlowKey& flowKey,
+                              const char*       pktId,
+                              unsigned int      pktIdSize)    // in bits
 {
     unsigned int pktIdBytes = pktIdSize >> 3;
     if (0 != (pktIdSize & 0x07))
@@ -231,26 +400,37 @@ bool SmfDpdTable::IsDuplicate(unsigned int   currentTime,
         return true;
     }
 
-    // 1) Find the "flow" w/ matching "flowId" or create a new one
-    Flow* flow = static_cast<Flow*>(flow_list.Find(flowId, flowIdSize));
+    // 1) Find the "flow" w/ matching "flowKey" or create a new one
+    Flow* flow = static_cast<Flow*>(flow_list.Find(flowKey));
     if (NULL == flow)
     {
-        // (TBD) should we keep a pool of Flows?
+        // (Flows come from the Flow slab allocator)
         if (NULL == (flow = new Flow(pkt_count_max)))
         {
             PLOG(PL_ERROR, "SmfDpdTable::IsDuplicate() new Flow error: %s\n", GetErrorString());
             return true;  // on failure, don't forward
         }
-        if (!flow->Init(flowId, flowIdSize))
+        if (!flow->Init(flowKey))
         {
             PLOG(PL_ERROR, "SmfDpdTable::IsDuplicate() flow initialization error.\n");
             return false; // on failure, don't forward
         }
+        flow->SetUpdateTime(currentTime);
         flow_list.Append(*flow);
+        EnforceFlowBudget(currentTime, *flow);
+    }
+    else
+    {
+        // Keep flow_list in update order for budget eviction
+        flow->SetUpdateTime(currentTime);
+        flow_list.MoveToTail(*flow);
     }
 
     // 2) Given "flow", check for duplications
-    return flow->IsDuplicate(currentTime, pktId, pktIdSize, entry_pools);
+    bool result = flow->IsDuplicate(currentTime, pktId, pktIdSize, entry_pools);
+    if (!flow->IsScheduled() && !flow->IsEmpty())
+        aging_wheel.Schedule(*flow, flow->GetOldestArrivalTime());
+    return result;
 
 }  // end SmfDpdTable::IsDuplicate()
 
@@ -263,10 +443,9 @@ SmfDpdTable::Flow::~Flow()
 {
 }
 
-bool SmfDpdTable::Flow::Init(const char*    flowId,
-                             unsigned int   flowIdSize) // in bits
+bool SmfDpdTable::Flow::Init(const SmfFlowKey& flowKey)
 {
-    if (!SmfFlow::Init(flowId, flowIdSize))
+    if (!SmfFlow::Init(flowKey))
     {
         PLOG(PL_ERROR, "SmfDpdTable::Flow::Init() SmfFlow initialization error\n");
         return false;
@@ -328,7 +507,7 @@ SmfDpdTable::PacketIdEntry::~PacketIdEntry()
 {
     if (NULL != pkt_id)
     {
-        delete[] pkt_id;
+        if (pkt_id_buf != pkt_id) delete[] pkt_id;
         pkt_id = NULL;
     }
 }
@@ -337,7 +516,9 @@ bool SmfDpdTable::PacketIdEntry::SetPktId(const char* pktId, UINT8 pktIdLength)
 {
     if (NULL == pkt_id)
     {
-        if (NULL == (pkt_id = new UINT8[pktIdLength + 1]))
+        if (pktIdLength < PKT_ID_INLINE)
+            pkt_id = pkt_id_buf;
+        else if (NULL == (pkt_id = new UINT8[pktIdLength + 1]))
         {
             PLOG(PL_ERROR, "SmfDpdTable::PacketIdEntry::SetPktId() new pkt_id error: %s\n", GetErrorString());
             return false;
@@ -496,7 +677,11 @@ void SmfDpdTable::PacketIdTable::EmptyToPool(ProtoTree::ItemPool** poolArray)
 // Window (sequence) based duplicate packet detection implementation
 
 
+SmfSlab SmfDpdWindow::Flow::slab("window", sizeof(SmfDpdWindow::Flow));
+
 SmfDpdWindow::Flow::Flow()
+ : window_past_max(0), size_min(0), size_max(0),
+   reorder_depth(0), seq_advance(0), adapt_time(0), state_record(NULL)
 {
 }
 
@@ -505,13 +690,14 @@ SmfDpdWindow::Flow::~Flow()
     Destroy();
 }
 
-bool SmfDpdWindow::Flow::Init(const char*         flowId,
-                              unsigned int        flowIdSize,     // in bits
+bool SmfDpdWindow::Flow::Init(const SmfFlowKey&   flowKey,
                               UINT8               seqNumSize,     // in bits
                               UINT32              windowSize,     // in packets
-                              UINT32              windowPastMax)  // in packets
+                              UINT32              windowPastMax,  // in packets
+                              UINT32              windowSizeMin,  // in packets
+                              UINT32              windowSizeMax)  // in packets
 {
-    if (!SmfFlow::Init(flowId, flowIdSize))
+    if (!SmfFlow::Init(flowKey))
     {
         PLOG(PL_ERROR, "SmfDpdWindow::Flow::Init() SmfFlow initialization error\n");
         return false;
@@ -525,6 +711,22 @@ bool SmfDpdWindow::Flow::Init(const char*         flowId,
         return false;
 	}
 
+    if (windowSizeMin < windowSizeMax)
+    {
+        // Adaptive window sizing, so fit the bounds (and windowSize) to the sequence space
+        UINT32 halfSpace = (UINT32)0x01 << (seqNumSize - 1);
+        if (windowSizeMax > halfSpace) windowSizeMax = halfSpace;
+        if (windowSizeMin > windowSizeMax) windowSizeMin = windowSizeMax;
+        if (windowSize < windowSizeMin) windowSize = windowSizeMin;
+        if (windowSize > windowSizeMax) windowSize = windowSizeMax;
+        if (windowPastMax < windowSizeMax) windowPastMax = windowSizeMax;
+        if (windowPastMax > halfSpace) windowPastMax = halfSpace;
+    }
+    else
+    {
+        windowSizeMin = windowSizeMax = windowSize;
+    }
+
     if (windowSize > ((UINT32)0x01 << (seqNumSize - 1)))
     {
         PLOG(PL_ERROR, "SmfDpdWindow::Flow::Init() error: invalid windowSize\n");
@@ -540,9 +742,7 @@ bool SmfDpdWindow::Flow::Init(const char*         flowId,
         return false;
     }
 
-    // Note seqRangeMask == sequence value max
-    UINT32 seqRangeMask = 0xffffffff >> (32 - seqNumSize);
-    if (!bitmask.Init(windowSize, seqRangeMask))
+    if (!bitmask.Init(windowSize, seqNumSize))
     {
         PLOG(PL_ERROR, "SmfDpdWindow::Flow::Init() bitmask init error: %s\n", GetErrorString());
         Destroy();
@@ -550,88 +750,122 @@ bool SmfDpdWindow::Flow::Init(const char*         flowId,
     }
 
     window_past_max = windowPastMax;
+    size_min = windowSizeMin;
+    size_max = windowSizeMax;
+    reorder_depth = seq_advance = 0;
 
     return true;
 
 }  // end SmfDpdWindow::Flow::Init()
 
+// Resizes the window bitmask, keeping the most recent history
+// (returns "true" if the size was changed)
+bool SmfDpdWindow::Flow::Resize(UINT32 windowSize)
+{
+    UINT32 oldSize = bitmask.GetSize();
+    if (!bitmask.Resize(windowSize))
+    {
+        PLOG(PL_ERROR, "SmfDpdWindow::Flow::Resize() error: unable to resize window\n");
+        return false;
+    }
+    PLOG(PL_DEBUG, "SmfDpdWindow::Flow::Resize() window size %u -> %u\n", oldSize, bitmask.GetSize());
+    return (bitmask.GetSize() != oldSize);
+}  // end SmfDpdWindow::Flow::Resize()
+
+void SmfDpdWindow::Flow::Adapt(unsigned int currentTime)
+{
+    if (size_min == size_max) return;  // fixed window size
+    unsigned int elapsed = currentTime - adapt_time;
+    if (0 == elapsed) return;
+    UINT32 velocity = seq_advance / elapsed;  // sequence numbers per second
+    UINT32 need = reorder_depth << 1;
+    if ((velocity >> 4) > need) need = velocity >> 4;
+    UINT32 target = size_min;
+    while ((target < need) && (target < size_max)) target <<= 1;
+    UINT32 size = bitmask.GetSize();
+    if (target > size)
+        Resize(target);
+    else if (target < size)
+        Resize((target > (size >> 1)) ? target : (size >> 1));
+    reorder_depth = seq_advance = 0;
+    adapt_time = currentTime;
+}  // end SmfDpdWindow::Flow::Adapt()
+
+void SmfDpdWindow::Flow::Restore(UINT32 seq)
+{
+    // Packets up to "seq" may have been forwarded before the restart,
+    // so the whole window is marked as received.  (Anything newer is
+    // then accepted while older repeats are detected as duplicates.)
+    bitmask.Reset(seq);
+    for (UINT32 i = 1; i < bitmask.GetSize(); i++)
+        bitmask.Set(seq - i);
+}  // end SmfDpdWindow::Flow::Restore()
+
 bool SmfDpdWindow::Flow::IsDuplicate(UINT32 seq)
 {
-    // Get the "lastSet" sequence (our current window "middle")
-    UINT32 lastSet;
-    if (bitmask.GetLastSet(lastSet))
-    {
-        // What region does this "seq" fall into
-        // with respect to our "window" ?
-        INT32 rangeSign = (INT32)bitmask.GetRangeSign();
-        INT32 rangeMask = (INT32)bitmask.GetRangeMask();
-        INT32 delta = seq - lastSet;
-        delta = ((0 == (delta & rangeSign)) ?
-                        (delta & rangeMask) :
-                        (((delta != rangeSign) || (seq < lastSet)) ?
-                            (delta | ~rangeMask) : delta));
-        if (delta > 0)
-        {
-            // It's a "new" packet
-            INT32 bitmaskSize = bitmask.GetSize();
-            if (delta < bitmaskSize) // "slide" the window as needed
-            {
-                UINT32 index = (lastSet - bitmaskSize + 1) & rangeMask;
-                bitmask.UnsetBits(index, delta);
-            }
-            else  // It's beyond of our window range, so reset window
-                bitmask.Clear();
+    if (!bitmask.IsSet())
+    {
+        // This is the first packet received
+        bitmask.Reset(seq);
+        return false;  // not a duplicate
+    }
+    // What region does this "seq" fall into with
+    // respect to our window "middle" (last set)?
+    INT32 delta = bitmask.GetDelta(seq);
+    if (delta > 0)
+    {
+        // It's a "new" packet, so "slide" the window as needed
+        seq_advance += delta;
+        bitmask.Advance(seq, delta);
+        return false;
+    }
+    else if (delta < 0)
+    {
+        // It's an "old" packet, so how old is it?
+        UINT32 age = -delta;
+        if (age > reorder_depth) reorder_depth = age;
+        if (age < bitmask.GetSize())
+        {
+            // It's old, but in our window ...
+            if (bitmask.Test(seq)) return true;
             bitmask.Set(seq);
             return false;
         }
-        else if (delta < 0)
+        else if ((age < size_max) && Resize(age + 1))
         {
-            // It's an "old" packet, so how old is it?
-            delta = -delta;
-            if ((unsigned int)delta < bitmask.GetSize())
-            {
-                // It's old, but in our window ...
-               if (bitmask.Test(seq))
-                   return true;
-               else
-                   bitmask.Set(seq);
-               return false;
-            }
-            else if (delta < (INT32)window_past_max)
-            {
-                // It's "very old".
-                // Newer behavior - assume it's not a duplicate and reset
-                // (this presumes our window is big enough to catch old duplicates)
-                // Our old behavior was to assume very old packets were duplicates
-                bitmask.Clear();
-                bitmask.Set(seq);
-                return false;
-            }
-            else
-            {
-                // It's so very "ancient", we reset our window to it
-                PLOG(PL_ERROR, "SmfDpdWindow::Flow::IsDuplicate() resetting window ...\n");
-                bitmask.Clear();
-                bitmask.Set(seq);
-                return false;
-            }
+            // It's older than our window but an adaptive window can
+            // grow to cover it (with its bit unknown, so it's assumed new)
+            bitmask.Set(seq);
+            return false;
+        }
+        else if (age < window_past_max)
+        {
+            // It's "very old".
+            // Newer behavior - assume it's not a duplicate and reset
+            // (this presumes our window is big enough to catch old duplicates)
+            // Our old behavior was to assume very old packets were duplicates
+            bitmask.Reset(seq);
+            return false;
         }
         else
         {
-            // It's a duplicate repeat of our lastSet
-            return true;
+            // It's so very "ancient", we reset our window to it
+            PLOG(PL_ERROR, "SmfDpdWindow::Flow::IsDuplicate() resetting window ...\n");
+            bitmask.Reset(seq);
+            return false;
         }
     }
     else
     {
-        // This is the first packet received
-        bitmask.Set(seq);
-        return false;  // not a duplicate
+        // It's a duplicate repeat of our lastSet
+        return true;
     }
 }  // end SmfDpdWindow::Flow::IsDuplicate()
 
 
 SmfDpdWindow::SmfDpdWindow()
+ : SmfFlowBudget::Member(flow_list), window_size(0), window_past_max(0), window_size_min(0), window_size_max(0),
+   state_file(NULL), state_if_index(0)
 {
 }
 
@@ -640,8 +874,86 @@ SmfDpdWindow::~SmfDpdWindow ()
     Destroy();
 }
 
+void SmfDpdWindow::Destroy()
+{
+    SmfFlow::Iterator iterator(flow_list);
+    Flow* nextFlow;
+    while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
+    {
+        if (NULL != state_file) state_file->Release(nextFlow->GetStateRecord());
+    }
+    flow_list.Destroy();
+}  // end SmfDpdWindow::Destroy()
+
+void SmfDpdWindow::DeleteFlow(Flow* flow)
+{
+    if (NULL != state_file) state_file->Release(flow->GetStateRecord());
+    flow_list.Remove(*flow);
+    delete flow;
+}  // end SmfDpdWindow::DeleteFlow()
+
+void SmfDpdWindow::SetStateFile(SmfStateFile* stateFile, UINT32 ifIndex)
+{
+    // Existing flows (if any) are detached from the old file, leaving their
+    // records in place.  Only flows created (or restored) afterwards are kept.
+    SmfFlow::Iterator iterator(flow_list);
+    Flow* nextFlow;
+    while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
+        nextFlow->SetStateRecord(NULL);
+    state_file = stateFile;
+    state_if_index = ifIndex;
+}  // end SmfDpdWindow::SetStateFile()
+
+unsigned int SmfDpdWindow::Restore(unsigned int currentTime)
+{
+    if ((NULL == state_file) || !state_file->IsOpen()) return 0;
+    unsigned int count = 0;
+    SmfStateFile::Record* record = NULL;
+    while (NULL != (record = state_file->GetNextPending(SmfStateFile::WINDOW, record)))
+    {
+        SmfFlowKey flowKey;
+        if ((state_if_index != record->if_index) ||
+            !flowKey.SetKey(record->flow_id, record->flow_id_size) ||
+            (NULL != flow_list.Find(flowKey)))
+        {
+            continue;
+        }
+        UINT32 windowSize = record->window_size;
+        if (windowSize < window_size_min) windowSize = window_size_min;
+        if (windowSize > window_size_max) windowSize = window_size_max;
+        Flow* theFlow = new Flow();
+        if (NULL == theFlow)
+        {
+            PLOG(PL_ERROR, "SmfDpdWindow::Restore() new Flow() error: %s\n", GetErrorString());
+            break;
+        }
+        if (!theFlow->Init(flowKey,
+                           record->pkt_id_size,
+                           windowSize,
+                           (windowSize > window_past_max) ? windowSize : window_past_max,
+                           window_size_min,
+                           window_size_max))
+        {
+            PLOG(PL_ERROR, "SmfDpdWindow::Restore() SmfDpdWindow::Flow::Init() error\n");
+            delete theFlow;
+            continue;  // (record is released with other unclaimed records)
+        }
+        theFlow->Restore(record->value);
+        theFlow->SetUpdateTime(currentTime);
+        theFlow->SetAdaptTime(currentTime);
+        state_file->Claim(*record);
+        theFlow->SetStateRecord(record);
+        flow_list.Append(*theFlow);
+        EnforceFlowBudget(currentTime, *theFlow);
+        count++;
+    }
+    return count;
+}  // end SmfDpdWindow::Restore()
+
 bool SmfDpdWindow::Init(UINT32 windowSize,       // in packets
-                        UINT32 windowPastMax)    // in packets
+                        UINT32 windowPastMax,    // in packets
+                        UINT32 windowSizeMin,    // in packets
+                        UINT32 windowSizeMax)    // in packets
 {
     Destroy();
     if (windowPastMax < windowSize)
@@ -649,16 +961,26 @@ bool SmfDpdWindow::Init(UINT32 windowSize,       // in packets
         PLOG(PL_ERROR, "SmfDpdWindow::Init() error: invalid windowPastMax value\n");
         return false;
     }
+    if ((0 == windowSizeMin) && (0 == windowSizeMax))
+    {
+        windowSizeMin = windowSizeMax = windowSize;  // fixed window size
+    }
+    else if ((0 == windowSizeMin) || (windowSizeMax < windowSizeMin))
+    {
+        PLOG(PL_ERROR, "SmfDpdWindow::Init() error: invalid window size bounds\n");
+        return false;
+    }
     window_size = windowSize;
     window_past_max = windowPastMax;
+    window_size_min = windowSizeMin;
+    window_size_max = windowSizeMax;
     return true;
 }  // end SmfDpdWindow::Init()
 
-bool SmfDpdWindow::IsDuplicate(unsigned int   currentTime,
-                               const char*    flowId,
-                               unsigned int   flowIdSize,   // in bits
-                               const char*    pktId,
-                               unsigned int   pktIdSize)    // in bits  (must be <= 32)
+bool SmfDpdWindow::IsDuplicate(unsigned int      currentTime,
+                               const SmfFlowKey& flowKey,
+                               const char*       pktId,
+                               unsigned int      pktIdSize)    // in bits  (must be <= 32)
 {
     if (pktIdSize > 32)
     {
@@ -672,7 +994,7 @@ bool SmfDpdWindow::IsDuplicate(unsigned int   currentTime,
     memcpy(((char*)&pktIdValue) + (4 - pktIdValueLen), pktId, pktIdValueLen);
     pktIdValue = ntohl(pktIdValue);
 
-    Flow* theFlow = static_cast<Flow*>(flow_list.Find(flowId, flowIdSize));
+    Flow* theFlow = static_cast<Flow*>(flow_list.Find(flowKey));
     if (NULL == theFlow)
     {
         // (TBD) We should have a max number of entries in tree
@@ -684,21 +1006,33 @@ bool SmfDpdWindow::IsDuplicate(unsigned int   currentTime,
             return true;  // returns true to be safe (but breaks forwarding)
         }
         // (TBD) set window_size_past properly
-        if (!theFlow->Init(flowId,
-                           flowIdSize,
+        if (!theFlow->Init(flowKey,
                            pktIdSize,
                            window_size,
-                           window_past_max))
+                           window_past_max,
+                           window_size_min,
+                           window_size_max))
         {
             PLOG(PL_ERROR,"SmfDpdWindow::IsDuplicate() SmfSlidingWindow::Flow::Init() error\n");
             delete theFlow;
             return true;  // returns true to be safe (but breaks forwarding)
         }
-        // (TBD) we may want to set a cache limit
-        // (max number of entries in flow_list/flow_tree)
         theFlow->SetUpdateTime(currentTime);
+        theFlow->SetAdaptTime(currentTime);
         flow_list.Append(*theFlow);
         theFlow->IsDuplicate(pktIdValue);
+        if (NULL != state_file)
+        {
+            SmfStateFile::Record* record = state_file->Allocate(SmfStateFile::WINDOW, flowKey.GetBuffer(), flowKey.GetSize());
+            if (NULL != record)
+            {
+                record->pkt_id_size = (UINT8)pktIdSize;
+                record->if_index = state_if_index;
+                theFlow->SetStateRecord(record);
+                theFlow->SaveState();
+            }
+        }
+        EnforceFlowBudget(currentTime, *theFlow);
         return false;
     }
     else
@@ -719,6 +1053,10 @@ bool SmfDpdWindow::IsDuplicate(unsigned int   currentTime,
             // "Bubble up" fresh flow to head of list
             theFlow->SetUpdateTime(currentTime);
             flow_list.MoveToTail(*theFlow);
+            // (adaptive sizing is done as flows are updated so Prune() only visits stale flows)
+            if (window_size_min < window_size_max)
+                theFlow->Adapt(currentTime);
+            theFlow->SaveState();
             return false;
         }
     }
@@ -732,22 +1070,513 @@ void SmfDpdWindow::Prune(unsigned int currentTime,
     while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
     {
         if (nextFlow->GetAge(currentTime) > ageMax)
+            DeleteFlow(nextFlow);
+        else
+            return;
+    }
+}  // end SmfDpdWindow::Prune()
+
+void SmfDpdWindow::EvictFlow(SmfFlow& flow)
+{
+    DeleteFlow(static_cast<Flow*>(&flow));
+}  // end SmfDpdWindow::EvictFlow()
+
+unsigned int SmfDpdWindow::GetWindowSizeCounts(unsigned int sizeCount[32]) const
+{
+    memset(sizeCount, 0, 32*sizeof(unsigned int));
+    unsigned int memory = 0;
+    SmfFlow::Iterator iterator(flow_list);
+    const Flow* nextFlow;
+    while (NULL != (nextFlow = static_cast<const Flow*>(iterator.GetNextFlow())))
+    {
+        UINT32 size = nextFlow->GetWindowSize();
+        unsigned int n = 0;
+        while ((n < 31) && (((UINT32)1 << n) < size)) n++;
+        sizeCount[n]++;
+        memory += (size + 7) >> 3;
+    }
+    return memory;
+}  // end SmfDpdWindow::GetWindowSizeCounts()
+
+/////////////////////////////////////////////////////////////////////
+//  SmfDpdHashTable implementation
+
+SmfDpdHashTable::SmfDpdHashTable()
+ : capacity(0), slot_mask(0), entry_index(NULL), flow_index(NULL), entry_array(NULL),
+   entry_head(0), entry_count(0), flow_count(0), member_alloc(0)
+{
+}
+
+SmfDpdHashTable::~SmfDpdHashTable()
+{
+    Destroy();
+}
+
+bool SmfDpdHashTable::Init(unsigned int capacityMax)
+{
+    Destroy();
+    if ((0 == capacityMax) || (capacityMax > 0x40000000))
+    {
+        PLOG(PL_ERROR, "SmfDpdHashTable::Init() error: invalid capacity\n");
+        return false;
+    }
+    unsigned int size = 1;
+    while (size < capacityMax) size <<= 1;
+    if (NULL == (entry_array = new Entry[size]))
+    {
+        PLOG(PL_ERROR, "SmfDpdHashTable::Init() new entry_array error: %s\n", GetErrorString());
+        return false;
+    }
+    if ((NULL == (entry_index = new Slot[2*size])) || (NULL == (flow_index = new Slot[2*size])))
+    {
+        PLOG(PL_ERROR, "SmfDpdHashTable::Init() new index error: %s\n", GetErrorString());
+        Destroy();
+        return false;
+    }
+    memset(entry_index, 0, 2*size*sizeof(Slot));
+    memset(flow_index, 0, 2*size*sizeof(Slot));
+    capacity = size;
+    slot_mask = 2*size - 1;
+    entry_head = entry_count = flow_count = 0;
+    return true;
+}  // end SmfDpdHashTable::Init()
+
+void SmfDpdHashTable::Destroy()
+{
+    if (NULL != entry_array)
+    {
+        delete[] entry_array;
+        entry_array = NULL;
+    }
+    if (NULL != entry_index)
+    {
+        delete[] entry_index;
+        entry_index = NULL;
+    }
+    if (NULL != flow_index)
+    {
+        delete[] flow_index;
+        flow_index = NULL;
+    }
+    capacity = 0;
+    slot_mask = 0;
+    entry_head = entry_count = flow_count = 0;
+}  // end SmfDpdHashTable::Destroy()
+
+// Returns index of the "flow_index" slot for the given "flowHash" or the empty slot where it belongs
+UINT32 SmfDpdHashTable::FindFlowSlot(UINT32 flowHash) const
+{
+    UINT32 index = flowHash & slot_mask;
+    while ((0 != flow_index[index].value) && (flowHash != flow_index[index].tag))
+        index = (index + 1) & slot_mask;
+    return index;
+}  // end SmfDpdHashTable::FindFlowSlot()
+
+// Empties the given slot, shifting any subsequent slots of its probe run back so
+// lookups still work without "tombstone" markers
+void SmfDpdHashTable::RemoveSlot(Slot* table, UINT32 index, bool isEntryTable)
+{
+    UINT32 next = index;
+    for (;;)
+    {
+        next = (next + 1) & slot_mask;
+        if (0 == table[next].value) break;
+        // The slot at "next" can be moved back to "index" unless its home slot is cyclically in (index, next]
+        UINT32 home = table[next].tag & slot_mask;
+        if ((index <= next) ? ((index < home) && (home <= next)) : ((index < home) || (home <= next)))
+            continue;
+        table[index] = table[next];
+        if (isEntryTable) entry_array[table[index].value - 1].slot = index;
+        index = next;
+    }
+    table[index].value = 0;
+}  // end SmfDpdHashTable::RemoveSlot()
+
+void SmfDpdHashTable::EvictOldest()
+{
+    Entry& entry = entry_array[(entry_head - entry_count) & (capacity - 1)];
+    RemoveSlot(entry_index, entry.slot, true);
+    UINT32 flowSlot = FindFlowSlot(entry.flow_hash);
+    if (0 != flow_index[flowSlot].value)
+    {
+        if (0 == --flow_index[flowSlot].value)
         {
-            flow_list.Remove(*nextFlow);
-            delete nextFlow;
+            RemoveSlot(flow_index, flowSlot, false);
+            flow_count--;
         }
-        else
+    }
+    entry_count--;
+}  // end SmfDpdHashTable::EvictOldest()
+
+bool SmfDpdHashTable::IsDuplicate(unsigned int      currentTime,
+                                  const SmfFlowKey& flowKey,
+                                  const char*       pktId,
+                                  unsigned int      pktIdSize,    // in bits
+                                  UINT64            memberBit)
+{
+    const char* flowId = flowKey.GetBuffer();
+    unsigned int flowIdSize = flowKey.GetSize();
+    unsigned int flowIdBytes = flowKey.GetLength();
+    unsigned int pktIdBytes = pktIdSize >> 3;
+    if (0 != (pktIdSize & 0x07))
+    {
+        PLOG(PL_ERROR, "SmfDpdHashTable::IsDuplicate() error: pktIdSize not multiple of 8\n");
+        return true;
+    }
+    if ((flowIdBytes > MAX_FLOW_ID_BYTES) || (pktIdBytes > MAX_PKT_ID_BYTES))
+    {
+        PLOG(PL_ERROR, "SmfDpdHashTable::IsDuplicate() error: oversized flowId or pktId\n");
+        return true;
+    }
+    if (NULL == entry_array)
+    {
+        PLOG(PL_ERROR, "SmfDpdHashTable::IsDuplicate() error: not initialized\n");
+        return true;  // on failure, don't forward
+    }
+    // 1) Look up the <flowId:pktId> key
+    UINT32 flowHash = flowKey.GetHash();
+    UINT32 hash = SmfFlowKey::ComputeHash(pktId, pktIdBytes, flowHash);
+    UINT32 index = hash & slot_mask;
+    while (0 != entry_index[index].value)
+    {
+        if (hash == entry_index[index].tag)
         {
-            return;
+            Entry& entry = entry_array[entry_index[index].value - 1];
+            if ((flowHash == entry.flow_hash) && (flowIdSize == entry.flow_id_size) &&
+                (pktIdSize == entry.pkt_id_size) &&
+                (0 == memcmp(entry.key, flowId, flowIdBytes)) &&
+                (0 == memcmp(entry.key + flowIdBytes, pktId, pktIdBytes)))
+            {
+                if (0 != (memberBit & entry.member_mask)) return true;
+                entry.member_mask |= memberBit;  // first seen by this member
+                return false;
+            }
         }
+        index = (index + 1) & slot_mask;
     }
-}  // end SmfDpdWindow::Prune()
+    // 2) Not a duplicate, so add it, evicting the oldest entry if the table is full
+    //    (eviction may shift our probe run, so the free slot is found again then)
+    if (entry_count == capacity)
+    {
+        EvictOldest();
+        index = hash & slot_mask;
+        while (0 != entry_index[index].value)
+            index = (index + 1) & slot_mask;
+    }
+    UINT32 entryIndex = entry_head & (capacity - 1);
+    Entry& entry = entry_array[entryIndex];
+    entry.member_mask = memberBit;
+    entry.flow_hash = flowHash;
+    entry.slot = index;
+    entry.arrival_time = currentTime;
+    entry.flow_id_size = flowIdSize;
+    entry.pkt_id_size = pktIdSize;
+    memcpy(entry.key, flowId, flowIdBytes);
+    memcpy(entry.key + flowIdBytes, pktId, pktIdBytes);
+    entry_index[index].tag = hash;
+    entry_index[index].value = entryIndex + 1;
+    entry_head++;
+    entry_count++;
+    UINT32 flowSlot = FindFlowSlot(flowHash);
+    if (0 == flow_index[flowSlot].value)
+    {
+        flow_index[flowSlot].tag = flowHash;
+        flow_count++;
+    }
+    flow_index[flowSlot].value++;
+    return false;
+}  // end SmfDpdHashTable::IsDuplicate()
+
+void SmfDpdHashTable::Prune(unsigned int currentTime, unsigned int ageMax)
+{
+    // Entries are in arrival order, so we only need to check the oldest ones
+    while (0 != entry_count)
+    {
+        const Entry& oldest = entry_array[(entry_head - entry_count) & (capacity - 1)];
+        if ((currentTime - oldest.arrival_time) <= ageMax) break;
+        EvictOldest();
+    }
+}  // end SmfDpdHashTable::Prune()
+
+int SmfDpdHashTable::AllocMember()
+{
+    for (int i = 0; i < 64; i++)
+    {
+        if (0 == (member_alloc & (((UINT64)1) << i)))
+        {
+            member_alloc |= ((UINT64)1) << i;
+            return i;
+        }
+    }
+    return -1;
+}  // end SmfDpdHashTable::AllocMember()
+
+void SmfDpdHashTable::ReleaseMember(int memberIndex)
+{
+    if ((memberIndex < 0) || (memberIndex > 63)) return;
+    UINT64 memberBit = ((UINT64)1) << memberIndex;
+    member_alloc &= ~memberBit;
+    // Clear the member's marks so a later user of the index starts fresh
+    for (unsigned int i = 0; i < entry_count; i++)
+        entry_array[(entry_head - entry_count + i) & (capacity - 1)].member_mask &= ~memberBit;
+}  // end SmfDpdHashTable::ReleaseMember()
+
+unsigned int SmfDpdHashTable::GetMemberCount() const
+{
+    unsigned int count = 0;
+    for (UINT64 mask = member_alloc; 0 != mask; mask &= (mask - 1))
+        count++;
+    return count;
+}  // end SmfDpdHashTable::GetMemberCount()
+
+/////////////////////////////////////////////////////////////////////
+//  SmfDpdShared implementation
+
+SmfDpdShared::SmfDpdShared(SmfDpdHashTable& theStore)
+ : store(theStore), member_index(-1)
+{
+}
+
+SmfDpdShared::~SmfDpdShared()
+{
+    Destroy();
+}
+
+bool SmfDpdShared::Init()
+{
+    Destroy();
+    if (0 == store.GetCapacity())
+    {
+        PLOG(PL_ERROR, "SmfDpdShared::Init() error: shared store not initialized\n");
+        return false;
+    }
+    if ((member_index = store.AllocMember()) < 0)
+    {
+        PLOG(PL_ERROR, "SmfDpdShared::Init() error: shared store member limit (64) reached\n");
+        return false;
+    }
+    return true;
+}  // end SmfDpdShared::Init()
+
+void SmfDpdShared::Destroy()
+{
+    if (member_index >= 0)
+    {
+        store.ReleaseMember(member_index);
+        member_index = -1;
+    }
+}  // end SmfDpdShared::Destroy()
+
+/////////////////////////////////////////////////////////////////////
+//  SmfDpdFilter implementation
+
+const double SmfDpdFilter::FP_RATE_DEFAULT = 1.0e-06;
+
+SmfDpdFilter::SmfDpdFilter()
+ : gen_current(0), bucket_mask(0), fp_bits(0), fp_mask(0), kick_seed(0x2545f491)
+{
+    memset(gen_array, 0, sizeof(gen_array));
+}
+
+SmfDpdFilter::~SmfDpdFilter()
+{
+    Destroy();
+}
+
+bool SmfDpdFilter::Init(unsigned int memoryBytes, double fpRate)
+{
+    Destroy();
+    if ((fpRate <= 0.0) || (fpRate >= 1.0))
+    {
+        PLOG(PL_ERROR, "SmfDpdFilter::Init() error: invalid false positive rate\n");
+        return false;
+    }
+    // A lookup checks 2 buckets in each generation, so the worst-case false positive
+    // rate is about (2 * BUCKET_SIZE * GENERATIONS) / 2^fpBits
+    unsigned int fpBits = 4;
+    while ((fpBits < 32) && (((double)(2 * BUCKET_SIZE * GENERATIONS) / (double)((UINT64)1 << fpBits)) > fpRate))
+        fpBits++;
+    // Largest power of 2 bucket count per generation that fits the memory budget
+    unsigned int bucketsMax = memoryBytes / (GENERATIONS * BUCKET_SIZE * sizeof(UINT32));
+    if (bucketsMax < 16)
+    {
+        PLOG(PL_ERROR, "SmfDpdFilter::Init() error: memory budget too small\n");
+        return false;
+    }
+    unsigned int buckets = 1;
+    while ((buckets << 1) <= bucketsMax) buckets <<= 1;
+    for (unsigned int i = 0; i < GENERATIONS; i++)
+    {
+        if (NULL == (gen_array[i].slot = new UINT32[buckets * BUCKET_SIZE]))
+        {
+            PLOG(PL_ERROR, "SmfDpdFilter::Init() new slot array error: %s\n", GetErrorString());
+            Destroy();
+            return false;
+        }
+        memset(gen_array[i].slot, 0, buckets * BUCKET_SIZE * sizeof(UINT32));
+        gen_array[i].count = 0;
+        gen_array[i].start_time = 0;
+    }
+    gen_current = 0;
+    bucket_mask = buckets - 1;
+    fp_bits = fpBits;
+    fp_mask = (32 == fpBits) ? 0xffffffff : ((((UINT32)1) << fpBits) - 1);
+    return true;
+}  // end SmfDpdFilter::Init()
+
+void SmfDpdFilter::Destroy()
+{
+    for (unsigned int i = 0; i < GENERATIONS; i++)
+    {
+        if (NULL != gen_array[i].slot)
+        {
+            delete[] gen_array[i].slot;
+            gen_array[i].slot = NULL;
+        }
+        gen_array[i].count = 0;
+    }
+    gen_current = 0;
+    bucket_mask = 0;
+    fp_bits = 0;
+    fp_mask = 0;
+}  // end SmfDpdFilter::Destroy()
+
+bool SmfDpdFilter::Contains(const Generation& gen, UINT32 index, UINT32 fp) const
+{
+    const UINT32* bucket = gen.slot + (index * BUCKET_SIZE);
+    if ((fp == bucket[0]) || (fp == bucket[1]) || (fp == bucket[2]) || (fp == bucket[3]))
+        return true;
+    bucket = gen.slot + (GetAltIndex(index, fp) * BUCKET_SIZE);
+    return ((fp == bucket[0]) || (fp == bucket[1]) || (fp == bucket[2]) || (fp == bucket[3]));
+}  // end SmfDpdFilter::Contains()
+
+// Inserts "fp" at bucket "index" (or its alternate), displacing fingerprints as
+// needed.  Returns "false" if the generation is full, with "fp" and "index" set
+// to the (displaced) fingerprint that could not be placed and its bucket.
+bool SmfDpdFilter::Insert(Generation& gen, UINT32& index, UINT32& fp)
+{
+    UINT32 altIndex = GetAltIndex(index, fp);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        UINT32* bucket = gen.slot + (((0 == i) ? index : altIndex) * BUCKET_SIZE);
+        for (unsigned int j = 0; j < BUCKET_SIZE; j++)
+        {
+            if (0 == bucket[j])
+            {
+                bucket[j] = fp;
+                gen.count++;
+                return true;
+            }
+        }
+    }
+    for (unsigned int k = 0; k < KICK_MAX; k++)
+    {
+        // xorshift32 picks the victim slot (and the starting bucket)
+        kick_seed ^= kick_seed << 13;
+        kick_seed ^= kick_seed >> 17;
+        kick_seed ^= kick_seed << 5;
+        if (0 == k) index = (0 != (kick_seed & 0x100)) ? altIndex : index;
+        UINT32* bucket = gen.slot + (index * BUCKET_SIZE);
+        UINT32 victim = bucket[kick_seed & (BUCKET_SIZE - 1)];
+        bucket[kick_seed & (BUCKET_SIZE - 1)] = fp;
+        fp = victim;
+        index = GetAltIndex(index, fp);
+        bucket = gen.slot + (index * BUCKET_SIZE);
+        for (unsigned int j = 0; j < BUCKET_SIZE; j++)
+        {
+            if (0 == bucket[j])
+            {
+                bucket[j] = fp;
+                gen.count++;
+                return true;
+            }
+        }
+    }
+    return false;
+}  // end SmfDpdFilter::Insert()
+
+// Clears the oldest generation and makes it the current one
+void SmfDpdFilter::Rotate(unsigned int currentTime)
+{
+    gen_current = (gen_current + 1) % GENERATIONS;
+    Generation& gen = gen_array[gen_current];
+    memset(gen.slot, 0, (bucket_mask + 1) * BUCKET_SIZE * sizeof(UINT32));
+    gen.count = 0;
+    gen.start_time = currentTime;
+}  // end SmfDpdFilter::Rotate()
+
+bool SmfDpdFilter::IsDuplicate(unsigned int      currentTime,
+                               const SmfFlowKey& flowKey,
+                               const char*       pktId,
+                               unsigned int      pktIdSize)    // in bits
+{
+    if (0 != (pktIdSize & 0x07))
+    {
+        PLOG(PL_ERROR, "SmfDpdFilter::IsDuplicate() error: pktIdSize not multiple of 8\n");
+        return true;
+    }
+    if (NULL == gen_array[0].slot)
+    {
+        PLOG(PL_ERROR, "SmfDpdFilter::IsDuplicate() error: not initialized\n");
+        return true;  // on failure, don't forward
+    }
+    // The bucket index and fingerprint come from independent hashes of the <flowId:pktId> key
+    // (a zero fingerprint is reserved to mark empty slots)
+    UINT32 flowHash = flowKey.GetHash();
+    UINT32 index = SmfFlowKey::ComputeHash(pktId, pktIdSize >> 3, flowHash) & bucket_mask;
+    UINT32 fp = SmfFlowKey::ComputeHash(pktId, pktIdSize >> 3, ~flowHash) & fp_mask;
+    if (0 == fp) fp = 1;
+    for (unsigned int i = 0; i < GENERATIONS; i++)
+    {
+        if (Contains(gen_array[i], index, fp)) return true;
+    }
+    Generation& gen = gen_array[gen_current];
+    if (0 == gen.count) gen.start_time = currentTime;
+    if (!Insert(gen, index, fp))
+    {
+        // Current generation is full, so start a new one with the fingerprint that was left over
+        PLOG(PL_DEBUG, "SmfDpdFilter::IsDuplicate() generation full (count %u)\n", gen.count);
+        Rotate(currentTime);
+        Insert(gen_array[gen_current], index, fp);
+    }
+    return false;
+}  // end SmfDpdFilter::IsDuplicate()
+
+void SmfDpdFilter::Prune(unsigned int currentTime, unsigned int ageMax)
+{
+    // Keys are remembered for between "ageMax" and GENERATIONS*ageMax
+    const Generation& gen = gen_array[gen_current];
+    if ((NULL != gen.slot) && (0 != gen.count) && ((currentTime - gen.start_time) >= ageMax))
+        Rotate(currentTime);
+}  // end SmfDpdFilter::Prune()
+
+double SmfDpdFilter::GetOccupancy() const
+{
+    if (NULL == gen_array[0].slot) return 0.0;
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < GENERATIONS; i++)
+        count += gen_array[i].count;
+    return ((double)count / (double)(GENERATIONS * BUCKET_SIZE * (bucket_mask + 1)));
+}  // end SmfDpdFilter::GetOccupancy()
+
+double SmfDpdFilter::GetFalsePositiveRate() const
+{
+    // A lookup compares against the fingerprints in 2 buckets per generation,
+    // each of which matches with probability 1/(2^fpBits - 1)
+    if (NULL == gen_array[0].slot) return 0.0;
+    double fpSpace = (double)fp_mask;
+    double rate = 0.0;
+    for (unsigned int i = 0; i < GENERATIONS; i++)
+        rate += (2.0 * (double)gen_array[i].count) / ((double)(bucket_mask + 1) * fpSpace);
+    return rate;
+}  // end SmfDpdFilter::GetFalsePositiveRate()
 
 /////////////////////////////////////////////////////////////////////
 //  Implementation of classes used for SMF resequencing functions
 
 SmfSequenceMgr::SmfSequenceMgr()
- : seq_mask(0)
+ : SmfFlowBudget::Member(flow_list), seq_mask(0),
+   state_file(NULL), state_type(SmfStateFile::SEQ_IPV4)
 {
 }
 
@@ -756,6 +1585,71 @@ SmfSequenceMgr::~SmfSequenceMgr()
     Destroy();
 }
 
+void SmfSequenceMgr::Destroy()
+{
+    SmfFlow::Iterator iterator(flow_list);
+    Flow* nextFlow;
+    while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
+    {
+        if (NULL != state_file) state_file->Release(nextFlow->GetStateRecord());
+    }
+    flow_list.Destroy();
+}  // end SmfSequenceMgr::Destroy()
+
+void SmfSequenceMgr::DeleteFlow(Flow* flow)
+{
+    if (NULL != state_file) state_file->Release(flow->GetStateRecord());
+    flow_list.Remove(*flow);
+    delete flow;
+}  // end SmfSequenceMgr::DeleteFlow()
+
+void SmfSequenceMgr::SetStateFile(SmfStateFile* stateFile, SmfStateFile::RecordType stateType)
+{
+    SmfFlow::Iterator iterator(flow_list);
+    Flow* nextFlow;
+    while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
+        nextFlow->SetStateRecord(NULL);
+    state_file = stateFile;
+    state_type = stateType;
+}  // end SmfSequenceMgr::SetStateFile()
+
+unsigned int SmfSequenceMgr::Restore(unsigned int currentTime)
+{
+    if ((NULL == state_file) || !state_file->IsOpen()) return 0;
+    unsigned int count = 0;
+    SmfStateFile::Record* record = NULL;
+    while (NULL != (record = state_file->GetNextPending(state_type, record)))
+    {
+        SmfFlowKey flowKey;
+        if (!flowKey.SetKey(record->flow_id, record->flow_id_size) ||
+            (NULL != flow_list.Find(flowKey)))
+        {
+            continue;
+        }
+        Flow* flow = new Flow();
+        if (NULL == flow)
+        {
+            PLOG(PL_ERROR, "SmfSequenceMgr::Restore() new Flow error: %s\n", GetErrorString());
+            break;
+        }
+        if (!flow->Init(flowKey))
+        {
+            PLOG(PL_ERROR, "SmfSequenceMgr::Restore() flow init error\n");
+            delete flow;
+            continue;
+        }
+        // Resume the flow's sequence where it left off
+        flow->SetSequence(record->value);
+        flow->SetUpdateTime(currentTime);
+        state_file->Claim(*record);
+        flow->SetStateRecord(record);
+        flow_list.Append(*flow);
+        EnforceFlowBudget(currentTime, *flow);
+        count++;
+    }
+    return count;
+}  // end SmfSequenceMgr::Restore()
+
 bool SmfSequenceMgr::Init(UINT8 numSeqBits)
 {
     seq_mask = 0xffffffff;
@@ -768,26 +1662,19 @@ bool SmfSequenceMgr::Init(UINT8 numSeqBits)
 UINT32 SmfSequenceMgr::GetSequence(const ProtoAddress* dstAddr,
                                    const ProtoAddress* srcAddr) const
 {
-    char addrKey[32];  // big enough for up IPv6 src::dst concatenation
-    unsigned int addrBits = 0;
-    if (NULL != srcAddr)
-    {
-        addrBits = srcAddr->GetLength();
-        memcpy(addrKey, srcAddr->GetRawHostAddress(), addrBits);
-    }
+    SmfFlowKey addrKey;  // src::dst concatenation
+    if (NULL != srcAddr) addrKey.AppendAddress(*srcAddr);
     if (NULL != dstAddr)
     {
-        unsigned int dstLen = dstAddr->GetLength();
-        memcpy(addrKey+addrBits, dstAddr->GetRawHostAddress(), dstLen);
-        addrBits += dstLen;
+        addrKey.AppendAddress(*dstAddr);
     }
     else
     {
         PLOG(PL_ERROR, "SmfSequenceMgr::IncrementSequence() warning: NULL dstAddr?!\n");
         ASSERT(0);
     }
-    addrBits <<= 3;
-    Flow* flow = static_cast<Flow*>(flow_list.Find(addrKey, addrBits));
+    addrKey.Finalize();
+    Flow* flow = static_cast<Flow*>(flow_list.Find(addrKey));
     if (NULL != flow)
     {
         return flow->GetSequence();
@@ -804,26 +1691,19 @@ UINT32 SmfSequenceMgr::IncrementSequence(unsigned int        updateTime,
                                          const ProtoAddress* dstAddr,
                                          const ProtoAddress* srcAddr)
 {
-    char addrKey[32];  // big enough for up IPv6 src::dst concatenation
-    unsigned int addrBits = 0;
-    if (NULL != srcAddr)
-    {
-        addrBits = srcAddr->GetLength();
-        memcpy(addrKey, srcAddr->GetRawHostAddress(), addrBits);
-    }
+    SmfFlowKey addrKey;  // src::dst concatenation
+    if (NULL != srcAddr) addrKey.AppendAddress(*srcAddr);
     if (NULL != dstAddr)
     {
-        unsigned int dstLen = dstAddr->GetLength();
-        memcpy(addrKey+addrBits, dstAddr->GetRawHostAddress(), dstLen);
-        addrBits += dstLen;
+        addrKey.AppendAddress(*dstAddr);
     }
     else
     {
         PLOG(PL_ERROR, "SmfSequenceMgr::IncrementSequence() warning: NULL dstAddr?!\n");
         ASSERT(0);
     }
-    addrBits <<= 3;
-    Flow* flow = static_cast<Flow*>(flow_list.Find(addrKey, addrBits));
+    addrKey.Finalize();
+    Flow* flow = static_cast<Flow*>(flow_list.Find(addrKey));
     if (NULL == flow)
     {
         if (NULL == (flow = new Flow()))
@@ -831,10 +1711,13 @@ UINT32 SmfSequenceMgr::IncrementSequence(unsigned int        updateTime,
             PLOG(PL_ERROR, "SmfSequenceMgr::IncrementSequence() new Item error: %s\n", GetErrorString());
             return  (seq_global++ & seq_mask);
         }
-        flow->Init(addrKey, addrBits);
+        flow->Init(addrKey);
         flow->SetSequence((UINT32)rand() & seq_mask);
         flow->SetUpdateTime(updateTime);
+        if (NULL != state_file)
+            flow->SetStateRecord(state_file->Allocate(state_type, addrKey.GetBuffer(), addrKey.GetSize()));
         flow_list.Append(*flow);
+        EnforceFlowBudget(updateTime, *flow);
     }
     else
     {
@@ -852,18 +1735,21 @@ void SmfSequenceMgr::Prune(unsigned int currentTime,
     while (NULL != (nextFlow = static_cast<Flow*>(iterator.GetNextFlow())))
     {
         if (nextFlow->GetAge(currentTime) > ageMax)
-        {
-            flow_list.Remove(*nextFlow);
-            delete nextFlow;
-        }
+            DeleteFlow(nextFlow);
         else
-        {
             return;
-        }
     }
 }  // end SmfSequenceMgr::Prune()
 
+void SmfSequenceMgr::EvictFlow(SmfFlow& flow)
+{
+    DeleteFlow(static_cast<Flow*>(&flow));
+}  // end SmfSequenceMgr::EvictFlow()
+
+SmfSlab SmfSequenceMgr::Flow::slab("seq", sizeof(SmfSequenceMgr::Flow));
+
 SmfSequenceMgr::Flow::Flow()
+ : sequence(0), state_record(NULL)
 {
 }
 
@@ -0,0 +1,93 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfFlowKey.h"
+
+bool SmfFlowKey::SetSize(unsigned int keySize)
+{
+    unsigned int keyBytes = (keySize + 7) >> 3;
+    if (keyBytes > KEY_BYTES_MAX)
+    {
+        key_size = 0;
+        key_hash = 0;
+        return false;
+    }
+    char* ptr = (char*)key_word;
+    // Zero any unused bits of the last key byte and the rest of its word
+    if (0 != (keySize & 0x07))
+        ptr[keyBytes - 1] &= (char)(0xff << (8 - (keySize & 0x07)));
+    unsigned int padBytes = ((keyBytes + 7) & ~7) - keyBytes;
+    memset(ptr + keyBytes, 0, padBytes);
+    key_size = keySize;
+    key_hash = ComputeHash(ptr, keyBytes, keySize);
+    return true;
+}  // end SmfFlowKey::SetSize()
+
+// This is the MurmurHash3 (x86_32) algorithm
+UINT32 SmfFlowKey::ComputeHash(const char* buffer, unsigned int length, UINT32 seed)
+{
+    const UINT32 C1 = 0xcc9e2d51;
+    const UINT32 C2 = 0x1b873593;
+    UINT32 h = seed;
+    unsigned int i = 0;
+    for (; (i + 4) <= length; i += 4)
+    {
+        UINT32 k;
+        memcpy(&k, buffer + i, 4);
+        k *= C1;
+        k = (k << 15) | (k >> 17);
+        k *= C2;
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h*5 + 0xe6546b64;
+    }
+    UINT32 k = 0;
+    switch (length & 3)
+    {
+        case 3:
+            k ^= ((UINT32)(UINT8)buffer[i + 2]) << 16;
+        case 2:
+            k ^= ((UINT32)(UINT8)buffer[i + 1]) << 8;
+        case 1:
+            k ^= (UINT32)(UINT8)buffer[i];
+            k *= C1;
+            k = (k << 15) | (k >> 17);
+            k *= C2;
+            h ^= k;
+        default:
+            break;
+    }
+    h ^= length;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}  // end SmfFlowKey::ComputeHash()
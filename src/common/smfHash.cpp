@@ -1,7 +1,14 @@
 #include "smfHash.h"
+#include "protoDebug.h"
 
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SMF_CRC_X86
+#include <nmmintrin.h>  // SSE4.2 crc32
+#include <wmmintrin.h>  // PCLMULQDQ
+#endif // __GNUC__ && x86
+
 SmfHash::SmfHash()
 {
 }
@@ -16,6 +23,9 @@ const char* const SmfHash::TYPE_NAMES[] =
     "MD5",      
     "CRC32",       
     "SHA1", 
+    "CRC32C",
+    "XXH3",
+    "SIPHASH",
     "INVALID",   
     NULL
 };
@@ -111,6 +121,212 @@ void SmfHash::ComputeHashIPv6(ProtoPktIPv6& ipv6Pkt)
 const UINT32 SmfHashCRC32::CRC32_XINIT = 0xFFFFFFFF; // initial value
 const UINT32 SmfHashCRC32::CRC32_XOROT = 0xFFFFFFFF; // final xor value 
 
+// Slice-by-16 tables, where table[0] is the usual byte-at-a-time table and
+// table[k][n] is the CRC contribution of byte value "n" followed by "k" zero bytes
+static UINT32 CRC32_SLICE_TABLE[16][256];
+static UINT32 CRC32C_SLICE_TABLE[16][256];
+
+static void CrcInitSliceTable(UINT32 table[16][256], UINT32 poly)  // (reflected poly)
+{
+    for (unsigned int n = 0; n < 256; n++)
+    {
+        UINT32 crc = n;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 1) ? ((crc >> 1) ^ poly) : (crc >> 1);
+        table[0][n] = crc;
+    }
+    for (unsigned int n = 0; n < 256; n++)
+    {
+        for (int k = 1; k < 16; k++)
+            table[k][n] = (table[k-1][n] >> 8) ^ table[0][table[k-1][n] & 0xFF];
+    }
+}  // end CrcInitSliceTable()
+
+static inline UINT32 CrcLoad32(const unsigned char* ptr)  // (little-endian)
+{
+    return ((UINT32)ptr[0] | ((UINT32)ptr[1] << 8) | ((UINT32)ptr[2] << 16) | ((UINT32)ptr[3] << 24));
+}
+
+static inline UINT32 CrcSlice16(const UINT32 table[16][256], UINT32 crc, const unsigned char* buffer, unsigned int buflen)
+{
+    while (buflen >= 16)
+    {
+        UINT32 w0 = CrcLoad32(buffer) ^ crc;
+        UINT32 w1 = CrcLoad32(buffer + 4);
+        UINT32 w2 = CrcLoad32(buffer + 8);
+        UINT32 w3 = CrcLoad32(buffer + 12);
+        crc = table[15][w0 & 0xFF] ^ table[14][(w0 >> 8) & 0xFF] ^
+              table[13][(w0 >> 16) & 0xFF] ^ table[12][w0 >> 24] ^
+              table[11][w1 & 0xFF] ^ table[10][(w1 >> 8) & 0xFF] ^
+              table[9][(w1 >> 16) & 0xFF] ^ table[8][w1 >> 24] ^
+              table[7][w2 & 0xFF] ^ table[6][(w2 >> 8) & 0xFF] ^
+              table[5][(w2 >> 16) & 0xFF] ^ table[4][w2 >> 24] ^
+              table[3][w3 & 0xFF] ^ table[2][(w3 >> 8) & 0xFF] ^
+              table[1][(w3 >> 16) & 0xFF] ^ table[0][w3 >> 24];
+        buffer += 16;
+        buflen -= 16;
+    }
+    while (buflen-- > 0)
+        crc = table[0][(crc ^ *buffer++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}  // end CrcSlice16()
+
+static UINT32 Crc32Slice16(UINT32 crc, const unsigned char* buffer, unsigned int buflen)
+{
+    return CrcSlice16(CRC32_SLICE_TABLE, crc, buffer, buflen);
+}  // end Crc32Slice16()
+
+static UINT32 Crc32cSlice16(UINT32 crc, const unsigned char* buffer, unsigned int buflen)
+{
+    return CrcSlice16(CRC32C_SLICE_TABLE, crc, buffer, buflen);
+}  // end Crc32cSlice16()
+
+#ifdef SMF_CRC_X86
+
+// CRC-32 by PCLMULQDQ folding of 64-byte blocks (per Gopal et al., "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction", Intel
+// 2009, using the bit-reflected constants for the 0x04C11DB7 polynomial).
+// Any tail (or a buffer shorter than 64 bytes) is done by slice-by-16.
+__attribute__((target("pclmul,sse4.1")))
+static UINT32 Crc32Pclmul(UINT32 crc, const unsigned char* buffer, unsigned int buflen)
+{
+    if (buflen < 64) return Crc32Slice16(crc, buffer, buflen);
+    
+    static const UINT64 K1K2[2] __attribute__((aligned(16))) = {0x0154442bd4ULL, 0x01c6e41596ULL};
+    static const UINT64 K3K4[2] __attribute__((aligned(16))) = {0x01751997d0ULL, 0x00ccaa009eULL};
+    static const UINT64 K5K0[2] __attribute__((aligned(16))) = {0x0163cd6124ULL, 0x0000000000ULL};
+    static const UINT64 POLY[2] __attribute__((aligned(16))) = {0x01db710641ULL, 0x01f7011641ULL};
+    
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    
+    x1 = _mm_loadu_si128((const __m128i*)(buffer + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buffer + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buffer + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buffer + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)K1K2);
+    buffer += 64;
+    buflen -= 64;
+    
+    // Fold four 128-bit lanes in parallel
+    while (buflen >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(buffer + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buffer + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buffer + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buffer + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buffer += 64;
+        buflen -= 64;
+    }
+    
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)K3K4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+    
+    // Fold any remaining 16-byte blocks
+    while (buflen >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buffer);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buffer += 16;
+        buflen -= 16;
+    }
+    
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)K5K0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)POLY);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = (UINT32)_mm_extract_epi32(x1, 1);
+    
+    return Crc32Slice16(crc, buffer, buflen);
+}  // end Crc32Pclmul()
+
+// CRC-32C using the SSE4.2 "crc32" instruction
+__attribute__((target("sse4.2")))
+static UINT32 Crc32cSse42(UINT32 crc, const unsigned char* buffer, unsigned int buflen)
+{
+#ifdef __x86_64__
+    UINT64 crc64 = crc;
+    while (buflen >= 8)
+    {
+        UINT64 word;
+        memcpy(&word, buffer, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        buffer += 8;
+        buflen -= 8;
+    }
+    crc = (UINT32)crc64;
+#endif // __x86_64__
+    while (buflen >= 4)
+    {
+        UINT32 word;
+        memcpy(&word, buffer, 4);
+        crc = _mm_crc32_u32(crc, word);
+        buffer += 4;
+        buflen -= 4;
+    }
+    while (buflen-- > 0)
+        crc = _mm_crc32_u8(crc, *buffer++);
+    return crc;
+}  // end Crc32cSse42()
+
+#endif // SMF_CRC_X86
+
+const char* SmfHashCRC32::engine_name = "slice16";
+SmfHashCRC32::UpdateFunc SmfHashCRC32::update_func = SmfHashCRC32::SelectEngine();
+
+SmfHashCRC32::UpdateFunc SmfHashCRC32::SelectEngine()
+{
+    CrcInitSliceTable(CRC32_SLICE_TABLE, 0xEDB88320);
+    ASSERT(0 == memcmp(CRC32_SLICE_TABLE[0], CRC32_TABLE, sizeof(CRC32_TABLE)));
+#ifdef SMF_CRC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    {
+        engine_name = "pclmul";
+        return Crc32Pclmul;
+    }
+#endif // SMF_CRC_X86
+    engine_name = "slice16";
+    return Crc32Slice16;
+}  // end SmfHashCRC32::SelectEngine()
+
 SmfHashCRC32::SmfHashCRC32()
  : checksum(CRC32_XINIT)
 {
@@ -120,16 +336,35 @@ SmfHashCRC32::~SmfHashCRC32()
 {
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+// begin SmfHashCRC32C Implementation
+
+const char* SmfHashCRC32C::engine_name = "slice16";
+SmfHashCRC32::UpdateFunc SmfHashCRC32C::update_func = SmfHashCRC32C::SelectEngine();
+
+SmfHashCRC32::UpdateFunc SmfHashCRC32C::SelectEngine()
+{
+    CrcInitSliceTable(CRC32C_SLICE_TABLE, 0x82F63B78);
+#ifdef SMF_CRC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        engine_name = "sse4.2";
+        return Crc32cSse42;
+    }
+#endif // SMF_CRC_X86
+    engine_name = "slice16";
+    return Crc32cSlice16;
+}  // end SmfHashCRC32C::SelectEngine()
 
-void SmfHashCRC32::Update(const char*    buffer, 
-                       unsigned int   buflen)
+SmfHashCRC32C::SmfHashCRC32C()
+ : checksum(0xFFFFFFFF)
 {
-    UINT32 result = checksum;
-    const unsigned char* bufPtr = (const unsigned char*)buffer;
-    for (unsigned int i = 0; i < buflen; i++)
-        result = CRC32_TABLE[(result ^ *bufPtr++) & 0xFF] ^ (result >> 8);
-    checksum = result;
-}  // end SmfHashCRC32::Update()
+}
+
+SmfHashCRC32C::~SmfHashCRC32C()
+{
+}
 
 
 /*****************************************************************/
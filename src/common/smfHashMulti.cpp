@@ -0,0 +1,387 @@
+#include "smfHashMulti.h"
+
+#include <string.h>  // for memcpy(), etc
+
+/*
+ * This implements "multi-buffer" MD5 where up to SmfHashMulti::LANES
+ * messages are hashed in parallel, one per 32-bit vector lane.  The MD5
+ * steps are the same as in SmfHashMD5::Transform() (Colin Plumb's public
+ * domain MD5), just applied to a vector of words from each lane's block.
+ * Lanes with fewer blocks are masked off (their state is not updated) once
+ * their last block is done.  Values are verified to match SmfHashMD5 for
+ * all lane counts, message lengths and Update() segmentations.
+ */
+
+#ifdef __GNUC__
+#define SMF_MD5_VECTOR
+#define SMF_MD5_INLINE inline __attribute__((always_inline))
+#define SMF_MD5_ALIGN __attribute__((aligned(4 * SmfHashMulti::LANES)))
+typedef UINT32 Md5Vec __attribute__((vector_size(4 * SmfHashMulti::LANES), may_alias));
+#if defined(__x86_64__) || defined(__i386__)
+#define SMF_MD5_X86
+#endif // x86
+#else
+#define SMF_MD5_INLINE inline
+#define SMF_MD5_ALIGN
+#endif // if/else __GNUC__
+
+static inline UINT32 Md5Load32(const UINT8* ptr)  // (little-endian)
+{
+    return ((UINT32)ptr[0] | ((UINT32)ptr[1] << 8) | ((UINT32)ptr[2] << 16) | ((UINT32)ptr[3] << 24));
+}
+
+static inline void Md5Store32(UINT8* ptr, UINT32 value)  // (little-endian)
+{
+    ptr[0] = (UINT8)value;
+    ptr[1] = (UINT8)(value >> 8);
+    ptr[2] = (UINT8)(value >> 16);
+    ptr[3] = (UINT8)(value >> 24);
+}
+
+/* The four core functions - F1 is optimized somewhat */
+#define F1(x, y, z) (z ^ (x & (y ^ z)))
+#define F2(x, y, z) F1(z, x, y)
+#define F3(x, y, z) (x ^ y ^ z)
+#define F4(x, y, z) (y ^ (x | ~z))
+
+#define MD5STEP(f, w, x, y, z, data, s) \
+	( w += f(x, y, z) + data,  w = w<<s | w>>(32-s),  w += x )
+
+// The 64 MD5 steps over block "x" where "T" is either a single UINT32
+// word or a vector of lane words (the constants are applied to all lanes)
+template <typename T>
+static SMF_MD5_INLINE void Md5Rounds(T& a, T& b, T& c, T& d, const T* x)
+{
+    MD5STEP(F1, a, b, c, d, x[0] + 0xd76aa478, 7);
+    MD5STEP(F1, d, a, b, c, x[1] + 0xe8c7b756, 12);
+    MD5STEP(F1, c, d, a, b, x[2] + 0x242070db, 17);
+    MD5STEP(F1, b, c, d, a, x[3] + 0xc1bdceee, 22);
+    MD5STEP(F1, a, b, c, d, x[4] + 0xf57c0faf, 7);
+    MD5STEP(F1, d, a, b, c, x[5] + 0x4787c62a, 12);
+    MD5STEP(F1, c, d, a, b, x[6] + 0xa8304613, 17);
+    MD5STEP(F1, b, c, d, a, x[7] + 0xfd469501, 22);
+    MD5STEP(F1, a, b, c, d, x[8] + 0x698098d8, 7);
+    MD5STEP(F1, d, a, b, c, x[9] + 0x8b44f7af, 12);
+    MD5STEP(F1, c, d, a, b, x[10] + 0xffff5bb1, 17);
+    MD5STEP(F1, b, c, d, a, x[11] + 0x895cd7be, 22);
+    MD5STEP(F1, a, b, c, d, x[12] + 0x6b901122, 7);
+    MD5STEP(F1, d, a, b, c, x[13] + 0xfd987193, 12);
+    MD5STEP(F1, c, d, a, b, x[14] + 0xa679438e, 17);
+    MD5STEP(F1, b, c, d, a, x[15] + 0x49b40821, 22);
+
+    MD5STEP(F2, a, b, c, d, x[1] + 0xf61e2562, 5);
+    MD5STEP(F2, d, a, b, c, x[6] + 0xc040b340, 9);
+    MD5STEP(F2, c, d, a, b, x[11] + 0x265e5a51, 14);
+    MD5STEP(F2, b, c, d, a, x[0] + 0xe9b6c7aa, 20);
+    MD5STEP(F2, a, b, c, d, x[5] + 0xd62f105d, 5);
+    MD5STEP(F2, d, a, b, c, x[10] + 0x02441453, 9);
+    MD5STEP(F2, c, d, a, b, x[15] + 0xd8a1e681, 14);
+    MD5STEP(F2, b, c, d, a, x[4] + 0xe7d3fbc8, 20);
+    MD5STEP(F2, a, b, c, d, x[9] + 0x21e1cde6, 5);
+    MD5STEP(F2, d, a, b, c, x[14] + 0xc33707d6, 9);
+    MD5STEP(F2, c, d, a, b, x[3] + 0xf4d50d87, 14);
+    MD5STEP(F2, b, c, d, a, x[8] + 0x455a14ed, 20);
+    MD5STEP(F2, a, b, c, d, x[13] + 0xa9e3e905, 5);
+    MD5STEP(F2, d, a, b, c, x[2] + 0xfcefa3f8, 9);
+    MD5STEP(F2, c, d, a, b, x[7] + 0x676f02d9, 14);
+    MD5STEP(F2, b, c, d, a, x[12] + 0x8d2a4c8a, 20);
+
+    MD5STEP(F3, a, b, c, d, x[5] + 0xfffa3942, 4);
+    MD5STEP(F3, d, a, b, c, x[8] + 0x8771f681, 11);
+    MD5STEP(F3, c, d, a, b, x[11] + 0x6d9d6122, 16);
+    MD5STEP(F3, b, c, d, a, x[14] + 0xfde5380c, 23);
+    MD5STEP(F3, a, b, c, d, x[1] + 0xa4beea44, 4);
+    MD5STEP(F3, d, a, b, c, x[4] + 0x4bdecfa9, 11);
+    MD5STEP(F3, c, d, a, b, x[7] + 0xf6bb4b60, 16);
+    MD5STEP(F3, b, c, d, a, x[10] + 0xbebfbc70, 23);
+    MD5STEP(F3, a, b, c, d, x[13] + 0x289b7ec6, 4);
+    MD5STEP(F3, d, a, b, c, x[0] + 0xeaa127fa, 11);
+    MD5STEP(F3, c, d, a, b, x[3] + 0xd4ef3085, 16);
+    MD5STEP(F3, b, c, d, a, x[6] + 0x04881d05, 23);
+    MD5STEP(F3, a, b, c, d, x[9] + 0xd9d4d039, 4);
+    MD5STEP(F3, d, a, b, c, x[12] + 0xe6db99e5, 11);
+    MD5STEP(F3, c, d, a, b, x[15] + 0x1fa27cf8, 16);
+    MD5STEP(F3, b, c, d, a, x[2] + 0xc4ac5665, 23);
+
+    MD5STEP(F4, a, b, c, d, x[0] + 0xf4292244, 6);
+    MD5STEP(F4, d, a, b, c, x[7] + 0x432aff97, 10);
+    MD5STEP(F4, c, d, a, b, x[14] + 0xab9423a7, 15);
+    MD5STEP(F4, b, c, d, a, x[5] + 0xfc93a039, 21);
+    MD5STEP(F4, a, b, c, d, x[12] + 0x655b59c3, 6);
+    MD5STEP(F4, d, a, b, c, x[3] + 0x8f0ccc92, 10);
+    MD5STEP(F4, c, d, a, b, x[10] + 0xffeff47d, 15);
+    MD5STEP(F4, b, c, d, a, x[1] + 0x85845dd1, 21);
+    MD5STEP(F4, a, b, c, d, x[8] + 0x6fa87e4f, 6);
+    MD5STEP(F4, d, a, b, c, x[15] + 0xfe2ce6e0, 10);
+    MD5STEP(F4, c, d, a, b, x[6] + 0xa3014314, 15);
+    MD5STEP(F4, b, c, d, a, x[13] + 0x4e0811a1, 21);
+    MD5STEP(F4, a, b, c, d, x[4] + 0xf7537e82, 6);
+    MD5STEP(F4, d, a, b, c, x[11] + 0xbd3af235, 10);
+    MD5STEP(F4, c, d, a, b, x[2] + 0x2ad7d2bb, 15);
+    MD5STEP(F4, b, c, d, a, x[9] + 0xeb86d391, 21);
+}  // end Md5Rounds()
+
+#ifndef SMF_MD5_VECTOR
+
+// One lane at a time (the portable engine)
+static void Md5TransformScalar(UINT32 state[4][SmfHashMulti::LANES],
+                               const UINT32 words[16][SmfHashMulti::LANES],
+                               const UINT32 mask[SmfHashMulti::LANES])
+{
+    for (unsigned int lane = 0; lane < SmfHashMulti::LANES; lane++)
+    {
+        if (0 == mask[lane]) continue;
+        UINT32 x[16];
+        for (unsigned int i = 0; i < 16; i++)
+            x[i] = words[i][lane];
+        UINT32 a = state[0][lane];
+        UINT32 b = state[1][lane];
+        UINT32 c = state[2][lane];
+        UINT32 d = state[3][lane];
+        Md5Rounds(a, b, c, d, x);
+        state[0][lane] += a;
+        state[1][lane] += b;
+        state[2][lane] += c;
+        state[3][lane] += d;
+    }
+}  // end Md5TransformScalar()
+
+#else
+
+// All lanes at once, where the masked off lanes' state is left unchanged
+// (the arrays are viewed directly as lane vectors, aligned per Compute())
+static SMF_MD5_INLINE void Md5TransformVector(UINT32 state[4][SmfHashMulti::LANES],
+                                              const UINT32 words[16][SmfHashMulti::LANES],
+                                              const UINT32 mask[SmfHashMulti::LANES])
+{
+    const Md5Vec* x = (const Md5Vec*)__builtin_assume_aligned(words, sizeof(Md5Vec));
+    const Md5Vec* m = (const Md5Vec*)__builtin_assume_aligned(mask, sizeof(Md5Vec));
+    Md5Vec* s = (Md5Vec*)__builtin_assume_aligned(state, sizeof(Md5Vec));
+    Md5Vec a = s[0];
+    Md5Vec b = s[1];
+    Md5Vec c = s[2];
+    Md5Vec d = s[3];
+    Md5Rounds(a, b, c, d, x);
+    s[0] += a & *m;
+    s[1] += b & *m;
+    s[2] += c & *m;
+    s[3] += d & *m;
+}  // end Md5TransformVector()
+
+// Generic vector code (e.g., SSE2 on x86-64, NEON on ARM)
+static void Md5TransformGeneric(UINT32 state[4][SmfHashMulti::LANES],
+                                const UINT32 words[16][SmfHashMulti::LANES],
+                                const UINT32 mask[SmfHashMulti::LANES])
+{
+    Md5TransformVector(state, words, mask);
+}
+
+#ifdef SMF_MD5_X86
+__attribute__((target("avx2")))
+static void Md5TransformAvx2(UINT32 state[4][SmfHashMulti::LANES],
+                             const UINT32 words[16][SmfHashMulti::LANES],
+                             const UINT32 mask[SmfHashMulti::LANES])
+{
+    Md5TransformVector(state, words, mask);
+}
+#endif // SMF_MD5_X86
+
+#endif // if/else !SMF_MD5_VECTOR
+
+const char* SmfHashMulti::engine_name = "scalar";
+SmfHashMulti::TransformFunc SmfHashMulti::transform_func = SmfHashMulti::SelectEngine();
+
+SmfHashMulti::TransformFunc SmfHashMulti::SelectEngine()
+{
+#ifdef SMF_MD5_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        engine_name = "avx2";
+        return Md5TransformAvx2;
+    }
+#endif // SMF_MD5_X86
+#ifdef SMF_MD5_VECTOR
+    engine_name = "vector";
+    return Md5TransformGeneric;
+#else
+    engine_name = "scalar";
+    return Md5TransformScalar;
+#endif // if/else SMF_MD5_VECTOR
+}  // end SmfHashMulti::SelectEngine()
+
+SmfHashMulti::SmfHashMulti()
+ : lane_count(0)
+{
+}
+
+SmfHashMulti::~SmfHashMulti()
+{
+}
+
+bool SmfHashMulti::ComputeHashIPv4(ProtoPktIPv4& ipv4Pkt)
+{
+    if (LANES == lane_count) return false;
+    lane_list[lane_count++].ComputeHashIPv4(ipv4Pkt);
+    return true;
+}  // end SmfHashMulti::ComputeHashIPv4()
+
+bool SmfHashMulti::ComputeHashIPv6(ProtoPktIPv6& ipv6Pkt)
+{
+    if (LANES == lane_count) return false;
+    lane_list[lane_count++].ComputeHashIPv6(ipv6Pkt);
+    return true;
+}  // end SmfHashMulti::ComputeHashIPv6()
+
+bool SmfHashMulti::ComputeHash(const char* buffer, unsigned int buflen)
+{
+    if (LANES == lane_count) return false;
+    lane_list[lane_count++].Compute(buffer, buflen);
+    return true;
+}  // end SmfHashMulti::ComputeHash()
+
+void SmfHashMulti::Compute()
+{
+    UINT32 state[4][LANES] SMF_MD5_ALIGN;
+    UINT32 words[16][LANES] SMF_MD5_ALIGN;
+    UINT32 mask[LANES] SMF_MD5_ALIGN;
+    memset(words, 0, sizeof(words));  // (unused lanes are hashed, but ignored)
+    unsigned int blockMax = 0;
+    for (unsigned int i = 0; i < LANES; i++)
+    {
+        state[0][i] = 0x67452301;
+        state[1][i] = 0xefcdab89;
+        state[2][i] = 0x98badcfe;
+        state[3][i] = 0x10325476;
+        if (i >= lane_count) continue;
+        Lane& lane = lane_list[i];
+        if (lane.overflow)
+        {
+            lane.md5.Finalize();
+            memcpy(lane.digest, lane.md5.GetValue(), 16);
+            lane.block_count = 0;
+            continue;
+        }
+        // Message plus "1" pad bit and 64-bit length, in 64-byte blocks
+        lane.block_count = (lane.msg_len + 8) / 64 + 1;
+        lane.seg_index = lane.seg_offset = 0;
+        lane.pad_set = false;
+        if (lane.block_count > blockMax) blockMax = lane.block_count;
+    }
+    for (unsigned int block = 0; block < blockMax; block++)
+    {
+        for (unsigned int i = 0; i < LANES; i++)
+        {
+            if ((i < lane_count) && (block < lane_list[i].block_count))
+            {
+                lane_list[i].LoadBlock(&words[0][i], block);
+                mask[i] = 0xffffffff;
+            }
+            else
+            {
+                mask[i] = 0;
+            }
+        }
+        transform_func(state, words, mask);
+    }
+    for (unsigned int i = 0; i < lane_count; i++)
+    {
+        Lane& lane = lane_list[i];
+        if (lane.overflow) continue;
+        for (unsigned int j = 0; j < 4; j++)
+            Md5Store32(lane.digest + 4*j, state[j][i]);
+    }
+}  // end SmfHashMulti::Compute()
+
+SmfHashMulti::Lane::Lane()
+ : seg_count(0), seg_index(0), seg_offset(0), pad_set(false),
+   msg_len(0), block_count(0), overflow(false)
+{
+    memset(digest, 0, sizeof(digest));
+}
+
+SmfHashMulti::Lane::~Lane()
+{
+}
+
+void SmfHashMulti::Lane::Init()
+{
+    seg_count = 0;
+    msg_len = 0;
+    overflow = false;
+}  // end SmfHashMulti::Lane::Init()
+
+void SmfHashMulti::Lane::Update(const char* buffer, unsigned int buflen)
+{
+    if (0 == buflen) return;
+    msg_len += buflen;
+    if (!overflow && (SEGMENT_MAX == seg_count))
+    {
+        // Out of segments, so switch this lane to its own SmfHashMD5
+        md5.Init();
+        for (unsigned int i = 0; i < seg_count; i++)
+            md5.Update(seg_ptr[i], seg_len[i]);
+        overflow = true;
+    }
+    if (overflow)
+    {
+        md5.Update(buffer, buflen);
+    }
+    else
+    {
+        seg_ptr[seg_count] = buffer;
+        seg_len[seg_count] = buflen;
+        seg_count++;
+    }
+}  // end SmfHashMulti::Lane::Update()
+
+// The "words" are this lane's column of the SmfHashMulti::Compute() "words" array
+void SmfHashMulti::Lane::LoadBlock(UINT32* words, unsigned int blockIndex)
+{
+    if ((seg_index < seg_count) && ((seg_len[seg_index] - seg_offset) >= 64))
+    {
+        // Whole block is in the current segment (the usual case)
+        const UINT8* ptr = (const UINT8*)seg_ptr[seg_index] + seg_offset;
+        for (unsigned int i = 0; i < 16; i++)
+            words[i*LANES] = Md5Load32(ptr + 4*i);
+        seg_offset += 64;
+        if (seg_offset == seg_len[seg_index])
+        {
+            seg_index++;
+            seg_offset = 0;
+        }
+        return;
+    }
+    UINT8 block[64];
+    unsigned int len = 0;
+    while ((len < 64) && (seg_index < seg_count))
+    {
+        unsigned int n = seg_len[seg_index] - seg_offset;
+        if (n > (64 - len)) n = 64 - len;
+        memcpy(block + len, seg_ptr[seg_index] + seg_offset, n);
+        len += n;
+        seg_offset += n;
+        if (seg_offset == seg_len[seg_index])
+        {
+            seg_index++;
+            seg_offset = 0;
+        }
+    }
+    if (len < 64)
+    {
+        // End of message, so pad with "1" bit, zeroes and (last block) bit count
+        if (!pad_set)
+        {
+            block[len++] = 0x80;
+            pad_set = true;
+        }
+        memset(block + len, 0, 64 - len);
+        if ((blockIndex + 1) == block_count)
+        {
+            Md5Store32(block + 56, msg_len << 3);
+            Md5Store32(block + 60, msg_len >> 29);
+        }
+    }
+    for (unsigned int i = 0; i < 16; i++)
+        words[i*LANES] = Md5Load32(block + 4*i);
+}  // end SmfHashMulti::Lane::LoadBlock()
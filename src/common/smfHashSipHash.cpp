@@ -0,0 +1,125 @@
+
+#include "smfHashSipHash.h"
+
+#include <string.h>  // for memcpy(), etc
+
+/*
+ * This implements SipHash-2-4 (64-bit output) per "SipHash: a fast
+ * short-input PRF" by Jean-Philippe Aumasson and Daniel J. Bernstein.
+ * The key and message words are little-endian per the specification
+ * and the 64-bit value is output in little-endian byte order.
+ */
+
+UINT64 SmfHashSipHash::key0 = 0;
+UINT64 SmfHashSipHash::key1 = 0;
+
+static inline UINT64 Read64(const UINT8* ptr)  // (little-endian)
+{
+    UINT64 value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | ptr[i];
+    return value;
+}
+
+static inline UINT64 Rotl64(UINT64 x, int r)
+{
+    return ((x << r) | (x >> (64 - r)));
+}
+
+#define SIP_ROUND(v0, v1, v2, v3)  \
+    do                             \
+    {                              \
+        v0 += v1;                  \
+        v1 = Rotl64(v1, 13);       \
+        v1 ^= v0;                  \
+        v0 = Rotl64(v0, 32);       \
+        v2 += v3;                  \
+        v3 = Rotl64(v3, 16);       \
+        v3 ^= v2;                  \
+        v0 += v3;                  \
+        v3 = Rotl64(v3, 21);       \
+        v3 ^= v0;                  \
+        v2 += v1;                  \
+        v1 = Rotl64(v1, 17);       \
+        v1 ^= v2;                  \
+        v2 = Rotl64(v2, 32);       \
+    } while (0)
+
+SmfHashSipHash::SmfHashSipHash()
+{
+    Init();
+}
+
+SmfHashSipHash::~SmfHashSipHash()
+{
+}
+
+void SmfHashSipHash::SetKey(const char key[KEY_SIZE])
+{
+    key0 = Read64((const UINT8*)key);
+    key1 = Read64((const UINT8*)key + 8);
+}  // end SmfHashSipHash::SetKey()
+
+void SmfHashSipHash::Init()
+{
+    v0 = key0 ^ 0x736f6d6570736575ULL;
+    v1 = key1 ^ 0x646f72616e646f6dULL;
+    v2 = key0 ^ 0x6c7967656e657261ULL;
+    v3 = key1 ^ 0x7465646279746573ULL;
+    tail_len = 0;
+    total_len = 0;
+}  // end SmfHashSipHash::Init()
+
+inline void SmfHashSipHash::Compress(UINT64 m)
+{
+    v3 ^= m;
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= m;
+}  // end SmfHashSipHash::Compress()
+
+void SmfHashSipHash::Update(const char* buffer, unsigned int buflen)
+{
+    const UINT8* input = (const UINT8*)buffer;
+    total_len += buflen;
+    // Complete any partial word left from the last update
+    if (0 != tail_len)
+    {
+        while ((tail_len < 8) && (buflen > 0))
+        {
+            tail[tail_len++] = *input++;
+            buflen--;
+        }
+        if (tail_len < 8) return;
+        Compress(Read64(tail));
+        tail_len = 0;
+    }
+    while (buflen >= 8)
+    {
+        Compress(Read64(input));
+        input += 8;
+        buflen -= 8;
+    }
+    memcpy(tail, input, buflen);
+    tail_len = buflen;
+}  // end SmfHashSipHash::Update()
+
+void SmfHashSipHash::Finalize()
+{
+    // Last word is the remaining bytes with the length (mod 256) in its top byte
+    UINT64 m = (UINT64)(total_len & 0xff) << 56;
+    for (unsigned int i = 0; i < tail_len; i++)
+        m |= (UINT64)tail[i] << (8 * i);
+    Compress(m);
+    v2 ^= 0xff;
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    UINT64 hash = v0 ^ v1 ^ v2 ^ v3;
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        digest[i] = (UINT8)hash;
+        hash >>= 8;
+    }
+}  // end SmfHashSipHash::Finalize()
@@ -0,0 +1,321 @@
+
+#include "smfHashXXH3.h"
+
+#include <string.h>  // for memcpy(), etc
+
+/*
+ * This implements the XXH3 64-bit hash (with the default secret and a
+ * zero seed) per the xxHash specification by Yann Collet.  Only the
+ * scalar code path is used.  Values are verified to match the reference
+ * implementation for all input lengths and Update() chunkings.
+ */
+
+static const UINT8 XXH3_SECRET[192] =
+{
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+};
+
+static const UINT32 PRIME32_1 = 0x9E3779B1U;
+static const UINT32 PRIME32_2 = 0x85EBCA77U;
+static const UINT32 PRIME32_3 = 0xC2B2AE3DU;
+static const UINT64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const UINT64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const UINT64 PRIME64_3 = 0x165667B19E3779F9ULL;
+static const UINT64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const UINT64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+static const UINT64 PRIME_MX1 = 0x165667919E3779F9ULL;
+static const UINT64 PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+static inline UINT32 Read32(const UINT8* ptr)  // (little-endian)
+{
+    return ((UINT32)ptr[0] | ((UINT32)ptr[1] << 8) | ((UINT32)ptr[2] << 16) | ((UINT32)ptr[3] << 24));
+}
+
+static inline UINT64 Read64(const UINT8* ptr)  // (little-endian)
+{
+    return ((UINT64)Read32(ptr) | ((UINT64)Read32(ptr + 4) << 32));
+}
+
+static inline UINT64 Rotl64(UINT64 x, int r)
+{
+    return ((x << r) | (x >> (64 - r)));
+}
+
+static inline UINT32 Swap32(UINT32 x)
+{
+    return (((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) |
+            ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff));
+}
+
+static inline UINT64 Swap64(UINT64 x)
+{
+    return (((UINT64)Swap32((UINT32)x) << 32) | (UINT64)Swap32((UINT32)(x >> 32)));
+}
+
+// Returns the low 64 bits of the 128-bit product XOR'd with the high 64 bits
+static inline UINT64 Mul128Fold64(UINT64 a, UINT64 b)
+{
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 UINT128;
+    UINT128 product = (UINT128)a * b;
+    return ((UINT64)product ^ (UINT64)(product >> 64));
+#else
+    UINT64 lolo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    UINT64 hilo = (a >> 32) * (b & 0xFFFFFFFF);
+    UINT64 lohi = (a & 0xFFFFFFFF) * (b >> 32);
+    UINT64 hihi = (a >> 32) * (b >> 32);
+    UINT64 cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+    UINT64 upper = (hilo >> 32) + (cross >> 32) + hihi;
+    UINT64 lower = (cross << 32) | (lolo & 0xFFFFFFFF);
+    return (lower ^ upper);
+#endif // if/else __SIZEOF_INT128__
+}
+
+static inline UINT64 XXH64Avalanche(UINT64 h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline UINT64 XXH3Avalanche(UINT64 h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline UINT64 Mix16B(const UINT8* input, const UINT8* secret)
+{
+    return Mul128Fold64(Read64(input) ^ Read64(secret), Read64(input + 8) ^ Read64(secret + 8));
+}
+
+// One-shot hash for inputs of 240 bytes or less
+static UINT64 XXH3HashShort(const UINT8* input, unsigned int len)
+{
+    const UINT8* secret = XXH3_SECRET;
+    if (len <= 16)
+    {
+        if (len > 8)
+        {
+            UINT64 inputLo = Read64(input) ^ (Read64(secret + 24) ^ Read64(secret + 32));
+            UINT64 inputHi = Read64(input + len - 8) ^ (Read64(secret + 40) ^ Read64(secret + 48));
+            UINT64 acc = len + Swap64(inputLo) + inputHi + Mul128Fold64(inputLo, inputHi);
+            return XXH3Avalanche(acc);
+        }
+        else if (len >= 4)
+        {
+            UINT64 input64 = (UINT64)Read32(input + len - 4) + ((UINT64)Read32(input) << 32);
+            UINT64 h = input64 ^ (Read64(secret + 8) ^ Read64(secret + 16));
+            // "rrmxmx" mix
+            h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+            h *= PRIME_MX2;
+            h ^= (h >> 35) + len;
+            h *= PRIME_MX2;
+            return (h ^ (h >> 28));
+        }
+        else if (len > 0)
+        {
+            UINT32 combined = ((UINT32)input[0] << 16) | ((UINT32)input[len >> 1] << 24) |
+                              (UINT32)input[len - 1] | ((UINT32)len << 8);
+            UINT64 bitflip = (UINT64)(Read32(secret) ^ Read32(secret + 4));
+            return XXH64Avalanche((UINT64)combined ^ bitflip);
+        }
+        else
+        {
+            return XXH64Avalanche(Read64(secret + 56) ^ Read64(secret + 64));
+        }
+    }
+    else if (len <= 128)
+    {
+        UINT64 acc = len * PRIME64_1;
+        if (len > 32)
+        {
+            if (len > 64)
+            {
+                if (len > 96)
+                {
+                    acc += Mix16B(input + 48, secret + 96);
+                    acc += Mix16B(input + len - 64, secret + 112);
+                }
+                acc += Mix16B(input + 32, secret + 64);
+                acc += Mix16B(input + len - 48, secret + 80);
+            }
+            acc += Mix16B(input + 16, secret + 32);
+            acc += Mix16B(input + len - 32, secret + 48);
+        }
+        acc += Mix16B(input, secret);
+        acc += Mix16B(input + len - 16, secret + 16);
+        return XXH3Avalanche(acc);
+    }
+    else
+    {
+        UINT64 acc = len * PRIME64_1;
+        unsigned int numRounds = len / 16;
+        for (unsigned int i = 0; i < 8; i++)
+            acc += Mix16B(input + (16 * i), secret + (16 * i));
+        UINT64 accEnd = Mix16B(input + len - 16, secret + 136 - 17);
+        acc = XXH3Avalanche(acc);
+        for (unsigned int i = 8; i < numRounds; i++)
+            accEnd += Mix16B(input + (16 * i), secret + (16 * (i - 8)) + 3);
+        return XXH3Avalanche(acc + accEnd);
+    }
+}  // end XXH3HashShort()
+
+static inline void Accumulate512(UINT64 acc[8], const UINT8* input, const UINT8* secret)
+{
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        UINT64 dataVal = Read64(input + (8 * i));
+        UINT64 dataKey = dataVal ^ Read64(secret + (8 * i));
+        acc[i ^ 1] += dataVal;
+        acc[i] += (UINT64)(UINT32)dataKey * (dataKey >> 32);
+    }
+}
+
+static inline void ScrambleAcc(UINT64 acc[8], const UINT8* secret)
+{
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        UINT64 a = acc[i];
+        a ^= a >> 47;
+        a ^= Read64(secret + (8 * i));
+        a *= PRIME32_1;
+        acc[i] = a;
+    }
+}
+
+SmfHashXXH3::SmfHashXXH3()
+{
+    Init();
+}
+
+SmfHashXXH3::~SmfHashXXH3()
+{
+}
+
+void SmfHashXXH3::Init()
+{
+    acc[0] = PRIME32_3;
+    acc[1] = PRIME64_1;
+    acc[2] = PRIME64_2;
+    acc[3] = PRIME64_3;
+    acc[4] = PRIME64_4;
+    acc[5] = PRIME32_2;
+    acc[6] = PRIME64_5;
+    acc[7] = PRIME32_1;
+    buffer_len = 0;
+    stripe_count = 0;
+    total_len = 0;
+}  // end SmfHashXXH3::Init()
+
+// Accumulates stripes, scrambling the accumulators at each block end
+// (Note this is only called when more input follows the given stripes)
+void SmfHashXXH3::ConsumeStripes(const UINT8* input, unsigned int numStripes)
+{
+    while (numStripes > 0)
+    {
+        unsigned int count = STRIPES_PER_BLOCK - stripe_count;
+        if (count > numStripes) count = numStripes;
+        for (unsigned int i = 0; i < count; i++)
+            Accumulate512(acc, input + (STRIPE_LEN * i), XXH3_SECRET + (8 * (stripe_count + i)));
+        input += STRIPE_LEN * count;
+        numStripes -= count;
+        stripe_count += count;
+        if (STRIPES_PER_BLOCK == stripe_count)
+        {
+            ScrambleAcc(acc, XXH3_SECRET + sizeof(XXH3_SECRET) - STRIPE_LEN);
+            stripe_count = 0;
+        }
+    }
+}  // end SmfHashXXH3::ConsumeStripes()
+
+void SmfHashXXH3::Update(const char* buf, unsigned int buflen)
+{
+    const UINT8* input = (const UINT8*)buf;
+    total_len += buflen;
+    // The buffer always keeps some input (at least one byte), so
+    // that Finalize() has the last stripe available
+    if ((buffer_len + buflen) <= BUFFER_SIZE)
+    {
+        memcpy(buffer + buffer_len, input, buflen);
+        buffer_len += buflen;
+        return;
+    }
+    if (0 != buffer_len)
+    {
+        unsigned int fill = BUFFER_SIZE - buffer_len;
+        memcpy(buffer + buffer_len, input, fill);
+        input += fill;
+        buflen -= fill;
+        ConsumeStripes(buffer, BUFFER_SIZE / STRIPE_LEN);
+        buffer_len = 0;
+    }
+    if (buflen > BUFFER_SIZE)
+    {
+        // Consume whole stripes directly from the input, keeping
+        // a copy of the last stripe (for Finalize()) as needed
+        unsigned int numStripes = (buflen - 1) / STRIPE_LEN;
+        ConsumeStripes(input, numStripes);
+        input += STRIPE_LEN * numStripes;
+        buflen -= STRIPE_LEN * numStripes;
+        memcpy(buffer + BUFFER_SIZE - STRIPE_LEN, input - STRIPE_LEN, STRIPE_LEN);
+    }
+    memcpy(buffer, input, buflen);
+    buffer_len = buflen;
+}  // end SmfHashXXH3::Update()
+
+void SmfHashXXH3::Finalize()
+{
+    UINT64 hash;
+    if (total_len <= 240)
+    {
+        hash = XXH3HashShort(buffer, (unsigned int)total_len);
+    }
+    else
+    {
+        UINT8 lastStripe[STRIPE_LEN];
+        const UINT8* lastStripePtr;
+        if (buffer_len >= STRIPE_LEN)
+        {
+            ConsumeStripes(buffer, (buffer_len - 1) / STRIPE_LEN);
+            lastStripePtr = buffer + buffer_len - STRIPE_LEN;
+        }
+        else
+        {
+            // Last stripe straddles the previously consumed input
+            unsigned int catchup = STRIPE_LEN - buffer_len;
+            memcpy(lastStripe, buffer + BUFFER_SIZE - catchup, catchup);
+            memcpy(lastStripe + catchup, buffer, buffer_len);
+            lastStripePtr = lastStripe;
+        }
+        Accumulate512(acc, lastStripePtr, XXH3_SECRET + sizeof(XXH3_SECRET) - STRIPE_LEN - 7);
+        // Merge accumulators
+        hash = total_len * PRIME64_1;
+        const UINT8* secret = XXH3_SECRET + 11;
+        for (unsigned int i = 0; i < 4; i++)
+            hash += Mul128Fold64(acc[2*i] ^ Read64(secret + (16 * i)), acc[2*i + 1] ^ Read64(secret + (16 * i) + 8));
+        hash = XXH3Avalanche(hash);
+    }
+    // Big-endian "canonical" form
+    for (int i = 7; i >= 0; i--)
+    {
+        digest[i] = (UINT8)hash;
+        hash >>= 8;
+    }
+}  // end SmfHashXXH3::Finalize()
@@ -0,0 +1,93 @@
+#include "smfPktInfo.h"
+
+#include <string.h>  // for memcpy(), etc
+
+SmfPktInfo::SmfPktInfo()
+{
+    Clear();
+}
+
+void SmfPktInfo::Clear()
+{
+    version = 0;
+    protocol = 0;
+    traffic_class = 0;
+    hash_value = NULL;
+}  // end SmfPktInfo::Clear()
+
+bool SmfPktInfo::InitFromPacket(ProtoPktIP& ipPkt)
+{
+    Clear();
+    switch (ipPkt.GetVersion())
+    {
+        case 4:
+        {
+            ProtoPktIPv4 ipv4Pkt(ipPkt);
+            const char* ipBuffer = (const char*)ipPkt.GetBuffer();
+            protocol = (UINT8)ipv4Pkt.GetProtocol();
+            traffic_class = ipv4Pkt.GetTOS();
+            memcpy(src_addr, ipBuffer + 12, 4);
+            memcpy(dst_addr, ipBuffer + 16, 4);
+            version = 4;
+            break;
+        }
+        case 6:
+        {
+            ProtoPktIPv6 ipv6Pkt(ipPkt);
+            protocol = (UINT8)ipv6Pkt.GetNextHeader();
+            traffic_class = ipv6Pkt.GetTrafficClass();
+            memcpy(src_addr, ipv6Pkt.GetSrcAddrPtr(), 16);
+            memcpy(dst_addr, ipv6Pkt.GetDstAddrPtr(), 16);
+            version = 6;
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
+}  // end SmfPktInfo::InitFromPacket()
+
+void SmfPktInfo::GetSrcAddr(ProtoAddress& addr) const
+{
+    if (4 == version)
+        addr.SetRawHostAddress(ProtoAddress::IPv4, (const char*)src_addr, 4);
+    else if (6 == version)
+        addr.SetRawHostAddress(ProtoAddress::IPv6, (const char*)src_addr, 16);
+    else
+        addr.Invalidate();
+}  // end SmfPktInfo::GetSrcAddr()
+
+void SmfPktInfo::GetDstAddr(ProtoAddress& addr) const
+{
+    if (4 == version)
+        addr.SetRawHostAddress(ProtoAddress::IPv4, (const char*)dst_addr, 4);
+    else if (6 == version)
+        addr.SetRawHostAddress(ProtoAddress::IPv6, (const char*)dst_addr, 16);
+    else
+        addr.Invalidate();
+}  // end SmfPktInfo::GetDstAddr()
+
+bool SmfPktInfo::DstIsMulticast() const
+{
+    if (4 == version)
+        return (0xe0 == (dst_addr[0] & 0xf0));  // 224.0.0.0/4
+    else if (6 == version)
+        return (0xff == dst_addr[0]);           // ff00::/8
+    else
+        return false;
+}  // end SmfPktInfo::DstIsMulticast()
+
+bool SmfPktInfo::DstIsUnicast() const
+{
+    if (!IsValid() || DstIsMulticast()) return false;
+    unsigned int addrLength = GetAddrLength();
+    bool allZero = true;
+    bool allOnes = true;
+    for (unsigned int i = 0; i < addrLength; i++)
+    {
+        if (0x00 != dst_addr[i]) allZero = false;
+        if (0xff != dst_addr[i]) allOnes = false;
+    }
+    // (not unspecified nor the IPv4 broadcast address)
+    return !(allZero || ((4 == version) && allOnes));
+}  // end SmfPktInfo::DstIsUnicast()
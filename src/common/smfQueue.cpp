@@ -6,40 +6,75 @@ SmfQueueBase::SmfQueueBase(const ProtoAddress&  dst,
                            UINT8                trafficClass)
  : queue_limit(0), queue_length(0)
 {
-    flow_id_size = BuildKey(flow_id, dst, src, proto, trafficClass);
+    BuildKey(flow_key, dst, src, proto, trafficClass);
 }
 
 SmfQueueBase::~SmfQueueBase()
 {
 }
 
-unsigned int SmfQueueBase::BuildKey(char* keyBuffer,  // must be sized at least 2*16 + 2 (IPv6 addr worst case)
-                                    const ProtoAddress&  src, 
-                                    const ProtoAddress&  dst,
-                                    ProtoPktIP::Protocol proto,
-                                    UINT8                trafficClass)
+void SmfQueueBase::BuildKey(SmfFlowKey&          flowKey,
+                            const ProtoAddress&  src, 
+                            const ProtoAddress&  dst,
+                            ProtoPktIP::Protocol proto,
+                            UINT8                trafficClass)
 {
-    unsigned int len = 0;
+    // (at most 2*16 + 2 bytes, i.e. IPv6 addr worst case)
+    flowKey.Clear();
     if (dst.IsValid())
-    {
-        unsigned int alen = dst.GetLength();
-        memcpy(keyBuffer, dst.GetRawHostAddress(), alen);
-        len = alen;
-    }
+        flowKey.AppendAddress(dst);
     if (src.IsValid())
-    {
-        unsigned int alen = src.GetLength();
-        memcpy(keyBuffer + len, src.GetRawHostAddress(), src.GetLength());
-        len += alen;
-    }
+        flowKey.AppendAddress(src);
     if (ProtoPktIP::RESERVED != proto)
-        keyBuffer[len++] = (char)proto;
+        flowKey.AppendByte((UINT8)proto);
     if (255 != trafficClass)
-        keyBuffer[len++] = (char)trafficClass;
-    return (len << 3);
+        flowKey.AppendByte(trafficClass);
+    flowKey.Finalize();
 }  // end SmfQueueBase::BuildKey()
 
 
+SmfPacketBuffer* SmfPacketBuffer::free_list = NULL;
+unsigned int SmfPacketBuffer::free_count = 0;
+
+SmfPacketBuffer* SmfPacketBuffer::Create()
+{
+    SmfPacketBuffer* pktBuf = free_list;
+    if (NULL != pktBuf)
+    {
+        free_list = pktBuf->next;
+        free_count--;
+        pktBuf->next = NULL;
+        pktBuf->ref_count = 1;
+    }
+    else if (NULL == (pktBuf = new SmfPacketBuffer()))
+    {
+        PLOG(PL_ERROR, "SmfPacketBuffer::Create() new SmfPacketBuffer error: %s\n", GetErrorString());
+    }
+    return pktBuf;
+}  // end SmfPacketBuffer::Create()
+
+void SmfPacketBuffer::Release()
+{
+    ASSERT(0 != ref_count);
+    if (0 == --ref_count)
+    {
+        next = free_list;
+        free_list = this;
+        free_count++;
+    }
+}  // end SmfPacketBuffer::Release()
+
+void SmfPacketBuffer::EmptyFreeList()
+{
+    while (NULL != free_list)
+    {
+        SmfPacketBuffer* pktBuf = free_list;
+        free_list = pktBuf->next;
+        delete pktBuf;
+    }
+    free_count = 0;
+}  // end SmfPacketBuffer::EmptyFreeList()
+
 SmfPacket* SmfPacket::Pool::GetPacket()
 {
     SmfPacket* pkt = Get();
@@ -47,7 +82,18 @@ SmfPacket* SmfPacket::Pool::GetPacket()
     {
         pkt = new SmfPacket(); // TBD - do we need to set bufmax
         if (NULL == pkt)
+        {
             PLOG(PL_ERROR, "SmfPacket::Pool::GetPacket() new SmfPacket error: %s\n", GetErrorString());
+            return NULL;
+        }
+    }
+    // Pooled packets may still reference a buffer shared with queued packets,
+    // so make sure we have our own (without copying old content)
+    if (NULL == pkt->PrepareBuffer())
+    {
+        PLOG(PL_ERROR, "SmfPacket::Pool::GetPacket() error: unable to get packet buffer\n");
+        Put(*pkt);
+        return NULL;
     }
     return pkt;
 }  // end SmfPacket::Pool::GetPacket()
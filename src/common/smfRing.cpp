@@ -0,0 +1,278 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "smfRing.h"
+#include "protoDebug.h"
+
+#ifdef LINUX
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <arpa/inet.h>  // for htons()
+#include <unistd.h>     // for close()
+#include <string.h>     // for memset()
+#include <errno.h>
+#endif // LINUX
+
+SmfRing::SmfRing()
+ : if_index(0), ring_buffer(NULL), ring_size(0), block_size(0), block_count(0),
+   block_index(0), block_ptr(NULL), block_frames(0), frame_ptr(NULL),
+   frame_count(0), block_total(0)
+{
+}
+
+SmfRing::~SmfRing()
+{
+    Close();
+}
+
+#ifdef LINUX
+
+bool SmfRing::Open(unsigned int ifIndex, unsigned int blockSize, unsigned int blockCount, unsigned int blockTimeout)
+{
+    if (IsOpen()) Close();
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfRing::Open() socket() error: %s\n", GetErrorString());
+        return false;
+    }
+    descriptor = fd;
+    int version = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfRing::Open() setsockopt(PACKET_VERSION) error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    // Note the kernel requires the block size to be a multiple of the
+    // page size (and a power-of-two number of pages)
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = blockSize;
+    req.tp_block_nr = blockCount;
+    req.tp_frame_size = TPACKET_ALIGNMENT << 7;  // nominal only for TPACKET_V3 (frames are variable size)
+    req.tp_frame_nr = (blockSize / req.tp_frame_size) * blockCount;
+    req.tp_retire_blk_tov = blockTimeout;
+    req.tp_feature_req_word = 0;
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfRing::Open() setsockopt(PACKET_RX_RING) error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    block_size = blockSize;
+    block_count = blockCount;
+    ring_size = (size_t)blockSize * (size_t)blockCount;
+    void* ptr = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfRing::Open() mmap() error: %s\n", GetErrorString());
+        ring_size = 0;
+        Close();
+        return false;
+    }
+    ring_buffer = (char*)ptr;
+#ifdef PACKET_IGNORE_OUTGOING
+    // Let the kernel skip our own (and other local) transmissions when supported
+    int ignore = 1;
+    if (setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof(ignore)) < 0)
+        PLOG(PL_WARN, "SmfRing::Open() warning: setsockopt(PACKET_IGNORE_OUTGOING) error: %s\n", GetErrorString());
+#endif // PACKET_IGNORE_OUTGOING
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifIndex;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfRing::Open() bind() error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    if_index = ifIndex;
+    block_index = 0;
+    block_ptr = NULL;
+    block_frames = 0;
+    frame_ptr = NULL;
+    if (!ProtoChannel::Open())
+    {
+        PLOG(PL_ERROR, "SmfRing::Open() error: ProtoChannel::Open() failure\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end SmfRing::Open()
+
+void SmfRing::Close()
+{
+    ProtoChannel::Close();
+    if (NULL != ring_buffer)
+    {
+        munmap(ring_buffer, ring_size);
+        ring_buffer = NULL;
+        ring_size = 0;
+    }
+    if (INVALID_HANDLE != descriptor)
+    {
+        close(descriptor);
+        descriptor = INVALID_HANDLE;
+    }
+    block_ptr = NULL;
+    block_frames = 0;
+    frame_ptr = NULL;
+    if_index = 0;
+}  // end SmfRing::Close()
+
+void SmfRing::ReleaseBlock()
+{
+    // Hand the current block back to the kernel and advance to the next one
+    struct tpacket_block_desc* pbd = (struct tpacket_block_desc*)block_ptr;
+    __sync_synchronize();  // make sure we're done with the block contents first
+    pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    block_ptr = NULL;
+    block_frames = 0;
+    frame_ptr = NULL;
+    block_index = (block_index + 1) % block_count;
+    block_total++;
+}  // end SmfRing::ReleaseBlock()
+
+bool SmfRing::GetNextFrame(const char*& frame, unsigned int& frameLength)
+{
+    if (NULL == ring_buffer) return false;
+    for (;;)
+    {
+        if (NULL == block_ptr)
+        {
+            struct tpacket_block_desc* pbd = (struct tpacket_block_desc*)(ring_buffer + ((size_t)block_index * block_size));
+            if (0 == (TP_STATUS_USER & pbd->hdr.bh1.block_status))
+                return false;  // no more retired blocks available
+            __sync_synchronize();
+            block_ptr = (char*)pbd;
+            block_frames = pbd->hdr.bh1.num_pkts;
+            frame_ptr = block_ptr + pbd->hdr.bh1.offset_to_first_pkt;
+        }
+        if (0 == block_frames)
+        {
+            ReleaseBlock();
+            continue;
+        }
+        const struct tpacket3_hdr* hdr = (const struct tpacket3_hdr*)frame_ptr;
+        const struct sockaddr_ll* sll = (const struct sockaddr_ll*)(frame_ptr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+        block_frames--;
+        frame_ptr += hdr->tp_next_offset;
+        if (PACKET_OUTGOING == sll->sll_pkttype) continue;  // only handle inbound packets
+        frame = ((const char*)hdr) + hdr->tp_mac;
+        frameLength = hdr->tp_snaplen;
+        frame_count++;
+        return true;
+    }
+}  // end SmfRing::GetNextFrame()
+
+unsigned int SmfRing::GetDropCount()
+{
+    if (!IsOpen()) return 0;
+    struct tpacket_stats_v3 stats;
+    socklen_t len = sizeof(stats);
+    if (getsockopt(descriptor, SOL_PACKET, PACKET_STATISTICS, &stats, &len) < 0)
+    {
+        PLOG(PL_ERROR, "SmfRing::GetDropCount() getsockopt(PACKET_STATISTICS) error: %s\n", GetErrorString());
+        return 0;
+    }
+    return stats.tp_drops;
+}  // end SmfRing::GetDropCount()
+
+bool SmfRing::AttachDropFilter(int descriptor)
+{
+    struct sock_filter code[] =
+    {
+        BPF_STMT(BPF_RET | BPF_K, 0)    // drop everything
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(struct sock_filter);
+    prog.filter = code;
+    if (setsockopt(descriptor, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfRing::AttachDropFilter() setsockopt(SO_ATTACH_FILTER) error: %s\n", GetErrorString());
+        return false;
+    }
+    // Discard anything that was queued before the filter was attached
+    char dummy;
+    while (recv(descriptor, &dummy, 1, MSG_DONTWAIT | MSG_TRUNC) >= 0);
+    return true;
+}  // end SmfRing::AttachDropFilter()
+
+bool SmfRing::DetachDropFilter(int descriptor)
+{
+    if ((setsockopt(descriptor, SOL_SOCKET, SO_DETACH_FILTER, NULL, 0) < 0) && (ENOENT != errno))
+    {
+        PLOG(PL_ERROR, "SmfRing::DetachDropFilter() setsockopt(SO_DETACH_FILTER) error: %s\n", GetErrorString());
+        return false;
+    }
+    return true;
+}  // end SmfRing::DetachDropFilter()
+
+#else  // !LINUX
+
+bool SmfRing::Open(unsigned int ifIndex, unsigned int blockSize, unsigned int blockCount, unsigned int blockTimeout)
+{
+    PLOG(PL_ERROR, "SmfRing::Open() error: TPACKET_V3 ring capture not supported on this system\n");
+    return false;
+}  // end SmfRing::Open()
+
+void SmfRing::Close()
+{
+}  // end SmfRing::Close()
+
+void SmfRing::ReleaseBlock()
+{
+}  // end SmfRing::ReleaseBlock()
+
+bool SmfRing::GetNextFrame(const char*& frame, unsigned int& frameLength)
+{
+    return false;
+}  // end SmfRing::GetNextFrame()
+
+unsigned int SmfRing::GetDropCount()
+{
+    return 0;
+}  // end SmfRing::GetDropCount()
+
+bool SmfRing::AttachDropFilter(int descriptor)
+{
+    return false;  // (not supported, so the caller's socket still gets copies)
+}  // end SmfRing::AttachDropFilter()
+
+bool SmfRing::DetachDropFilter(int descriptor)
+{
+    return true;
+}  // end SmfRing::DetachDropFilter()
+
+#endif // if/else LINUX
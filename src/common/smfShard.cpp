@@ -0,0 +1,238 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfShard.h"
+#include "protoDebug.h"
+
+#include <stdio.h>  // for fflush()
+#include <string.h>  // for memset()
+
+#ifdef LINUX
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <linux/filter.h>
+#include <signal.h>
+#include <unistd.h>
+#endif // LINUX
+
+SmfShard::SmfShard()
+ : shard_count(1), shard_index(0), shard_counters(NULL)
+{
+    for (unsigned int i = 0; i < SHARD_COUNT_MAX; i++)
+        shard_pid[i] = 0;
+}
+
+SmfShard::~SmfShard()
+{
+    Stop();
+}
+
+#ifdef LINUX
+
+bool SmfShard::Start(unsigned int shardCount)
+{
+    if (IsActive())
+    {
+        PLOG(PL_ERROR, "SmfShard::Start() error: shards already started\n");
+        return false;
+    }
+    if ((shardCount < 1) || (shardCount > SHARD_COUNT_MAX))
+    {
+        PLOG(PL_ERROR, "SmfShard::Start() error: invalid shard count %u\n", shardCount);
+        return false;
+    }
+    // The counters area is mapped before forking so all shards share it
+    size_t countersSize = SHARD_COUNT_MAX * IFACE_COUNT_MAX * sizeof(Counters);
+    void* ptr = mmap(NULL, countersSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfShard::Start() mmap() error: %s\n", GetErrorString());
+        return false;
+    }
+    memset(ptr, 0, countersSize);
+    shard_counters = (Counters*)ptr;
+    shard_count = shardCount;
+    shard_index = 0;
+    pid_t parentPid = getpid();
+    fflush(NULL);  // so buffered output isn't duplicated by the children
+    for (unsigned int i = 1; i < shardCount; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            PLOG(PL_ERROR, "SmfShard::Start() fork() error: %s\n", GetErrorString());
+            Stop();
+            shard_count = 1;
+            return false;
+        }
+        else if (0 == pid)
+        {
+            // We're a child shard. Make sure we go away with the primary.
+            shard_index = i;
+            for (unsigned int j = 0; j < SHARD_COUNT_MAX; j++)
+                shard_pid[j] = 0;
+            if (prctl(PR_SET_PDEATHSIG, SIGTERM) < 0)
+                PLOG(PL_WARN, "SmfShard::Start() warning: prctl(PR_SET_PDEATHSIG) error: %s\n", GetErrorString());
+            if (getppid() != parentPid) _exit(0);  // primary already gone
+            return true;
+        }
+        shard_pid[i] = pid;
+    }
+    return true;
+}  // end SmfShard::Start()
+
+void SmfShard::Stop()
+{
+    if (!IsPrimary()) return;
+    for (unsigned int i = 1; i < shard_count; i++)
+    {
+        if (shard_pid[i] > 0)
+        {
+            if (kill(shard_pid[i], SIGTERM) < 0)
+                PLOG(PL_WARN, "SmfShard::Stop() warning: kill(%d) error: %s\n", shard_pid[i], GetErrorString());
+            else if (waitpid(shard_pid[i], NULL, 0) < 0)
+                PLOG(PL_WARN, "SmfShard::Stop() warning: waitpid(%d) error: %s\n", shard_pid[i], GetErrorString());
+            shard_pid[i] = 0;
+        }
+    }
+    if (NULL != shard_counters)
+    {
+        munmap(shard_counters, SHARD_COUNT_MAX * IFACE_COUNT_MAX * sizeof(Counters));
+        shard_counters = NULL;
+    }
+}  // end SmfShard::Stop()
+
+void SmfShard::PublishCounters(const Counters* counters, unsigned int count)
+{
+    if (NULL == shard_counters) return;
+    Counters* slot = shard_counters + (shard_index * IFACE_COUNT_MAX);
+    if (count > IFACE_COUNT_MAX) count = IFACE_COUNT_MAX;
+    memcpy(slot, counters, count * sizeof(Counters));
+    if (count < IFACE_COUNT_MAX)
+        memset(slot + count, 0, (IFACE_COUNT_MAX - count) * sizeof(Counters));
+}  // end SmfShard::PublishCounters()
+
+void SmfShard::AddShardCounters(unsigned int ifIndex, Counters& totals) const
+{
+    if (NULL == shard_counters) return;
+    for (unsigned int i = 0; i < shard_count; i++)
+    {
+        if (i == shard_index) continue;  // (the caller has its own live counters)
+        const Counters* slot = shard_counters + (i * IFACE_COUNT_MAX);
+        for (unsigned int j = 0; j < IFACE_COUNT_MAX; j++)
+        {
+            if (slot[j].if_index != ifIndex) continue;
+            totals.flows += slot[j].flows;
+            totals.recv += slot[j].recv;
+            totals.mrcv += slot[j].mrcv;
+            totals.sent += slot[j].sent;
+            totals.retr += slot[j].retr;
+            totals.fwd += slot[j].fwd;
+            totals.dups += slot[j].dups;
+            totals.asym += slot[j].asym;
+            break;
+        }
+    }
+}  // end SmfShard::AddShardCounters()
+
+bool SmfShard::AttachFilter(int descriptor) const
+{
+    if (!IsActive()) return true;  // nothing to filter
+    // Classic BPF program:  A = hash(IP src addr, IP dst addr) % shard_count and
+    // the frame is accepted if it matches our shard index.  For IPv6, the low-order
+    // address words are used.  The protocol and addresses are loaded relative to the
+    // kernel's protocol and network header (not fixed Ethernet offsets) so the same
+    // program works on any link type (e.g., GRE interfaces have no link header).  Note
+    // frames queued before the filter is attached may be seen by more than one shard
+    // (TBD - drain those?)
+    const UINT32 ACCEPT = 0x40000;  // (snap length)
+    const UINT32 AD_PROTOCOL = (UINT32)(SKF_AD_OFF + SKF_AD_PROTOCOL);  // (skb protocol)
+    const UINT32 NET_OFF = (UINT32)SKF_NET_OFF;                         // (network header)
+    struct sock_filter code[] =
+    {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, AD_PROTOCOL),           // 0: A = ethertype
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x0800, 0, 4),         // 1: IPv4? (else goto 6)
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, NET_OFF + 12),          // 2: A = IPv4 src addr
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),                           // 3: X = A
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, NET_OFF + 16),          // 4: A = IPv4 dst addr
+        BPF_JUMP(BPF_JMP | BPF_JA, 4, 0, 0),                       // 5: goto 10
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x86dd, 0, 11),        // 6: IPv6? (else goto 18)
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, NET_OFF + 20),          // 7: A = IPv6 src addr (low word)
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),                           // 8: X = A
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, NET_OFF + 36),          // 9: A = IPv6 dst addr (low word)
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),                    // 10: A ^= X
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),                           // 11: X = A
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),                   // 12: A >>= 16
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),                    // 13: A ^= X
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, shard_count),          // 14: A %= shard_count
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, shard_index, 0, 1),    // 15: our shard? (else goto 17)
+        BPF_STMT(BPF_RET | BPF_K, ACCEPT),                         // 16: accept
+        BPF_STMT(BPF_RET | BPF_K, 0),                              // 17: drop
+        BPF_STMT(BPF_RET | BPF_K, IsPrimary() ? ACCEPT : 0)        // 18: non-IP frames go to primary
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(struct sock_filter);
+    prog.filter = code;
+    if (setsockopt(descriptor, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfShard::AttachFilter() setsockopt(SO_ATTACH_FILTER) error: %s\n", GetErrorString());
+        return false;
+    }
+    return true;
+}  // end SmfShard::AttachFilter()
+
+#else  // !LINUX
+
+bool SmfShard::Start(unsigned int shardCount)
+{
+    if (1 == shardCount) return true;
+    PLOG(PL_ERROR, "SmfShard::Start() error: flow sharding not supported on this system\n");
+    return false;
+}  // end SmfShard::Start()
+
+void SmfShard::Stop()
+{
+}  // end SmfShard::Stop()
+
+void SmfShard::PublishCounters(const Counters* counters, unsigned int count)
+{
+}  // end SmfShard::PublishCounters()
+
+void SmfShard::AddShardCounters(unsigned int ifIndex, Counters& totals) const
+{
+}  // end SmfShard::AddShardCounters()
+
+bool SmfShard::AttachFilter(int descriptor) const
+{
+    return !IsActive();
+}  // end SmfShard::AttachFilter()
+
+#endif // if/else LINUX
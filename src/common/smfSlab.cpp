@@ -0,0 +1,157 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfSlab.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for strcmp(), memcpy()
+#include <stdint.h>  // for uintptr_t
+
+SmfSlab* SmfSlab::slab_head = NULL;
+
+SmfSlab::SmfSlab(const char* name, size_t objectSize, size_t objectAlignment)
+ : slab_name(name), object_size(0), alignment(objectAlignment), slab_objects(0),
+   slab_list(NULL), slab_count(0), free_list(NULL), use_count(0), use_peak(0),
+   fail_count(0), next(slab_head)
+{
+    if (alignment < sizeof(FreeItem)) alignment = sizeof(FreeItem);
+    object_size = (objectSize + alignment - 1) & ~(alignment - 1);
+    slab_objects = SLAB_SIZE / object_size;
+    if (0 == slab_objects) slab_objects = 1;
+    slab_head = this;
+}
+
+SmfSlab::~SmfSlab()
+{
+    // (objects still in use may be deleted later during process exit, so we
+    //  leave the slab memory and free list intact in that case)
+    Destroy();
+    if (0 != use_count) return;
+    SmfSlab* prev = NULL;
+    SmfSlab* slab = slab_head;
+    while ((NULL != slab) && (this != slab))
+    {
+        prev = slab;
+        slab = slab->next;
+    }
+    if (NULL == slab) return;
+    if (NULL != prev)
+        prev->next = next;
+    else
+        slab_head = next;
+}
+
+void SmfSlab::Destroy()
+{
+    if (0 != use_count)
+    {
+        PLOG(PL_DEBUG, "SmfSlab::Destroy() %s: %u objects still in use\n", slab_name, use_count);
+        return;
+    }
+    while (NULL != slab_list)
+    {
+        char* nextSlab;
+        memcpy(&nextSlab, slab_list, sizeof(char*));
+        delete[] slab_list;
+        slab_list = nextSlab;
+    }
+    slab_count = 0;
+    free_list = NULL;
+}  // end SmfSlab::Destroy()
+
+bool SmfSlab::Grow()
+{
+    // The raw slab begins with a link to the next slab, followed by
+    // the "alignment"-aligned array of objects
+    size_t rawSize = sizeof(char*) + (alignment - 1) + ((size_t)slab_objects * object_size);
+    char* rawSlab = new char[rawSize];
+    if (NULL == rawSlab)
+    {
+        PLOG(PL_ERROR, "SmfSlab::Grow() %s new slab error: %s\n", slab_name, GetErrorString());
+        return false;
+    }
+    memcpy(rawSlab, &slab_list, sizeof(char*));
+    slab_list = rawSlab;
+    slab_count++;
+    uintptr_t base = ((uintptr_t)(rawSlab + sizeof(char*)) + (alignment - 1)) & ~((uintptr_t)alignment - 1);
+    // Push objects in reverse so they are handed out in address order
+    for (unsigned int i = slab_objects; i > 0; i--)
+    {
+        FreeItem* item = static_cast<FreeItem*>((void*)(base + ((i - 1) * object_size)));
+        item->next = free_list;
+        free_list = item;
+    }
+    return true;
+}  // end SmfSlab::Grow()
+
+bool SmfSlab::Preallocate(unsigned int count)
+{
+    while (GetObjectCount() < count)
+    {
+        if (!Grow()) return false;
+    }
+    return true;
+}  // end SmfSlab::Preallocate()
+
+void* SmfSlab::Get(size_t size)
+{
+    if (size > object_size)
+    {
+        PLOG(PL_ERROR, "SmfSlab::Get() %s error: oversized object\n", slab_name);
+        fail_count++;
+        return NULL;
+    }
+    if ((NULL == free_list) && !Grow())
+    {
+        fail_count++;
+        return NULL;
+    }
+    FreeItem* item = free_list;
+    free_list = item->next;
+    if (++use_count > use_peak) use_peak = use_count;
+    return (void*)item;
+}  // end SmfSlab::Get()
+
+void SmfSlab::Put(void* ptr)
+{
+    if (NULL == ptr) return;
+    FreeItem* item = static_cast<FreeItem*>(ptr);
+    item->next = free_list;
+    free_list = item;
+    use_count--;
+}  // end SmfSlab::Put()
+
+SmfSlab* SmfSlab::Find(const char* name)
+{
+    for (SmfSlab* slab = slab_head; NULL != slab; slab = slab->next)
+    {
+        if (!strcmp(name, slab->slab_name)) return slab;
+    }
+    return NULL;
+}  // end SmfSlab::Find()
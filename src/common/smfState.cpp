@@ -0,0 +1,232 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfState.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memset(), memcpy(), memcmp()
+#include <time.h>    // for time()
+
+#ifdef UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // UNIX
+
+static const char SMF_STATE_MAGIC[4] = {'S', 'M', 'F', 'S'};
+
+SmfStateFile::SmfStateFile()
+ : file_descriptor(-1), map_base(NULL), map_size(0), header(NULL), record_array(NULL),
+   capacity(0), free_stack(NULL), free_count(0)
+{
+}
+
+SmfStateFile::~SmfStateFile()
+{
+    Close();
+}
+
+#ifdef UNIX
+
+bool SmfStateFile::Open(const char* path, unsigned int staleMax, unsigned int recordCapacity, bool* adopted)
+{
+    if (IsOpen()) Close();
+    if (NULL != adopted) *adopted = false;
+    if (0 == recordCapacity) recordCapacity = CAPACITY_DEFAULT;
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfStateFile::Open() open(%s) error: %s\n", path, GetErrorString());
+        return false;
+    }
+    size_t size = sizeof(Header) + ((size_t)recordCapacity * sizeof(Record));
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0)
+    {
+        PLOG(PL_ERROR, "SmfStateFile::Open() fstat() error: %s\n", GetErrorString());
+        close(fd);
+        return false;
+    }
+    bool sizeMatch = ((size_t)fileStat.st_size == size);
+    if (!sizeMatch && (ftruncate(fd, (off_t)size) < 0))
+    {
+        PLOG(PL_ERROR, "SmfStateFile::Open() ftruncate() error: %s\n", GetErrorString());
+        close(fd);
+        return false;
+    }
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfStateFile::Open() mmap() error: %s\n", GetErrorString());
+        close(fd);
+        return false;
+    }
+    file_descriptor = fd;
+    map_base = ptr;
+    map_size = size;
+    header = static_cast<Header*>(map_base);
+    record_array = static_cast<Record*>((void*)((char*)map_base + sizeof(Header)));
+    capacity = recordCapacity;
+
+    // Validate any existing state and check its staleness
+    UINT32 now = (UINT32)time(NULL);
+    bool valid = sizeMatch &&
+                 (0 == memcmp(header->magic, SMF_STATE_MAGIC, 4)) &&
+                 (VERSION == header->version) &&
+                 (sizeof(Record) == header->record_size) &&
+                 (capacity == header->capacity) &&
+                 ((now - header->write_time) <= staleMax);
+    if (!valid)
+    {
+        PLOG(PL_INFO, "SmfStateFile::Open() initializing state file %s\n", path);
+        memset(map_base, 0, map_size);
+        memcpy(header->magic, SMF_STATE_MAGIC, 4);
+        header->version = VERSION;
+        header->record_size = sizeof(Record);
+        header->capacity = capacity;
+    }
+    header->write_time = now;
+
+    if (NULL == (free_stack = new UINT32[capacity]))
+    {
+        PLOG(PL_ERROR, "SmfStateFile::Open() new free_stack error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    free_count = 0;
+    unsigned int pendingCount = 0;
+    for (unsigned int i = capacity; i > 0; i--)
+    {
+        Record& record = record_array[i - 1];
+        if ((FREE == record.type) || (record.flow_id_size > (FLOW_ID_MAX << 3)))
+        {
+            record.type = FREE;
+            free_stack[free_count++] = i - 1;
+        }
+        else
+        {
+            record.type |= PENDING;
+            pendingCount++;
+        }
+    }
+    if (valid)
+    {
+        PLOG(PL_INFO, "SmfStateFile::Open() adopting %u flow state records from %s\n", pendingCount, path);
+        if (NULL != adopted) *adopted = true;
+    }
+    return true;
+}  // end SmfStateFile::Open()
+
+void SmfStateFile::Close()
+{
+    if (NULL != map_base)
+    {
+        header->write_time = (UINT32)time(NULL);
+        munmap(map_base, map_size);
+        map_base = NULL;
+        map_size = 0;
+    }
+    if (file_descriptor >= 0)
+    {
+        close(file_descriptor);
+        file_descriptor = -1;
+    }
+    if (NULL != free_stack)
+    {
+        delete[] free_stack;
+        free_stack = NULL;
+    }
+    header = NULL;
+    record_array = NULL;
+    capacity = free_count = 0;
+}  // end SmfStateFile::Close()
+
+#else  // !UNIX
+
+bool SmfStateFile::Open(const char* path, unsigned int staleMax, unsigned int recordCapacity, bool* adopted)
+{
+    PLOG(PL_ERROR, "SmfStateFile::Open() error: state file not supported on this system\n");
+    return false;
+}  // end SmfStateFile::Open()
+
+void SmfStateFile::Close()
+{
+}  // end SmfStateFile::Close()
+
+#endif // if/else UNIX
+
+SmfStateFile::Record* SmfStateFile::Allocate(RecordType type, const char* flowId, unsigned int flowIdSize)
+{
+    unsigned int flowIdBytes = (flowIdSize + 7) >> 3;
+    if (!IsOpen() || (0 == free_count) || (flowIdBytes > FLOW_ID_MAX)) return NULL;
+    Record& record = record_array[free_stack[--free_count]];
+    record.flow_id_size = (UINT16)flowIdSize;
+    record.pkt_id_size = 0;
+    record.if_index = 0;
+    record.window_size = 0;
+    record.value = 0;
+    memcpy(record.flow_id, flowId, flowIdBytes);
+    record.type = (UINT8)type;  // (set last)
+    return &record;
+}  // end SmfStateFile::Allocate()
+
+void SmfStateFile::Release(Record* record)
+{
+    if (!IsOpen() || (NULL == record)) return;
+    record->type = FREE;
+    free_stack[free_count++] = (UINT32)(record - record_array);
+}  // end SmfStateFile::Release()
+
+SmfStateFile::Record* SmfStateFile::GetNextPending(RecordType type, Record* prev) const
+{
+    if (!IsOpen()) return NULL;
+    unsigned int index = (NULL != prev) ? (unsigned int)(prev - record_array) + 1 : 0;
+    for (; index < capacity; index++)
+    {
+        if ((PENDING | type) == record_array[index].type)
+            return &record_array[index];
+    }
+    return NULL;
+}  // end SmfStateFile::GetNextPending()
+
+void SmfStateFile::ReleasePending()
+{
+    if (!IsOpen()) return;
+    for (unsigned int i = 0; i < capacity; i++)
+    {
+        if (0 != (PENDING & record_array[i].type))
+            Release(&record_array[i]);
+    }
+}  // end SmfStateFile::ReleasePending()
+
+void SmfStateFile::SetWriteTime(UINT32 wallTime)
+{
+    if (IsOpen()) header->write_time = wallTime;
+}  // end SmfStateFile::SetWriteTime()
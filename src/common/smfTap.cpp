@@ -0,0 +1,620 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfTap.h"
+#include "protoDebug.h"
+#include "protoNet.h"
+
+#ifdef LINUX
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <net/if.h>
+#include <net/if_arp.h>      // for ARPHRD_ETHER
+#include <linux/if_tun.h>
+#include <sys/uio.h>    // for readv(), writev()
+#ifndef TUN_F_USO4
+#define TUN_F_USO4  0x20    // (UDP segmentation offload flags added in Linux 6.2)
+#define TUN_F_USO6  0x40
+#endif // !TUN_F_USO4
+#include <fcntl.h>
+#include <unistd.h>     // for close(), read(), write()
+#include <string.h>     // for memset(), strncpy()
+#include <errno.h>
+#endif // LINUX
+
+SmfTap::SmfTap(unsigned int queueCount, bool vnetHdr)
+ : queue_count(0), read_index(0), vnet_hdr(vnetHdr),
+   gso_buffer(NULL), gso_length(0), gso_offset(0), gso_index(0), gso_size(0),
+   gso_proto(0), gso_ipv4(true), gso_l4_offset(0), gso_hdr_len(0), gso_ip_id(0),
+   gso_seq(0), super_count(0), segment_count(0)
+{
+    if (queueCount < 1)
+        queueCount = 1;
+    else if (queueCount > QUEUE_COUNT_MAX)
+        queueCount = QUEUE_COUNT_MAX;
+    queue_count = queueCount;
+    for (unsigned int i = 0; i < QUEUE_COUNT_MAX; i++)
+        queue_fd[i] = -1;
+}
+
+SmfTap::~SmfTap()
+{
+    Close();
+}
+
+unsigned int SmfTap::GetFlowQueue(const char* frame, unsigned int frameLength, unsigned int queueCount)
+{
+    // (Same address fold as the SmfShard socket filter)
+    if ((queueCount < 2) || (frameLength < 14)) return 0;
+    const unsigned char* ptr = (const unsigned char*)frame;
+    UINT16 type = (ptr[12] << 8) | ptr[13];
+    unsigned int srcOffset, dstOffset;
+    if ((0x0800 == type) && (frameLength >= 34))
+    {
+        srcOffset = 26;
+        dstOffset = 30;
+    }
+    else if ((0x86dd == type) && (frameLength >= 54))
+    {
+        srcOffset = 34;  // (low 32 bits of IPv6 src/dst addresses)
+        dstOffset = 50;
+    }
+    else
+    {
+        return 0;
+    }
+    UINT32 hash = 0;
+    for (unsigned int i = 0; i < 4; i++)
+        hash = (hash << 8) | (ptr[srcOffset + i] ^ ptr[dstOffset + i]);
+    hash ^= (hash >> 16);
+    return (unsigned int)((hash & 0xffff) % queueCount);
+}  // end SmfTap::GetFlowQueue()
+
+// Adds "data" to a 16-bit one's complement "sum" (as used for IP/TCP/UDP checksums)
+UINT32 SmfTap::ChecksumAdd(UINT32 sum, const UINT8* data, unsigned int length)
+{
+    while (length > 1)
+    {
+        sum += (data[0] << 8) | data[1];
+        data += 2;
+        length -= 2;
+    }
+    if (0 != length) sum += (data[0] << 8);
+    return sum;
+}  // end SmfTap::ChecksumAdd()
+
+UINT16 SmfTap::ChecksumFold(UINT32 sum)
+{
+    while (0 != (sum >> 16))
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (UINT16)sum;
+}  // end SmfTap::ChecksumFold()
+
+#ifdef LINUX
+
+// The IFF_VNET_HDR frame header (i.e. "struct virtio_net_hdr", mirrored
+// here since <linux/virtio_net.h> can't be included in C++ code)
+struct SmfVnetHdr
+{
+    UINT8   flags;
+    UINT8   gso_type;
+    UINT16  hdr_len;
+    UINT16  gso_size;
+    UINT16  csum_start;
+    UINT16  csum_offset;
+};
+enum
+{
+    VNET_HDR_F_NEEDS_CSUM   = 0x01,
+    VNET_HDR_GSO_NONE       = 0,
+    VNET_HDR_GSO_TCPV4      = 1,
+    VNET_HDR_GSO_TCPV6      = 4,
+    VNET_HDR_GSO_UDP_L4     = 5,
+    VNET_HDR_GSO_ECN        = 0x80
+};
+
+// Validates the headers of the GSO super-frame in "gso_buffer" and sets up
+// its segmentation state.  (Only TCP and UDP (USO) GSO types are supported)
+bool SmfTap::InitSegmentation(UINT8 gsoType, UINT16 gsoSize, unsigned int frameLength)
+{
+    const UINT8* frame = (const UINT8*)gso_buffer;
+    if ((0 == gsoSize) || (frameLength < 34)) return false;
+    UINT16 type = (frame[12] << 8) | frame[13];
+    const UINT8* ip = frame + 14;
+    unsigned int l4Offset;
+    UINT8 proto;
+    if ((0x0800 == type) && (4 == (ip[0] >> 4)))
+    {
+        gso_ipv4 = true;
+        l4Offset = 14 + ((ip[0] & 0x0f) << 2);
+        proto = ip[9];
+        gso_ip_id = (ip[4] << 8) | ip[5];
+    }
+    else if ((0x86dd == type) && (6 == (ip[0] >> 4)))
+    {
+        gso_ipv4 = false;
+        l4Offset = 14 + 40;  // (no IPv6 extension headers expected)
+        proto = ip[6];
+    }
+    else
+    {
+        return false;
+    }
+    unsigned int hdrLen;
+    switch (gsoType & ~VNET_HDR_GSO_ECN)
+    {
+        case VNET_HDR_GSO_TCPV4:
+        case VNET_HDR_GSO_TCPV6:
+            if ((6 != proto) || (frameLength < (l4Offset + 20))) return false;
+            hdrLen = l4Offset + ((frame[l4Offset + 12] >> 4) << 2);
+            gso_seq = ((UINT32)frame[l4Offset + 4] << 24) | ((UINT32)frame[l4Offset + 5] << 16) |
+                      ((UINT32)frame[l4Offset + 6] << 8) | (UINT32)frame[l4Offset + 7];
+            break;
+        case VNET_HDR_GSO_UDP_L4:
+            if (17 != proto) return false;
+            hdrLen = l4Offset + 8;
+            break;
+        default:
+            return false;
+    }
+    if (hdrLen >= frameLength) return false;
+    gso_proto = proto;
+    gso_l4_offset = l4Offset;
+    gso_hdr_len = hdrLen;
+    gso_size = gsoSize;
+    gso_offset = hdrLen;
+    gso_index = 0;
+    gso_length = frameLength;
+    super_count++;
+    return true;
+}  // end SmfTap::InitSegmentation()
+
+// Copies the next segment of the pending GSO super-frame into "buffer"
+bool SmfTap::GetNextSegment(char* buffer, unsigned int& numBytes)
+{
+    unsigned int payload = gso_length - gso_offset;
+    if (payload > gso_size) payload = gso_size;
+    bool last = ((gso_offset + payload) >= gso_length);
+    unsigned int segLength = gso_hdr_len + payload;
+    if (segLength > numBytes)
+    {
+        PLOG(PL_ERROR, "SmfTap::GetNextSegment() error: segment size %u exceeds buffer size\n", segLength);
+        gso_length = 0;
+        numBytes = 0;
+        return false;
+    }
+    memcpy(buffer, gso_buffer, gso_hdr_len);
+    memcpy(buffer + gso_hdr_len, gso_buffer + gso_offset, payload);
+    UINT8* ip = (UINT8*)buffer + 14;
+    UINT8* l4 = (UINT8*)buffer + gso_l4_offset;
+    unsigned int l4Length = segLength - gso_l4_offset;
+    UINT32 sum;  // L4 pseudo header sum
+    if (gso_ipv4)
+    {
+        unsigned int ipLength = segLength - 14;
+        ip[2] = (UINT8)(ipLength >> 8);
+        ip[3] = (UINT8)ipLength;
+        UINT16 id = gso_ip_id + gso_index;
+        ip[4] = (UINT8)(id >> 8);
+        ip[5] = (UINT8)id;
+        ip[10] = ip[11] = 0;
+        UINT16 ipSum = ~ChecksumFold(ChecksumAdd(0, ip, gso_l4_offset - 14));
+        ip[10] = (UINT8)(ipSum >> 8);
+        ip[11] = (UINT8)ipSum;
+        sum = ChecksumAdd(0, ip + 12, 8);  // src/dst addresses
+    }
+    else
+    {
+        unsigned int payloadLength = segLength - 54;
+        ip[4] = (UINT8)(payloadLength >> 8);
+        ip[5] = (UINT8)payloadLength;
+        sum = ChecksumAdd(0, ip + 8, 32);  // src/dst addresses
+    }
+    sum += gso_proto + l4Length;
+    unsigned int sumOffset;
+    if (6 == gso_proto)
+    {
+        UINT32 seq = gso_seq + (gso_offset - gso_hdr_len);
+        l4[4] = (UINT8)(seq >> 24);
+        l4[5] = (UINT8)(seq >> 16);
+        l4[6] = (UINT8)(seq >> 8);
+        l4[7] = (UINT8)seq;
+        if (!last) l4[13] &= ~0x09;             // FIN and PSH only on last segment
+        if (0 != gso_index) l4[13] &= ~0x80;    // CWR only on first segment
+        sumOffset = 16;
+    }
+    else
+    {
+        l4[4] = (UINT8)(l4Length >> 8);
+        l4[5] = (UINT8)l4Length;
+        sumOffset = 6;
+    }
+    l4[sumOffset] = l4[sumOffset + 1] = 0;
+    UINT16 l4Sum = ~ChecksumFold(ChecksumAdd(sum, l4, l4Length));
+    if ((17 == gso_proto) && (0 == l4Sum)) l4Sum = 0xffff;
+    l4[sumOffset] = (UINT8)(l4Sum >> 8);
+    l4[sumOffset + 1] = (UINT8)l4Sum;
+    gso_offset += payload;
+    gso_index++;
+    if (last) gso_length = 0;
+    segment_count++;
+    numBytes = segLength;
+    return true;
+}  // end SmfTap::GetNextSegment()
+
+bool SmfTap::Open(const char* vifName, const ProtoAddress& ipAddr, unsigned int maskLen)
+{
+    if (IsOpen()) Close();
+    struct ifreq req;
+    for (unsigned int i = 0; i < queue_count; i++)
+    {
+        // Each open of "/dev/net/tun" attached with the same name adds a queue
+        if ((queue_fd[i] = open("/dev/net/tun", O_RDWR | O_NONBLOCK)) < 0)
+        {
+            PLOG(PL_ERROR, "SmfTap::Open() open(/dev/net/tun) error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+        memset(&req, 0, sizeof(req));
+        req.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE;
+        if (vnet_hdr) req.ifr_flags |= IFF_VNET_HDR;
+        strncpy(req.ifr_name, vifName, IFNAMSIZ - 1);
+        if (ioctl(queue_fd[i], TUNSETIFF, &req) < 0)
+        {
+            PLOG(PL_ERROR, "SmfTap::Open() ioctl(TUNSETIFF) queue %u error: %s\n", i, GetErrorString());
+            Close();
+            return false;
+        }
+    }
+    strncpy(vif_name, req.ifr_name, IFNAMSIZ);
+    vif_name[IFNAMSIZ - 1] = '\0';
+    if (vnet_hdr)
+    {
+        // Let the kernel pass us partial checksum and TSO (and USO) super-frames
+        unsigned int offloads = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+        // (Older kernels reject the USO flags, so we retry without them)
+        if ((ioctl(queue_fd[0], TUNSETOFFLOAD, offloads | TUN_F_USO4 | TUN_F_USO6) < 0) &&
+            (ioctl(queue_fd[0], TUNSETOFFLOAD, offloads) < 0))
+        {
+            PLOG(PL_ERROR, "SmfTap::Open() ioctl(TUNSETOFFLOAD) error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+        if (NULL == (gso_buffer = new char[SUPER_FRAME_MAX]))
+        {
+            PLOG(PL_ERROR, "SmfTap::Open() new gso_buffer error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+    }
+    gso_length = 0;
+    if ((descriptor = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() epoll_create1() error: %s\n", GetErrorString());
+        descriptor = INVALID_HANDLE;
+        Close();
+        return false;
+    }
+    for (unsigned int i = 0; i < queue_count; i++)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        if (epoll_ctl(descriptor, EPOLL_CTL_ADD, queue_fd[i], &event) < 0)
+        {
+            PLOG(PL_ERROR, "SmfTap::Open() epoll_ctl() error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+    }
+    if (!ProtoNet::GetInterfaceAddress(vif_name, ProtoAddress::ETH, hw_addr))
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() error: unable to get hardware address for \"%s\"\n", vif_name);
+        Close();
+        return false;
+    }
+    // Bring the interface up
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() socket() error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    memset(&req, 0, sizeof(req));
+    strncpy(req.ifr_name, vif_name, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFFLAGS, &req) < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() ioctl(SIOCGIFFLAGS) error: %s\n", GetErrorString());
+        close(fd);
+        Close();
+        return false;
+    }
+    req.ifr_flags |= IFF_UP;
+    if (ioctl(fd, SIOCSIFFLAGS, &req) < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() ioctl(SIOCSIFFLAGS) error: %s\n", GetErrorString());
+        close(fd);
+        Close();
+        return false;
+    }
+    close(fd);
+    if (ipAddr.IsValid() && !ProtoNet::AddInterfaceAddress(vif_name, ipAddr, maskLen))
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() error: unable to assign address %s\n", ipAddr.GetHostString());
+        Close();
+        return false;
+    }
+    read_index = 0;
+    if (!ProtoChannel::Open())
+    {
+        PLOG(PL_ERROR, "SmfTap::Open() error: ProtoChannel::Open() failure\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end SmfTap::Open()
+
+void SmfTap::Close()
+{
+    ProtoChannel::Close();
+    if (INVALID_HANDLE != descriptor)
+    {
+        close(descriptor);
+        descriptor = INVALID_HANDLE;
+    }
+    // (the device goes away when the last queue is closed)
+    for (unsigned int i = 0; i < queue_count; i++)
+    {
+        if (queue_fd[i] >= 0)
+        {
+            close(queue_fd[i]);
+            queue_fd[i] = -1;
+        }
+    }
+    if (NULL != gso_buffer)
+    {
+        delete[] gso_buffer;
+        gso_buffer = NULL;
+    }
+    gso_length = 0;
+}  // end SmfTap::Close()
+
+bool SmfTap::SetHardwareAddress(const ProtoAddress& ethAddr)
+{
+    if (ProtoAddress::ETH != ethAddr.GetType())
+    {
+        PLOG(PL_ERROR, "SmfTap::SetHardwareAddress() error: invalid address type\n");
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::SetHardwareAddress() socket() error: %s\n", GetErrorString());
+        return false;
+    }
+    struct ifreq req;
+    memset(&req, 0, sizeof(req));
+    strncpy(req.ifr_name, vif_name, IFNAMSIZ - 1);
+    req.ifr_hwaddr.sa_family = ARPHRD_ETHER;
+    memcpy(req.ifr_hwaddr.sa_data, ethAddr.GetRawHostAddress(), 6);
+    if (ioctl(fd, SIOCSIFHWADDR, &req) < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::SetHardwareAddress() ioctl(SIOCSIFHWADDR) error: %s\n", GetErrorString());
+        close(fd);
+        return false;
+    }
+    close(fd);
+    hw_addr = ethAddr;
+    return true;
+}  // end SmfTap::SetHardwareAddress()
+
+bool SmfTap::SetARP(bool status)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::SetARP() socket() error: %s\n", GetErrorString());
+        return false;
+    }
+    struct ifreq req;
+    memset(&req, 0, sizeof(req));
+    strncpy(req.ifr_name, vif_name, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFFLAGS, &req) < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::SetARP() ioctl(SIOCGIFFLAGS) error: %s\n", GetErrorString());
+        close(fd);
+        return false;
+    }
+    if (status)
+        req.ifr_flags &= ~IFF_NOARP;
+    else
+        req.ifr_flags |= IFF_NOARP;
+    if (ioctl(fd, SIOCSIFFLAGS, &req) < 0)
+    {
+        PLOG(PL_ERROR, "SmfTap::SetARP() ioctl(SIOCSIFFLAGS) error: %s\n", GetErrorString());
+        close(fd);
+        return false;
+    }
+    close(fd);
+    return true;
+}  // end SmfTap::SetARP()
+
+bool SmfTap::Write(const char* buffer, unsigned int numBytes)
+{
+    unsigned int index = GetFlowQueue(buffer, numBytes, queue_count);
+    ssize_t result;
+    if (vnet_hdr)
+    {
+        // (a zeroed header is a plain frame with no offload)
+        SmfVnetHdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        struct iovec iov[2];
+        iov[0].iov_base = &hdr;
+        iov[0].iov_len = sizeof(hdr);
+        iov[1].iov_base = (void*)buffer;
+        iov[1].iov_len = numBytes;
+        result = writev(queue_fd[index], iov, 2);
+        if (result >= (ssize_t)sizeof(hdr)) result -= sizeof(hdr);
+    }
+    else
+    {
+        result = write(queue_fd[index], buffer, numBytes);
+    }
+    if (result < 0)
+    {
+        if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            PLOG(PL_ERROR, "SmfTap::Write() write() error: %s\n", GetErrorString());
+        return false;
+    }
+    else if ((unsigned int)result != numBytes)
+    {
+        PLOG(PL_ERROR, "SmfTap::Write() error: incomplete write\n");
+        return false;
+    }
+    return true;
+}  // end SmfTap::Write()
+
+bool SmfTap::Read(char* buffer, unsigned int& numBytes)
+{
+    if (0 != gso_length) return GetNextSegment(buffer, numBytes);
+    // Check each queue once, starting where we left off for fairness
+    for (unsigned int i = 0; i < queue_count; i++)
+    {
+        unsigned int index = read_index;
+        if (++read_index >= queue_count) read_index = 0;
+        if (vnet_hdr)
+        {
+            // A frame that fits goes directly into "buffer" while the
+            // remainder of a larger GSO super-frame lands in "gso_buffer"
+            if (numBytes > SUPER_FRAME_MAX) numBytes = SUPER_FRAME_MAX;
+            SmfVnetHdr hdr;
+            struct iovec iov[3];
+            iov[0].iov_base = &hdr;
+            iov[0].iov_len = sizeof(hdr);
+            iov[1].iov_base = buffer;
+            iov[1].iov_len = numBytes;
+            iov[2].iov_base = gso_buffer + numBytes;
+            iov[2].iov_len = SUPER_FRAME_MAX - numBytes;
+            ssize_t result = readv(queue_fd[index], iov, 3);
+            if (result >= (ssize_t)sizeof(hdr))
+            {
+                unsigned int frameLength = (unsigned int)(result - sizeof(hdr));
+                if (VNET_HDR_GSO_NONE == (hdr.gso_type & ~VNET_HDR_GSO_ECN))
+                {
+                    if (frameLength > numBytes)
+                    {
+                        PLOG(PL_ERROR, "SmfTap::Read() error: oversized frame (%u bytes)\n", frameLength);
+                        continue;
+                    }
+                    if (0 != (VNET_HDR_F_NEEDS_CSUM & hdr.flags))
+                    {
+                        // Complete the partial checksum (the checksum field holds the pseudo header sum)
+                        unsigned int sumOffset = hdr.csum_start + hdr.csum_offset;
+                        if ((hdr.csum_start < frameLength) && ((sumOffset + 2) <= frameLength))
+                        {
+                            UINT8* ptr = (UINT8*)buffer;
+                            UINT16 sum = ~ChecksumFold(ChecksumAdd(0, ptr + hdr.csum_start, frameLength - hdr.csum_start));
+                            ptr[sumOffset] = (UINT8)(sum >> 8);
+                            ptr[sumOffset + 1] = (UINT8)sum;
+                        }
+                    }
+                    numBytes = frameLength;
+                    return true;
+                }
+                // A GSO super-frame to segment (make it contiguous in "gso_buffer" first)
+                memcpy(gso_buffer, buffer, (frameLength < numBytes) ? frameLength : numBytes);
+                if (!InitSegmentation(hdr.gso_type, hdr.gso_size, frameLength))
+                {
+                    PLOG(PL_ERROR, "SmfTap::Read() error: unsupported GSO frame (type %u)\n", hdr.gso_type);
+                    continue;
+                }
+                return GetNextSegment(buffer, numBytes);
+            }
+            else if (result >= 0)
+            {
+                continue;  // (runt read, shouldn't happen)
+            }
+        }
+        else
+        {
+            ssize_t result = read(queue_fd[index], buffer, numBytes);
+            if (result >= 0)
+            {
+                numBytes = (unsigned int)result;
+                return true;
+            }
+        }
+        if ((EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno))
+        {
+            PLOG(PL_ERROR, "SmfTap::Read() read() error: %s\n", GetErrorString());
+            numBytes = 0;
+            return false;
+        }
+    }
+    numBytes = 0;  // nothing ready on any queue
+    return true;
+}  // end SmfTap::Read()
+
+#else  // !LINUX
+
+bool SmfTap::Open(const char* vifName, const ProtoAddress& ipAddr, unsigned int maskLen)
+{
+    PLOG(PL_ERROR, "SmfTap::Open() error: multi-queue tap not supported on this system\n");
+    return false;
+}  // end SmfTap::Open()
+
+void SmfTap::Close()
+{
+}  // end SmfTap::Close()
+
+bool SmfTap::SetHardwareAddress(const ProtoAddress& ethAddr)
+{
+    return false;
+}  // end SmfTap::SetHardwareAddress()
+
+bool SmfTap::SetARP(bool status)
+{
+    return false;
+}  // end SmfTap::SetARP()
+
+bool SmfTap::Write(const char* buffer, unsigned int numBytes)
+{
+    return false;
+}  // end SmfTap::Write()
+
+bool SmfTap::Read(char* buffer, unsigned int& numBytes)
+{
+    numBytes = 0;
+    return false;
+}  // end SmfTap::Read()
+
+#endif // if/else LINUX
@@ -0,0 +1,144 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfTimingWheel.h"
+
+#include <string.h>  // for memset()
+
+SmfTimingWheel::Item::Item()
+ : expire_time(0), wheel_slot(NULL), wheel_prev(NULL), wheel_next(NULL)
+{
+}
+
+SmfTimingWheel::Item::~Item()
+{
+}
+
+SmfTimingWheel::SmfTimingWheel()
+ : wheel_time(0), item_count(0)
+{
+    memset(slot_array, 0, sizeof(slot_array));
+}
+
+SmfTimingWheel::~SmfTimingWheel()
+{
+}
+
+void SmfTimingWheel::Link(Item*& slotHead, Item& item)
+{
+    item.wheel_slot = &slotHead;
+    item.wheel_prev = NULL;
+    item.wheel_next = slotHead;
+    if (NULL != slotHead) slotHead->wheel_prev = &item;
+    slotHead = &item;
+}  // end SmfTimingWheel::Link()
+
+void SmfTimingWheel::Insert(Item& item)
+{
+    // (past due items go in the next level 0 slot)
+    unsigned int delta = item.expire_time - wheel_time;
+    if ((0 == delta) || (delta > ((unsigned int)-1 >> 1)))
+        Link(slot_array[0][(wheel_time + 1) & SLOT_MASK], item);
+    else if (delta < SLOTS)
+        Link(slot_array[0][item.expire_time & SLOT_MASK], item);
+    else if (delta < (SLOTS << SLOT_BITS))
+        Link(slot_array[1][(item.expire_time >> SLOT_BITS) & SLOT_MASK], item);
+    else
+        Link(slot_array[1][((wheel_time >> SLOT_BITS) - 1) & SLOT_MASK], item);
+}  // end SmfTimingWheel::Insert()
+
+void SmfTimingWheel::Schedule(Item& item, unsigned int expireTime)
+{
+    if (item.IsScheduled()) Cancel(item);
+    item.expire_time = expireTime;
+    Insert(item);
+    item_count++;
+}  // end SmfTimingWheel::Schedule()
+
+void SmfTimingWheel::Cancel(Item& item)
+{
+    if (!item.IsScheduled()) return;
+    if (NULL != item.wheel_prev)
+        item.wheel_prev->wheel_next = item.wheel_next;
+    else
+        *item.wheel_slot = item.wheel_next;
+    if (NULL != item.wheel_next)
+        item.wheel_next->wheel_prev = item.wheel_prev;
+    item.wheel_slot = NULL;
+    item.wheel_prev = item.wheel_next = NULL;
+    item_count--;
+}  // end SmfTimingWheel::Cancel()
+
+SmfTimingWheel::Item* SmfTimingWheel::Advance(unsigned int currentTime)
+{
+    Item* expiredList = NULL;
+    if (0 == item_count)
+    {
+        wheel_time = currentTime;  // nothing to do
+        return NULL;
+    }
+    while ((int)(currentTime - wheel_time) > 0)
+    {
+        wheel_time++;
+        unsigned int index = wheel_time & SLOT_MASK;
+        if (0 == index)
+        {
+            // Cascade the next level 1 slot down into level 0
+            Item* item = slot_array[1][(wheel_time >> SLOT_BITS) & SLOT_MASK];
+            slot_array[1][(wheel_time >> SLOT_BITS) & SLOT_MASK] = NULL;
+            while (NULL != item)
+            {
+                Item* nextItem = item->wheel_next;
+                if (item->expire_time == wheel_time)
+                    Link(slot_array[0][index], *item);
+                else
+                    Insert(*item);
+                item = nextItem;
+            }
+        }
+        Item* item = slot_array[0][index];
+        slot_array[0][index] = NULL;
+        while (NULL != item)
+        {
+            Item* nextItem = item->wheel_next;
+            item->wheel_slot = NULL;
+            item->wheel_prev = NULL;
+            item->wheel_next = expiredList;
+            expiredList = item;
+            item_count--;
+            item = nextItem;
+        }
+        if (0 == item_count)
+        {
+            wheel_time = currentTime;
+            break;
+        }
+    }
+    return expiredList;
+}  // end SmfTimingWheel::Advance()
@@ -0,0 +1,187 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "smfTxBatch.h"
+#include "protoDebug.h"
+
+#include <string.h>     // for memcpy()
+#ifdef LINUX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif // LINUX
+
+SmfTxBatch::SmfTxBatch()
+ : batch_size(0), frame_size(0), frame_buffer(NULL), frame_length(NULL),
+   frame_count(0), send_index(0), msg_vector(NULL), iov_vector(NULL),
+   send_count(0), flush_count(0), error_count(0)
+{
+}
+
+SmfTxBatch::~SmfTxBatch()
+{
+    Destroy();
+}
+
+#ifdef LINUX
+
+bool SmfTxBatch::Init(unsigned int batchSize, unsigned int frameSizeMax)
+{
+    Destroy();
+    if ((batchSize < 2) || (batchSize > BATCH_SIZE_MAX))
+    {
+        PLOG(PL_ERROR, "SmfTxBatch::Init() error: invalid batch size %u\n", batchSize);
+        return false;
+    }
+    if (NULL == (frame_buffer = new char[batchSize * frameSizeMax]))
+    {
+        PLOG(PL_ERROR, "SmfTxBatch::Init() new frame_buffer error: %s\n", GetErrorString());
+        return false;
+    }
+    frame_length = new unsigned int[batchSize];
+    struct mmsghdr* msgVector = new struct mmsghdr[batchSize];
+    struct iovec* iovVector = new struct iovec[batchSize];
+    msg_vector = msgVector;
+    iov_vector = iovVector;
+    if ((NULL == frame_length) || (NULL == msgVector) || (NULL == iovVector))
+    {
+        PLOG(PL_ERROR, "SmfTxBatch::Init() new error: %s\n", GetErrorString());
+        Destroy();
+        return false;
+    }
+    // The message headers refer to fixed buffer slots, so only the
+    // iov_len needs to be set as frames are staged
+    memset(msgVector, 0, batchSize * sizeof(struct mmsghdr));
+    for (unsigned int i = 0; i < batchSize; i++)
+    {
+        iovVector[i].iov_base = frame_buffer + (i * frameSizeMax);
+        iovVector[i].iov_len = 0;
+        msgVector[i].msg_hdr.msg_iov = iovVector + i;
+        msgVector[i].msg_hdr.msg_iovlen = 1;
+    }
+    batch_size = batchSize;
+    frame_size = frameSizeMax;
+    frame_count = send_index = 0;
+    return true;
+}  // end SmfTxBatch::Init()
+
+void SmfTxBatch::Destroy()
+{
+    if (NULL != msg_vector)
+    {
+        delete[] (struct mmsghdr*)msg_vector;
+        msg_vector = NULL;
+    }
+    if (NULL != iov_vector)
+    {
+        delete[] (struct iovec*)iov_vector;
+        iov_vector = NULL;
+    }
+    if (NULL != frame_length)
+    {
+        delete[] frame_length;
+        frame_length = NULL;
+    }
+    if (NULL != frame_buffer)
+    {
+        delete[] frame_buffer;
+        frame_buffer = NULL;
+    }
+    batch_size = frame_size = 0;
+    frame_count = send_index = 0;
+}  // end SmfTxBatch::Destroy()
+
+bool SmfTxBatch::Stage(const char* frame, unsigned int frameLength, const char* srcMac)
+{
+    ASSERT(frameLength <= frame_size);
+    if (IsFull()) return false;
+    char* slot = frame_buffer + (frame_count * frame_size);
+    memcpy(slot, frame, frameLength);
+    if ((NULL != srcMac) && (frameLength >= 12))
+        memcpy(slot + 6, srcMac, 6);  // Ethernet src MAC addr field
+    ((struct iovec*)iov_vector)[frame_count].iov_len = frameLength;
+    frame_length[frame_count++] = frameLength;
+    return true;
+}  // end SmfTxBatch::Stage()
+
+bool SmfTxBatch::Flush(int fd)
+{
+    struct mmsghdr* msgVector = (struct mmsghdr*)msg_vector;
+    while (send_index < frame_count)
+    {
+        int result = sendmmsg(fd, msgVector + send_index, frame_count - send_index, 0);
+        if (result < 0)
+        {
+            switch (errno)
+            {
+                case EINTR:
+                    continue;
+                case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+                case EWOULDBLOCK:
+#endif // EWOULDBLOCK != EAGAIN
+                    return false;  // remaining frames are kept for retry
+                default:
+                    // Drop the offending frame and carry on with the rest
+                    PLOG(PL_WARN, "SmfTxBatch::Flush() sendmmsg() error: %s\n", GetErrorString());
+                    error_count++;
+                    send_index++;
+                    continue;
+            }
+        }
+        send_index += result;
+        send_count += result;
+        flush_count++;
+    }
+    frame_count = send_index = 0;
+    return true;
+}  // end SmfTxBatch::Flush()
+
+#else  // !LINUX
+
+bool SmfTxBatch::Init(unsigned int batchSize, unsigned int frameSizeMax)
+{
+    PLOG(PL_ERROR, "SmfTxBatch::Init() error: batched transmission not supported on this system\n");
+    return false;
+}  // end SmfTxBatch::Init()
+
+void SmfTxBatch::Destroy()
+{
+}  // end SmfTxBatch::Destroy()
+
+bool SmfTxBatch::Stage(const char* frame, unsigned int frameLength, const char* srcMac)
+{
+    return false;
+}  // end SmfTxBatch::Stage()
+
+bool SmfTxBatch::Flush(int fd)
+{
+    return true;
+}  // end SmfTxBatch::Flush()
+
+#endif // if/else LINUX
@@ -0,0 +1,544 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfUring.h"
+#include "protoDebug.h"
+
+#ifdef LINUX
+#include <linux/io_uring.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <arpa/inet.h>  // for htons()
+#include <unistd.h>     // for close()
+#include <string.h>     // for memset()
+#include <errno.h>
+#endif // LINUX
+
+SmfUring::SmfUring()
+ : ring_fd(-1), sq_ring(NULL), sq_ring_size(0), cq_ring(NULL), cq_ring_size(0),
+   sqe_array(NULL), sqe_array_size(0), sq_head(NULL), sq_tail(NULL), sq_flags(NULL),
+   sq_mask(0), sq_entries(0), sq_index_array(NULL), sq_local_tail(0),
+   cq_head(NULL), cq_tail(NULL), cq_mask(0), cqe_array(NULL), cq_local_head(0),
+   buffer_area(NULL), buffer_size(0), frame_count(0), buf_ring(NULL), buf_ring_size(0),
+   buf_tail(0), recv_count(0), rearm_count(0)
+{
+    for (int i = 0; i < SOCKET_MAX; i++)
+    {
+        socket_table[i].fd = -1;
+        socket_table[i].user_data = NULL;
+        socket_table[i].enabled = false;
+        socket_table[i].armed = false;
+        socket_table[i].closing = false;
+    }
+}
+
+SmfUring::~SmfUring()
+{
+    Close();
+}
+
+#ifdef LINUX
+
+// Our (single) provided buffer group id
+#define SMF_URING_BGID 0
+
+// The provided buffer ring tail overlays the "resv" field of its first entry.  (Note
+// we don't use "struct io_uring_buf_ring" since its flexible "bufs" array member
+// is not at offset zero when the kernel header is compiled as C++)
+#define SMF_URING_BUF_TAIL(bufRing) (&(bufRing)[0].resv)
+
+bool SmfUring::Open(unsigned int frameCount, unsigned int ringSize)
+{
+    if (IsOpen()) Close();
+    // (buffer ids are 16 bits and the buffer ring size must be a power of 2)
+    if ((0 == frameCount) || (frameCount > 32768) || (0 != (frameCount & (frameCount - 1))))
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() error: invalid frame count %u\n", frameCount);
+        return false;
+    }
+    // The completion queue is sized so a completion can be posted for every buffer
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 2*((frameCount > ringSize) ? frameCount : ringSize);
+    ring_fd = (int)syscall(__NR_io_uring_setup, ringSize, &params);
+    if (ring_fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() io_uring_setup() error: %s\n", GetErrorString());
+        ring_fd = -1;
+        return false;
+    }
+    sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned int);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    if (0 != (params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        if (cq_ring_size > sq_ring_size) sq_ring_size = cq_ring_size;
+        cq_ring_size = sq_ring_size;
+    }
+    void* ptr = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() mmap(sq_ring) error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    sq_ring = (char*)ptr;
+    if (0 != (params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        cq_ring = sq_ring;
+    }
+    else
+    {
+        ptr = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ptr)
+        {
+            PLOG(PL_ERROR, "SmfUring::Open() mmap(cq_ring) error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+        cq_ring = (char*)ptr;
+    }
+    sqe_array_size = params.sq_entries*sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, sqe_array_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() mmap(sqes) error: %s\n", GetErrorString());
+        sqe_array_size = 0;
+        Close();
+        return false;
+    }
+    sqe_array = (struct io_uring_sqe*)ptr;
+    sq_head = (unsigned int*)(sq_ring + params.sq_off.head);
+    sq_tail = (unsigned int*)(sq_ring + params.sq_off.tail);
+    sq_flags = (unsigned int*)(sq_ring + params.sq_off.flags);
+    sq_mask = *(unsigned int*)(sq_ring + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_index_array = (unsigned int*)(sq_ring + params.sq_off.array);
+    sq_local_tail = *sq_tail;
+    cq_head = (unsigned int*)(cq_ring + params.cq_off.head);
+    cq_tail = (unsigned int*)(cq_ring + params.cq_off.tail);
+    cq_mask = *(unsigned int*)(cq_ring + params.cq_off.ring_mask);
+    cqe_array = (struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+    cq_local_head = *cq_head;
+
+    // Allocate the frame buffer pool and register it as our provided buffer ring
+    buffer_size = (size_t)frameCount * FRAME_SIZE;
+    ptr = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() mmap(buffers) error: %s\n", GetErrorString());
+        buffer_size = 0;
+        Close();
+        return false;
+    }
+    buffer_area = (char*)ptr;
+    frame_count = frameCount;
+    buf_ring_size = frameCount*sizeof(struct io_uring_buf);
+    ptr = mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() mmap(buf_ring) error: %s\n", GetErrorString());
+        buf_ring_size = 0;
+        Close();
+        return false;
+    }
+    buf_ring = (struct io_uring_buf*)ptr;
+    memset(buf_ring, 0, buf_ring_size);  // (fault the pages in before the kernel pins them)
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)buf_ring;
+    reg.ring_entries = frameCount;
+    reg.bgid = SMF_URING_BGID;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() io_uring_register(PBUF_RING) error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    buf_tail = 0;
+    for (unsigned int i = 0; i < frameCount; i++)
+        ReleaseFrame(buffer_area + (size_t)i*FRAME_SIZE + FRAME_HEADROOM);
+    __atomic_store_n(SMF_URING_BUF_TAIL(buf_ring), buf_tail, __ATOMIC_RELEASE);
+
+    // Completions are signaled via an eventfd that serves as our ProtoChannel descriptor
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd < 0)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() eventfd() error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    descriptor = efd;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD, &efd, 1) < 0)
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() io_uring_register(EVENTFD) error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    if (!ProtoChannel::Open())
+    {
+        PLOG(PL_ERROR, "SmfUring::Open() error: ProtoChannel::Open() failure\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end SmfUring::Open()
+
+void SmfUring::Close()
+{
+    ProtoChannel::Close();
+    for (int i = 0; i < SOCKET_MAX; i++)
+    {
+        if (socket_table[i].fd >= 0) close(socket_table[i].fd);
+        socket_table[i].fd = -1;
+        socket_table[i].user_data = NULL;
+        socket_table[i].enabled = false;
+        socket_table[i].armed = false;
+        socket_table[i].closing = false;
+    }
+    // (closing the ring cancels any outstanding requests)
+    if (ring_fd >= 0)
+    {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+    if (NULL != sqe_array)
+    {
+        munmap(sqe_array, sqe_array_size);
+        sqe_array = NULL;
+        sqe_array_size = 0;
+    }
+    if ((NULL != cq_ring) && (cq_ring != sq_ring))
+        munmap(cq_ring, cq_ring_size);
+    cq_ring = NULL;
+    cq_ring_size = 0;
+    if (NULL != sq_ring)
+    {
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = NULL;
+        sq_ring_size = 0;
+    }
+    if (NULL != buf_ring)
+    {
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = NULL;
+        buf_ring_size = 0;
+    }
+    if (NULL != buffer_area)
+    {
+        munmap(buffer_area, buffer_size);
+        buffer_area = NULL;
+        buffer_size = 0;
+    }
+    frame_count = 0;
+    if (INVALID_HANDLE != descriptor)
+    {
+        close(descriptor);
+        descriptor = INVALID_HANDLE;
+    }
+}  // end SmfUring::Close()
+
+int SmfUring::AddSocket(unsigned int ifIndex, const void* userData)
+{
+    if (!IsOpen())
+    {
+        PLOG(PL_ERROR, "SmfUring::AddSocket() error: ring not open\n");
+        return -1;
+    }
+    int slot;
+    for (slot = 0; slot < SOCKET_MAX; slot++)
+    {
+        if ((socket_table[slot].fd < 0) && !socket_table[slot].closing) break;
+    }
+    if (SOCKET_MAX == slot)
+    {
+        PLOG(PL_ERROR, "SmfUring::AddSocket() error: socket table full\n");
+        return -1;
+    }
+    int fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "SmfUring::AddSocket() socket() error: %s\n", GetErrorString());
+        return -1;
+    }
+#ifdef PACKET_IGNORE_OUTGOING
+    // Let the kernel skip our own (and other local) transmissions
+    int ignore = 1;
+    if (setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof(ignore)) < 0)
+    {
+        // (unlike SmfRing, we have no sockaddr_ll per frame to filter them ourselves)
+        PLOG(PL_ERROR, "SmfUring::AddSocket() setsockopt(PACKET_IGNORE_OUTGOING) error: %s\n", GetErrorString());
+        close(fd);
+        return -1;
+    }
+#endif // PACKET_IGNORE_OUTGOING
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifIndex;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        PLOG(PL_ERROR, "SmfUring::AddSocket() bind() error: %s\n", GetErrorString());
+        close(fd);
+        return -1;
+    }
+    Socket& s = socket_table[slot];
+    s.fd = fd;
+    s.user_data = userData;
+    s.enabled = false;
+    s.armed = false;
+    s.closing = false;
+    if (!Arm(slot) || !Submit())
+    {
+        PLOG(PL_ERROR, "SmfUring::AddSocket() error: unable to arm multishot receive\n");
+        RemoveSocket(slot);
+        return -1;
+    }
+    return slot;
+}  // end SmfUring::AddSocket()
+
+void SmfUring::RemoveSocket(int slot)
+{
+    if ((slot < 0) || (slot >= SOCKET_MAX) || (socket_table[slot].fd < 0)) return;
+    Socket& s = socket_table[slot];
+    // The slot isn't reused until the final completion for its receive request is seen
+    if (s.armed && Cancel(slot)) Submit();
+    s.closing = s.armed;
+    close(s.fd);
+    s.fd = -1;
+    s.user_data = NULL;
+    s.enabled = false;
+}  // end SmfUring::RemoveSocket()
+
+void SmfUring::EnableSocket(int slot, bool enable)
+{
+    if ((slot < 0) || (slot >= SOCKET_MAX) || (socket_table[slot].fd < 0)) return;
+    socket_table[slot].enabled = enable;
+}  // end SmfUring::EnableSocket()
+
+struct io_uring_sqe* SmfUring::GetSqe()
+{
+    unsigned int head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if ((sq_local_tail - head) >= sq_entries)
+    {
+        // Submission queue full, so submit what we have and try again
+        if (!Submit()) return NULL;
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if ((sq_local_tail - head) >= sq_entries) return NULL;
+    }
+    unsigned int index = sq_local_tail & sq_mask;
+    sq_index_array[index] = index;
+    sq_local_tail++;
+    struct io_uring_sqe* sqe = sqe_array + index;
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}  // end SmfUring::GetSqe()
+
+bool SmfUring::Submit(bool getEvents)
+{
+    unsigned int count = sq_local_tail - *sq_tail;
+    if ((0 == count) && !getEvents) return true;
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    unsigned int flags = getEvents ? IORING_ENTER_GETEVENTS : 0;
+    if (syscall(__NR_io_uring_enter, ring_fd, count, 0, flags, NULL, 0) < 0)
+    {
+        // (entries left in the submission queue will be submitted next time)
+        if ((EINTR != errno) && (EAGAIN != errno) && (EBUSY != errno))
+            PLOG(PL_ERROR, "SmfUring::Submit() io_uring_enter() error: %s\n", GetErrorString());
+        return false;
+    }
+    return true;
+}  // end SmfUring::Submit()
+
+// Prepares a multishot receive request for the socket in the given slot (user_data is slot + 1)
+bool SmfUring::Arm(int slot)
+{
+    struct io_uring_sqe* sqe = GetSqe();
+    if (NULL == sqe) return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket_table[slot].fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = SMF_URING_BGID;
+    sqe->user_data = (UINT64)(slot + 1);
+    socket_table[slot].armed = true;
+    return true;
+}  // end SmfUring::Arm()
+
+// Prepares cancellation of the socket's receive request (the cancel request's own user_data is 0)
+bool SmfUring::Cancel(int slot)
+{
+    struct io_uring_sqe* sqe = GetSqe();
+    if (NULL == sqe) return false;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (UINT64)(slot + 1);
+    sqe->user_data = 0;
+    return true;
+}  // end SmfUring::Cancel()
+
+void SmfUring::BeginReceive()
+{
+    UINT64 value;
+    if (read(descriptor, &value, sizeof(value)) < 0)
+    {
+        if (EAGAIN != errno)
+            PLOG(PL_ERROR, "SmfUring::BeginReceive() read() error: %s\n", GetErrorString());
+    }
+}  // end SmfUring::BeginReceive()
+
+bool SmfUring::GetNextFrame(char*& frame, unsigned int& frameLength, const void*& userData)
+{
+    if (ring_fd < 0) return false;
+    unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (cq_local_head != tail)
+    {
+        const struct io_uring_cqe* cqe = cqe_array + (cq_local_head & cq_mask);
+        cq_local_head++;
+        if (0 == cqe->user_data) continue;  // cancel request completion
+        Socket& s = socket_table[cqe->user_data - 1];
+        if (0 == (cqe->flags & IORING_CQE_F_MORE))
+        {
+            // The multishot receive terminated (it is re-armed in EndReceive() if still open)
+            if ((cqe->res < 0) && (-ENOBUFS != cqe->res) && (-ECANCELED != cqe->res))
+                PLOG(PL_WARN, "SmfUring::GetNextFrame() warning: receive error: %s\n", strerror(-cqe->res));
+            s.armed = false;
+            s.closing = false;
+        }
+        if (0 == (cqe->flags & IORING_CQE_F_BUFFER)) continue;
+        char* buffer = buffer_area + (size_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT)*FRAME_SIZE + FRAME_HEADROOM;
+        if ((cqe->res > 0) && (s.fd >= 0) && s.enabled)
+        {
+            frame = buffer;
+            frameLength = (unsigned int)cqe->res;
+            userData = s.user_data;
+            recv_count++;
+            return true;
+        }
+        ReleaseFrame(buffer);
+    }
+    return false;
+}  // end SmfUring::GetNextFrame()
+
+void SmfUring::ReleaseFrame(char* frame)
+{
+    // (the buffer ring tail isn't published to the kernel until EndReceive())
+    unsigned int bid = (unsigned int)((frame - buffer_area) / FRAME_SIZE);
+    struct io_uring_buf* buf = buf_ring + (buf_tail & (frame_count - 1));
+    buf->addr = (unsigned long)(buffer_area + (size_t)bid*FRAME_SIZE + FRAME_HEADROOM);
+    buf->len = FRAME_SIZE - FRAME_HEADROOM - FRAME_TAILROOM;
+    buf->bid = (UINT16)bid;
+    buf_tail++;
+}  // end SmfUring::ReleaseFrame()
+
+void SmfUring::EndReceive()
+{
+    if (ring_fd < 0) return;
+    __atomic_store_n(SMF_URING_BUF_TAIL(buf_ring), buf_tail, __ATOMIC_RELEASE);
+    __atomic_store_n(cq_head, cq_local_head, __ATOMIC_RELEASE);
+    for (int slot = 0; slot < SOCKET_MAX; slot++)
+    {
+        if ((socket_table[slot].fd >= 0) && !socket_table[slot].armed)
+        {
+            if (Arm(slot)) rearm_count++;
+        }
+    }
+    // Completions that overflowed the completion queue are flushed upon entering the kernel
+    bool overflow = (0 != (__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW));
+    Submit(overflow);
+}  // end SmfUring::EndReceive()
+
+#else  // !LINUX
+
+bool SmfUring::Open(unsigned int frameCount, unsigned int ringSize)
+{
+    PLOG(PL_ERROR, "SmfUring::Open() error: io_uring not supported on this system\n");
+    return false;
+}  // end SmfUring::Open()
+
+void SmfUring::Close()
+{
+}  // end SmfUring::Close()
+
+int SmfUring::AddSocket(unsigned int ifIndex, const void* userData)
+{
+    return -1;
+}  // end SmfUring::AddSocket()
+
+void SmfUring::RemoveSocket(int slot)
+{
+}  // end SmfUring::RemoveSocket()
+
+void SmfUring::EnableSocket(int slot, bool enable)
+{
+}  // end SmfUring::EnableSocket()
+
+struct io_uring_sqe* SmfUring::GetSqe()
+{
+    return NULL;
+}  // end SmfUring::GetSqe()
+
+bool SmfUring::Submit(bool getEvents)
+{
+    return false;
+}  // end SmfUring::Submit()
+
+bool SmfUring::Arm(int slot)
+{
+    return false;
+}  // end SmfUring::Arm()
+
+bool SmfUring::Cancel(int slot)
+{
+    return false;
+}  // end SmfUring::Cancel()
+
+void SmfUring::BeginReceive()
+{
+}  // end SmfUring::BeginReceive()
+
+bool SmfUring::GetNextFrame(char*& frame, unsigned int& frameLength, const void*& userData)
+{
+    return false;
+}  // end SmfUring::GetNextFrame()
+
+void SmfUring::ReleaseFrame(char* frame)
+{
+}  // end SmfUring::ReleaseFrame()
+
+void SmfUring::EndReceive()
+{
+}  // end SmfUring::EndReceive()
+
+#endif // if/else LINUX
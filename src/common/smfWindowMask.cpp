@@ -0,0 +1,190 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "smfWindowMask.h"
+#include "protoDebug.h"
+#include <string.h>  // for memset()
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif // __AVX2__
+
+SmfWindowMask::SmfWindowMask()
+ : bits(NULL), num_bits(0), range_mask(0), delta_shift(0), last_set(0), is_set(false)
+{
+}
+
+SmfWindowMask::~SmfWindowMask()
+{
+    Destroy();
+}
+
+bool SmfWindowMask::Init(UINT32 numBits, UINT8 seqNumSize)
+{
+    Destroy();
+    if ((seqNumSize < 8) || (seqNumSize > 32))
+    {
+        PLOG(PL_ERROR, "SmfWindowMask::Init() error: invalid sequence number size: %d\n", seqNumSize);
+        return false;
+    }
+    UINT32 size = 64;
+    while (size < numBits) size <<= 1;
+    if ((size > ((UINT32)0x01 << (seqNumSize - 1))) || (0 == size))
+    {
+        PLOG(PL_ERROR, "SmfWindowMask::Init() error: invalid window size\n");
+        return false;
+    }
+    if (NULL == (bits = new UINT64[size >> 6]))
+    {
+        PLOG(PL_ERROR, "SmfWindowMask::Init() new bits error: %s\n", GetErrorString());
+        return false;
+    }
+    memset(bits, 0, (size >> 6) * sizeof(UINT64));
+    num_bits = size;
+    range_mask = 0xffffffff >> (32 - seqNumSize);
+    delta_shift = 32 - seqNumSize;
+    last_set = 0;
+    is_set = false;
+    return true;
+}  // end SmfWindowMask::Init()
+
+void SmfWindowMask::Destroy()
+{
+    if (NULL != bits)
+    {
+        delete[] bits;
+        bits = NULL;
+    }
+    num_bits = 0;
+    is_set = false;
+}  // end SmfWindowMask::Destroy()
+
+bool SmfWindowMask::Resize(UINT32 numBits)
+{
+    UINT32 size = 64;
+    while (size < numBits) size <<= 1;
+    if (size == num_bits) return true;
+    if (size > ((range_mask >> 1) + 1))
+    {
+        PLOG(PL_ERROR, "SmfWindowMask::Resize() error: invalid window size\n");
+        return false;
+    }
+    UINT64* newBits = new UINT64[size >> 6];
+    if (NULL == newBits)
+    {
+        PLOG(PL_ERROR, "SmfWindowMask::Resize() new bits error: %s\n", GetErrorString());
+        return false;
+    }
+    memset(newBits, 0, (size >> 6) * sizeof(UINT64));
+    if (is_set)
+    {
+        // Copy the most recent history, a word at a time where the
+        // old and new ring positions are word-aligned with each other
+        // (they always are since both sizes are multiples of 64)
+        UINT32 count = (size < num_bits) ? size : num_bits;
+        UINT32 seq = (last_set - count + 1) & range_mask;
+        while (0 != count)
+        {
+            UINT32 oldPos = seq & (num_bits - 1);
+            UINT32 newPos = seq & (size - 1);
+            UINT32 offset = oldPos & 63;  // (same as newPos & 63)
+            UINT32 span = 64 - offset;
+            if (span > count) span = count;
+            UINT64 mask = (64 == span) ? ~((UINT64)0) : ((((UINT64)1 << span) - 1) << offset);
+            newBits[newPos >> 6] |= (bits[oldPos >> 6] & mask);
+            seq = (seq + span) & range_mask;
+            count -= span;
+        }
+    }
+    delete[] bits;
+    bits = newBits;
+    num_bits = size;
+    return true;
+}  // end SmfWindowMask::Resize()
+
+// Clears "count" bits of the ring starting at ring position "pos"
+void SmfWindowMask::ClearRange(UINT32 pos, UINT32 count)
+{
+    UINT32 wordCount = num_bits >> 6;
+    while (0 != count)
+    {
+        UINT32 index = pos >> 6;
+        UINT32 offset = pos & 63;
+        if ((0 == offset) && (count >= 64))
+        {
+            // Clear whole words up to the end of the ring
+            UINT32 words = count >> 6;
+            if (words > (wordCount - index)) words = wordCount - index;
+            UINT64* ptr = bits + index;
+            UINT32 n = words;
+#ifdef __AVX2__
+            __m256i zero = _mm256_setzero_si256();
+            for (; n >= 4; n -= 4, ptr += 4)
+                _mm256_storeu_si256((__m256i*)ptr, zero);
+#endif // __AVX2__
+            for (; 0 != n; n--)
+                *ptr++ = 0;
+            pos = (pos + (words << 6)) & (num_bits - 1);
+            count -= (words << 6);
+        }
+        else
+        {
+            UINT32 span = 64 - offset;
+            if (span > count) span = count;
+            UINT64 mask = (64 == span) ? ~((UINT64)0) : ((((UINT64)1 << span) - 1) << offset);
+            bits[index] &= ~mask;
+            pos = (pos + span) & (num_bits - 1);
+            count -= span;
+        }
+    }
+}  // end SmfWindowMask::ClearRange()
+
+void SmfWindowMask::Advance(UINT32 seq, UINT32 delta)
+{
+    if (delta < num_bits)
+        ClearRange((last_set + 1) & (num_bits - 1), delta);
+    else
+        memset(bits, 0, (num_bits >> 6) * sizeof(UINT64));
+    Set(seq);
+    last_set = seq;
+}  // end SmfWindowMask::Advance()
+
+void SmfWindowMask::Reset(UINT32 seq)
+{
+    Clear();
+    Set(seq);
+    last_set = seq;
+    is_set = true;
+}  // end SmfWindowMask::Reset()
+
+void SmfWindowMask::Clear()
+{
+    if (NULL != bits) memset(bits, 0, (num_bits >> 6) * sizeof(UINT64));
+    is_set = false;
+}  // end SmfWindowMask::Clear()
@@ -0,0 +1,413 @@
+/*********************************************************************
+ *
+ * AUTHORIZATION TO USE AND DISTRIBUTE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that:
+ *
+ * (1) source code distributions retain this paragraph in its entirety,
+ *
+ * (2) distributions including binary code include this paragraph in
+ *     its entirety in the documentation or other materials provided
+ *     with the distribution, and
+ *
+ * (3) all advertising materials mentioning features or use of this
+ *     software display the following acknowledgment:
+ *
+ *  The name of NRL, the name(s) of NRL  employee(s), or any entity
+ *  of the United States Government may not be used to endorse or
+ *  promote  products derived from this software, nor does the
+ *  inclusion of the NRL written and developed software  directly or
+ *  indirectly suggest NRL or United States  Government endorsement
+ *  of this product.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "smfXdp.h"
+#include "protoDebug.h"
+
+#include <string.h>  // for memcpy(), strerror()
+
+#ifdef HAVE_XDP
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <linux/if_xdp.h>
+#include <errno.h>
+#include <unistd.h>
+#endif // HAVE_XDP
+
+SmfXdpUmem::SmfXdpUmem()
+ : umem_area(NULL), umem_size(0), frame_count(0),
+   free_stack(NULL), free_count(0), ref_count(NULL)
+#ifdef HAVE_XDP
+   , umem_handle(NULL)
+#endif // HAVE_XDP
+{
+}
+
+SmfXdpUmem::~SmfXdpUmem()
+{
+    Close();
+}
+
+bool SmfXdpUmem::AllocFrame(UINT64& addr)
+{
+    if (0 == free_count) return false;
+    addr = free_stack[--free_count];
+    ref_count[addr / FRAME_SIZE] = 1;
+    return true;
+}  // end SmfXdpUmem::AllocFrame()
+
+void SmfXdpUmem::ReleaseFrame(UINT64 addr)
+{
+    unsigned int index = (unsigned int)(addr / FRAME_SIZE);
+    ASSERT(0 != ref_count[index]);
+    if (0 == --ref_count[index])
+        free_stack[free_count++] = (UINT64)index * FRAME_SIZE;
+}  // end SmfXdpUmem::ReleaseFrame()
+
+#ifdef HAVE_XDP
+
+bool SmfXdpUmem::Open(unsigned int frameCount)
+{
+    if (IsOpen()) Close();
+    umem_size = (size_t)frameCount * FRAME_SIZE;
+    void* ptr = mmap(NULL, umem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptr)
+    {
+        PLOG(PL_ERROR, "SmfXdpUmem::Open() mmap() error: %s\n", GetErrorString());
+        umem_size = 0;
+        return false;
+    }
+    if ((NULL == (free_stack = new UINT64[frameCount])) ||
+        (NULL == (ref_count = new UINT16[frameCount])))
+    {
+        PLOG(PL_ERROR, "SmfXdpUmem::Open() new frame list error: %s\n", GetErrorString());
+        munmap(ptr, umem_size);
+        umem_size = 0;
+        Close();
+        return false;
+    }
+    struct xsk_umem_config config;
+    memset(&config, 0, sizeof(config));
+    config.fill_size = RING_SIZE;
+    config.comp_size = RING_SIZE;
+    config.frame_size = FRAME_SIZE;
+    config.frame_headroom = FRAME_HEADROOM;
+    config.flags = 0;
+    int result = xsk_umem__create(&umem_handle, ptr, umem_size, &umem_fill, &umem_comp, &config);
+    if (0 != result)
+    {
+        PLOG(PL_ERROR, "SmfXdpUmem::Open() xsk_umem__create() error: %s\n", strerror(-result));
+        umem_handle = NULL;
+        munmap(ptr, umem_size);
+        umem_size = 0;
+        Close();
+        return false;
+    }
+    umem_area = (char*)ptr;
+    frame_count = frameCount;
+    // Put all frames on the free list (pushed in reverse so lower frames are used first)
+    free_count = 0;
+    for (unsigned int i = frameCount; i > 0; i--)
+    {
+        ref_count[i-1] = 0;
+        free_stack[free_count++] = (UINT64)(i-1) * FRAME_SIZE;
+    }
+    return true;
+}  // end SmfXdpUmem::Open()
+
+void SmfXdpUmem::Close()
+{
+    if (NULL != umem_handle)
+    {
+        int result = xsk_umem__delete(umem_handle);
+        if (0 != result)
+            PLOG(PL_ERROR, "SmfXdpUmem::Close() xsk_umem__delete() error: %s\n", strerror(-result));
+        umem_handle = NULL;
+    }
+    if (NULL != umem_area)
+    {
+        munmap(umem_area, umem_size);
+        umem_area = NULL;
+        umem_size = 0;
+    }
+    if (NULL != free_stack)
+    {
+        delete[] free_stack;
+        free_stack = NULL;
+    }
+    if (NULL != ref_count)
+    {
+        delete[] ref_count;
+        ref_count = NULL;
+    }
+    free_count = frame_count = 0;
+}  // end SmfXdpUmem::Close()
+
+#else  // !HAVE_XDP
+
+bool SmfXdpUmem::Open(unsigned int frameCount)
+{
+    PLOG(PL_ERROR, "SmfXdpUmem::Open() error: AF_XDP support not built (requires HAVE_XDP)\n");
+    return false;
+}  // end SmfXdpUmem::Open()
+
+void SmfXdpUmem::Close()
+{
+}  // end SmfXdpUmem::Close()
+
+#endif // if/else HAVE_XDP
+
+SmfXdpSocket::SmfXdpSocket(SmfXdpUmem& theUmem)
+ : umem(theUmem), rx_index(0), rx_count(0), rx_peeked(0),
+   recv_count(0), send_count(0), zcopy_count(0)
+#ifdef HAVE_XDP
+   , xsk(NULL)
+#endif // HAVE_XDP
+{
+}
+
+SmfXdpSocket::~SmfXdpSocket()
+{
+    Close();
+}
+
+#ifdef HAVE_XDP
+
+bool SmfXdpSocket::Open(const char* ifaceName, unsigned int queueId, bool zeroCopy)
+{
+    if (IsOpen()) Close();
+    if (!umem.IsOpen() && !umem.Open())
+    {
+        PLOG(PL_ERROR, "SmfXdpSocket::Open() error: unable to open UMEM\n");
+        return false;
+    }
+    struct xsk_socket_config config;
+    memset(&config, 0, sizeof(config));
+    config.rx_size = SmfXdpUmem::RING_SIZE;
+    config.tx_size = SmfXdpUmem::RING_SIZE;
+    config.libxdp_flags = 0;  // libxdp loads its default XSK redirect program
+    config.xdp_flags = 0;
+    config.bind_flags = XDP_USE_NEED_WAKEUP | (zeroCopy ? XDP_ZEROCOPY : XDP_COPY);
+    int result = xsk_socket__create_shared(&xsk, ifaceName, queueId, umem.GetHandle(),
+                                           &rx_ring, &tx_ring, &fill_ring, &comp_ring, &config);
+    if (0 != result)
+    {
+        PLOG(PL_ERROR, "SmfXdpSocket::Open(%s) xsk_socket__create_shared() error: %s\n", ifaceName, strerror(-result));
+        xsk = NULL;
+        return false;
+    }
+    descriptor = xsk_socket__fd(xsk);
+    rx_index = rx_count = rx_peeked = 0;
+    Refill();
+    if (!ProtoChannel::Open())
+    {
+        PLOG(PL_ERROR, "SmfXdpSocket::Open() error: ProtoChannel::Open() failure\n");
+        Close();
+        return false;
+    }
+    return true;
+}  // end SmfXdpSocket::Open()
+
+void SmfXdpSocket::Close()
+{
+    ProtoChannel::Close();
+    if (NULL != xsk)
+    {
+        // Return the UMEM frames held by this socket's rings to the shared free
+        // list so the UMEM doesn't shrink as sockets are closed and reopened.
+        // The rx and completion rings are drained first, then the frames the
+        // kernel has not yet taken from the fill and tx rings are released just
+        // before the socket is deleted.  (A frame the kernel moves between rings
+        // meanwhile is left out rather than risking releasing it twice.)
+        while (0 != rx_count)
+        {
+            umem.ReleaseFrame(xsk_ring_cons__rx_desc(&rx_ring, rx_index++)->addr);
+            rx_count--;
+        }
+        if (0 != rx_peeked) xsk_ring_cons__release(&rx_ring, rx_peeked);
+        UINT32 index;
+        unsigned int count;
+        while (0 != (count = xsk_ring_cons__peek(&rx_ring, SmfXdpUmem::RING_SIZE, &index)))
+        {
+            for (unsigned int i = 0; i < count; i++)
+                umem.ReleaseFrame(xsk_ring_cons__rx_desc(&rx_ring, index + i)->addr);
+            xsk_ring_cons__release(&rx_ring, count);
+        }
+        Reclaim();
+        UINT32 cons = __atomic_load_n(fill_ring.consumer, __ATOMIC_ACQUIRE);
+        for (index = cons; index != fill_ring.cached_prod; index++)
+            umem.ReleaseFrame(*xsk_ring_prod__fill_addr(&fill_ring, index));
+        cons = __atomic_load_n(tx_ring.consumer, __ATOMIC_ACQUIRE);
+        for (index = cons; index != tx_ring.cached_prod; index++)
+            umem.ReleaseFrame(xsk_ring_prod__tx_desc(&tx_ring, index)->addr);
+        xsk_socket__delete(xsk);  // also closes the socket descriptor
+        xsk = NULL;
+    }
+    descriptor = INVALID_HANDLE;
+    rx_index = rx_count = rx_peeked = 0;
+}  // end SmfXdpSocket::Close()
+
+void SmfXdpSocket::Reclaim()
+{
+    UINT32 index;
+    unsigned int count = xsk_ring_cons__peek(&comp_ring, SmfXdpUmem::RING_SIZE, &index);
+    if (0 == count) return;
+    for (unsigned int i = 0; i < count; i++)
+        umem.ReleaseFrame(*xsk_ring_cons__comp_addr(&comp_ring, index + i));
+    xsk_ring_cons__release(&comp_ring, count);
+}  // end SmfXdpSocket::Reclaim()
+
+void SmfXdpSocket::Refill()
+{
+    unsigned int count = xsk_prod_nb_free(&fill_ring, SmfXdpUmem::RING_SIZE);
+    if (count > umem.GetFreeCount()) count = umem.GetFreeCount();
+    if (0 == count) return;
+    UINT32 index;
+    if (count != xsk_ring_prod__reserve(&fill_ring, count, &index)) return;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        UINT64 addr;
+        umem.AllocFrame(addr);  // (can't fail since count <= free count)
+        *xsk_ring_prod__fill_addr(&fill_ring, index + i) = addr;
+    }
+    xsk_ring_prod__submit(&fill_ring, count);
+}  // end SmfXdpSocket::Refill()
+
+void SmfXdpSocket::Kick()
+{
+    if (xsk_ring_prod__needs_wakeup(&tx_ring))
+    {
+        if ((sendto(descriptor, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0) &&
+            (ENOBUFS != errno) && (EAGAIN != errno) && (EBUSY != errno) && (ENETDOWN != errno))
+        {
+            PLOG(PL_ERROR, "SmfXdpSocket::Kick() sendto() error: %s\n", GetErrorString());
+        }
+    }
+}  // end SmfXdpSocket::Kick()
+
+bool SmfXdpSocket::GetNextFrame(char*& frame, unsigned int& frameLength)
+{
+    if (0 == rx_count)
+    {
+        UINT32 index;
+        rx_count = xsk_ring_cons__peek(&rx_ring, SmfXdpUmem::RING_SIZE, &index);
+        if (0 == rx_count) return false;
+        rx_index = index;
+        rx_peeked += rx_count;
+    }
+    const struct xdp_desc* desc = xsk_ring_cons__rx_desc(&rx_ring, rx_index++);
+    rx_count--;
+    frame = umem.GetPointer(desc->addr);
+    frameLength = desc->len;
+    recv_count++;
+    return true;
+}  // end SmfXdpSocket::GetNextFrame()
+
+void SmfXdpSocket::EndReceive()
+{
+    // Drop any frames that were peeked but not handled
+    while (0 != rx_count)
+    {
+        umem.ReleaseFrame(xsk_ring_cons__rx_desc(&rx_ring, rx_index++)->addr);
+        rx_count--;
+    }
+    if (0 != rx_peeked)
+    {
+        xsk_ring_cons__release(&rx_ring, rx_peeked);
+        rx_peeked = 0;
+    }
+    Reclaim();
+    Refill();
+}  // end SmfXdpSocket::EndReceive()
+
+bool SmfXdpSocket::Send(char* frame, unsigned int& frameLength, const char* srcMac, bool handoff)
+{
+    Reclaim();
+    if (0 == xsk_prod_nb_free(&tx_ring, 1))
+    {
+        Kick();
+        return false;  // tx ring is full, so we're blocked
+    }
+    UINT64 addr;
+    if (handoff && umem.Contains(frame) && (1 == umem.GetRefCount(umem.GetAddress(frame))))
+    {
+        // Received frame that only we hold, so transmit it by descriptor
+        addr = umem.GetAddress(frame);
+        memcpy(frame + 6, srcMac, 6);
+        umem.RetainFrame(addr);
+        zcopy_count++;
+    }
+    else
+    {
+        if (frameLength > (SmfXdpUmem::FRAME_SIZE - SmfXdpUmem::FRAME_HEADROOM))
+        {
+            PLOG(PL_ERROR, "SmfXdpSocket::Send() error: frame too large\n");
+            frameLength = 0;
+            return false;
+        }
+        if (!umem.AllocFrame(addr))
+        {
+            Kick();
+            return false;  // no free UMEM frames (treated as blocked until tx completions)
+        }
+        addr += SmfXdpUmem::FRAME_HEADROOM;
+        char* txFrame = umem.GetPointer(addr);
+        memcpy(txFrame, frame, frameLength);
+        memcpy(txFrame + 6, srcMac, 6);
+    }
+    UINT32 index;
+    xsk_ring_prod__reserve(&tx_ring, 1, &index);
+    struct xdp_desc* desc = xsk_ring_prod__tx_desc(&tx_ring, index);
+    desc->addr = addr;
+    desc->len = frameLength;
+    xsk_ring_prod__submit(&tx_ring, 1);
+    send_count++;
+    Kick();
+    return true;
+}  // end SmfXdpSocket::Send()
+
+#else  // !HAVE_XDP
+
+bool SmfXdpSocket::Open(const char* ifaceName, unsigned int queueId, bool zeroCopy)
+{
+    PLOG(PL_ERROR, "SmfXdpSocket::Open() error: AF_XDP support not built (requires HAVE_XDP)\n");
+    return false;
+}  // end SmfXdpSocket::Open()
+
+void SmfXdpSocket::Close()
+{
+}  // end SmfXdpSocket::Close()
+
+void SmfXdpSocket::Reclaim()
+{
+}  // end SmfXdpSocket::Reclaim()
+
+void SmfXdpSocket::Refill()
+{
+}  // end SmfXdpSocket::Refill()
+
+void SmfXdpSocket::Kick()
+{
+}  // end SmfXdpSocket::Kick()
+
+bool SmfXdpSocket::GetNextFrame(char*& frame, unsigned int& frameLength)
+{
+    return false;
+}  // end SmfXdpSocket::GetNextFrame()
+
+void SmfXdpSocket::EndReceive()
+{
+}  // end SmfXdpSocket::EndReceive()
+
+bool SmfXdpSocket::Send(char* frame, unsigned int& frameLength, const char* srcMac, bool handoff)
+{
+    frameLength = 0;
+    return false;
+}  // end SmfXdpSocket::Send()
+
+#endif // if/else HAVE_XDP
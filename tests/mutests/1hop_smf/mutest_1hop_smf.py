@@ -1,5 +1,6 @@
 """Basic SMF mutest."""
 
+import base64
 import subprocess
 
 from munet.mutest.userapi import match_step, step
@@ -44,6 +45,82 @@ def pipe_close(proc: subprocess.Popen, timeout: int = 5) -> None:
         proc.wait()
 
 
+# Sends "count" UDP packets to the group, each "copies" times back to back
+# with identical IP headers (the same source address and IP ID), so r1 sees
+# the duplicates.  Args: ifaddr srcaddr group port count copies
+DUP_SEND = """
+import socket, struct, sys, time
+ifaddr, src, grp = sys.argv[1], sys.argv[2], sys.argv[3]
+port, count, copies = int(sys.argv[4]), int(sys.argv[5]), int(sys.argv[6])
+sock = socket.socket(socket.AF_INET, socket.SOCK_RAW, socket.IPPROTO_RAW)
+sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(ifaddr))
+sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 0)
+for seq in range(count):
+    payload = b"dup %d" % seq
+    udp = struct.pack("!HHHH", port, port, 8 + len(payload), 0) + payload
+    ip = struct.pack("!BBHHHBBH4s4s", 0x45, 0, 20 + len(udp), 1000 + seq, 0, 8,
+                     socket.IPPROTO_UDP, 0, socket.inet_aton(src), socket.inet_aton(grp))
+    for _ in range(copies):
+        sock.sendto(ip + udp, (grp, 0))
+    time.sleep(0.05)
+"""
+
+# Counts the packets (and distinct payloads) received for the group for
+# "secs" seconds.  Args: ifaddr group port secs
+DUP_RECV = """
+import socket, sys, time
+ifaddr, grp, port, secs = sys.argv[1], sys.argv[2], int(sys.argv[3]), float(sys.argv[4])
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+sock.bind((grp, port))
+sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP,
+                socket.inet_aton(grp) + socket.inet_aton(ifaddr))
+counts = {}
+deadline = time.time() + secs
+while time.time() < deadline:
+    sock.settimeout(max(0.01, deadline - time.time()))
+    try:
+        data = sock.recv(2048)
+    except socket.timeout:
+        break
+    counts[data] = counts.get(data, 0) + 1
+total = sum(counts.values())
+print("received %d packets, %d unique, %d duplicates" % (total, len(counts), total - len(counts)))
+"""
+
+
+def python_cmd(script: str) -> str:
+    """Return a shell command running the given inline python script."""
+    encoded = base64.b64encode(script.encode()).decode()
+    return f'python3 -c "$(echo {encoded} | base64 -d)"'
+
+
+def check_duplicates(tag: str, desc: str, count: int = 40) -> None:
+    """Inject the same stream twice on both r1 interfaces and check that
+    each host receives each packet exactly once.
+
+    h1 (on eth0) and h2 (on eth1) each send every packet twice, so r1 gets
+    the same stream on both interfaces plus a back-to-back duplicate of each
+    packet.  With working DPD, r1 forwards the first copy from each side
+    once and drops the rest.  (The source address is not local to either
+    host, so neither drops the other's copies as martians.)
+    """
+    log = f"dup-{tag}.log"
+    for node, ifaddr in (("h1", "10.0.1.2"), ("h2", "10.0.2.2")):
+        step(node, f"{python_cmd(DUP_RECV)} {ifaddr} 239.0.0.2 5002 10 > {log} 2>&1 &")
+    step("r1", "sleep 1")
+    step("h2", f"{python_cmd(DUP_SEND)} 10.0.2.2 10.0.1.99 239.0.0.2 5002 {count} 2 &")
+    step("h1", f"{python_cmd(DUP_SEND)} 10.0.1.2 10.0.1.99 239.0.0.2 5002 {count} 2")
+    for node in ("h1", "h2"):
+        wait_step(
+            node,
+            f"cat {log}",
+            match=f"received {count} packets, {count} unique, 0 duplicates",
+            desc=f"{node} received each packet exactly once {desc}",
+            timeout=20,
+        )
+
+
 section("Verify interfaces are ready")
 
 for node in ("h1", "h2", "r1"):
@@ -152,6 +229,585 @@ wait_step(
     desc="stopped nrlsmf",
 )
 
+# AF_XDP packet I/O (requires nrlsmf built with XDP=1; nrlsmf would otherwise
+# quietly fall back to ProtoCap, so the log is checked for the AF_XDP sockets)
+section("Start nrlsmf merge eth0/x,eth1/x (AF_XDP) on r1 ")
+
+step("r1", "nrlsmf debug 4 merge eth0/x,eth1/x &> nrlsmf-xdp.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-xdp.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-xdp.log contains merge group for eth0,eth1",
+)
+
+for iface in ("eth0", "eth1"):
+    wait_step(
+        "r1",
+        'grep  "AF_XDP packet I/O enabled" nrlsmf-xdp.log',
+        match=f'"{iface}"',
+        desc=f"nrlsmf-xdp.log shows AF_XDP socket opened for {iface}",
+    )
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via AF_XDP merge",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# io_uring multishot receive (requires kernel 6.0 or later; nrlsmf would otherwise
+# quietly fall back to ProtoCap::Recv(), so the log is checked for io_uring capture)
+section("Start nrlsmf merge eth0/u,eth1/u (io_uring) on r1 ")
+
+step("r1", "nrlsmf debug 4 merge eth0/u,eth1/u &> nrlsmf-uring.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-uring.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-uring.log contains merge group for eth0,eth1",
+)
+
+for iface in ("eth0", "eth1"):
+    ifindex = step("r1", f"cat /sys/class/net/{iface}/ifindex").strip()
+    wait_step(
+        "r1",
+        'grep  "io_uring capture enabled" nrlsmf-uring.log',
+        match=rf"ifIndex {ifindex}\b",
+        desc=f"nrlsmf-uring.log shows io_uring capture enabled for {iface}",
+    )
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via io_uring merge",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# Open-addressing hash table DPD
+section("Start nrlsmf dpd hash merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 dpd hash merge eth0,eth1 &> nrlsmf-dpd.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-dpd.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-dpd.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with hash table DPD",
+)
+
+check_duplicates("dpd-hash", "with hash table DPD")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf dpd filter/256/1e-4 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 dpd filter/256/1e-4 merge eth0,eth1 &> nrlsmf-filter.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-filter.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-filter.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with cuckoo filter DPD",
+)
+
+check_duplicates("dpd-filter", "with cuckoo filter DPD")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf window on,64,1024 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 window on,64,1024 merge eth0,eth1 &> nrlsmf-window.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-window.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-window.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with adaptive window DPD",
+)
+
+check_duplicates("window", "with adaptive window DPD")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf dpd shared merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 dpd shared merge eth0,eth1 &> nrlsmf-shared.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-shared.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-shared.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with shared DPD store",
+)
+
+check_duplicates("dpd-shared", "with shared DPD store")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf budget 2 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 budget 2 merge eth0,eth1 &> nrlsmf-budget.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-budget.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-budget.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with flow budget",
+)
+
+wait_step(
+    "r1",
+    'grep  "budget>" nrlsmf-budget.log | tail -n1',
+    match="/2 evictions",
+    desc="nrlsmf-budget.log reports flow budget in use",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf prealloc flow/4096,pktid/65536 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 prealloc flow/4096,pktid/65536 merge eth0,eth1 &> nrlsmf-slab.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-slab.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-slab.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with preallocated flow slabs",
+)
+
+wait_step(
+    "r1",
+    'grep  "slab> pktid" nrlsmf-slab.log | tail -n1',
+    match="pktid use:",
+    desc="nrlsmf-slab.log reports preallocated packet id slab",
+)
+
+check_duplicates("prealloc", "with preallocated flow slabs")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf window on state nrlsmf.state merge eth0,eth1 on r1 ")
+
+step("r1", "rm -f nrlsmf.state")
+
+step("r1", "nrlsmf debug 4 window on state nrlsmf.state merge eth0,eth1 &> nrlsmf-state.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-state.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-state.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with state file",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+step("r1", "nrlsmf debug 4 window on state nrlsmf.state merge eth0,eth1 &> nrlsmf-state2.log &")
+
+wait_step(
+    "r1",
+    'grep  "adopting" nrlsmf-state2.log',
+    match="flow state records",
+    desc="nrlsmf-state2.log reports adopted flow state upon restart",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps after warm restart",
+)
+
+check_duplicates("state", "after warm restart")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf idpd off hash CRC32C merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 idpd off hash CRC32C merge eth0,eth1 &> nrlsmf-crc32c.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-crc32c.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-crc32c.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with CRC32C H-DPD",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf idpd off hash MD5 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 idpd off hash MD5 merge eth0,eth1 &> nrlsmf-md5.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-md5.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-md5.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with (batched) MD5 H-DPD",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+section("Start nrlsmf idpd off hashkey ... hash SIPHASH merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 idpd off hashkey 000102030405060708090a0b0c0d0e0f hash SIPHASH merge eth0,eth1 &> nrlsmf-siphash.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-siphash.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-siphash.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps with keyed SIPHASH H-DPD",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# Batched transmit (sendmmsg)
+section("Start nrlsmf batch 32 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 batch 32 merge eth0,eth1 &> nrlsmf-batch.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-batch.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-batch.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via batched transmit merge",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# Transmit pipeline threads
+section("Start nrlsmf pipeline 256 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 pipeline 256 merge eth0,eth1 &> nrlsmf-pipeline.log &")
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-pipeline.log',
+    match='"merge" eth0,eth1',
+    desc="nrlsmf-pipeline.log contains merge group for eth0,eth1",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via tx pipeline merge",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# Flow-sharded forwarding processes
+section("Start nrlsmf shards 2 merge eth0,eth1 on r1 ")
+
+step("r1", "nrlsmf debug 4 shards 2 merge eth0,eth1 &> nrlsmf-shards.log &")
+
+wait_step(
+    "r1",
+    'grep  "started flow shard 1" nrlsmf-shards.log',
+    match="started flow shard 1 of 2",
+    desc="nrlsmf-shards.log shows second flow shard started",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via flow-sharded merge",
+)
+
+# The hosts join 239.0.0.2 while the shards run, so their IGMP reports and the
+# group's data may be steered to different shards
+check_duplicates("shards", "with flow shards")
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# IGMP proxying needs membership state that the shards would each only see part of
+igmp_shards_output = step("r1", "sh -lc 'nrlsmf debug 2 shards 2 merge eth0,eth1 igmpProxy eth1 2>&1; echo EXIT:$?'")
+test_step(
+    "igmpProxy) error: not supported with flow shards" in igmp_shards_output,
+    "nrlsmf rejects igmpProxy with flow shards",
+    target="r1",
+)
+test_step("EXIT:0" not in igmp_shards_output, "nrlsmf shards with igmpProxy exits with an error", target="r1")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="no nrlsmf shards left running",
+)
+
+# Multi-queue vif devices
+section("Start nrlsmf device vif0,eth0,queues=2 device vif1,eth1,queues=2 merge vif0,vif1 on r1 ")
+
+step(
+    "r1",
+    "nrlsmf debug 4 device vif0,eth0,queues=2 device vif1,eth1,queues=2 merge vif0,vif1 &> nrlsmf-mqvif.log &",
+)
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-mqvif.log',
+    match='"merge" vif0,vif1',
+    desc="nrlsmf-mqvif.log contains merge group for vif0,vif1",
+)
+
+wait_step(
+    "r1",
+    "ls /sys/class/net/vif0/queues",
+    match="tx-1",
+    desc="vif0 device has multiple queues",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via multi-queue vif merge",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
+# Offloading (IFF_VNET_HDR) vif devices
+section("Start nrlsmf device vif0,eth0,offload device vif1,eth1,offload merge vif0,vif1 on r1 ")
+
+step(
+    "r1",
+    "nrlsmf debug 4 device vif0,eth0,offload device vif1,eth1,offload merge vif0,vif1 &> nrlsmf-offload.log &",
+)
+
+wait_step(
+    "r1",
+    'grep  "regular group" nrlsmf-offload.log',
+    match='"merge" vif0,vif1',
+    desc="nrlsmf-offload.log contains merge group for vif0,vif1",
+)
+
+wait_step(
+    "r1",
+    "ethtool -k vif0 | grep tcp-segmentation-offload",
+    match="tcp-segmentation-offload: on",
+    desc="vif0 device has TSO enabled",
+)
+
+wait_step(
+    "h2",
+    "tail -n1 iperf-server.log",
+    match="8 pps",
+    desc="Receiving 239.0.0.1 at full rate of 8 pps via offloading vif merge",
+)
+
+step("r1", "pkill nrlsmf")
+
+wait_step(
+    "r1",
+    'pgrep -af "nrlsmf"',
+    match="",
+    desc="stopped nrlsmf",
+)
+
 # Classic flooding
 section("Start nrlsmf with classic flooding on r1 ")
 step(